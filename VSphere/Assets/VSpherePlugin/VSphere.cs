@@ -23,9 +23,9 @@ public class VSphere : MonoBehaviour
     [DllImport(VSphereLibrary)]
     private static extern bool PrepareSphere(bool open_console, int recorder_frame_duration_ms);
     [DllImport(VSphereLibrary)]
-    private static extern int GetInternalData(string data_element);
+    private static extern bool SetControl(int control, int value);
     [DllImport(VSphereLibrary)]
-    private static extern bool SetInternalData(string data_element);
+    private static extern int GetQuery(int query);
     [DllImport(VSphereLibrary)]
     private static extern int ConfigureCamera(int hardware_index, int hardware_channel, int focus_value, int location_x, int location_y, int location_z, int offset_x, int offset_y, int offset_z);
     [DllImport(VSphereLibrary)]
@@ -55,6 +55,18 @@ public class VSphere : MonoBehaviour
 
 
 
+    // Values of the enums VSphereControl and VSphereQuery (see PluginDataTypes.h of the DLL)
+
+    const int ControlShowFullRays = 0;
+    const int ControlPreviewType = 1;
+    const int ControlPreviewWindowVariant = 2;
+    const int ControlPreviewWindowOrderOffset = 3;
+
+    const int QueryPreviewType = 3;
+    const int QueryPreviewWindowOrderOffset = 5;
+
+
+
     // Settings
 
     bool paused = false; // Stopped updating or not
@@ -405,7 +417,7 @@ public class VSphere : MonoBehaviour
 
         set
         {
-            SetInternalData(value ? "Full rays: true" : "Full rays: false");
+            SetControl(ControlShowFullRays, value ? 1 : 0);
             fullRays = value;
         }
     }
@@ -433,7 +445,7 @@ public class VSphere : MonoBehaviour
         set
         {
             previewType = value;
-            SetInternalData("Preview type: " + previewType.ToString());
+            SetControl(ControlPreviewType, previewType);
         }
     }
 
@@ -447,7 +459,7 @@ public class VSphere : MonoBehaviour
         set
         {
             previewWindowOrderOffset = value;
-            SetInternalData("Preview window order offset: " + previewWindowOrderOffset.ToString());
+            SetControl(ControlPreviewWindowOrderOffset, previewWindowOrderOffset);
         }
     }
 
@@ -462,9 +474,9 @@ public class VSphere : MonoBehaviour
         {
             previewEnabled = value;
             if (!previewEnabled)
-                SetInternalData("Preview window variant: 0");
+                SetControl(ControlPreviewWindowVariant, 0);
             else
-                SetInternalData("Preview window variant: " + PreviewWindowVariant.ToString());
+                SetControl(ControlPreviewWindowVariant, PreviewWindowVariant);
         }
     }
 
@@ -478,32 +490,32 @@ public class VSphere : MonoBehaviour
         set
         {
             previewWindowVariant = value;
-            SetInternalData("Preview window variant: " + PreviewWindowVariant.ToString());
+            SetControl(ControlPreviewWindowVariant, PreviewWindowVariant);
         }
     }
 
     internal void nextPreviewType()
     {
-        SetInternalData("Next preview type");
-        previewType = GetInternalData("Preview type");
+        SetControl(ControlPreviewType, -2);
+        previewType = GetQuery(QueryPreviewType);
     }
 
     internal void lastPreviewType()
     {
-        SetInternalData("Last preview type");
-        previewType = GetInternalData("Preview type");
+        SetControl(ControlPreviewType, -1);
+        previewType = GetQuery(QueryPreviewType);
     }
 
     internal void nextPreviewWindowOrderOffset()
     {
-        SetInternalData("Next preview window order offset");
-        previewWindowOrderOffset = GetInternalData("Preview window order offset");
+        SetControl(ControlPreviewWindowOrderOffset, -2);
+        previewWindowOrderOffset = GetQuery(QueryPreviewWindowOrderOffset);
     }
 
     internal void lastPreviewWindowOrderOffset()
     {
-        SetInternalData("Last preview window order offset");
-        previewWindowOrderOffset = GetInternalData("Preview window order offset");
+        SetControl(ControlPreviewWindowOrderOffset, -1);
+        previewWindowOrderOffset = GetQuery(QueryPreviewWindowOrderOffset);
     }
 
 }
\ No newline at end of file
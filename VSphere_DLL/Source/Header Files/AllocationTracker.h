@@ -0,0 +1,50 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include <atomic>
+
+#include "PluginDataTypes.h"
+
+
+// Instrumented build: Count every heap allocation of the DLL per thread and stage (replaces the global operator new).
+// Defined by the Release-TrackAllocations configuration of the solution (the DLL is copied into Unity like the Release build).
+//#define TRACK_ALLOCATIONS
+
+// Threads counted separately (all further threads share the last counters)
+#define ALLOCATION_TRACKED_THREADS 64
+
+
+class AllocationTracker
+{
+private:
+	struct ThreadCounters
+	{
+		atomic<long long> allocations[ALLOCATION_STAGE_COUNT];
+		atomic<long long> bytes[ALLOCATION_STAGE_COUNT];
+		atomic<int> role;
+		atomic<int> index;
+	};
+
+	static ThreadCounters counters[ALLOCATION_TRACKED_THREADS];
+	static atomic<int> thread_count;
+
+	// Counters and current stage of the calling thread
+	static thread_local int thread_slot;
+	static thread_local int thread_stage;
+
+	static int getSlot();
+
+public:
+	static bool isEnabled();
+
+	static void countAllocation(size_t size);
+
+	static void setStage(int stage);
+	static void nameThread(int role, int index);
+
+	static long long getThreadAllocations();
+
+	static int getStatistics(AllocationStatistics * statistics, int max_count);
+	static void reset();
+};
@@ -5,10 +5,26 @@
 #include <vector>
 
 
+// States of a block of the coarse level (see BackgroundReference::computePyramidMask)
+#define COARSE_OBJECT 1			// The sample of the block is not background
+#define COARSE_TESTED 2			// The pixels of the block have been classified at full resolution (near the coarse boundary)
+#define COARSE_UNSAMPLED 4		// The block is not completely inside the window and has no sample
+
+// The coarse level of the last binary mask. The blocks which have not been tested are filled with the class of their sample.
+struct CoarseMask
+{
+	uchar * states = nullptr;
+	int block_size = 1;			// 1 = no coarse level (every pixel has been classified at full resolution)
+	int blocks_w = 0, blocks_h = 0;
+};
+
+
 class BackgroundReference
 {
 private:
 	int background_color_tolerance;
+	float adaptation_rate;
+	float variance_factor;
 
 	Mat * background = nullptr;
 	bool * binaryMask = nullptr;
@@ -19,24 +35,67 @@ private:
 
 	int pixelcount;
 
+	// Thresholds of the current frame (see computeRGBbinaryMask)
+	float tolerance_squared, max_tolerance_squared, variance_factor_squared;
+
+	// Coarse level (see computePyramidMask)
+	int pyramid_block_size;
+	int pyramid_frame = 0;
+	CoarseMask coarse_mask;
+	int fine_pixels = 0;		// Pixels classified at full resolution in the last frame
+
+	// Running model (3 floats per pixel in the same order as the frame)
+	float * mean = nullptr;
+	float * variance = nullptr;
+
+	// Sums while a new background is built from several frames
+	float * frame_sum = nullptr;
+	float * frame_square_sum = nullptr;
+	int accumulated_frames;
+
+	// Model built in the background from the running frames (see startShadowBackground)
+	float * shadow_mean = nullptr;
+	float * shadow_variance = nullptr;
+	int shadow_expected_frames = 0;
+	bool shadow_ready = false;
+
 
 	int expectedFrames;
-	double frameFactor;
 
 
+	void allocateModel();
+	void resetSums();
+	void computeModelFromSums(float * target_mean, float * target_variance);
+	void updateBackgroundImage();
+	void computeMaskSpan(int begin, int end);
+	void computePyramidMask(Rect window);
+	bool isBackgroundPixel(int i);
+	void adaptPixel(int i);
+
 public:
 	BackgroundReference();
 	~BackgroundReference();
 
+	void applyConfiguration(PipelineConfiguration * configuration);
+
 	void startNewBackground(Mat * frame, int expectedFrames);
 	void addFrame();
 	void finalizeBackground();
 
 	void computeRGBbinaryMask();
+	void computeRGBbinaryMask(Rect window);
+
+	void startShadowBackground(int expectedFrames);
+	void addShadowFrame();
+	bool isShadowBackgroundActive();
+	bool isShadowBackgroundReady();
+	void swapShadowBackground();
 
 	Mat * getBackground();
 	bool * getBinaryMask();
+	CoarseMask * getCoarseMask();
+	float getFinePixelShare();
 
 	void previewNonbackgroundImageRGB(cv::Mat * dest, bool onlyBinary);
 	//void previewNonbackgroundImageHSV(cv::Mat * dest, bool onlyBinary);
-};
\ No newline at end of file
+};
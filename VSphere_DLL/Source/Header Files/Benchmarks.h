@@ -3,6 +3,9 @@
 #include "simplifyingHeader.h"
 
 #include <chrono>
+#include <atomic>
+
+#include "PluginDataTypes.h"
 
 using namespace std::chrono;
 
@@ -73,4 +76,33 @@ public:
 
 	void printAverageFull(float everySeconds, std::string str);
 	void printAverageFull(float everySeconds, const char* str);
-};
\ No newline at end of file
+};
+
+
+
+// Buckets of a latencyHistogram: exact below 64 microseconds, above 32 buckets per power of two (at most 3% too high)
+#define LATENCY_EXACT_BUCKETS 64
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_BUCKET_COUNT (LATENCY_EXACT_BUCKETS + (32 - 6) * (1 << LATENCY_SUB_BUCKET_BITS))
+
+class latencyHistogram
+{
+private:
+	atomic<unsigned int> buckets[LATENCY_BUCKET_COUNT];
+	atomic<unsigned int> count;
+	atomic<unsigned long long> sum, square_sum, max_value; // In microseconds
+
+	static int bucketOf(unsigned int microseconds);
+	static unsigned int bucketValue(int bucket);
+
+public:
+	latencyHistogram();
+
+	void record(double microseconds);
+	high_resolution_clock::time_point recordSince(high_resolution_clock::time_point start);
+
+	void resetValues();
+
+	double getPercentile(double percentile);
+	void fillStatistics(LatencyStatistics * target);
+};
@@ -4,6 +4,8 @@
 
 #include "CameraSource.h"
 
+class RecordingHandler;
+
 class CameraHandler
 {
 private:
@@ -12,6 +14,8 @@ private:
 	set<int> cameras_with_subchannels;
 	bool isGrabberChannel(int cameraIndex);
 
+	void negotiateDevice(CameraSource * source, vector2di * size, double * fps);
+
 
 public:
 	int addCamera(int cameraIndex, vector2di size, vector3df origin, vector3df offset, double focus_value);
@@ -21,6 +25,8 @@ public:
 
 	int getCount();
 
+	void negotiateModes(RecordingHandler * records);
+
 	CameraSource * getCameraSource(int list_index);
 };
 
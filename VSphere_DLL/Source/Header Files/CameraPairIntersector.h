@@ -0,0 +1,74 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "RayGenerator.h"
+#include "Ray3D.h"
+#include "CustomMath.h"
+
+
+// A pair of intersecting rays of the two cameras with the values both ModelBuilders need (see ModelBuilder::storePairIntersection)
+struct PairIntersection
+{
+	int ray_first, ray_second; // Indices in the rays of both cameras
+
+	// Factors along the intersection line (direction: normal of the first ray x normal of the second ray)
+	float pos_first_start, pos_first_end, pos_second_start, pos_second_end;
+
+	// Positions along the rays where the intersection line crosses their edges (like this_ray_pos_start in ModelBuilder)
+	float length_first_start, length_first_end, length_second_start, length_second_end;
+
+	// |sin| and cos of the angle between the intersection line and the direction of each camera
+	float sine_first, cosine_first, sine_second, cosine_second;
+};
+
+
+class CameraPairIntersector
+{
+private:
+	// Work and result of a part of the rays of the first camera (only used by one thread at a time)
+	struct PairSlice
+	{
+		vector<PairIntersection> intersections;
+		vector<int> candidates;
+		NarrowPhaseBatch batch;
+	};
+
+	RayGenerator * first_generator, * second_generator;
+	vector<Ray3D*> * first_rays, * second_rays;
+
+	int max_ray_length;
+	int intersection_engine;
+	bool batched_narrow_phase;
+
+	NarrowPhaseConstants constants;
+
+	// Sweep engine (like ModelBuilder::prepareSweep)
+	bool sweep_possible;
+	vector3df sweep_normal;
+	vector<pair<float, int>> sweep_order;
+	float sweep_max_width_sq;
+
+	vector<PairSlice*> slices;
+
+
+	void prepareConstants();
+	void collectCandidates(Ray3D * ray, vector<int> * candidates);
+
+public:
+	CameraPairIntersector(RayGenerator * first_generator, RayGenerator * second_generator, int slice_count);
+	~CameraPairIntersector();
+
+	void applyConfiguration(PipelineConfiguration * configuration);
+
+	void prepareSweep();
+	void intersectSlice(int slice);
+	int getSliceCount();
+
+	static void intersectTasks(vector<CameraPairIntersector*> * pairs, int worker, int worker_count);
+
+	void collect(bool first_camera, vector<int> * offsets, vector<PairIntersection*> * order);
+
+	vector<Ray3D*> * getRays(bool first_camera);
+	bool involves(RayGenerator * ray_generator, bool * first_camera);
+};
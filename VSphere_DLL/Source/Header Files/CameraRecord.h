@@ -2,6 +2,8 @@
 
 #include "simplifyingHeader.h"
 
+#include <fstream>
+
 
 class CameraRecord
 {
@@ -13,6 +15,17 @@ private:
 	cv::VideoWriter * video_writer = nullptr;
 	cv::VideoCapture * video_reader = nullptr;
 
+	// Media timestamp of every frame (see MediaClock)
+	vector<long long> timestamps;
+	ofstream * timestamp_writer = nullptr;
+
+	// Index of the record on the media clock (-1 if it is not synchronized), the frame the reader reads next,
+	// offset of the last played frame from the play position and the loop it belongs to
+	int clock_record = -1;
+	int next_frame = 0;
+	long long frame_offset = 0;
+	int loop = 0;
+
 
 public:
 
@@ -31,4 +44,17 @@ public:
 
 	bool getJustLooped();
 
+	vector<long long> * getTimestamps();
+	void setTimestampWriter(ofstream * timestamp_writer);
+	ofstream * getTimestampWriter();
+
+	void setClockRecord(int clock_record);
+	int getClockRecord();
+	void setNextFrame(int next_frame);
+	int getNextFrame();
+	void setFrameOffset(long long frame_offset);
+	long long getFrameOffset();
+	void setLoop(int loop);
+	int getLoop();
+
 };
\ No newline at end of file
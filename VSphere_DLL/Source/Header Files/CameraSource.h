@@ -11,13 +11,19 @@ private:
 	int cam_index;
 	int channel = 0;
 	bool is_grabber_channel;
-	vector2di * size;
+	vector2di * size;			// Pixels of the frames (the negotiated mode, see CameraHandler::negotiateModes)
+	vector2di * requested_size;
+	double fps, requested_fps;	// 0 = whatever the camera delivers
+	bool mode_negotiated = false;
+	float view_width;			// Width of the virtual camera plane in space (it keeps its extent whatever the resolution)
+	float pixel_size;			// Units in space per pixel
 	vector3df * origin;
 	quaternion * direction;
 	vector3df * to_corner;
 	double focus_value;
 	string cam_name;
 
+	void computeCorner();
 
 public:
 	CameraSource();
@@ -34,6 +40,15 @@ public:
 	vector2di getSize();
 	int getPixelCount();
 
+	void requestMode(vector2di size, double fps);
+	vector2di getRequestedSize();
+	double getRequestedFps();
+
+	void setMode(vector2di size, double fps);
+	bool getModeNegotiated();
+	double getFps();
+	float getPixelSize();
+
 
 	vector3df getOrigin();
 
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "PerCamControler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+
+class CapturePool
+{
+private:
+	// A hardware device with all cameras which are channels of it
+	struct CaptureDevice
+	{
+		int index;							// Hardware index of the device
+		VideoCapture * capture;
+		mutex lock;							// Serializes grabbing and retrieving outside of grabAll() (see PerCamControler::initializeProcessing)
+		vector<PerCamControler*> channels;
+		high_resolution_clock::time_point grabbed;
+	};
+
+	vector<CaptureDevice*> devices;
+	vector<PerCamControler*> played_cameras;	// Cameras played from a record (their frames are read by their tasks)
+
+	// Start barrier of the grabbers
+	mutex pool_lock;
+	condition_variable grab_requested;
+	condition_variable grabs_finished;
+	int generation = 0;
+	int pending_grabs = 0;
+	atomic<int> arrived_grabbers;
+	bool stopping = false;
+
+	vector<thread*> grabbers;
+	bool use_priorities = false;
+
+
+	CaptureDevice * findDevice(int index);
+
+	void grabDevice(CaptureDevice * device);
+
+	static void launchGrabber(CapturePool * pool, int grabber);
+	void grabberLoop(int grabber);
+
+public:
+	CapturePool();
+	~CapturePool();
+
+	VideoCapture * openDevice(CameraSource * source);
+	mutex * getDeviceLock(int index);
+
+	void addCamera(PerCamControler * controler, bool live);
+	void start();
+
+	void grabAll();
+};
@@ -23,28 +23,38 @@ private:
 	int pixelcount;
 	int mask_pixelcount;
 	int contour_mask_pixelcount;
+	int allocated_mask_pixelcount = 0;
 
 	int frame_w, frame_h;
 	int grid_w, grid_h;
+	Rect computed_cells;	// Window of the last computation (see computeContour(Rect))
 
 	bool * contour_pixels = nullptr;
 
 	int * contour_keypooints_grid = nullptr;
 	int * inout_grid = nullptr;
+	bool * cleared_cells = nullptr;	// Cells without any contour pixel set in contour_pixels (a uniform cell does not have to clear them again)
 
 
 	// references from other components
 
 	bool * binaryMask;
+	CoarseMask * coarse_mask;
+
+
+	int getUniformCellState(int x, int y);
 
 public:
 	ContoursExtractor();
 	~ContoursExtractor();
 
-	void initData(Mat * frame, Mat * background, bool * binaryMask);
+	void initData(Mat * frame, Mat * background, bool * binaryMask, CoarseMask * coarse_mask);
+
+	bool applyConfiguration(PipelineConfiguration * configuration);
 
 	//void computeContoursPixels();
 	void computeContour();
+	void computeContour(Rect cells);
 
 	int * getContourGrid();
 	int * getInoutGrid();
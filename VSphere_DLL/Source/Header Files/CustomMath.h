@@ -5,9 +5,58 @@
 #include <Ray3D.h>
 
 
+// Number of pairs of rays handled by one call of CustomMath::compute_narrow_phase_batch() (one AVX2 register of floats)
+#define NARROW_PHASE_BATCH 8
+
+// Relative tolerance of the differential tests of the batched narrow phase
+#define NARROW_PHASE_TOLERANCE 0.001f
+
+
+// Values of a pair of cameras which are the same for all pairs of rays (see ModelBuilder::referenceAnotherRayGenerator)
+struct NarrowPhaseConstants
+{
+	vector3df cam_vec, cam_vec_norm, other_vec, other_vec_norm;
+	float cam_dot, other_dot, ab_dot, quotient;
+};
+
+// One own ray and up to NARROW_PHASE_BATCH rays of another camera, stored as a structure of arrays
+struct NarrowPhaseBatch
+{
+	int count = 0;
+
+	// Own ray
+	vector3df origin, origin_start, origin_end, normal;
+	float width_sq;
+
+	// Other rays
+	float origin_x[NARROW_PHASE_BATCH], origin_y[NARROW_PHASE_BATCH], origin_z[NARROW_PHASE_BATCH];
+	float start_x[NARROW_PHASE_BATCH], start_y[NARROW_PHASE_BATCH], start_z[NARROW_PHASE_BATCH];
+	float end_x[NARROW_PHASE_BATCH], end_y[NARROW_PHASE_BATCH], end_z[NARROW_PHASE_BATCH];
+	float normal_x[NARROW_PHASE_BATCH], normal_y[NARROW_PHASE_BATCH], normal_z[NARROW_PHASE_BATCH];
+	float other_width_sq[NARROW_PHASE_BATCH];
+
+	// Results (only meaningful where valid is not 0)
+	int valid[NARROW_PHASE_BATCH]; // Close enough, planes not parallel and intersection line not parallel to either ray
+	float pos_this_start[NARROW_PHASE_BATCH], pos_this_end[NARROW_PHASE_BATCH];
+	float pos_other_start[NARROW_PHASE_BATCH], pos_other_end[NARROW_PHASE_BATCH];
+	float this_ray_pos_start[NARROW_PHASE_BATCH], this_ray_pos_end[NARROW_PHASE_BATCH];
+	float sine[NARROW_PHASE_BATCH], cosine[NARROW_PHASE_BATCH]; // |sin| and cos of the angle between the intersection line and the camera direction
+
+	// The same seen from the other ray (used when a pair of cameras is intersected once for both, see CameraPairIntersector)
+	float other_ray_pos_start[NARROW_PHASE_BATCH], other_ray_pos_end[NARROW_PHASE_BATCH];
+	float other_sine[NARROW_PHASE_BATCH], other_cosine[NARROW_PHASE_BATCH];
+
+
+	void setRay(Ray3D * ray);
+	void addOtherRay(Ray3D * other_ray);
+};
+
 
 class CustomMath
 {
+private:
+	static int count_narrow_phase_mismatches(const NarrowPhaseBatch & computed, const NarrowPhaseBatch & reference, float tolerance);
+
 public:
 	static void RGB2HSV(float r, float g, float b,
 		float &h, float &s, float &v);
@@ -20,6 +69,13 @@ public:
 
 	static int compute_plane_collission(vector3df normal_a, vector3df normal_b, vector3df base_a, vector3df base_b, vector3df * line_orig, vector3df * line_target);
 
+	static bool narrow_phase_uses_avx2();
+	static void compute_narrow_phase_batch(const NarrowPhaseConstants & constants, NarrowPhaseBatch * batch);
+	static void compute_narrow_phase_batch_scalar(const NarrowPhaseConstants & constants, NarrowPhaseBatch * batch);
+	static void compute_narrow_phase_reference(const NarrowPhaseConstants & constants, NarrowPhaseBatch * batch);
+	static int check_narrow_phase_batch(const NarrowPhaseConstants & constants, const NarrowPhaseBatch & batch, float tolerance);
+	static int check_narrow_phase_paths(float tolerance, int * checked_pairs);
+
 	static double lengthdir_x(double len, double dir);
 	static double lengthdir_y(double len, double dir);
 };
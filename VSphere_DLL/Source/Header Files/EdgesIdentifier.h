@@ -27,18 +27,29 @@ private:
 	vector<int> segments_end;
 	vector<bool> segments_orientation;
 
+	// Work queues of computeEdges() (members to keep their capacity from frame to frame)
+	vector<int> gridcord_q;
+	vector<int> segment_start_q;
+	vector<int> directions_q;
+
 
 	// references from other components
 
 	int * contours_grid;
 	int * inout_grid;
 
+
+	void mergeEdges();
+
 public:
 	EdgesIdentifier();
 
 	void initData(int frame_w, int frame_h, int * contours_grid, int * inout_grid);
 
-	void computeEdges(bool optimise, valueBench * bench);
+	void applyConfiguration(PipelineConfiguration * configuration);
+
+	void computeEdges(bool merge_optimizable_edges, valueBench * bench);
+	void computeEdges(bool merge_optimizable_edges, valueBench * bench, Rect cells);
 
 
 	vector<int> * getEdgesStarts();
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "PerCamControler.h"
+#include "CameraPairIntersector.h"
+#include "VoxelCarver.h"
+#include "MeshExtractor.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+class FrameScheduler
+{
+private:
+	enum TaskKind
+	{
+		TASK_INITIALIZE,	// PerCamControler::initializeProcessing()
+		TASK_SEGMENT,		// PerCamControler::processFrame() (segments and rays)
+		TASK_INTERSECT,		// CameraPairIntersector::intersectSlice()
+		TASK_CONTENT,		// PerCamControler::computeContent() (gathering the intersections and quads)
+		TASK_CARVE,			// VoxelCarver::carveSlice()
+		TASK_EXTRACT,		// VoxelCarver::extractSlice()
+		TASK_MESH_BLOCK,	// MeshExtractor::buildBlock()
+		TASK_MESH_LAYOUT,	// MeshExtractor::layoutMesh()
+		TASK_MESH_WRITE		// MeshExtractor::writeBlock()
+	};
+
+	struct SchedulerTask
+	{
+		int kind;
+		int index;					// Camera or pair
+		int slice;					// Slice of a pair
+		int node;					// Home node of the camera (ready queue the task is put into)
+		int dependencies;			// Number of tasks which have to be finished before this one can start
+		vector<int> successors;		// Tasks which depend on this one
+		int remaining;				// Dependencies not finished yet in the running graph (guarded by queue_lock)
+	};
+
+	vector<PerCamControler*> * camera_controlers;
+	vector<CameraPairIntersector*> * camera_pairs;
+	VoxelCarver * voxel_carver;
+	MeshExtractor * mesh_extractor;
+
+	// The graphs are built once and run again for every frame
+	vector<SchedulerTask> initialization_graph;
+	vector<SchedulerTask> frame_graph;			// Frame without shared pairs (every camera intersects its own rays) and with the polyhedral hull
+	vector<SchedulerTask> shared_pairs_graph;	// Frame with the intersect tasks of the shared pairs (see CONFIG_SHARED_PAIR_INTERSECTION)
+	vector<SchedulerTask> carving_graph;		// Frame with RECONSTRUCTION_ENGINE_VOXELS
+
+	// State of the running graph
+	vector<SchedulerTask> * running_graph = nullptr;
+	vector<vector<int>> ready_tasks;	// One queue per NUMA node (only one unless pinning per node)
+	vector<int> ready_heads;			// Next task to take from every queue (a task enters a queue once per run, so nothing is removed)
+	bool home_only = false;				// The tasks of the running graph are not taken by workers of other nodes (the initialization)
+	int unfinished_tasks = 0;
+	bool surface_mesh = false;
+	bool stopping = false;
+
+	mutex queue_lock;
+	condition_variable graph_finished;
+
+	// Every worker waits on its own condition; a ready task wakes one idle worker, preferably of its home node
+	vector<condition_variable*> worker_wakeups;
+	vector<bool> worker_idle;
+	vector<vector<int>> idle_workers;	// Per NUMA node
+
+	vector<thread*> workers;
+
+	// Placement of the workers (see ThreadPlacement)
+	vector<int> worker_processors;
+	vector<int> worker_nodes;
+	vector<int> node_workers;			// Number of workers per node
+	bool use_priorities;
+
+	latencyHistogram * slice_latency;
+
+
+	int addTask(vector<SchedulerTask> * graph, int kind, int index, int slice);
+	static void addDependency(vector<SchedulerTask> * graph, int before, int after);
+
+	void buildGraphs();
+	void buildCarvingGraph();
+	void assignNodes(vector<SchedulerTask> * graph);
+	void runGraph(vector<SchedulerTask> * graph);
+	void queueTask(vector<SchedulerTask> * graph, int task);
+	int findTaskNode(int own_node);
+
+	static void launchWorker(FrameScheduler * scheduler, int worker);
+	void workerLoop(int worker);
+	void executeTask(SchedulerTask * task);
+
+public:
+	FrameScheduler(vector<PerCamControler*> * camera_controlers, vector<CameraPairIntersector*> * camera_pairs, VoxelCarver * voxel_carver, MeshExtractor * mesh_extractor, int worker_count, latencyHistogram * slice_latency);
+	~FrameScheduler();
+
+	static int resolveWorkerCount(int configured_count);
+
+	void initializeCameras();
+	void processFrame();
+
+	int getWorkerCount();
+};
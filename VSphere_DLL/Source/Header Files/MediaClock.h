@@ -0,0 +1,48 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include <chrono>
+
+
+class MediaClock
+{
+private:
+	// A played record with its timestamps from first to last
+	struct PlayedRecord
+	{
+		long long first_timestamp;
+		long long last_timestamp;
+		long long frame_interval;
+		long long offset;			// Added to the play position to get the timestamp of the record (see alignRecords)
+	};
+
+	high_resolution_clock::time_point origin;
+
+	// Position in the played records (their timestamps, see RecordingHandler)
+	vector<PlayedRecord> records;
+	bool aligned_on_starts = false;
+	bool started = false;
+	long long play_start = 0;
+	long long play_end = 0;
+	long long play_step = 0;
+	long long play_position = 0;
+	int loop_count = 0;
+
+	void alignRecords();
+
+public:
+	MediaClock();
+
+	void setOrigin(high_resolution_clock::time_point origin);
+	long long toMediaTime(high_resolution_clock::time_point time);
+
+	int addPlayedRecord(long long first_timestamp, long long last_timestamp, long long frame_interval);
+
+	void beginFrame();
+
+	long long getPlayPosition();
+	long long getRecordPosition(int record);
+	long long getFrameInterval();
+	int getLoopCount();
+};
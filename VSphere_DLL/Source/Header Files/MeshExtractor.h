@@ -0,0 +1,53 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "VoxelCarver.h"
+
+
+class MeshExtractor
+{
+private:
+	// The part of the mesh of a slice of the VoxelCarver
+	struct MeshBlock
+	{
+		// Vertices owned by this block: corner of the voxels -> number in the block (open addressing, see findVertex)
+		vector<int> table_corners;
+		vector<int> table_vertices;
+		vector<int> table_stamps;	// Entries of older frames count as empty
+		int table_mask = 0;
+		int stamp = 0;
+
+		vector<int> vertices;		// 5 values per vertex (see getVertices)
+		vector<int> faces;			// 4 corners per face of a voxel (linear index of the corner)
+		int first_vertex, first_index;
+	};
+
+	VoxelCarver * voxel_carver;
+	vector<MeshBlock*> blocks;
+
+	vector<int> mesh_vertices;
+	vector<int> mesh_indices;
+
+
+	int cornerIndex(int x, int y, int z);
+	int cornerOwner(int x, int y, int z);
+	int findVertex(MeshBlock * block, int corner);
+	void insertVertex(MeshBlock * block, int corner, int vertex);
+
+	void addFace(MeshBlock * block, int block_index, int corners[4][3]);
+	void addVertex(MeshBlock * block, int x, int y, int z);
+
+public:
+	MeshExtractor(VoxelCarver * voxel_carver);
+	~MeshExtractor();
+
+	void buildBlock(int block);
+	void layoutMesh();
+	void writeBlock(int block);
+
+	vector<int> * getVertices();
+	vector<int> * getIndices();
+
+	int countOpenEdges();
+};
@@ -4,6 +4,8 @@
 
 #include "RayGenerator.h"
 #include "Ray3D.h"
+#include "CustomMath.h"
+#include "CameraPairIntersector.h"
 
 
 
@@ -23,6 +25,28 @@ private:
 	vector<float> ab_direction_dots;
 	vector<float> quotients;
 
+	// Sweep engine (per other camera; see prepareSweep)
+	int intersection_engine;
+	vector<bool> sweep_possible;
+	vector<vector3df> sweep_normals;
+	vector<vector<pair<float, int>>> sweep_orders;
+	vector<float> sweep_max_width_sq;
+
+	// Rays of another camera tested with the current own ray
+	vector<int> candidates;
+
+	// Batched narrow phase (see CustomMath::compute_narrow_phase_batch)
+	bool batched_narrow_phase;
+	vector<NarrowPhaseConstants> narrow_phase_constants;
+	NarrowPhaseBatch narrow_phase_batch;
+
+	// Intersections shared with the other cameras (per other camera; see CameraPairIntersector)
+	bool shared_pair_intersection;
+	vector<CameraPairIntersector*> pair_intersectors;
+	vector<bool> pair_is_first;
+	vector<vector<int>> pair_offsets;
+	vector<vector<PairIntersection*>> pair_orders;
+
 
 	vector<int> debug_quads;
 
@@ -31,6 +55,12 @@ private:
 
 	int dbg_test = 0;
 
+	int intersection_count = 0;
+
+	// Whether the quads are built per sub-ray (required for merged edges, see Ray3D::addAsModelSubQuads())
+	bool exact_subray_quads;
+	SubRayWorkspace subray_workspace;
+
 
 	boolean currently_A = true;
 
@@ -73,15 +103,33 @@ private:
 	vector<Ray3D*> * rays;
 
 
+	void prepareSweep();
+	void collectSweepCandidates(Ray3D * ray, int other_set);
+	void prepareNarrowPhaseConstants();
+	bool intersectRayPair(Ray3D * ray, Ray3D * other_ray, int other_set, int intersect_ind);
+	bool storeBatchIntersection(Ray3D * ray, Ray3D * other_ray, int lane, int intersect_ind);
+	bool usesPairIntersections();
+	bool storePairIntersection(Ray3D * ray, PairIntersection * intersection, int other_set, int intersect_ind);
+	bool classifyOverlap(float pos_this_start, float pos_this_end, float pos_other_start, float pos_other_end, float * start_y, float * end_y);
+	void storeIntersection(Ray3D * ray, Ray3D * other_ray, int intersect_ind, float start_y, float end_y, float this_ray_pos_start, float this_ray_pos_end, double intersection_sine, double intersection_cos);
+
+
 public:
 
 	ModelBuilder();
 	~ModelBuilder();
 
 	void referenceAnotherRayGenerator(RayGenerator * ray_generator, bool finalize_with_own_ray_generator);
+	void referencePairIntersector(CameraPairIntersector * pair_intersector);
+
+	void applyConfiguration(PipelineConfiguration * configuration);
 
 	void intersectRays();
 	void computeModelPart(vector<int> * output_content);
+
+	int getIntersectionCount();
+
+	int checkNarrowPhase(float tolerance, int * pairs_checked);
 };
 
 
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+
+class ModelDetailLevels
+{
+private:
+	vector<vector<int>*> levels;	// Index: level - 1 (level 0 are the quads themselves)
+	int level_count = 0;
+
+	vector<bool> joined_quads;		// Quads already part of a run of the current level
+
+
+	bool nearCorner(int * corner, int * other, float tolerance_sq);
+	bool nearTexture(int * texture, int * other);
+	int joins(int * last, int * next);
+	bool alongRun(int * head, int * next);
+
+public:
+	ModelDetailLevels();
+	~ModelDetailLevels();
+
+	void computeLevels(vector<int> * quads, int level_count);
+
+	int getLevelCount();
+	vector<int> * getLevel(int level);
+};
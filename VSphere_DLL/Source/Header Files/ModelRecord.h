@@ -0,0 +1,82 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "PluginDataTypes.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+
+
+class ModelRecord
+{
+private:
+	// A model on its way between the sphere loop and the file
+	struct RecordFrame
+	{
+		ModelTiming timing;
+		vector<int> quads;
+	};
+
+	// Adaptive Rice parameter of a value of the quads (see encodeModel)
+	struct RiceContext
+	{
+		long long magnitude_sum;
+		int count;
+	};
+
+	bool recording;
+	string file_path;
+	fstream file;
+	streampos first_frame;
+
+	vector<RecordFrame*> frames;
+	vector<RecordFrame*> free_frames;
+	vector<RecordFrame*> queued_frames;		// To be written (recording) or decoded and waiting for the sphere loop (playback), oldest first
+
+	mutex record_lock;
+	condition_variable frame_queued;
+	condition_variable frame_freed;
+	bool stopping = false;
+	bool failed = false;
+
+	thread * io_thread = nullptr;
+	bool use_priorities = false;
+
+	vector<unsigned char> packed;			// Compressed model of the I/O thread
+
+	int frame_count = 0;
+	int dropped_frames = 0;
+	long long raw_bytes = 0;
+	long long packed_bytes = 0;
+
+
+	static int predictValue(const int * previous, const int * quad, int index);
+	static int riceParameter(RiceContext * context);
+	static void updateContext(RiceContext * context, unsigned int value);
+
+	bool writeFrame(RecordFrame * frame);
+	bool readFrame(RecordFrame * frame);
+
+	static void launchIoThread(ModelRecord * record);
+	void recordLoop();
+	void playLoop();
+
+public:
+	ModelRecord(bool recording, string file_path);
+	~ModelRecord();
+
+	bool getRecording();
+
+	bool start();
+
+	void recordModel(ModelTiming * timing, vector<int> * quads);
+
+	bool waitModel();
+	void takeModel(ModelTiming * timing, vector<int> * quads);
+
+	static void encodeModel(vector<int> * quads, vector<unsigned char> * packed);
+	static bool decodeModel(const unsigned char * packed, int packed_size, int quad_count, vector<int> * quads);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include <windows.h>
+
+#include "PluginDataTypes.h"
+
+
+class ModelStream
+{
+private:
+	HANDLE mapping = NULL;
+	char * view = nullptr;
+	ModelStreamHeader * header = nullptr;
+	HANDLE model_published[2] = { NULL, NULL };	// Manual-reset events of the even and odd sequences, the readers wait on them (see ModelStreamReader::waitModel)
+
+	ModelStreamSlot * getSlot(int slot);
+
+public:
+	ModelStream();
+	~ModelStream();
+
+	bool open(const char * name, int slot_quads);
+	void close();
+
+	void publish(int sequence, vector<int> * quads, ModelTiming * timing);
+};
@@ -0,0 +1,206 @@
+/*
+Reads the models the sphere publishes into shared memory (configuration key model_stream_quads, see ModelStream.cpp)
+from another process on the same host, without loading the plugin. Only needs this file and PluginDataTypes.h.
+
+The quads are used where they are in the shared memory, nothing is copied:
+
+	ModelStreamReader reader;
+	long long sequence = 0;
+	const ModelStreamSlot * model;
+	const int * quads;
+
+	if (reader.open())
+		while (reader.isActive())
+		{
+			if (reader.acquireLatest(sequence, &model, &quads))
+			{
+				// Render model->quad_count quads (20 ints each, see StartRetrievingModel())
+				if (reader.isValid())
+					sequence = reader.getSequence();	// Otherwise the sphere has overwritten the model meanwhile; drop what was rendered
+			}
+
+			reader.waitModel(sequence, 100);	// Sleeps until the sphere publishes a model after the one rendered
+		}
+
+The sphere overwrites the slot of a model MODEL_STREAM_SLOTS - 1 models later (see ModelStream.cpp), so a reader should finish with a model within that time.
+
+The reader keeps the shared memory alive when the sphere stops. A restarted sphere takes it over and begins a new session (see getSession);
+its sequences start at 1 again, which acquireLatest() takes into account, so the loop above simply goes on with the models of the new sphere.
+isActive() is false between both spheres, a reader which should survive a restart calls open() again until it succeeds and then keeps waiting.
+
+Any number of readers (in one or more processes) can wait at the same time, every published model wakes all of them.
+*/
+
+#pragma once
+
+#include <windows.h>
+#include <string>
+
+#include "PluginDataTypes.h"
+
+
+class ModelStreamReader
+{
+private:
+	HANDLE mapping = NULL;
+	HANDLE model_published[2] = { NULL, NULL };	// Events of the even and odd sequences (see ModelStream.cpp)
+	const char * view = nullptr;
+	const ModelStreamHeader * header = nullptr;
+
+	const ModelStreamSlot * slot = nullptr;
+	long long sequence = 0;
+	long long session = 0;
+
+public:
+	~ModelStreamReader()
+	{
+		close();
+	}
+
+	/*
+	Open the shared memory of a running sphere. Returns false if no sphere streams under the name.
+	*/
+	bool open(const char * name = MODEL_STREAM_NAME)
+	{
+		close();
+
+		mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+		if (mapping == NULL)
+			return(false);
+
+		view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		header = (const ModelStreamHeader*)view;
+
+		if ((view == nullptr) || (header->magic != MODEL_STREAM_MAGIC) || (header->version != MODEL_STREAM_VERSION))
+		{
+			close();
+			return(false);
+		}
+
+		MemoryBarrier(); // The layout has been written before the magic
+
+		// Without the events the reader polls (see waitModel)
+		for (int e = 0; e < 2; ++e)
+			model_published[e] = OpenEventA(SYNCHRONIZE, FALSE, (std::string(name) + MODEL_STREAM_EVENT_SUFFIX + std::to_string(e)).c_str());
+		return(true);
+	}
+
+	void close()
+	{
+		if (view != nullptr)
+			UnmapViewOfFile(view);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		for (int e = 0; e < 2; ++e)
+			if (model_published[e] != NULL)
+				CloseHandle(model_published[e]);
+
+		view = nullptr;
+		header = nullptr;
+		mapping = NULL;
+		model_published[0] = model_published[1] = NULL;
+		slot = nullptr;
+	}
+
+	/*
+	Whether the sphere still publishes models (it stops when it quits; the last models stay readable).
+	*/
+	bool isActive()
+	{
+		return((header != nullptr) && (header->active != 0));
+	}
+
+	/*
+	Sleep until the sphere has published a model after after_sequence (or stopped) or timeout_ms have passed. Returns false at the timeout.
+	Returns at once if there already is a newer model. After a restart of the sphere it waits for its first model (like acquireLatest).
+	Without the events (of an older sphere) it sleeps for the timeout.
+	*/
+	bool waitModel(long long after_sequence, DWORD timeout_ms)
+	{
+		if (header == nullptr)
+			return(false);
+
+		if (header->session != session)
+			after_sequence = 0;
+
+		if ((header->active == 0) || (header->latest_sequence > after_sequence))
+			return(true);
+
+		HANDLE next_model = model_published[(after_sequence + 1) % 2];
+		if (next_model == NULL)
+		{
+			Sleep(timeout_ms);
+			return(false);
+		}
+
+		return(WaitForSingleObject(next_model, timeout_ms) == WAIT_OBJECT_0);
+	}
+
+	/*
+	Take the newest complete model if it is newer than after_sequence. Returns false if there is none (yet).
+	A sequence of an earlier session (an earlier sphere) counts as no model, so the first model of a restarted sphere is taken.
+	*/
+	bool acquireLatest(long long after_sequence, const ModelStreamSlot ** model, const int ** quads)
+	{
+		if (header == nullptr)
+			return(false);
+
+		// A starting sphere is resetting the slots
+		long long current_session = header->session;
+		MemoryBarrier();
+		if (current_session % 2 != 0)
+			return(false);
+
+		if (current_session != session)
+			after_sequence = 0;
+
+		long long latest = header->latest_sequence;
+		if (latest <= after_sequence)
+			return(false);
+
+		const ModelStreamSlot * latest_slot = (const ModelStreamSlot*)(view + header->first_slot + (latest % header->slot_count) * header->slot_bytes);
+
+		// The model is complete if the slot tells its sequence (and is not being overwritten by a newer one)
+		long long state = latest_slot->state;
+		MemoryBarrier();
+
+		if ((state != 2 * latest) || (header->session != current_session))
+			return(false);
+
+		slot = latest_slot;
+		sequence = latest;
+		session = current_session;
+
+		*model = slot;
+		*quads = (const int*)(slot + 1);
+		return(true);
+	}
+
+	/*
+	Whether the acquired model has not been overwritten since acquireLatest(). Check it after using the model.
+	*/
+	bool isValid()
+	{
+		if (slot == nullptr)
+			return(false);
+
+		MemoryBarrier();
+		return((slot->state == 2 * sequence) && (header->session == session));
+	}
+
+	/*
+	Sequence of the acquired model (same as ModelTiming::sequence).
+	*/
+	long long getSequence()
+	{
+		return(sequence);
+	}
+
+	/*
+	Session of the acquired model. It changes when a restarted sphere takes over the shared memory, and its sequences start at 1 again.
+	*/
+	long long getSession()
+	{
+		return(session);
+	}
+};
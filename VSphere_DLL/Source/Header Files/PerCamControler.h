@@ -1,7 +1,6 @@
 #pragma once
 
 #include "simplifyingHeader.h"
-#include "thread"
 #include "atomic"
 #include <mutex>
 
@@ -9,8 +8,26 @@
 
 #include "BackgroundReference.h"
 #include "ContoursExtractor.h"
+#include "RegionOfInterest.h"
 #include "EdgesIdentifier.h"
 #include "ModelBuilder.h"
+#include "CameraPairIntersector.h"
+#include "VoxelCarver.h"
+#include "PolyhedralHull.h"
+#include "ModelDetailLevels.h"
+
+#include "PluginDataTypes.h"
+
+
+// Points in time of the frame processed by a camera (carried into the timing of the model, see SphereControler)
+struct FrameTiming
+{
+	high_resolution_clock::time_point captured, segmented, rays, intersected, quads;
+	long long media_us;		// Timestamp of the frame on the media clock (the recorded one for a played frame, see MediaClock)
+};
+
+
+class CapturePool;
 
 
 class PerCamControler
@@ -24,14 +41,12 @@ private:
 
 	int camera_list_index;
 
-	bool cam_running = false;
-
 	bool show_rays = false;
 
 	boolean initialized = false;
 
-	volatile bool compute_frame = false;
-	volatile bool has_computed = false;
+	// Set from outside to rebuild the background reference from the running frames
+	atomic<bool> background_recompute_requested;
 
 	mutex * computation_lock;
 
@@ -43,73 +58,100 @@ private:
 
 
 
-	int frame_task_mode, next_frame_task_mode;
+	// Configuration currently used by the processing objects of this camera
+	PipelineConfiguration * configuration;
+	int configuration_user;					// See Settings::acquireConfiguration
 
-	VideoCapture * capture = nullptr;
+	VideoCapture * capture = nullptr;		// Shared by all channels of the device (owned by the CapturePool)
+	mutex * device_lock = nullptr;
 	Mat current_frame, preview_image;
+	mutex frame_lock;
+
+	// Moment of the last grab and the timing of the current frame (only accessed by the tasks of a frame and between frames)
+	high_resolution_clock::time_point grab_time;
+	FrameTiming frame_timing;
 
 
 	// OUTPUT
 	vector<int> * output_content = new vector<int>;
+	ModelDetailLevels * detail_levels;		// Coarser levels of the output (configuration key detail_levels)
 
+	// Numbers of the last frame (read by the plugin interface from another thread)
+	CameraStatistics statistics;
+	mutex statistics_lock;
+	float frame_process_ms = 0;
+	bool sync_started = false;			// The first sync offset is taken again after a loop of the record (see recordSyncOffset)
+	float first_sync_offset_ms = 0;
 
+	timeBench bench = timeBench(0);
+	valueBench averageSegments;
+	valueBench averageComputingTime;
 
-	thread processing_thread;
-
-	// Semaphores and atomics for coordinating threads
-	//atomic<bool> running;
-	HANDLE controlSem, workerSem;
+	// Durations of the stages (read by the plugin interface from another thread)
+	latencyHistogram latencies[LATENCY_CAMERA_STAGE_COUNT];
 
 
 	/// Frame processing objects
 
 	BackgroundReference * background_reference;
 	ContoursExtractor * contours_extractor;
+	RegionOfInterest * region_of_interest;
 	EdgesIdentifier * edges_identifier;
 	RayGenerator * ray_generator;
 	ModelBuilder * model_computer;
 
-	/// Private functions
+	// Pairs of cameras intersected once for both (shared by all cameras, see CameraPairIntersector)
+	vector<CameraPairIntersector*> * camera_pairs = nullptr;
 
-	static void launchFrameLoop(PerCamControler * thisControler);
+	// Reconstruction engine shared by all cameras (used instead of the rays with RECONSTRUCTION_ENGINE_VOXELS)
+	VoxelCarver * voxel_carver = nullptr;
+	PolyhedralHull * polyhedral_hull = nullptr;	// RECONSTRUCTION_ENGINE_POLYHEDRAL
 
-	void frameLoop();
+	/// Private functions
 
 	void getFrame();
 
 	void updateModelTextureRegion();
 
+	void applyConfiguration(PipelineConfiguration * newest);
+
+	void handleBackgroundRecomputation();
+
 public:
 	PerCamControler(CameraHandler * cameraSet, RecordingHandler * records, int cameraListIndex, mutex * computation_lock);
 	~PerCamControler();
 
 
-	bool initialize();
+	bool initialize(CapturePool * capture_pool);
 
 	void referenceOtherCamera(PerCamControler * other_controler);
+	void takeCameraPairs(vector<CameraPairIntersector*> * camera_pairs);
+	void takeVoxelCarver(VoxelCarver * voxel_carver);
+	void takePolyhedralHull(PolyhedralHull * polyhedral_hull);
 
 
-	HANDLE getSem();
-	thread* getLoopThread();
-
-
-	void grabFrame();
+	// Called by the CapturePool between frames
+	void setGrabTime(high_resolution_clock::time_point grab_time);
+	void retrieveFrame();
+	bool isLive();
 
 	void takeTextureHandle(unsigned char* model_texture_data, int model_texture_width, int model_texture_height);
 	
 
 	Mat getCurrentFrame();
+	void takeSnapshot(Mat * frame, Mat * background);
 	Mat getPreviewImage();
 
 	RayGenerator * getRayGenerator();
 
-	void processNextFrame();
-
-	void computeFrameProcess();
-	void computeSphereContent();
+	// Tasks of the FrameScheduler
+	void initializeProcessing();
+	void processFrame();
+	void computeContent();
 
 
 	vector<int> * getSphereContent();
+	ModelDetailLevels * getDetailLevels();
 
 	
 	void computeBackgroundReference();
@@ -119,7 +161,12 @@ public:
 	bool getShowRays();
 	void setShowFullRays(bool show_rays);
 
-	bool hasComputed();
+	bool isInitialized();
+
+	void getStatistics(CameraStatistics * target);
+	latencyHistogram * getLatencyHistogram(int stage);
+	FrameTiming getFrameTiming();
+	void recordSyncOffset(float offset_ms);
 
 
 
@@ -130,10 +177,6 @@ public:
 	int getTexOffsetY();
 
 
-	// Quit the loop
-	void quit();
-
-
 	/*
 	void stopProcessing();
 
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "BackgroundReference.h"
+#include "ContoursExtractor.h"
+#include "RegionOfInterest.h"
+#include "EdgesIdentifier.h"
+#include "RayGenerator.h"
+#include "ModelBuilder.h"
+#include "CameraPairIntersector.h"
+#include "VoxelCarver.h"
+#include "MeshExtractor.h"
+#include "PolyhedralHull.h"
+#include "ModelDetailLevels.h"
+
+#include "PluginDataTypes.h"
+
+class SyntheticScene;
+
+
+class PipelineBenchmark
+{
+private:
+	// Snapshot of a camera and the processing objects working on it
+	struct BenchmarkCamera
+	{
+		CameraSource * camera_source;
+		Mat frame, background;
+		int tex_offs_x, tex_offs_y;
+
+		BackgroundReference * background_reference = nullptr;
+		ContoursExtractor * contours_extractor = nullptr;
+		RegionOfInterest * region_of_interest = nullptr;
+		EdgesIdentifier * edges_identifier = nullptr;
+		RayGenerator * ray_generator = nullptr;
+		ModelBuilder * model_computer = nullptr;
+
+		vector<int> output_content;
+		ModelDetailLevels * detail_levels = nullptr;
+	};
+
+	vector<BenchmarkCamera*> cameras;
+	vector<CameraPairIntersector*> camera_pairs;
+	VoxelCarver * voxel_carver = nullptr;		// Only for BENCHMARK_VOXEL_CARVING
+	MeshExtractor * mesh_extractor = nullptr;
+	PolyhedralHull * polyhedral_hull = nullptr;	// Only for BENCHMARK_POLYHEDRAL_HULL
+
+	// Scene the snapshots were rendered from (nullptr for snapshots of real cameras)
+	SyntheticScene * ground_truth = nullptr;
+
+
+	void buildPipeline(PipelineConfiguration * configuration);
+	void releasePipeline();
+
+	void runVariant(int variant, int iterations, BenchmarkResult * result);
+
+public:
+	PipelineBenchmark();
+	~PipelineBenchmark();
+
+	void addCamera(CameraSource * camera_source, Mat frame, Mat background, int tex_offs_x, int tex_offs_y);
+	void setGroundTruth(SyntheticScene * scene);
+
+	int run(int iterations, BenchmarkResult * results, int max_count);
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "PluginDataTypes.h"
+
+
+// Description of a single key which can be changed through a file or the plugin interface
+struct ConfigurationKey
+{
+	int key;				// Value of VSphereConfigurationKey
+	const char * name;		// Name used in configuration files
+	float min_value, max_value;
+	bool integer;			// Whether the value is rounded to an int
+};
+
+
+class PipelineConfiguration
+{
+public:
+	// Generation of this configuration (every published configuration receives a higher one)
+	int generation = 0;
+
+	// Processing values (see the getters in Settings.cpp for their meaning)
+	int background_reference_frames = 20;
+	int background_color_tolerance = 35;
+	int contour_mask_size = 8;
+	int noisepixel_tolerance = 5;
+	float segment_optimisation_tolerance = 0.25f;
+	int max_ray_length = 640;
+	int thread_timeout_ms = 400;
+	float preview_scale_factor = 0.3333f;
+	float background_adaptation_rate = 0.02f;
+	float background_variance_factor = 2.5f;
+	bool merge_edges = true;
+	int intersection_engine = INTERSECTION_ENGINE_SWEEP;
+	bool batched_narrow_phase = true;
+	bool shared_pair_intersection = true;
+	int worker_threads = 0;
+	int thread_pinning = THREAD_PINNING_NONE;
+	int first_processor = 0;
+	bool thread_priorities = false;
+	bool roi_tracking = false;
+	int roi_margin = 32;
+	int roi_sweep_interval = 15;
+	int pyramid_block_size = 1;
+	int reconstruction_engine = RECONSTRUCTION_ENGINE_RAYS;
+	int voxel_depth = 7;
+	bool surface_mesh = false;
+	int detail_levels = 2;
+	int model_stream_quads = 0;
+
+
+	static int getKeyCount();
+	static const ConfigurationKey * getKey(int key);
+	static const ConfigurationKey * findKey(const string & name);
+
+
+	bool setValue(int key, float value);
+	float getValue(int key);
+
+	bool loadFromFile(const string & file_path);
+};
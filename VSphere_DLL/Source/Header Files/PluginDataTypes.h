@@ -0,0 +1,311 @@
+/*
+Plain data types used by the typed control and query functions of the plugin interface (see VSpherePlugin.cpp).
+All members are 32 bit values without padding so the same layout can be declared on the C# side (see VSphere.cs in the Unity project).
+*/
+
+#pragma once
+
+
+// Commands for SetControl()
+enum VSphereControl
+{
+	CONTROL_SHOW_FULL_RAYS = 0,					// value: 0 = only the model; 1 = the entire rays
+	CONTROL_PREVIEW_TYPE = 1,					// value: preview type (see Settings.cpp); -1 = next; -2 = last
+	CONTROL_PREVIEW_WINDOW_VARIANT = 2,			// value: 0 = no window; 1 = separate windows; 2 = combined window
+	CONTROL_PREVIEW_WINDOW_ORDER_OFFSET = 3		// value: camera shown in full size in the combined window; -1 = next; -2 = last
+};
+
+// Values for GetQuery()
+enum VSphereQuery
+{
+	QUERY_IS_RUNNING = 0,
+	QUERY_CAMERA_COUNT = 1,
+	QUERY_PREVIEW_TYPE_COUNT = 2,
+	QUERY_PREVIEW_TYPE = 3,
+	QUERY_PREVIEW_WINDOW_VARIANT = 4,
+	QUERY_PREVIEW_WINDOW_ORDER_OFFSET = 5,
+	QUERY_SHOW_FULL_RAYS = 6,
+	QUERY_MODEL_QUAD_COUNT = 7,
+	QUERY_CONFIGURATION_GENERATION = 8
+};
+
+// Keys for SetConfigurationValue() and GetConfigurationValue() (names used in configuration files in brackets)
+enum VSphereConfigurationKey
+{
+	CONFIG_BACKGROUND_REFERENCE_FRAMES = 0,		// (background_reference_frames)
+	CONFIG_BACKGROUND_COLOR_TOLERANCE = 1,		// (background_color_tolerance)
+	CONFIG_CONTOUR_MASK_SIZE = 2,				// (contour_mask_size) Power of two; changing it re-plans the grid buffers
+	CONFIG_NOISEPIXEL_TOLERANCE = 3,			// (noisepixel_tolerance)
+	CONFIG_SEGMENT_OPTIMISATION_TOLERANCE = 4,	// (segment_optimisation_tolerance)
+	CONFIG_MAX_RAY_LENGTH = 5,					// (max_ray_length)
+	CONFIG_THREAD_TIMEOUT_MS = 6,				// (thread_timeout_ms)
+	CONFIG_PREVIEW_SCALE_FACTOR = 7,			// (preview_scale_factor)
+	CONFIG_BACKGROUND_ADAPTATION_RATE = 8,		// (background_adaptation_rate) Weight of a new frame in the running background model; 0 = no adaptation
+	CONFIG_BACKGROUND_VARIANCE_FACTOR = 9,		// (background_variance_factor) Tolerance in standard deviations of a background pixel
+	CONFIG_MERGE_EDGES = 10,					// (merge_edges) 1 = merge connected edges with similar direction into wide rays (exact sub-ray quads); 0 = one ray per grid segment
+	CONFIG_INTERSECTION_ENGINE = 11,			// (intersection_engine) See VSphereIntersectionEngine
+	CONFIG_BATCHED_NARROW_PHASE = 12,			// (batched_narrow_phase) 1 = test several pairs of rays at once (AVX2 if the CPU supports it); 0 = one pair after another
+	CONFIG_SHARED_PAIR_INTERSECTION = 13,		// (shared_pair_intersection) 1 = intersect every pair of cameras once for both (see CameraPairIntersector); 0 = every camera intersects its own rays
+	CONFIG_WORKER_THREADS = 14,					// (worker_threads) Threads processing the tasks of all cameras; 0 = one per core. Only used when the sphere starts
+	CONFIG_THREAD_PINNING = 15,					// (thread_pinning) See VSphereThreadPinning. Only used when the sphere starts
+	CONFIG_FIRST_PROCESSOR = 16,				// (first_processor) Logical processor of the capture thread when pinning; the workers use the following ones
+	CONFIG_THREAD_PRIORITIES = 17,				// (thread_priorities) 1 = capture thread above the workers above the control thread; 0 = all normal. Only used when the sphere starts
+	CONFIG_ROI_TRACKING = 18,					// (roi_tracking) 1 = segment only a window around the object of the previous frame (see RegionOfInterest); 0 = always the whole frame
+	CONFIG_ROI_MARGIN = 19,						// (roi_margin) Pixels the window extends beyond the object of the previous frame (the motion allowed between frames)
+	CONFIG_ROI_SWEEP_INTERVAL = 20,				// (roi_sweep_interval) Frames after which the whole frame is segmented again to find new objects
+	CONFIG_PYRAMID_BLOCK_SIZE = 21,				// (pyramid_block_size) Pixels per side of a block of the coarse level; only blocks near the coarse boundary are classified at full resolution. 1 = every pixel
+	CONFIG_RECONSTRUCTION_ENGINE = 22,			// (reconstruction_engine) See VSphereReconstructionEngine
+	CONFIG_VOXEL_DEPTH = 23,					// (voxel_depth) Levels of the octree of the voxel carving; the finest level has 2^voxel_depth voxels per axis
+	CONFIG_SURFACE_MESH = 24,					// (surface_mesh) 1 = also extract a closed triangle mesh with shared vertices from the voxels (see GetModelMesh); only with the voxel carving
+	CONFIG_DETAIL_LEVELS = 25,					// (detail_levels) Coarser levels of detail computed of every model (see GetModelLevel); level n joins up to 2^n quads. 0 = only the full model
+	CONFIG_MODEL_STREAM_QUADS = 26				// (model_stream_quads) Quads per model of the shared memory stream for other processes (see ModelStreamHeader); 0 = no stream. Only used when the sphere starts
+};
+
+// Values for CONFIG_THREAD_PINNING (the placement is reported by GetThreadPlacements())
+enum VSphereThreadPinning
+{
+	THREAD_PINNING_NONE = 0,					// Threads may run on any processor
+	THREAD_PINNING_COMPACT = 1,					// Capture thread and workers on consecutive logical processors from CONFIG_FIRST_PROCESSOR on
+	THREAD_PINNING_NUMA = 2						// Workers spread over the NUMA nodes; every camera has a home node whose workers prefer its tasks
+};
+
+// Stages measured by the latency histograms (see GetLatencyStatistics())
+enum VSphereLatencyStage
+{
+	LATENCY_CAPTURE = 0,						// Per camera: retrieving the frame from the device (on its grabber, see CapturePool) or reading it from the record
+	LATENCY_SEGMENTATION = 1,					// Per camera: mask, contours and edges
+	LATENCY_RAYS = 2,							// Per camera: generating the rays
+	LATENCY_INTERSECTION = 3,					// Per camera: intersecting or gathering the intersections of its rays
+	LATENCY_QUADS = 4,							// Per camera: building the quads
+	LATENCY_CAMERA_FRAME = 5,					// Per camera: all its stages of a frame (without waiting for other cameras)
+	LATENCY_CAMERA_STAGE_COUNT = 6,
+	LATENCY_PAIR_SLICE = 6,						// Sphere: a slice of the intersections of a pair of cameras
+	LATENCY_SPHERE_FRAME = 7,					// Sphere: all tasks of a frame
+	LATENCY_FRAME_INTERVAL = 8,					// Sphere: time between two models (its jitter is the frame time jitter)
+	LATENCY_CAPTURE_TO_MODEL = 9,				// Sphere: earliest capture of the frames of a model until the model is published
+	LATENCY_CAPTURE_SKEW = 10,					// Sphere: earliest until latest capture of the frames of all cameras of a model (recorded captures for played cameras, only with more than one camera)
+	LATENCY_STAGE_COUNT = 11
+};
+
+// Threads of the sphere reported by GetThreadPlacements()
+enum VSphereThreadRole
+{
+	THREAD_ROLE_CONTROL = 0,					// Started by StartSphere(), waits for the sphere to quit
+	THREAD_ROLE_CAPTURE = 1,					// Grabs the frames, outputs the model and draws the preview at a lower priority (see SphereControler::sphereLoop)
+	THREAD_ROLE_WORKER = 2,						// Executes the tasks of the cameras (see FrameScheduler)
+	THREAD_ROLE_GRABBER = 3,					// Grabs and retrieves one device when the capture thread releases all grabbers (see CapturePool); only with more than one device
+	THREAD_ROLE_RECORDER = 4					// Compresses and writes, or reads and decompresses, the models of a model record (see ModelRecord); only with a model record
+};
+
+// Stages the heap allocations are counted for (see GetAllocationStatistics(), only in builds with TRACK_ALLOCATIONS)
+enum VSphereAllocationStage
+{
+	ALLOCATION_OTHER = 0,						// Outside of the processing of a frame (setup, plugin calls)
+	ALLOCATION_CAPTURE = 1,						// Grabbing and retrieving the frames (including the grabber threads)
+	ALLOCATION_SEGMENTATION = 2,				// Mask, contours and edges
+	ALLOCATION_RAYS = 3,
+	ALLOCATION_INTERSECTION = 4,				// Including the slices of shared pairs
+	ALLOCATION_QUADS = 5,
+	ALLOCATION_OUTPUT = 6,						// Uniting the model of all cameras
+	ALLOCATION_PREVIEW = 7,						// Preview windows (a debugging aid, not part of the steady state)
+	ALLOCATION_STAGE_COUNT = 8
+};
+
+// Values for CONFIG_INTERSECTION_ENGINE (both produce the same model)
+enum VSphereIntersectionEngine
+{
+	INTERSECTION_ENGINE_ALL_PAIRS = 0,			// Test every own ray against every ray of the other cameras
+	INTERSECTION_ENGINE_SWEEP = 1				// Test only the rays found in the sorted positions of the other cameras (see ModelBuilder::prepareSweep)
+};
+
+// Values for CONFIG_RECONSTRUCTION_ENGINE
+enum VSphereReconstructionEngine
+{
+	RECONSTRUCTION_ENGINE_RAYS = 0,				// Intersect the rays of the edges of all cameras (see ModelBuilder)
+	RECONSTRUCTION_ENGINE_VOXELS = 1,			// Carve a sparse octree against the silhouettes of all cameras (see VoxelCarver)
+	RECONSTRUCTION_ENGINE_POLYHEDRAL = 2		// Cut the cones of the contour chains against the silhouettes of all cameras (see PolyhedralHull)
+};
+
+// Variants compared by RunPipelineBenchmark()
+enum VSphereBenchmarkVariant
+{
+	BENCHMARK_UNMERGED_EDGES = 0,				// One ray per grid segment, full-width quads, all-pairs intersection
+	BENCHMARK_MERGED_EDGES = 1,					// Merged edges, exact sub-ray quads, all-pairs intersection
+	BENCHMARK_UNMERGED_EDGES_SWEEP = 2,			// Like BENCHMARK_UNMERGED_EDGES with the sweep intersection engine
+	BENCHMARK_MERGED_EDGES_SWEEP = 3,			// Like BENCHMARK_MERGED_EDGES with the sweep intersection engine
+	BENCHMARK_MERGED_EDGES_SWEEP_SINGLE_PAIRS = 4,	// Like BENCHMARK_MERGED_EDGES_SWEEP with the narrow phase testing one pair after another
+	BENCHMARK_MERGED_EDGES_SWEEP_SHARED_PAIRS = 5,	// Like BENCHMARK_MERGED_EDGES_SWEEP with every pair of cameras intersected once for both
+	BENCHMARK_ROI_TRACKING = 6,					// Like BENCHMARK_MERGED_EDGES_SWEEP_SHARED_PAIRS with the segmentation restricted to the tracked region of interest
+	BENCHMARK_PYRAMID_SEGMENTATION = 7,			// Like BENCHMARK_MERGED_EDGES_SWEEP_SHARED_PAIRS with the coarse to fine segmentation (pyramid block size 4)
+	BENCHMARK_VOXEL_CARVING = 8,				// The model carved from a sparse octree instead of intersecting rays (see CONFIG_RECONSTRUCTION_ENGINE)
+	BENCHMARK_POLYHEDRAL_HULL = 9				// The polyhedral visual hull of the contour chains instead of intersecting rays
+};
+
+
+// Static description of a configured camera
+struct CameraInfo
+{
+	int list_index;
+	int hardware_index;
+	int channel;
+	float origin_x, origin_y, origin_z;
+	int width, height;		// Resolution (the negotiated one once the texture size has been requested or the sphere has started)
+	float fps;				// Negotiated frame rate (0 if unknown)
+};
+
+// Numbers of the last processed frame of a camera
+struct CameraStatistics
+{
+	int list_index;
+	int segments;
+	int rays;
+	int intersections;
+	int quads;
+	float computation_ms;			// Processing time of the last frame
+	float average_computation_ms;	// Average since the last loop of a record (or since the start)
+	float roi_pixel_share;			// Share of the pixels segmented in the last frame (1 without CONFIG_ROI_TRACKING)
+	int roi_hits;					// Tracked frames with the object inside the window (since the start)
+	int roi_misses;					// Tracked frames with the object at the border of the window and sweeps which found contours outside of it
+	float fine_pixel_share;			// Share of the pixels classified at full resolution in the last frame (see CONFIG_PYRAMID_BLOCK_SIZE)
+	float sync_offset_ms;			// Capture of the last frame after the earliest frame of all cameras of the same model (recorded capture for a played camera)
+	float sync_drift_ms;			// Change of sync_offset_ms since the first frame (or the last loop of a record)
+};
+
+// The complete state of the sphere at once
+struct SphereState
+{
+	int is_running;
+	int camera_count;
+	int preview_type;
+	int preview_type_count;
+	int preview_window_variant;
+	int preview_window_order_offset;
+	int show_full_rays;
+	int model_quad_count;
+};
+
+// Distribution of the durations of a stage since the start or the last ResetLatencyStatistics()
+struct LatencyStatistics
+{
+	int camera;						// List index of the camera; -1 for the stages of the whole sphere
+	int stage;						// See VSphereLatencyStage
+	int count;						// Recorded durations
+	float p50_ms, p90_ms, p99_ms;	// Percentiles (at most 3% too high)
+	float max_ms;
+	float mean_ms;
+	float jitter_ms;				// Standard deviation
+};
+
+// Timing of a published model (see GetModelTiming)
+// The stage times are counted from capture_us and tell when the last camera finished the stage.
+struct ModelTiming
+{
+	int sequence;					// Number of the model since the sphere started (1 = first model, 0 = none yet)
+	long long capture_us;			// Earliest capture of the frames of the model, microseconds of the sphere clock (see GetSphereTime)
+	float capture_spread_ms;		// Latest minus earliest capture of the cameras (on the media clock, so played cameras count with their recorded captures)
+	float segmented_ms;				// Mask, contours and edges
+	float rays_ms;
+	float intersected_ms;
+	float quads_ms;
+	float published_ms;				// The model has been united and can be retrieved
+};
+
+// Placement of a thread of the sphere
+struct ThreadPlacementInfo
+{
+	int role;						// See VSphereThreadRole
+	int index;						// Number of the worker (0 for the other roles)
+	int processor;					// Logical processor the thread is pinned to; -1 = not pinned
+	int numa_node;					// NUMA node of that processor (counting only nodes with processors); -1 = not pinned
+	int priority;					// Windows thread priority
+	int tasks;						// Tasks executed by a worker
+	int foreign_tasks;				// Among them tasks of cameras with another home node (see THREAD_PINNING_NUMA)
+};
+
+// Heap allocations of a thread in a stage since the DLL was loaded or the last ResetAllocationStatistics()
+struct AllocationStatistics
+{
+	int thread;						// Number of the thread in the order of its first allocation
+	int role;						// See VSphereThreadRole; -1 for threads not started by the sphere (for example the one of the host)
+	int index;						// Number of the worker (0 for the other roles)
+	int stage;						// See VSphereAllocationStage
+	long long allocations;
+	long long bytes;
+};
+
+// Result of one variant of RunPipelineBenchmark() (numbers summed over all cameras, times averaged per frame)
+struct BenchmarkResult
+{
+	int variant;
+	int rays;
+	int intersections;
+	int quads;
+	float frame_ms;					// Complete processing of a frame of all cameras
+	float segmentation_ms;			// Mask, contours, edges and rays
+	float intersection_ms;
+	float quad_ms;
+	unsigned int output_hash;		// Hash of the model of all cameras (equal for variants which only differ in the intersection engine)
+	int narrow_phase_pairs;			// Pairs of rays compared between the batched narrow phase and the single pair reference
+	int narrow_phase_mismatches;	// Pairs among them which differ by more than the tolerance
+	float model_precision;			// Share of the quads on the surface of the visual hull (only with RunSyntheticBenchmark(), otherwise -1)
+	float model_coverage;			// Share of the surface of the visual hull covered by quads (only with RunSyntheticBenchmark(), otherwise -1)
+	int steady_allocations;			// Heap allocations after the first two iterations, has to be 0 (only with TRACK_ALLOCATIONS, otherwise -1)
+	float roi_pixel_share;			// Average share of the pixels segmented per frame (1 without region of interest)
+	int roi_hits, roi_misses;		// Like in CameraStatistics, summed over all cameras and iterations
+	float fine_pixel_share;			// Average share of the pixels classified at full resolution per frame
+	int octree_nodes;				// Cubes tested by the voxel carving per frame (0 for the other variants)
+	int octree_leaves;				// Cubes inside all silhouettes per frame
+	float mesh_ms;					// Extraction of the closed mesh (see CONFIG_SURFACE_MESH, only BENCHMARK_VOXEL_CARVING), part of frame_ms
+	int mesh_vertices, mesh_triangles;
+	int mesh_open_edges;			// Edges of the mesh without an opposite edge, has to be 0 (a closed surface)
+	int hull_crossings;				// Crossings of viewing lines with silhouette edges found by the polyhedral hull per frame (only BENCHMARK_POLYHEDRAL_HULL)
+	float detail_ms;				// Computation of the coarser levels of detail (see CONFIG_DETAIL_LEVELS), part of frame_ms
+	int detail_quads;				// Quads of the coarsest level
+	float detail_precision;			// Share of the quads of the coarsest level on the surface of the visual hull (like model_precision)
+	float record_ms;				// Compression of the model for a model record (see ConfigureModelRecord), done by its I/O thread and not part of frame_ms
+	int record_bytes;				// Compressed size of the model (quads * 80 bytes uncompressed); -1 if it does not decompress to the same quads
+};
+
+// Ground truth of the scene of RunSyntheticBenchmark() (volumes in voxels of the grid around the shapes)
+struct SyntheticGroundTruth
+{
+	int camera_count;
+	int width, height;
+	int shape_count;
+	int grid_size;					// Voxels per axis
+	float voxel_size;				// Edge length of a voxel in units of the model
+	int shape_voxels;				// Inside the analytic shapes
+	int hull_voxels;				// Inside the silhouettes of all cameras (visual hull)
+	float volume_overlap;			// Intersection over union of both
+};
+
+
+// Shared memory through which other processes on the same host read the models (configuration key model_stream_quads, see ModelStreamReader.h)
+#define MODEL_STREAM_NAME "Local\\VSphereModelStream"
+#define MODEL_STREAM_EVENT_SUFFIX "Event"	// The manual-reset events signaled after the models are named MODEL_STREAM_NAME + this suffix + 0 or 1 (the parity of the sequence)
+#define MODEL_STREAM_MAGIC 0x534D5356		// "VSMS"
+#define MODEL_STREAM_VERSION 2
+
+// Start of the shared memory of the model stream, followed by slot_count slots of slot_bytes each
+struct ModelStreamHeader
+{
+	int magic;								// MODEL_STREAM_MAGIC
+	int version;							// MODEL_STREAM_VERSION
+	int slot_count;
+	int slot_quads;							// Quads a slot can hold
+	int slot_bytes;							// Distance between two slots
+	int first_slot;							// Distance of the first slot from the start of the header
+	volatile int active;					// 1 while the sphere publishes models
+	int reserved;
+	volatile long long latest_sequence;		// Newest complete model (0 = none yet), in slot latest_sequence % slot_count
+	volatile long long session;				// Odd while a starting sphere takes over the memory, even afterwards; every sphere counts it up and its sequences start again at 1
+};
+
+// A model of the stream, followed by quad_count * 20 ints in the format of StartRetrievingModel()
+struct ModelStreamSlot
+{
+	volatile long long state;				// 2 * sequence + 1 while the model is written, 2 * sequence once it is complete
+	ModelTiming timing;
+	int quad_count;
+	int dropped_quads;						// Quads of the model which did not fit into the slot
+};
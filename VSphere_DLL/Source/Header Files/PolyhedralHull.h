@@ -0,0 +1,82 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "CameraSource.h"
+#include "PipelineConfiguration.h"
+
+
+class PolyhedralHull
+{
+private:
+	// Edges of the silhouette of a camera sorted into bins across the direction the viewing lines of another camera are seen in
+	struct SilhouetteBins
+	{
+		vector2df direction;			// Pixels of the other camera per unit along a viewing line of the own camera
+		vector2df across;				// Unit vector perpendicular to direction
+		bool degenerate;				// The viewing lines are seen as points (parallel cameras)
+
+		float across_min, bin_width;
+		vector<int> bin_starts;			// First entry of every bin in bin_edges (one more than bins)
+		vector<int> bin_edges;			// Edges of the silhouette overlapping every bin
+	};
+
+	struct HullCamera
+	{
+		CameraSource * camera_source;
+		int tex_offs_x, tex_offs_y;
+
+		// Pose of the last frame (a pixel x, y is at corner + right * x * pixel_size - up * y * pixel_size)
+		int width, height;
+		float pixel_size;
+		vector3df corner, right, up, forward;
+
+		// Silhouette of the last frame: the contour chains of the EdgesIdentifier
+		vector<int> * segment_starts;
+		vector<int> * segment_ends;
+		vector<bool> * segment_orientations;
+		bool * binary_mask;
+		Rect window;
+		bool prepared = false;
+
+		// Work of cutting the cones of this camera (only used by its own task)
+		vector<SilhouetteBins*> bins;	// Index: other camera
+		vector<float> crossings;
+		vector<float> start_intervals, end_intervals, cut_intervals, camera_intervals;
+		vector<vector<float>> level_intervals;
+		int crossing_count = 0;
+
+		vector<int> output;
+	};
+
+	vector<HullCamera*> cameras;
+	float max_ray_length = 0;
+
+
+	vector2df projectPoint(HullCamera * camera, vector3df position);
+	vector3df pixelPosition(HullCamera * camera, float x, float y);
+
+	bool insideMask(HullCamera * camera, vector2df pixel);
+	void addInterval(vector<float> * intervals, float from, float to);
+
+	void binSilhouette(HullCamera * camera, HullCamera * other, SilhouetteBins * bins);
+	void cutViewingLine(HullCamera * camera, float x, float y, vector<float> * intervals);
+	void crossSilhouette(HullCamera * camera, HullCamera * other, SilhouetteBins * bins, vector2df start, vector<float> * intervals);
+
+	void addFaces(HullCamera * camera, vector2df from, vector2df to, bool inside_on_right, vector<float> * from_intervals, vector<float> * to_intervals, int level);
+	void addFaceQuad(HullCamera * camera, vector2df from, vector2df to, bool inside_on_right, float from_near, float from_far, float to_near, float to_far);
+
+public:
+	PolyhedralHull();
+	~PolyhedralHull();
+
+	void addCamera(CameraSource * camera_source, int tex_offs_x, int tex_offs_y);
+	void applyConfiguration(PipelineConfiguration * configuration);
+
+	void prepareCamera(int camera, vector<int> * segment_starts, vector<int> * segment_ends, vector<bool> * segment_orientations, bool * binary_mask, Rect window);
+
+	void cutCamera(int camera);
+	void collectModelPart(int camera, vector<int> * output_content);
+
+	int getCrossingCount();
+};
@@ -12,6 +12,15 @@
 
 
 
+// Reusable memory for Ray3D::addAsModelSubQuads() (one per ModelBuilder to avoid allocations per ray)
+struct SubRayWorkspace
+{
+	vector<float> breakpoints;
+	vector<pair<float, int>> active; // x position at the center of the current sub-ray and intersection index
+	float pixel_size = 1;			 // Of the camera of the rays in units of space (see CameraSource::getPixelSize)
+};
+
+
 struct Ray3D
 {
 	vector3df origin;
@@ -37,8 +46,10 @@ struct Ray3D
 private:
 	void addQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, vector3df cam_direction, vector3df dir_along_y, vector<int> * output);
 	void addTexture(vector<int> * texture_coordinates, int last_index, int index, vector<int> * output);
+	void addTextureInterpolated(vector<int> * texture_coordinates, int last_index, float last_from, float last_to, int index, float from, float to, vector<int> * output);
 	
 public:
 	void addAsModelQuads(vector<int> * output, vector3df cam_direction, vector<float> * intersection_factor_start_x, vector<float> * intersection_factor_end_x, vector<float> * intersection_factor_start_y, vector<float> * intersection_factor_end_y, vector<bool> * is_visible_plane_starter, vector<int> * texture_coordinates);
+	void addAsModelSubQuads(vector<int> * output, vector3df cam_direction, vector<float> * intersection_factor_start_x, vector<float> * intersection_factor_end_x, vector<float> * intersection_factor_start_y, vector<float> * intersection_factor_end_y, vector<bool> * is_visible_plane_starter, vector<int> * texture_coordinates, SubRayWorkspace * workspace);
 	void addAsRayQuad(vector<int> * output, vector3df cam_direction, float maxLength, bool show_orientation);
 };
\ No newline at end of file
@@ -12,6 +12,7 @@ class RayGenerator
 private:
 	CameraSource * camera_source;
 	int cam_w, cam_h;
+	float pixel_size; // Units in space per pixel (see CameraSource::setMode)
 	quaternion cam_direction;
 	vector3df cam_left_top;
 
@@ -19,6 +20,7 @@ private:
 
 
 	vector<Ray3D*> rays;
+	vector<Ray3D*> ray_pool; // All rays ever created, the rays of a frame are taken from here (see addRay)
 
 	vector<int> debug_quads;
 
@@ -43,7 +45,7 @@ public:
 
 	
 
-	void generateRays();
+	void generateRays(bool edges_merged);
 
 	void visualizeRays(vector<int> * output_content, int length);
 
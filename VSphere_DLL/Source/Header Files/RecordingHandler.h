@@ -3,6 +3,8 @@
 #include "simplifyingHeader.h"
 
 #include "CameraRecord.h"
+#include "ModelRecord.h"
+#include "MediaClock.h"
 
 #include <chrono>
 
@@ -11,10 +13,12 @@ class RecordingHandler
 {
 private:
 
-	volatile int current_position;
 	map<int, CameraRecord> * recorders;
-	int frame_delay_ms;
-	high_resolution_clock::time_point delay_start;
+	MediaClock * media_clock;
+	int frame_delay_ms;						// Frame interval of records without timestamps and frame rate
+	ModelRecord * model_record = nullptr;
+
+	void loadTimestamps(CameraRecord * record, double fps);
 
 public:
 
@@ -23,14 +27,20 @@ public:
 
 	void addRecord(int camera_list_index, string file_path);
 	void playRecord(int camera_list_index, string file_path);
+	void addModelRecord(string file_path);
+	void playModelRecord(string file_path);
 
-	void startRecordOrPlay(int camera_list_index);
+	bool probeRecord(int camera_list_index, cv::Size * frame_size, double * fps);
+	void startRecordOrPlay(int camera_list_index, cv::Size frame_size, double fps);
 	void handleBackgroundImage(int camera_list_index, cv::Mat * frame);
-	void handleFrame(int camera_list_index, cv::Mat * frame);
-
-	bool delayFrame(int camera_list_index);
+	void handleFrame(int camera_list_index, cv::Mat * frame, high_resolution_clock::time_point captured);
 
 	bool isPlaying(int camera_list_index);
 	bool justLooped(int camera_list_index);
+	long long getFrameOffset(int camera_list_index);
+
+	MediaClock * getMediaClock();
+
+	ModelRecord * getModelRecord();
 
 };
\ No newline at end of file
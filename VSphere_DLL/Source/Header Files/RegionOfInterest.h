@@ -0,0 +1,51 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "PipelineConfiguration.h"
+
+
+class RegionOfInterest
+{
+private:
+	bool enabled = false;
+	int margin;
+	int sweep_interval;
+
+	int frame_w, frame_h;
+	int cell_size;
+	int grid_w, grid_h;
+
+	Rect cells;				// Window of the current frame in cells of the contour grid
+	Rect tracked_cells;		// Window of the last tracked frame (a sweep checks whether it missed anything)
+	Rect found_cells;		// Cells with contours found in the window (empty if none)
+
+	bool sweep;				// The current frame is segmented completely
+	bool sweep_requested;
+	int frames_since_sweep;
+
+	// Statistics
+	float pixel_share;
+	int hits, misses;
+
+
+	Rect dilate(Rect box, int by);
+
+public:
+	RegionOfInterest();
+
+	void initData(int frame_w, int frame_h, int cell_size);
+	void applyConfiguration(PipelineConfiguration * configuration);
+
+	void planFrame();
+	void takeContours(int * contours_grid);
+
+	Rect getCellWindow();
+	Rect getPixelWindow();
+
+	bool isSweep();
+	float getPixelShare();
+	int getHits();
+	int getMisses();
+	void resetStatistics();
+};
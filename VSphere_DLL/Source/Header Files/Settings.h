@@ -3,6 +3,10 @@
 #include "simplifyingHeader.h"
 
 #include <vector>
+#include <atomic>
+#include <mutex>
+
+#include "PipelineConfiguration.h"
 
 
 class Settings
@@ -18,6 +22,20 @@ private:
 	// Array with text containing the various types of preview 
 	static vector<string> preview_type_text;
 
+
+	// Configuration read by all threads; only replaced at a frame boundary (see publishPendingConfiguration)
+	static atomic<PipelineConfiguration*> active_configuration;
+	// Configuration waiting to become active
+	static PipelineConfiguration * pending_configuration;
+	// Previously active configurations (freed once no user holds them anymore)
+	static vector<PipelineConfiguration*> retired_configurations;
+	// Generation held by every registered user (INT_MAX: holds none), see acquireConfiguration
+	static vector<int> user_generations;
+	// While a sphere exists only its frame boundaries publish (see attachSphere)
+	static bool sphere_attached;
+	static mutex configuration_lock;
+	static int last_generation;
+
 public:
 
 	// Settings to modify
@@ -52,4 +70,37 @@ public:
 	static void changePreviewWindowOrderOffset(int offset, int maximum);
 
 	static void changePreviewWindowVariant(int variant);
+
+
+	// Configuration handling (see PipelineConfiguration.cpp)
+
+	static PipelineConfiguration * getConfiguration();
+
+	// Read the active configuration from a thread which is no task of the sphere (see releaseRetiredConfigurations)
+	static float getConfigurationValue(int key);
+	static int getConfigurationGeneration();
+
+	// Get a private copy of the newest configuration (pending or active), for example for a benchmark. The caller deletes it.
+	static PipelineConfiguration * copyConfiguration();
+
+	// Change the newest configuration and stage it, at once so concurrent changes are all kept. Returns false (and changes nothing) if invalid.
+	static bool updateConfigurationValue(int key, float value);
+	static bool updateConfigurationFromFile(const string & file_path);
+
+	// Called at a frame boundary: make the staged configuration active and free the retired ones no user holds anymore. Returns false if nothing was staged.
+	static bool publishPendingConfiguration();
+
+	// Users which keep a pointer to the configuration across frames (the cameras) register and take the active one through acquireConfiguration()
+	static int registerConfigurationUser();
+	static PipelineConfiguration * acquireConfiguration(int user);
+	static void releaseConfigurationUser(int user);
+
+	// From creating the sphere until it has been destroyed, changes are only published at its frame boundaries
+	static void attachSphere();
+	static void detachSphere();
+
+private:
+	static void stageConfiguration(PipelineConfiguration * configuration);
+	static bool activatePendingConfiguration();
+	static void releaseUnusedConfigurations();
 };
\ No newline at end of file
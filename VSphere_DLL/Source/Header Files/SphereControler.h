@@ -14,6 +14,16 @@
 #include <DirectX11Handler.h>
 
 
+class PipelineBenchmark;
+class FrameScheduler;
+class CapturePool;
+class VoxelCarver;
+class MeshExtractor;
+class PolyhedralHull;
+class ModelStream;
+class ModelRecord;
+
+
 class SphereControler
 {
 private:
@@ -23,20 +33,56 @@ private:
 	RecordingHandler * records = nullptr;
 
 	vector<PerCamControler*> camera_controlers;
+
+	// Every unordered pair of cameras (intersected once for both, see CameraPairIntersector)
+	vector<CameraPairIntersector*> camera_pairs;
+
+	// Reconstruction engine of all cameras with RECONSTRUCTION_ENGINE_VOXELS
+	VoxelCarver * voxel_carver = nullptr;
+	MeshExtractor * mesh_extractor = nullptr;	// Closed mesh of the voxels (configuration key surface_mesh)
+
+	// Reconstruction engine of all cameras with RECONSTRUCTION_ENGINE_POLYHEDRAL
+	PolyhedralHull * polyhedral_hull = nullptr;
+
+	// Runs the tasks of all cameras on its worker threads
+	FrameScheduler * scheduler = nullptr;
+
+	// Grabs all devices at the same time
+	CapturePool * capture_pool = nullptr;
+
+	// Publishes every model to other processes (configuration key model_stream_quads)
+	ModelStream * model_stream = nullptr;
+
+	// Records the models or plays them instead of the cameras (owned by the RecordingHandler, see ConfigureModelRecord())
+	ModelRecord * model_record = nullptr;
+	bool playing_models = false;
+
+	// Durations of the stages of the whole sphere (index: stage - LATENCY_CAMERA_STAGE_COUNT)
+	latencyHistogram sphere_latencies[LATENCY_STAGE_COUNT - LATENCY_CAMERA_STAGE_COUNT];
+
 	vector<SimpleNamedWindow*> preview_windows;
 	SimpleNamedWindow * combined_preview_window = nullptr;
 	vector<cv::Mat*> combined_preview_split_mats;
 
 	int sphere_running;
-	vector<HANDLE> camera_threads;
 
 	thread * localSphereLoop;
-	bool threaded_content_computed_and_ready;
 
 	vector<int> * complete_sphere_content;
 
+	// The mesh of the published model (empty unless surface_mesh is set, see MeshExtractor)
+	vector<int> complete_mesh_vertices;
+	vector<int> complete_mesh_indices;
+
+	// The coarser levels of detail of the published model (index: level - 1, see ModelDetailLevels)
+	vector<vector<int>> complete_detail_levels;
+	int complete_level_count = 0;
+
+	// Timing of the published model (locked like the content) and the start of the sphere clock
+	ModelTiming model_timing;
+	high_resolution_clock::time_point start_time;
+
 	// For thread coordination
-	vector<HANDLE> worker_sems;
 	HANDLE data_output_sem;
 
 	mutex * data_output_lock;
@@ -56,17 +102,21 @@ private:
 
 	// volatiles
 	volatile bool has_new_model_frame = false;
+
+	bool show_full_rays = false;
 	
 
 
 
 
-	static void launchSphereLoop(SphereControler * thisControler, vector<HANDLE> * workerSems);
-	void sphereLoop(vector<HANDLE> * workerSems);
+	static void launchSphereLoop(SphereControler * thisControler);
+	void sphereLoop();
 
 
 	void handlePreviewWindows();
 
+	void computeModelTiming(int sequence, high_resolution_clock::time_point published);
+
 
 public:
 	SphereControler(CameraHandler * camera_set, RecordingHandler * records);
@@ -89,9 +139,22 @@ public:
 	
 	int getSphereContentSize();
 	vector<int> * getSphereContentCoordinates();
+	vector<int> * getMeshVertices();
+	vector<int> * getMeshIndices();
+	vector<int> * getModelLevel(int level);
 
 	void initPreviewWindows();
 
 	void setShowFullRays(bool showRays);
+	bool getShowFullRays();
+
+	void getCameraStatistics(int list_index, CameraStatistics * target);
+	int getLatencyStatistics(LatencyStatistics * statistics, int max_count);
+	void resetLatencyStatistics();
+
+	void getModelTiming(ModelTiming * timing);
+	long long getSphereTime();
+
+	bool fillBenchmark(PipelineBenchmark * benchmark);
 };
 
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "CameraSource.h"
+#include "PluginDataTypes.h"
+
+class PipelineBenchmark;
+
+
+class SyntheticScene
+{
+private:
+	enum ShapeType
+	{
+		SHAPE_SPHERE,		// center a, radius
+		SHAPE_BOX,			// center a, half_size (axis aligned)
+		SHAPE_TORUS,		// center a, radius (ring) and minor_radius (tube), around the Y axis
+		SHAPE_CAPSULE		// from a to b with radius (the parts of an articulated cylinder)
+	};
+
+	struct SyntheticShape
+	{
+		int type;
+		vector3df a, b, half_size;
+		float radius, minor_radius;
+		unsigned char color[3];
+	};
+
+	int width, height;
+	float pixel_size;		// Units in space per pixel (the camera planes keep their width at every resolution)
+	int max_ray_length;
+	int shape_count;		// Primitives as requested (an articulated cylinder consists of several capsules)
+
+	vector<SyntheticShape> shapes;
+	float bound_radius;		// All shapes are inside this sphere around the origin
+
+	vector<CameraSource*> camera_sources;
+	vector<Mat> frames, backgrounds, masks;
+
+	// Ground truth on a voxel grid around the bounding sphere
+	int grid_size;
+	vector3df grid_min;
+	float voxel_size;
+	vector<unsigned char> shape_grid, hull_grid, surface_grid;
+	int shape_voxels, hull_voxels, overlap_voxels, surface_voxels;
+
+
+	void buildShapes(int complexity);
+	void placeCameras(int camera_count);
+	void render(int camera);
+	void computeGroundTruth();
+
+	float distance(vector3df point, int * nearest_shape);
+	vector3df normal(vector3df point);
+	bool trace(vector3df start, vector3df direction, vector3df * hit, int * hit_shape);
+	bool project(int camera, vector3df point, int * x, int * y);
+
+	int voxelIndex(int x, int y, int z);
+	bool nearSurface(vector3df point);
+
+public:
+	SyntheticScene(int camera_count, int width, int height, int complexity, int max_ray_length);
+	~SyntheticScene();
+
+	int getCameraCount();
+	CameraSource * getCameraSource(int camera);
+
+	void fillBenchmark(PipelineBenchmark * benchmark);
+
+	void evaluateModel(vector<vector<int>*> * models, float * precision, float * coverage);
+	void getGroundTruth(SyntheticGroundTruth * truth);
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include <mutex>
+#include <atomic>
+
+#include "PluginDataTypes.h"
+#include "PipelineConfiguration.h"
+
+
+// Placed threads whose tasks are counted separately (all further threads share the last counters)
+#define PLACEMENT_COUNTED_THREADS 64
+
+class ThreadPlacement
+{
+private:
+	// Threads placed since the last start of the sphere
+	static vector<ThreadPlacementInfo> placements;
+	static mutex placements_lock;
+
+	// Counted by the workers without taking placements_lock, copied into the registrations by getPlacements()
+	struct TaskCounters
+	{
+		atomic<long long> tasks;
+		atomic<long long> foreign_tasks;
+	};
+
+	static TaskCounters task_counters[PLACEMENT_COUNTED_THREADS];
+
+	static vector<vector<int>> getNodeProcessors();
+	static int getRolePriority(int role);
+	static bool toProcessorNumber(int processor, PROCESSOR_NUMBER * number);
+
+public:
+	static int getProcessorCount();
+	static int getNodeCount();
+	static int getNode(int processor);
+
+	static int planProcessor(int role, int index, PipelineConfiguration * configuration);
+	static int getCameraNode(int camera, PipelineConfiguration * configuration);
+
+	static int place(int role, int index, int processor, bool use_priorities);
+	static void countTask(int placement, bool foreign);
+	static void setPreviewPriority(bool drawing);
+
+	static int getPlacements(ThreadPlacementInfo * infos, int max_count);
+	static void reset();
+};
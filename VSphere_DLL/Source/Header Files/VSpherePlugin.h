@@ -2,6 +2,7 @@
 
 #include "simplifyingHeader.h"
 #include "UnityInterface.h"
+#include "PluginDataTypes.h"
 
 
 
@@ -14,12 +15,35 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload();
 
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API PrepareSphere(bool open_console, int recorder_frame_duration_ms);
 
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetControl(int control, int value);
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetQuery(int query);
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetSphereState(SphereState* state);
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCameraInfos(CameraInfo* infos, int max_count);
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCameraStatistics(CameraStatistics* statistics, int max_count);
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetLatencyStatistics(LatencyStatistics* statistics, int max_count);
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetLatencyStatistics();
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetThreadPlacements(ThreadPlacementInfo* infos, int max_count);
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetAllocationStatistics(AllocationStatistics* statistics, int max_count);
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetAllocationStatistics();
+
+// Legacy string based variants of SetControl() and GetQuery()
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetInternalData(char* data_element);
 extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetInternalData(char* data_element);
 
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetConfigurationValue(int key, float value);
+extern "C" float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetConfigurationValue(int key);
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API LoadConfiguration(char* file_path);
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RunPipelineBenchmark(int iterations, BenchmarkResult* results, int max_count);
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RunSyntheticBenchmark(int camera_count, int width, int height, int complexity, int iterations, BenchmarkResult* results, int max_count, SyntheticGroundTruth* ground_truth);
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API CheckNarrowPhase(int* checked_pairs);
+
 extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureCamera(int hardware_index, int hardware_channel, int focus_value, int location_x, int location_y, int location_z, int offset_x, int offset_y, int offset_z);
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureCameraMode(int configured_camera_index, int width, int height, int fps);
 
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureRecordHandler(int configured_camera_index, char* file_path, int type);
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureModelRecord(char* file_path, int type);
 
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartSphere(int preview_window_variant, int preview_type);
 
@@ -44,6 +68,10 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API WaitForNextModel();
 
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartRetrievingModel(int** quadsData, int* quadsCount);
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API EndRetrievingModel();
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetModelMesh(int** verticesData, int* verticesCount, int** indicesData, int* indicesCount);
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetModelLevel(int level, int** quadsData, int* quadsCount);
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetModelTiming(ModelTiming* timing);
+extern "C" long long UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetSphereTime();
 
 
 
@@ -56,4 +84,5 @@ void startConsole();
 void hideConsole();
 void ClearScreen();
 string MakeStringCopy(const char* str);
+bool parseCommandValue(const char* command, const char* prefix, int* value);
 int roundToNextPotency(int value, int potency);
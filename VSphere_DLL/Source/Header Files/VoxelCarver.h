@@ -0,0 +1,99 @@
+#pragma once
+
+#include "simplifyingHeader.h"
+
+#include "CameraSource.h"
+#include "PipelineConfiguration.h"
+
+
+// A cube of the grid which is inside all silhouettes (position and size in voxels)
+struct VoxelLeaf
+{
+	int x, y, z;
+	int size;
+};
+
+
+class VoxelCarver
+{
+private:
+	// A camera with its projection into the grid and the foreground counts of its last mask
+	struct CarvingCamera
+	{
+		CameraSource * camera_source;
+		int width, height;
+		int tex_offs_x, tex_offs_y;
+		vector3df forward;
+
+		// Pixel of a grid position: x = grid_to_x.dot(position) + x_at_origin (the same for y)
+		vector3df grid_to_x, grid_to_y;
+		float x_at_origin, y_at_origin;
+		float x_extent_min, x_extent_max;	// Projected extent of a voxel (a cube of size n spans n times as much)
+		float y_extent_min, y_extent_max;
+
+		// Summed area table of the foreground pixels inside the window of the last mask (one row and column of zeros first)
+		vector<int> foreground_table;
+		bool * binary_mask;
+		Rect window;
+		bool prepared = false;
+	};
+
+	// The cubes of the top levels a slice carves with its leaves and quads (the slices share no voxels)
+	struct CarvingSlice
+	{
+		vector<VoxelLeaf> leaves;
+		vector<int> output;
+		int nodes = 0;
+	};
+
+	vector<CarvingCamera*> cameras;
+	vector<CarvingSlice*> slices;
+
+	int depth = 0;
+	int grid_size = 0;					// Voxels per axis (2^depth)
+	int slice_level;					// Level of the cubes distributed to the slices
+	vector3df grid_min;
+	float voxel_size;
+	int max_ray_length = 0;
+
+	vector<unsigned char> occupancy;	// One byte per voxel: inside a leaf
+
+	int face_cameras[6];				// Camera texturing the faces of every direction (index: axis * 2, plus 1 for the positive direction)
+
+
+	void placeGrid();
+
+	int classifyCube(CarvingCamera * camera, int x, int y, int z, int size);
+	bool pointInside(CarvingCamera * camera, vector3df position);
+	void carveCube(CarvingSlice * slice, int x, int y, int z, int level, unsigned long long undecided);
+	void markLeaves(CarvingSlice * slice, unsigned char value);
+
+	void projectTexture(CarvingCamera * camera, vector3df position, int * u, int * v);
+	void addFaceQuad(CarvingSlice * slice, int axis, bool positive, int plane, int u0, int u1, int v0, int v1);
+
+public:
+	VoxelCarver(int slice_count);
+	~VoxelCarver();
+
+	void addCamera(CameraSource * camera_source, int tex_offs_x, int tex_offs_y);
+	void applyConfiguration(PipelineConfiguration * configuration);
+
+	void prepareCamera(int camera, bool * binary_mask, Rect window);
+
+	void carveSlice(int slice);
+	void extractSlice(int slice);
+	void collectModelPart(int part, vector<int> * output_content);
+
+	int getSliceCount();
+	int getNodeCount();
+	int getLeafCount();
+
+	// The carved grid for the surface extraction (see MeshExtractor)
+	int getGridSize();
+	vector<VoxelLeaf> * getLeaves(int slice);
+	int getVoxelSlice(int x, int y, int z);
+	bool isOccupied(int x, int y, int z);
+	bool insideHull(vector3df position);
+	vector3df gridToWorld(vector3df position);
+	void projectTexture(vector3df position, vector3df normal, int * u, int * v);
+};
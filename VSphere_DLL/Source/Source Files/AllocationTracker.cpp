@@ -0,0 +1,178 @@
+/*
+Counts the heap allocations of the DLL per thread and per stage of the processing (instrumented builds with TRACK_ALLOCATIONS only).
+
+The processing reuses its buffers from frame to frame (they keep the capacity of the largest frame so far),
+so after the first frames a frame is processed without any allocation. The PipelineBenchmark asserts this.
+Only allocations through operator new of this DLL are counted; OpenCV allocates the data of its Mats in its own modules.
+
+Without TRACK_ALLOCATIONS the functions can still be called but nothing is counted.
+
+Input:
+	The stage set by the calling thread (setStage) and its role (nameThread, see ThreadPlacement)
+
+Output:
+	AllocationStatistics	// For every thread and stage with allocations
+*/
+
+#include "stdafx.h"
+
+#include "AllocationTracker.h"
+
+#include <new>
+
+
+AllocationTracker::ThreadCounters AllocationTracker::counters[ALLOCATION_TRACKED_THREADS];
+atomic<int> AllocationTracker::thread_count;
+
+thread_local int AllocationTracker::thread_slot = -1;
+thread_local int AllocationTracker::thread_stage = ALLOCATION_OTHER;
+
+
+#ifdef TRACK_ALLOCATIONS
+
+// The counting itself must not allocate: The counters are static and the slot of a thread is taken on its first allocation
+void * operator new(size_t size)
+{
+	AllocationTracker::countAllocation(size);
+
+	void * memory = malloc((size == 0) ? 1 : size);
+	if (memory == nullptr)
+		throw bad_alloc();
+
+	return(memory);
+}
+
+void * operator new[](size_t size)
+{
+	return(operator new(size));
+}
+
+void operator delete(void * memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void * memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void * memory, size_t size) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void * memory, size_t size) noexcept
+{
+	free(memory);
+}
+
+#endif
+
+
+bool AllocationTracker::isEnabled()
+{
+#ifdef TRACK_ALLOCATIONS
+	return(true);
+#else
+	return(false);
+#endif
+}
+
+/*
+The counters of the calling thread (taken on its first call).
+*/
+int AllocationTracker::getSlot()
+{
+	if (thread_slot < 0)
+	{
+		thread_slot = min(thread_count.fetch_add(1), ALLOCATION_TRACKED_THREADS - 1);
+		counters[thread_slot].role = -1;
+		counters[thread_slot].index = 0;
+	}
+
+	return(thread_slot);
+}
+
+void AllocationTracker::countAllocation(size_t size)
+{
+	int slot = getSlot();
+
+	counters[slot].allocations[thread_stage].fetch_add(1, memory_order_relaxed);
+	counters[slot].bytes[thread_stage].fetch_add(size, memory_order_relaxed);
+}
+
+
+/*
+Count the following allocations of the calling thread for the given stage (see VSphereAllocationStage).
+*/
+void AllocationTracker::setStage(int stage)
+{
+	thread_stage = stage;
+}
+
+/*
+Name the calling thread in the statistics by its role in the sphere (see ThreadPlacement::place).
+*/
+void AllocationTracker::nameThread(int role, int index)
+{
+	int slot = getSlot();
+
+	counters[slot].role = role;
+	counters[slot].index = index;
+}
+
+
+/*
+Allocations of the calling thread in all stages (0 without TRACK_ALLOCATIONS).
+*/
+long long AllocationTracker::getThreadAllocations()
+{
+	int slot = getSlot();
+	long long sum = 0;
+
+	for (int stage = 0; stage < ALLOCATION_STAGE_COUNT; ++stage)
+		sum += counters[slot].allocations[stage];
+
+	return(sum);
+}
+
+
+/*
+Copy the counters of every thread and stage with allocations into an array of the caller. Returns the number of elements written.
+*/
+int AllocationTracker::getStatistics(AllocationStatistics * statistics, int max_count)
+{
+	int thread_number = min((int)thread_count, ALLOCATION_TRACKED_THREADS);
+	int written = 0;
+
+	for (int t = 0; t < thread_number; ++t)
+		for (int stage = 0; (stage < ALLOCATION_STAGE_COUNT) && (written < max_count); ++stage)
+		{
+			if (counters[t].allocations[stage] == 0)
+				continue;
+
+			statistics[written].thread = t;
+			statistics[written].role = counters[t].role;
+			statistics[written].index = counters[t].index;
+			statistics[written].stage = stage;
+			statistics[written].allocations = counters[t].allocations[stage];
+			statistics[written].bytes = counters[t].bytes[stage];
+			written++;
+		}
+
+	return(written);
+}
+
+/*
+Start counting from zero (the threads keep their numbers and roles).
+*/
+void AllocationTracker::reset()
+{
+	for (int t = 0; t < ALLOCATION_TRACKED_THREADS; ++t)
+		for (int stage = 0; stage < ALLOCATION_STAGE_COUNT; ++stage)
+		{
+			counters[t].allocations[stage] = 0;
+			counters[t].bytes[stage] = 0;
+		}
+}
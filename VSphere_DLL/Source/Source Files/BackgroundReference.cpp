@@ -1,14 +1,27 @@
 /*
 This core class handles how the background of a camera frame is removed. It is bound to exactly one camera (indirectly through the input frame pointer).
 
-The method bases on a background-sample which is computed by an avergae of frames (which may not contain anything that shall be rednered later in 3D).
-When the background from a frame shall be removed it compares the colors of image with the background reference.
+The method bases on a background model which is computed from an average of frames (which may not contain anything that shall be rednered later in 3D).
+When the background from a frame shall be removed it compares the colors of image with the background model.
+
+The model stores a running mean and variance for every channel of every pixel.
+Every pixel classified as background updates it (exponential moving average) within the same pass that classifies the pixel.
+Therefore the reference follows slow changes of the lighting without recomputing it. Pixels of the object do not change the model.
+A complete recomputation while running is built in a shadow model from the frames which are processed anyway
+and swapped in at a frame boundary (see startShadowBackground). Only the very first reference is computed from frames grabbed for that purpose.
+A channel counts as background when its absolute difference to the mean is smaller than the larger one of
+the color tolerance and a multiple of the standard deviation (limited to twice the color tolerance).
+
+At high resolutions most pixels are far from the outline of the object. With a pyramid block size above 1 the frame is classified
+coarse to fine: one sample per block first, then at full resolution only the blocks where the samples of the block and its neighbors differ.
+All other blocks take the class of their sample (see computePyramidMask). Details smaller than a block can be missed.
 
 Input (from PerCamControler):
 	frame 2D image (MAT) pointer // Representing a frame from the camera
 
 Output:
 	BinaryMask pointer			 // Bool array covering the frame image containing which pixels are background and which object
+	background pointer			 // 8 bit image of the current mean (kept up to date for the preview and records)
 
 
 Todo: Much more advanced techniques than the simple one used here are available (however they tend to be more timeconsuming)
@@ -22,10 +35,22 @@ Todo: Much more advanced techniques than the simple one used here are available
 
 #include "BackgroundReference.h"
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define BACKGROUND_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+
+// The variance may at most widen the tolerance to this multiple of the color tolerance
+#define MAX_TOLERANCE_FACTOR 2
+
 
 BackgroundReference::BackgroundReference()
 {
 	background_color_tolerance = Settings::getBackgroundColorTolerance();
+	adaptation_rate = Settings::getConfiguration()->background_adaptation_rate;
+	variance_factor = Settings::getConfiguration()->background_variance_factor;
+	pyramid_block_size = Settings::getConfiguration()->pyramid_block_size;
 }
 
 BackgroundReference::~BackgroundReference()
@@ -37,6 +62,31 @@ BackgroundReference::~BackgroundReference()
 	// free the binary mask
 	if (binaryMask != nullptr)
 		delete[] binaryMask;
+
+	// Free the model
+	if (mean != nullptr)
+	{
+		delete[] mean;
+		delete[] variance;
+		delete[] frame_sum;
+		delete[] frame_square_sum;
+		delete[] shadow_mean;
+		delete[] shadow_variance;
+	}
+
+	if (coarse_mask.states != nullptr)
+		delete[] coarse_mask.states;
+}
+
+/*
+Take the values of a newly published configuration (called between frames).
+*/
+void BackgroundReference::applyConfiguration(PipelineConfiguration * configuration)
+{
+	background_color_tolerance = configuration->background_color_tolerance;
+	adaptation_rate = configuration->background_adaptation_rate;
+	variance_factor = configuration->background_variance_factor;
+	pyramid_block_size = configuration->pyramid_block_size;
 }
 
 /*
@@ -45,7 +95,8 @@ Start creating a new reference background from a given number of frames.
 frame: pointer to first the image/frame (datastructure Mat from OpenCV).
 	   This pointer should contain the new frame every time addFrame() is called
 	   and it should be the same pointer which will contain the further camera frames during the execution of the VSphere.
-expectedFrames: Number of frames to expect for computing the reference background
+expectedFrames: Number of frames to expect for computing the reference background.
+				Use -1 if the 8 bit background image is filled from outside (from a record) before calling finalizeBackground().
 */
 void BackgroundReference::startNewBackground(Mat * frame, int expectedFrames)
 {
@@ -60,56 +111,176 @@ void BackgroundReference::startNewBackground(Mat * frame, int expectedFrames)
 	if (binaryMask == nullptr)
 		binaryMask = new bool[pixelcount];
 
+	allocateModel();
 
-	// We are using a 32bit image matrix for storing the background so a normal 8bit frame fits 4 times.
-	// Therefore the factor needs to be 4 / totalFrames
-	frameFactor = ((float)4) / expectedFrames;
-	
+	// Enough blocks for the smallest block size, so a changed block size needs no new buffer
+	if (coarse_mask.states == nullptr)
+		coarse_mask.states = new uchar[((frame->cols + 1) / 2) * ((frame->rows + 1) / 2)];
 
-	if (expectedFrames > 0)
-		background = nullptr; 
-	
-	if (expectedFrames == -1)
-		background = new Mat();
+	// The 8 bit background keeps its address (other components hold a pointer to its data)
+	if (background == nullptr)
+		background = new Mat(frame->rows, frame->cols, CV_8UC3, Scalar(0, 0, 0));
+
+	resetSums();
 }
 
 /*
-Add another frame (data still in the same pointer provided in startNewBackground() )
+Allocate the arrays of the model (only once since the frame size does not change).
 */
-void BackgroundReference::addFrame()
+void BackgroundReference::allocateModel()
 {
-	if (background == nullptr)
+	if (mean != nullptr)
+		return;
+
+	mean = new float[pixelcount * 3];
+	variance = new float[pixelcount * 3];
+	frame_sum = new float[pixelcount * 3];
+	frame_square_sum = new float[pixelcount * 3];
+	shadow_mean = new float[pixelcount * 3];
+	shadow_variance = new float[pixelcount * 3];
+}
+
+void BackgroundReference::resetSums()
+{
+	accumulated_frames = 0;
+	for (int i = 0; i < pixelcount * 3; ++i)
 	{
-		background = new Mat();
+		frame_sum[i] = 0;
+		frame_square_sum[i] = 0;
+	}
+}
 
-		// Create a background of 32bit type
-		frame->convertTo(*background, CV_32SC3, frameFactor, 0);
+/*
+Compute mean and variance of all frames added since the sums have been reset.
+*/
+void BackgroundReference::computeModelFromSums(float * target_mean, float * target_variance)
+{
+	float factor = 1.0f / accumulated_frames;
 
-		bc = background->ptr<uchar>(0);
+	for (int i = 0; i < pixelcount * 3; ++i)
+	{
+		target_mean[i] = frame_sum[i] * factor;
+		target_variance[i] = max(0.0f, frame_square_sum[i] * factor - target_mean[i] * target_mean[i]);
 	}
-	else
+
+	accumulated_frames = 0;
+}
+
+/*
+Add another frame (data still in the same pointer provided in startNewBackground() )
+*/
+void BackgroundReference::addFrame()
+{
+	f = frame->ptr<uchar>(0);
+
+	for (int i = 0; i < pixelcount * 3; ++i)
 	{
-		// Add every frame to this background. Thanks to the factor 'frameFactor', the 32 bit are filled up accurately
-		// no matter how many frames were used
-		addWeighted(*background, 1, *frame, frameFactor, 0, *background, CV_32SC3);
+		float value = f[i];
+		frame_sum[i] += value;
+		frame_square_sum[i] += value * value;
 	}
 
+	accumulated_frames++;
 }
 
 /*
 Call when all frames have been added.
+The model starts with the mean and variance of the added frames.
+If no frame has been added, the model starts with the 8 bit background image and no variance.
 */
 void BackgroundReference::finalizeBackground()
 {
-	if (expectedFrames > 0)
+	if (accumulated_frames > 0)
 	{
-		// Scale back down to a 8bit image for easier comparison later -> Results in an average from all frames
-		background->convertTo(*background, CV_8UC3, 0.5, 0);
+		computeModelFromSums(mean, variance);
+		updateBackgroundImage();
+	}
+	else
+	{
+		if ((background->cols * background->rows != pixelcount) || (background->type() != CV_8UC3))
+		{
+			StaticDebug::addError("The background image does not fit the frame size!");
+			background->create(frame->rows, frame->cols, CV_8UC3);
+			background->setTo(Scalar(0, 0, 0));
+		}
+
+		uchar * b = background->ptr<uchar>(0);
+		for (int i = 0; i < pixelcount * 3; ++i)
+		{
+			mean[i] = b[i];
+			variance[i] = 0;
+		}
 	}
 
 	bc = background->ptr<uchar>(0);
 }
 
+/*
+Start building a new model from the next frames which are classified anyway (no additional frames are grabbed).
+The current model stays in use until the new one is complete and swapShadowBackground() is called.
+*/
+void BackgroundReference::startShadowBackground(int expectedFrames)
+{
+	resetSums();
+	shadow_expected_frames = expectedFrames;
+	shadow_ready = false;
+}
+
+/*
+Add the current frame to the shadow model (does nothing if no shadow model is being built).
+*/
+void BackgroundReference::addShadowFrame()
+{
+	if (shadow_expected_frames <= 0)
+		return;
+
+	addFrame();
+
+	if (accumulated_frames >= shadow_expected_frames)
+	{
+		computeModelFromSums(shadow_mean, shadow_variance);
+		shadow_expected_frames = 0;
+		shadow_ready = true;
+	}
+}
+
+bool BackgroundReference::isShadowBackgroundActive()
+{
+	return(shadow_expected_frames > 0);
+}
+
+bool BackgroundReference::isShadowBackgroundReady()
+{
+	return(shadow_ready);
+}
+
+/*
+Replace the model by the completed shadow model. Call only between two frames.
+All buffers keep their addresses so no other component has to be initialized again.
+*/
+void BackgroundReference::swapShadowBackground()
+{
+	if (!shadow_ready)
+		return;
+
+	swap(mean, shadow_mean);
+	swap(variance, shadow_variance);
+	updateBackgroundImage();
+
+	shadow_ready = false;
+}
+
+/*
+Write the complete mean into the 8 bit background image.
+*/
+void BackgroundReference::updateBackgroundImage()
+{
+	uchar * b = background->ptr<uchar>(0);
+
+	for (int i = 0; i < pixelcount * 3; ++i)
+		b[i] = (uchar)(mean[i] + 0.5f);
+}
+
 
 
 Mat * BackgroundReference::getBackground()
@@ -132,17 +303,348 @@ bool * BackgroundReference::getBinaryMask()
 	return(binaryMask);
 }
 
+CoarseMask * BackgroundReference::getCoarseMask()
+{
+	return(&coarse_mask);
+}
+
+/*
+Share of the pixels of the frame which have been classified at full resolution in the last frame.
+*/
+float BackgroundReference::getFinePixelShare()
+{
+	return((pixelcount > 0) ? fine_pixels / (float)pixelcount : 1);
+}
+
+
+#ifdef BACKGROUND_USE_SSE2
+
+// For every combination of 4 background pixels (bits) the masks of the 12 channel values which belong to those pixels
+struct BackgroundLaneMasks
+{
+	__m128 masks[16][3];
+
+	BackgroundLaneMasks()
+	{
+		for (int bits = 0; bits < 16; ++bits)
+		{
+			unsigned int lanes[12];
+			for (int l = 0; l < 12; ++l)
+				lanes[l] = ((bits >> (l / 3)) & 1) ? 0xFFFFFFFF : 0;
+
+			for (int v = 0; v < 3; ++v)
+				masks[bits][v] = _mm_castsi128_ps(_mm_setr_epi32(lanes[v * 4], lanes[v * 4 + 1], lanes[v * 4 + 2], lanes[v * 4 + 3]));
+		}
+	}
+};
+
+static const BackgroundLaneMasks background_lane_masks;
+
+#endif
+
 
 /*
 Compute the mask for the frame which is currently in the pointer which has been given through startNewBackground()
+and update the model with all pixels which are classified as background.
 */
 void BackgroundReference::computeRGBbinaryMask()
 {
-	int j = 0;
-	for (int i = 0; i < pixelcount - 1; ++i)
+	computeRGBbinaryMask(Rect(0, 0, frame->cols, frame->rows));
+}
+
+/*
+Like computeRGBbinaryMask() but only for the pixels inside a window (see RegionOfInterest).
+The mask and the model outside of the window keep the values of the last frame which covered them.
+*/
+void BackgroundReference::computeRGBbinaryMask(Rect window)
+{
+	f = frame->ptr<uchar>(0);
+
+	tolerance_squared = (float)(background_color_tolerance * background_color_tolerance);
+	max_tolerance_squared = tolerance_squared * MAX_TOLERANCE_FACTOR * MAX_TOLERANCE_FACTOR;
+	variance_factor_squared = variance_factor * variance_factor;
+
+	if (pyramid_block_size > 1)
 	{
-		binaryMask[i] = (f[j] - bc[j] < background_color_tolerance && f[j + 1] - bc[j + 1] < background_color_tolerance && f[j + 2] - bc[j + 2] < background_color_tolerance);
-		j += 3;
+		computePyramidMask(window);
+		return;
+	}
+
+	coarse_mask.block_size = 1;
+	fine_pixels = window.area();
+
+	int w = frame->cols;
+
+	if (window.width == w) // Complete rows are contiguous
+		computeMaskSpan(window.y * w, (window.y + window.height) * w);
+	else
+		for (int y = window.y; y < window.y + window.height; ++y)
+			computeMaskSpan(y * w + window.x, y * w + window.x + window.width);
+}
+
+/*
+Classify the pixels from begin to end (linear indices) and update the model with the background pixels.
+*/
+void BackgroundReference::computeMaskSpan(int begin, int end)
+{
+	float rate = adaptation_rate;
+	bool adapt = rate > 0;
+
+	int i = begin;
+
+#ifdef BACKGROUND_USE_SSE2
+	// 4 pixels (12 channel values) per step. 16 bytes are loaded so the last pixels of the frame are left for the scalar loop.
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 tol2 = _mm_set1_ps(tolerance_squared);
+	const __m128 max_tol2 = _mm_set1_ps(max_tolerance_squared);
+	const __m128 k2 = _mm_set1_ps(variance_factor_squared);
+	const __m128 a = _mm_set1_ps(rate);
+	const __m128 one_minus_a = _mm_set1_ps(1 - rate);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	for (; (i + 4 <= end) && (i + 6 <= pixelcount); i += 4)
+	{
+		int j = i * 3;
+
+		__m128i raw = _mm_loadu_si128((const __m128i*)(f + j));
+		__m128i low = _mm_unpacklo_epi8(raw, zero);
+		__m128i high = _mm_unpackhi_epi8(raw, zero);
+
+		__m128 value[3];
+		value[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+		value[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+		value[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+
+		__m128 m[3], var[3], diff[3], diff2[3];
+		int lanes = 0;
+
+		for (int v = 0; v < 3; ++v)
+		{
+			m[v] = _mm_loadu_ps(mean + j + v * 4);
+			var[v] = _mm_loadu_ps(variance + j + v * 4);
+
+			diff[v] = _mm_sub_ps(value[v], m[v]);
+			diff2[v] = _mm_mul_ps(diff[v], diff[v]);
+
+			__m128 threshold = _mm_min_ps(_mm_max_ps(tol2, _mm_mul_ps(k2, var[v])), max_tol2);
+			lanes |= _mm_movemask_ps(_mm_cmplt_ps(diff2[v], threshold)) << (v * 4);
+		}
+
+		// A pixel is background if all of its 3 channels are
+		int pixels = 0;
+		for (int p = 0; p < 4; ++p)
+		{
+			bool is_background = ((lanes >> (p * 3)) & 7) == 7;
+			binaryMask[i + p] = is_background;
+			pixels |= is_background << p;
+		}
+
+		if ((pixels == 0) || !adapt)
+			continue;
+
+		// Update mean and variance of the background pixels only
+		for (int v = 0; v < 3; ++v)
+		{
+			__m128 mask = background_lane_masks.masks[pixels][v];
+
+			__m128 new_var = _mm_mul_ps(one_minus_a, _mm_add_ps(var[v], _mm_mul_ps(a, diff2[v])));
+
+			m[v] = _mm_add_ps(m[v], _mm_and_ps(mask, _mm_mul_ps(a, diff[v])));
+			var[v] = _mm_add_ps(var[v], _mm_and_ps(mask, _mm_sub_ps(new_var, var[v])));
+
+			_mm_storeu_ps(mean + j + v * 4, m[v]);
+			_mm_storeu_ps(variance + j + v * 4, var[v]);
+		}
+
+		// Refresh the 8 bit background (exactly 12 bytes), rounded like the scalar loop: truncate mean + 0.5 (_mm_cvtps_epi32 would round half to even)
+		__m128i rounded[3];
+		for (int v = 0; v < 3; ++v)
+			rounded[v] = _mm_cvttps_epi32(_mm_add_ps(m[v], half));
+
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(rounded[0], rounded[1]), _mm_packs_epi32(rounded[2], zero));
+		_mm_storel_epi64((__m128i*)(bc + j), packed);
+		*((int*)(bc + j + 8)) = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+	}
+#endif
+
+	// Remaining pixels (or all without SSE2)
+	for (; i < end; ++i)
+	{
+		bool is_background = isBackgroundPixel(i);
+
+		binaryMask[i] = is_background;
+
+		if (is_background && adapt)
+			adaptPixel(i);
+	}
+}
+
+/*
+Classify a single pixel (linear index) without changing the model.
+*/
+bool BackgroundReference::isBackgroundPixel(int i)
+{
+	int j = i * 3;
+
+	bool is_background = true;
+	for (int c = 0; c < 3; ++c)
+	{
+		float diff = f[j + c] - mean[j + c];
+		float threshold = min(max(tolerance_squared, variance_factor_squared * variance[j + c]), max_tolerance_squared);
+		is_background &= diff * diff < threshold;
+	}
+
+	return(is_background);
+}
+
+/*
+Update the model with a pixel which has been classified as background.
+*/
+void BackgroundReference::adaptPixel(int i)
+{
+	int j = i * 3;
+	float rate = adaptation_rate;
+
+	for (int c = 0; c < 3; ++c)
+	{
+		float diff = f[j + c] - mean[j + c];
+		mean[j + c] += rate * diff;
+		variance[j + c] = (1 - rate) * (variance[j + c] + rate * diff * diff);
+		bc[j + c] = (uchar)(mean[j + c] + 0.5f);
+	}
+}
+
+
+/*
+What happens to the pixels of a block of the coarse level: COARSE_TESTED, or filled with background (0) or object (COARSE_OBJECT).
+*/
+static inline uchar blockTreatment(uchar state)
+{
+	return((state & COARSE_TESTED) ? COARSE_TESTED : (state & COARSE_OBJECT));
+}
+
+/*
+Coarse to fine classification of the pixels inside a window (pyramid block size above 1):
+1. One pixel per block (the sample) is classified. Blocks which are not completely inside the window have no sample.
+2. A block is classified at full resolution if it has no sample or if the sample of any neighbor differs from its own (the band around the coarse boundary).
+   Neighbors outside of the frame do not count, neighbors outside of the window always differ.
+3. All other blocks are filled with the class of their sample. Only their sample updates the model.
+   The sample moves through the block from frame to frame, so every pixel keeps adapting (at a lower rate).
+The states of the blocks are kept for the ContoursExtractor (see CoarseMask).
+*/
+void BackgroundReference::computePyramidMask(Rect window)
+{
+	int b = pyramid_block_size;
+	int w = frame->cols;
+	int h = frame->rows;
+
+	int blocks_w = (w + b - 1) / b;
+	int blocks_h = (h + b - 1) / b;
+	uchar * states = coarse_mask.states;
+
+	coarse_mask.block_size = b;
+	coarse_mask.blocks_w = blocks_w;
+	coarse_mask.blocks_h = blocks_h;
+
+	int window_x1 = window.x + window.width;
+	int window_y1 = window.y + window.height;
+
+	// Blocks touched by the window
+	int bx0 = window.x / b;
+	int by0 = window.y / b;
+	int bx1 = (window_x1 + b - 1) / b;
+	int by1 = (window_y1 + b - 1) / b;
+
+	int sample = pyramid_frame++ % (b * b);
+	int sample_x = sample % b;
+	int sample_y = sample / b;
+
+	// 1. Coarse level
+	for (int by = by0; by < by1; ++by)
+		for (int bx = bx0; bx < bx1; ++bx)
+		{
+			int x0 = bx * b, y0 = by * b;
+			int x1 = min(w, x0 + b), y1 = min(h, y0 + b);
+
+			if ((x0 < window.x) || (y0 < window.y) || (x1 > window_x1) || (y1 > window_y1))
+			{
+				states[by * blocks_w + bx] = COARSE_UNSAMPLED | COARSE_TESTED;
+				continue;
+			}
+
+			int i = min(y0 + sample_y, y1 - 1) * w + min(x0 + sample_x, x1 - 1);
+			states[by * blocks_w + bx] = isBackgroundPixel(i) ? 0 : COARSE_OBJECT;
+		}
+
+	// 2. Band around the coarse boundary (only the flags of step 1 are compared, so the states can be marked in place)
+	bool adapt = adaptation_rate > 0;
+
+	for (int by = by0; by < by1; ++by)
+	{
+		// Rows of the neighbors (a missing row at the border of the frame is replaced by the own one, which never differs)
+		uchar * above = states + max(by - 1, 0) * blocks_w;
+		uchar * row = states + by * blocks_w;
+		uchar * below = states + min(by + 1, blocks_h - 1) * blocks_w;
+
+		bool border_row = ((by == by0) && (by0 > 0)) || ((by == by1 - 1) && (by1 < blocks_h));
+
+		for (int bx = bx0; bx < bx1; ++bx)
+		{
+			uchar state = row[bx];
+			if (state & COARSE_UNSAMPLED)
+				continue;
+
+			int left = max(bx - 1, 0);
+			int right = min(bx + 1, blocks_w - 1);
+
+			uchar differences = (above[left] ^ state) | (above[bx] ^ state) | (above[right] ^ state)
+				| (row[left] ^ state) | (row[right] ^ state)
+				| (below[left] ^ state) | (below[bx] ^ state) | (below[right] ^ state);
+
+			bool band = border_row || ((bx == bx0) && (bx0 > 0)) || ((bx == bx1 - 1) && (bx1 < blocks_w))
+				|| ((differences & (COARSE_OBJECT | COARSE_UNSAMPLED)) != 0);
+
+			if (band)
+				row[bx] = state | COARSE_TESTED;
+			else if (adapt && (state == 0))
+				adaptPixel(min(by * b + sample_y, h - 1) * w + min(bx * b + sample_x, w - 1));
+		}
+	}
+
+	// 3. Fill or classify the rows of the window in runs of blocks with the same treatment
+	fine_pixels = 0;
+
+	for (int by = by0; by < by1; ++by)
+	{
+		uchar * row_states = states + by * blocks_w;
+		int y0 = max(window.y, by * b);
+		int y1 = min(window_y1, (by + 1) * b);
+
+		int bx = bx0;
+		while (bx < bx1)
+		{
+			uchar state = blockTreatment(row_states[bx]);
+
+			int run_end = bx + 1;
+			while ((run_end < bx1) && (blockTreatment(row_states[run_end]) == state))
+				run_end++;
+
+			int x0 = max(window.x, bx * b);
+			int x1 = min(window_x1, run_end * b);
+
+			for (int y = y0; y < y1; ++y)
+			{
+				if (state == COARSE_TESTED)
+					computeMaskSpan(y * w + x0, y * w + x1);
+				else
+					memset(binaryMask + y * w + x0, (state == 0) ? 1 : 0, x1 - x0);
+			}
+
+			if (state == COARSE_TESTED)
+				fine_pixels += (x1 - x0) * (y1 - y0);
+
+			bx = run_end;
+		}
 	}
 }
 
@@ -1,5 +1,6 @@
 /*
 Those classes provide a few simple benchmarks.
+The latencyHistogram can be recorded from any number of threads without locks and read at the same time (see GetLatencyStatistics()).
 
 @Author: Alexander Georgescu
 */
@@ -114,12 +115,6 @@ void timeBench::printAverage(float everySeconds, const char* str)
 
 
 
-time_t ref_time;
-time_t ref_time_print;
-double value_sum;
-double max_val, min_val;
-int count;
-
 valueBench::valueBench()
 {
 	resetValue();
@@ -190,3 +185,129 @@ void valueBench::printAverageFull(float everySeconds, string str)
 		}
 
 }
+
+
+
+
+// Distribution of durations in logarithmic buckets like an HDR histogram
+latencyHistogram::latencyHistogram()
+{
+	resetValues();
+}
+
+int latencyHistogram::bucketOf(unsigned int microseconds)
+{
+	if (microseconds < LATENCY_EXACT_BUCKETS)
+		return(microseconds);
+
+	int power = 31;
+	while ((microseconds & (1u << power)) == 0)
+		power--;
+
+	// The bits below the highest one select the sub bucket of its power of two
+	int sub_bucket = (microseconds >> (power - LATENCY_SUB_BUCKET_BITS)) & ((1 << LATENCY_SUB_BUCKET_BITS) - 1);
+	return(LATENCY_EXACT_BUCKETS + (power - 6) * (1 << LATENCY_SUB_BUCKET_BITS) + sub_bucket);
+}
+
+/*
+The highest value counted in a bucket.
+*/
+unsigned int latencyHistogram::bucketValue(int bucket)
+{
+	if (bucket < LATENCY_EXACT_BUCKETS)
+		return(bucket);
+
+	int power = 6 + (bucket - LATENCY_EXACT_BUCKETS) / (1 << LATENCY_SUB_BUCKET_BITS);
+	unsigned int sub_bucket = (bucket - LATENCY_EXACT_BUCKETS) % (1 << LATENCY_SUB_BUCKET_BITS);
+	unsigned long long width = 1ull << (power - LATENCY_SUB_BUCKET_BITS);
+
+	return((unsigned int)min(((1ull << power) + sub_bucket * width) + width - 1, 0xFFFFFFFFull));
+}
+
+/*
+Count a duration (lock free).
+*/
+void latencyHistogram::record(double microseconds)
+{
+	unsigned int value = (unsigned int)max(0.0, min(microseconds, 4e9));
+
+	buckets[bucketOf(value)].fetch_add(1, memory_order_relaxed);
+	sum.fetch_add(value, memory_order_relaxed);
+	square_sum.fetch_add((unsigned long long)value * value, memory_order_relaxed);
+
+	unsigned long long previous_max = max_value.load(memory_order_relaxed);
+	while ((value > previous_max) && !max_value.compare_exchange_weak(previous_max, value, memory_order_relaxed));
+
+	count.fetch_add(1, memory_order_release);
+}
+
+/*
+Count the time since start and return the current time (to measure the next stage from there).
+*/
+high_resolution_clock::time_point latencyHistogram::recordSince(high_resolution_clock::time_point start)
+{
+	high_resolution_clock::time_point now = high_resolution_clock::now();
+	record((double)duration_cast<microseconds>(now - start).count());
+	return(now);
+}
+
+/*
+Start again (durations recorded at the same time may be lost).
+*/
+void latencyHistogram::resetValues()
+{
+	for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+		buckets[i].store(0, memory_order_relaxed);
+
+	sum.store(0, memory_order_relaxed);
+	square_sum.store(0, memory_order_relaxed);
+	max_value.store(0, memory_order_relaxed);
+	count.store(0, memory_order_release);
+}
+
+/*
+The duration (microseconds) which the given share (0 - 1) of all recorded durations does not exceed.
+*/
+double latencyHistogram::getPercentile(double percentile)
+{
+	unsigned long long total = 0;
+	for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+		total += buckets[i].load(memory_order_relaxed);
+
+	if (total == 0)
+		return(0);
+
+	unsigned long long rank = max(1ull, (unsigned long long)ceil(percentile * total));
+	unsigned long long seen = 0;
+
+	for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+	{
+		seen += buckets[i].load(memory_order_relaxed);
+		if (seen >= rank)
+			return(min((double)bucketValue(i), (double)max_value.load(memory_order_relaxed)));
+	}
+
+	return((double)max_value.load(memory_order_relaxed));
+}
+
+void latencyHistogram::fillStatistics(LatencyStatistics * target)
+{
+	int samples = count.load(memory_order_acquire);
+
+	target->count = samples;
+	target->p50_ms = (float)(getPercentile(0.5) / 1000);
+	target->p90_ms = (float)(getPercentile(0.9) / 1000);
+	target->p99_ms = (float)(getPercentile(0.99) / 1000);
+	target->max_ms = (float)(max_value.load(memory_order_relaxed) / 1000.0);
+	target->mean_ms = 0;
+	target->jitter_ms = 0;
+
+	if (samples > 0)
+	{
+		double mean = (double)sum.load(memory_order_relaxed) / samples;
+		double variance = (double)square_sum.load(memory_order_relaxed) / samples - mean * mean;
+
+		target->mean_ms = (float)(mean / 1000);
+		target->jitter_ms = (float)(sqrt(max(0.0, variance)) / 1000);
+	}
+}
@@ -9,6 +9,11 @@ It contains an array with classes and functionality to separate between channels
 
 #include "CameraHandler.h"
 #include "CameraSource.h"
+#include "RecordingHandler.h"
+
+
+// Modes tried one after another if the requested one is not delivered (only those not larger than the request)
+static const int fallback_modes[][2] = { { 1920, 1080 }, { 1280, 720 }, { 640, 480 } };
 
 
 CameraHandler::~CameraHandler()
@@ -60,3 +65,100 @@ CameraSource * CameraHandler::getCameraSource(int list_index)
 {
 	return(cameras.at(list_index));
 }
+
+
+
+/*
+Negotiate the resolution and frame rate of all cameras which have not been negotiated yet.
+Has to happen before the texture size is computed and before the controlers of the cameras are created, because everything sizes itself from the frames.
+Cameras played from a record take the mode of the record. Live cameras are opened shortly and asked for the requested mode;
+if they do not deliver it, the fallback modes are tried and in the end the camera keeps whatever it delivers.
+All channels of a device share the mode of the device.
+*/
+void CameraHandler::negotiateModes(RecordingHandler * records)
+{
+	map<int, pair<vector2di, double>> device_modes;
+
+	for (int c = 0; c < cameras.size(); ++c)
+	{
+		CameraSource * source = cameras[c];
+		if (source->getModeNegotiated())
+			continue;
+
+		vector2di size = source->getRequestedSize();
+		double fps = source->getRequestedFps();
+
+		if ((records != nullptr) && records->isPlaying(c))
+		{
+			Size frame_size;
+			if (records->probeRecord(c, &frame_size, &fps))
+				size = vector2di(frame_size.width, frame_size.height);
+			else
+				addError("The record of " + source->getName() + " could not be probed, its requested size is used.");
+		}
+		else if (device_modes.find(source->getIndex()) != device_modes.end())
+		{
+			size = device_modes[source->getIndex()].first;
+			fps = device_modes[source->getIndex()].second;
+		}
+		else
+		{
+			negotiateDevice(source, &size, &fps);
+			device_modes[source->getIndex()] = make_pair(size, fps);
+		}
+
+		if ((size.X <= 0) || (size.Y <= 0))
+		{
+			addError("No mode could be negotiated for " + source->getName() + ", using 640x480.");
+			size = vector2di(640, 480);
+		}
+
+		source->setMode(size, fps);
+		addInfoLine(source->getName() + " delivers " + to_string(size.X) + "x" + to_string(size.Y) + " pixels at " + to_string((int)fps) + " fps.");
+	}
+}
+
+/*
+Ask the device of a camera for its requested mode and fall back to the next smaller one until a mode is delivered.
+The mode is verified by a frame because not every driver reports the properties reliably.
+*/
+void CameraHandler::negotiateDevice(CameraSource * source, vector2di * size, double * fps)
+{
+	vector2di requested = source->getRequestedSize();
+	bool largest = (requested.X <= 0) || (requested.Y <= 0); // No size requested: the largest mode available
+
+	VideoCapture capture(source->getIndex());
+	if (!capture.isOpened())
+		return; // Keeps the requested mode (initialize() reports the error)
+
+	vector<vector2di> candidates;
+	if (!largest)
+		candidates.push_back(requested);
+	for (int m = 0; m < sizeof(fallback_modes) / sizeof(fallback_modes[0]); ++m)
+		if (largest || ((fallback_modes[m][0] <= requested.X) && (fallback_modes[m][1] <= requested.Y) && (vector2di(fallback_modes[m][0], fallback_modes[m][1]) != requested)))
+			candidates.push_back(vector2di(fallback_modes[m][0], fallback_modes[m][1]));
+
+	for (int m = 0; m < candidates.size(); ++m)
+	{
+		capture.set(CAP_PROP_FRAME_WIDTH, candidates[m].X);
+		capture.set(CAP_PROP_FRAME_HEIGHT, candidates[m].Y);
+
+		if (((int)capture.get(CAP_PROP_FRAME_WIDTH) == candidates[m].X) && ((int)capture.get(CAP_PROP_FRAME_HEIGHT) == candidates[m].Y))
+			break;
+
+		addInfoLine(source->getName() + " does not deliver " + to_string(candidates[m].X) + "x" + to_string(candidates[m].Y) + " pixels.");
+	}
+
+	if (source->getRequestedFps() > 0)
+		capture.set(CAP_PROP_FPS, source->getRequestedFps());
+
+	// Take what the camera actually delivers
+	Mat frame;
+	if (capture.read(frame) && !frame.empty())
+		*size = vector2di(frame.cols, frame.rows);
+	else
+		*size = vector2di((int)capture.get(CAP_PROP_FRAME_WIDTH), (int)capture.get(CAP_PROP_FRAME_HEIGHT));
+	*fps = capture.get(CAP_PROP_FPS);
+
+	capture.release();
+}
@@ -0,0 +1,283 @@
+/*
+Intersects the rays of two cameras once for both of them.
+
+The ModelBuilder of every camera tests its own rays against the rays of all other cameras,
+so every pair of rays of two cameras is tested twice (once by each camera) and the results only differ in the point of view.
+An instance of this class exists for every unordered pair of cameras (created by the SphereControler).
+It tests the rays of the first camera against those of the second one with the batched narrow phase, which also returns
+the values seen from the second camera (see CustomMath::compute_narrow_phase_batch), and keeps the intersecting pairs.
+The ModelBuilders of both cameras then take their intersections from it (see ModelBuilder::storePairIntersection).
+
+The rays of the first camera are split into slices which are separate tasks of the FrameScheduler.
+A camera gathers its intersections once the slices of all pairs it is part of are complete.
+
+Input (from both RayGenerators):
+	rays pointers	// The rays of the current frame of both cameras
+
+Output:
+	PairIntersection	// For every pair of rays whose center lines are close enough and whose planes intersect (the overlap is checked by the ModelBuilders)
+*/
+
+#include "stdafx.h"
+
+#include "CameraPairIntersector.h"
+
+#include <algorithm>
+
+
+// Same values as the sweep engine of the ModelBuilder (see ModelBuilder.cpp)
+#define SWEEP_RANGE_TOLERANCE 0.01f
+#define SWEEP_MIN_DIRECTION_CROSS 0.05f
+
+
+CameraPairIntersector::CameraPairIntersector(RayGenerator * first_generator, RayGenerator * second_generator, int slice_count)
+{
+	this->first_generator = first_generator;
+	this->second_generator = second_generator;
+
+	first_rays = first_generator->getRays();
+	second_rays = second_generator->getRays();
+
+	max_ray_length = Settings::getMaxRayLength();
+	intersection_engine = Settings::getConfiguration()->intersection_engine;
+	batched_narrow_phase = Settings::getConfiguration()->batched_narrow_phase;
+
+	vector3df first_dir = first_generator->getCameraSource()->getDirection() * vector3df(0, 0, 1);
+	vector3df second_dir = second_generator->getCameraSource()->getDirection() * vector3df(0, 0, 1);
+
+	sweep_normal = first_dir.crossProduct(second_dir);
+	sweep_possible = (sweep_normal.getLength() >= SWEEP_MIN_DIRECTION_CROSS); // Parallel cameras always use all pairs
+	sweep_normal.normalize();
+	sweep_max_width_sq = 0;
+
+	for (int s = 0; s < max(1, slice_count); ++s)
+		slices.push_back(new PairSlice());
+
+	prepareConstants();
+}
+
+CameraPairIntersector::~CameraPairIntersector()
+{
+	for (int s = 0; s < slices.size(); ++s)
+		delete(slices[s]);
+}
+
+
+/*
+Take the values of a newly published configuration.
+Called by the segment task of the first camera only (between frames), the second camera does not touch these values.
+*/
+void CameraPairIntersector::applyConfiguration(PipelineConfiguration * configuration)
+{
+	intersection_engine = configuration->intersection_engine;
+	batched_narrow_phase = configuration->batched_narrow_phase;
+
+	if (configuration->max_ray_length == max_ray_length)
+		return;
+
+	max_ray_length = configuration->max_ray_length;
+	prepareConstants();
+}
+
+/*
+The values of both camera directions for the narrow phase (the same as in ModelBuilder::referenceAnotherRayGenerator).
+*/
+void CameraPairIntersector::prepareConstants()
+{
+	constants.cam_vec = first_generator->getCameraSource()->getDirection() * vector3df(0, 0, max_ray_length);
+	constants.other_vec = second_generator->getCameraSource()->getDirection() * vector3df(0, 0, max_ray_length);
+
+	constants.cam_vec_norm = constants.cam_vec;
+	constants.cam_vec_norm.normalize();
+	constants.other_vec_norm = constants.other_vec;
+	constants.other_vec_norm.normalize();
+
+	constants.cam_dot = constants.cam_vec.dotProduct(constants.cam_vec);
+	constants.other_dot = constants.other_vec.dotProduct(constants.other_vec);
+	constants.ab_dot = constants.cam_vec.dotProduct(constants.other_vec);
+	constants.quotient = constants.cam_dot * constants.other_dot - constants.ab_dot * constants.ab_dot;
+}
+
+
+/*
+Sort the rays of the second camera along the axis of the sweep engine (see ModelBuilder::prepareSweep).
+Called by the segment task of the second camera as soon as its rays of the frame are generated.
+*/
+void CameraPairIntersector::prepareSweep()
+{
+	sweep_order.clear();
+	sweep_max_width_sq = 0;
+
+	if (!sweep_possible)
+		return;
+
+	int len = second_rays->size();
+	for (int j = 0; j < len; ++j)
+	{
+		Ray3D * other_ray = (*second_rays)[j];
+
+		sweep_order.push_back(pair<float, int>(other_ray->origin.dotProduct(sweep_normal), j));
+		sweep_max_width_sq = max(sweep_max_width_sq, other_ray->ray_width_sq);
+	}
+
+	sort(sweep_order.begin(), sweep_order.end());
+}
+
+/*
+Fill candidates with the ascending indices of the rays of the second camera which have to be tested with the given ray.
+*/
+void CameraPairIntersector::collectCandidates(Ray3D * ray, vector<int> * candidates)
+{
+	candidates->clear();
+
+	if ((intersection_engine != INTERSECTION_ENGINE_SWEEP) || !sweep_possible)
+	{
+		for (int j = 0; j < second_rays->size(); ++j)
+			candidates->push_back(j);
+		return;
+	}
+
+	float position = ray->origin.dotProduct(sweep_normal);
+	float range = sqrt(ray->ray_width_sq + sweep_max_width_sq) * (1 + SWEEP_RANGE_TOLERANCE) + SWEEP_RANGE_TOLERANCE;
+
+	vector<pair<float, int>>::iterator it = lower_bound(sweep_order.begin(), sweep_order.end(), pair<float, int>(position - range, -1));
+	for (; (it != sweep_order.end()) && (it->first <= position + range); ++it)
+		candidates->push_back(it->second);
+
+	sort(candidates->begin(), candidates->end());
+}
+
+
+/*
+Intersect a slice of the rays of the first camera with all rays of the second camera.
+Different slices can be computed on different threads at the same time.
+*/
+void CameraPairIntersector::intersectSlice(int slice)
+{
+	PairSlice * work = slices[slice];
+	work->intersections.clear();
+
+	int ray_count = first_rays->size();
+	int first = (int)((long long)ray_count * slice / slices.size());
+	int last = (int)((long long)ray_count * (slice + 1) / slices.size());
+
+	NarrowPhaseBatch & batch = work->batch;
+
+	for (int k = first; k < last; ++k)
+	{
+		Ray3D * ray = (*first_rays)[k];
+
+		collectCandidates(ray, &work->candidates);
+
+		int len = work->candidates.size();
+		for (int c = 0; c < len; c += NARROW_PHASE_BATCH)
+		{
+			batch.setRay(ray);
+			for (int l = c; (l < len) && (l < c + NARROW_PHASE_BATCH); ++l)
+				batch.addOtherRay((*second_rays)[work->candidates[l]]);
+
+			if (batched_narrow_phase)
+				CustomMath::compute_narrow_phase_batch(constants, &batch);
+			else
+				CustomMath::compute_narrow_phase_batch_scalar(constants, &batch);
+
+			for (int l = 0; l < batch.count; ++l)
+			{
+				if (!batch.valid[l])
+					continue;
+
+				PairIntersection intersection;
+				intersection.ray_first = k;
+				intersection.ray_second = work->candidates[c + l];
+
+				intersection.pos_first_start = batch.pos_this_start[l];
+				intersection.pos_first_end = batch.pos_this_end[l];
+				intersection.pos_second_start = batch.pos_other_start[l];
+				intersection.pos_second_end = batch.pos_other_end[l];
+
+				intersection.length_first_start = batch.this_ray_pos_start[l];
+				intersection.length_first_end = batch.this_ray_pos_end[l];
+				intersection.length_second_start = batch.other_ray_pos_start[l];
+				intersection.length_second_end = batch.other_ray_pos_end[l];
+
+				intersection.sine_first = batch.sine[l];
+				intersection.cosine_first = batch.cosine[l];
+				intersection.sine_second = batch.other_sine[l];
+				intersection.cosine_second = batch.other_cosine[l];
+
+				work->intersections.push_back(intersection);
+			}
+		}
+	}
+}
+
+
+/*
+Compute the share of the slices of all pairs which belongs to the given worker (out of worker_count).
+Every worker has to call this before any camera gathers the results (used by the PipelineBenchmark with a single worker).
+*/
+void CameraPairIntersector::intersectTasks(vector<CameraPairIntersector*> * pairs, int worker, int worker_count)
+{
+	int task = 0;
+
+	for (int p = 0; p < pairs->size(); ++p)
+		for (int s = 0; s < (*pairs)[p]->slices.size(); ++s, ++task)
+			if (task % worker_count == worker)
+				(*pairs)[p]->intersectSlice(s);
+}
+
+
+/*
+Order the intersections by the rays of one of the two cameras (counting sort, so every ray keeps the order of the other camera's rays).
+The intersections of the own ray k are order[offsets[k]] to order[offsets[k + 1] - 1].
+*/
+void CameraPairIntersector::collect(bool first_camera, vector<int> * offsets, vector<PairIntersection*> * order)
+{
+	int ray_count = getRays(first_camera)->size();
+
+	offsets->assign(ray_count + 1, 0);
+
+	for (int s = 0; s < slices.size(); ++s)
+		for (int i = 0; i < slices[s]->intersections.size(); ++i)
+		{
+			PairIntersection & intersection = slices[s]->intersections[i];
+			(*offsets)[(first_camera ? intersection.ray_first : intersection.ray_second) + 1]++;
+		}
+
+	for (int k = 0; k < ray_count; ++k)
+		(*offsets)[k + 1] += (*offsets)[k];
+
+	order->resize((*offsets)[ray_count]);
+
+	// Every entry is moved to the start of the next ray while filling and moved back afterwards
+	for (int s = 0; s < slices.size(); ++s)
+		for (int i = 0; i < slices[s]->intersections.size(); ++i)
+		{
+			PairIntersection & intersection = slices[s]->intersections[i];
+			(*order)[(*offsets)[first_camera ? intersection.ray_first : intersection.ray_second]++] = &intersection;
+		}
+
+	for (int k = ray_count; k > 0; --k)
+		(*offsets)[k] = (*offsets)[k - 1];
+	(*offsets)[0] = 0;
+}
+
+
+int CameraPairIntersector::getSliceCount()
+{
+	return(slices.size());
+}
+
+vector<Ray3D*> * CameraPairIntersector::getRays(bool first_camera)
+{
+	return(first_camera ? first_rays : second_rays);
+}
+
+/*
+Whether the given camera (by its RayGenerator) is one of the pair and if so, whether it is the first one.
+*/
+bool CameraPairIntersector::involves(RayGenerator * ray_generator, bool * first_camera)
+{
+	*first_camera = (ray_generator == first_generator);
+	return((ray_generator == first_generator) || (ray_generator == second_generator));
+}
@@ -58,3 +58,60 @@ bool CameraRecord::getJustLooped()
 {
 	return(just_looped);
 }
+
+
+vector<long long> * CameraRecord::getTimestamps()
+{
+	return(&timestamps);
+}
+
+void CameraRecord::setTimestampWriter(ofstream * timestamp_writer)
+{
+	this->timestamp_writer = timestamp_writer;
+}
+
+ofstream * CameraRecord::getTimestampWriter()
+{
+	return(timestamp_writer);
+}
+
+
+void CameraRecord::setClockRecord(int clock_record)
+{
+	this->clock_record = clock_record;
+}
+
+int CameraRecord::getClockRecord()
+{
+	return(clock_record);
+}
+
+void CameraRecord::setNextFrame(int next_frame)
+{
+	this->next_frame = next_frame;
+}
+
+int CameraRecord::getNextFrame()
+{
+	return(next_frame);
+}
+
+void CameraRecord::setFrameOffset(long long frame_offset)
+{
+	this->frame_offset = frame_offset;
+}
+
+long long CameraRecord::getFrameOffset()
+{
+	return(frame_offset);
+}
+
+void CameraRecord::setLoop(int loop)
+{
+	this->loop = loop;
+}
+
+int CameraRecord::getLoop()
+{
+	return(loop);
+}
\ No newline at end of file
@@ -21,6 +21,12 @@ CameraSource::CameraSource(int ind, bool grabber_channel, vector2di size, vector
 	this->origin = new vector3df(origin.X, origin.Y, origin.Z);
 	this->focus_value = focus_value;
 
+	// Until a mode is negotiated the size is taken as the resolution as well
+	requested_size = new vector2di(size.X, size.Y);
+	fps = requested_fps = 0;
+	view_width = size.X;
+	pixel_size = 1;
+
 	direction = new quaternion();
 
 	if (ind == 0)
@@ -28,7 +34,8 @@ CameraSource::CameraSource(int ind, bool grabber_channel, vector2di size, vector
 	else
 		direction->lookRotation(-origin, vector3df(0, 1, 1)).normalize();
 
-	to_corner = new vector3df((*direction) * vector3df(-size.X / 2, size.Y / 2, 0));
+	to_corner = new vector3df();
+	computeCorner();
 
 	this->origin = new vector3df(origin.X + offset.X, origin.Y + offset.Y, origin.Z + offset.Z);
 
@@ -48,10 +55,17 @@ CameraSource::CameraSource(int ind, int ch, bool grabber_channel, vector2di size
 	this->origin = new vector3df(origin.X, origin.Y, origin.Z);
 	this->focus_value = focus_value;
 
+	// Until a mode is negotiated the size is taken as the resolution as well
+	requested_size = new vector2di(size.X, size.Y);
+	fps = requested_fps = 0;
+	view_width = size.X;
+	pixel_size = 1;
+
 	direction = new quaternion();
 	direction->lookRotation(-origin, vector3df(0, 1, 0)).normalize();
 
-	to_corner = new vector3df((*direction) * vector3df(-size.X / 2, size.Y / 2, 0));
+	to_corner = new vector3df();
+	computeCorner();
 
 	this->origin = new vector3df(origin.X + offset.X, origin.Y + offset.Y, origin.Z + offset.Z);
 
@@ -65,6 +79,7 @@ CameraSource::CameraSource(int ind, int ch, bool grabber_channel, vector2di size
 CameraSource::~CameraSource()
 {
 	delete(size);
+	delete(requested_size);
 	delete(origin);
 	delete(direction);
 	delete(to_corner);
@@ -94,6 +109,66 @@ int CameraSource::getPixelCount()
 	return(size->X * size->Y);
 }
 
+
+/*
+The left top corner of the virtual camera plane relative to the origin.
+*/
+void CameraSource::computeCorner()
+{
+	*to_corner = (*direction) * (vector3df(-size->X / 2, size->Y / 2, 0) * pixel_size);
+}
+
+
+/*
+The mode the camera should deliver (a size of 0 asks for the largest one available, see CameraHandler::negotiateModes).
+*/
+void CameraSource::requestMode(vector2di size, double fps)
+{
+	*requested_size = size;
+	requested_fps = fps;
+	mode_negotiated = false;
+}
+
+vector2di CameraSource::getRequestedSize()
+{
+	return(*requested_size);
+}
+
+double CameraSource::getRequestedFps()
+{
+	return(requested_fps);
+}
+
+
+/*
+Take the mode the camera actually delivers. The camera plane keeps its width in space, so a higher resolution gives smaller pixels
+and every position computed from pixels (see RayGenerator::addRay) has to be scaled by getPixelSize().
+*/
+void CameraSource::setMode(vector2di size, double fps)
+{
+	*(this->size) = size;
+	this->fps = fps;
+	pixel_size = view_width / size.X;
+	mode_negotiated = true;
+
+	computeCorner();
+}
+
+bool CameraSource::getModeNegotiated()
+{
+	return(mode_negotiated);
+}
+
+double CameraSource::getFps()
+{
+	return(fps);
+}
+
+float CameraSource::getPixelSize()
+{
+	return(pixel_size);
+}
+
 vector3df CameraSource::getOrigin()
 {
 	return(*origin);
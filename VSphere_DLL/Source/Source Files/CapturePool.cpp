@@ -0,0 +1,235 @@
+/*
+Grabs the frames of all camera devices at the same time.
+
+Every hardware device is opened once and shared by all cameras which are channels of it (multi-channel grabbers).
+With more than one device every device has its own grabber thread. grabAll() releases all grabbers at once; they meet at a start barrier
+(every grabber waits until all of them are awake) and then grab their device at the same moment. After the grab a grabber retrieves
+every channel of its device directly into the frame of the camera, so the channels need no extra copy and the decoding of the devices runs in parallel.
+With a single device the capture thread grabs it directly.
+
+The end of the grab of a device is the capture time of its cameras on the media clock; the skew between all cameras is measured from it (see SphereControler::computeModelTiming).
+Cameras played from a record take the moment the grabbers are released as their capture time.
+
+Input:
+	The cameras of the sphere (their source tells the device and channel)
+
+Output:
+	The current frame of every live camera (see PerCamControler::retrieveFrame) and the capture times of all cameras
+*/
+
+#include "stdafx.h"
+
+#include "CapturePool.h"
+
+#include "ThreadPlacement.h"
+#include "AllocationTracker.h"
+
+
+CapturePool::CapturePool()
+{
+	arrived_grabbers = 0;
+}
+
+/*
+Stop and join the grabbers and release the devices.
+*/
+CapturePool::~CapturePool()
+{
+	pool_lock.lock();
+	stopping = true;
+	pool_lock.unlock();
+	grab_requested.notify_all();
+
+	for (int g = 0; g < grabbers.size(); ++g)
+	{
+		grabbers[g]->join();
+		delete(grabbers[g]);
+	}
+
+	for (int d = 0; d < devices.size(); ++d)
+	{
+		if (devices[d]->capture != nullptr)
+		{
+			devices[d]->capture->release();
+			delete(devices[d]->capture);
+		}
+		delete(devices[d]);
+	}
+}
+
+
+CapturePool::CaptureDevice * CapturePool::findDevice(int index)
+{
+	for (int d = 0; d < devices.size(); ++d)
+		if (devices[d]->index == index)
+			return(devices[d]);
+	return(nullptr);
+}
+
+/*
+Open the device of a camera and set its negotiated mode, or return the device if another channel has opened it already.
+Returns nullptr if the device cannot be opened.
+*/
+VideoCapture * CapturePool::openDevice(CameraSource * source)
+{
+	CaptureDevice * device = findDevice(source->getIndex());
+	if (device != nullptr)
+		return(device->capture);
+
+	VideoCapture * capture = new VideoCapture(source->getIndex());
+
+	if (!capture->isOpened())
+	{
+		delete(capture);
+		return(nullptr);
+	}
+
+	vector2di size = source->getSize(); // The negotiated mode (see CameraHandler::negotiateModes)
+
+	capture->set(CAP_PROP_FRAME_WIDTH, size.X);
+	capture->set(CAP_PROP_FRAME_HEIGHT, size.Y);
+	if (source->getFps() > 0)
+		capture->set(CAP_PROP_FPS, source->getFps());
+
+	if (source->getFocusValue() != -1)
+	{
+		capture->set(CAP_PROP_AUTOFOCUS, 0);
+		capture->set(CAP_PROP_FOCUS, source->getFocusValue());
+	}
+	else
+		capture->set(CAP_PROP_AUTOFOCUS, 1);
+
+	device = new CaptureDevice();
+	device->index = source->getIndex();
+	device->capture = capture;
+	devices.push_back(device);
+
+	return(capture);
+}
+
+/*
+The lock a camera has to hold while it grabs or retrieves its device on its own (nullptr if the device has not been opened).
+*/
+mutex * CapturePool::getDeviceLock(int index)
+{
+	CaptureDevice * device = findDevice(index);
+	return((device != nullptr) ? &device->lock : nullptr);
+}
+
+
+/*
+Add a camera after it has been initialized. live: the camera has opened its device (false if it is played from a record or failed to open).
+*/
+void CapturePool::addCamera(PerCamControler * controler, bool live)
+{
+	CaptureDevice * device = live ? findDevice(controler->getCameraSource()->getIndex()) : nullptr;
+
+	if (device != nullptr)
+		device->channels.push_back(controler);
+	else
+		played_cameras.push_back(controler);
+}
+
+/*
+Start one grabber per device (only with more than one device). Call once after all cameras have been added.
+*/
+void CapturePool::start()
+{
+	PipelineConfiguration * configuration = Settings::getConfiguration();
+	use_priorities = configuration->thread_priorities;
+
+	if (devices.size() > 1)
+		for (int d = 0; d < devices.size(); ++d)
+			grabbers.push_back(new thread(launchGrabber, this, d));
+
+	addInfoLine("Grabbing " + to_string(devices.size()) + " devices with " + to_string(grabbers.size()) + " grabber threads.");
+}
+
+
+/*
+Grab a frame of every device at the same time and retrieve all channels. Returns when every camera has its frame.
+*/
+void CapturePool::grabAll()
+{
+	high_resolution_clock::time_point released = high_resolution_clock::now();
+
+	if (grabbers.empty())
+	{
+		for (int d = 0; d < devices.size(); ++d)
+			grabDevice(devices[d]);
+	}
+	else
+	{
+		unique_lock<mutex> guard(pool_lock);
+
+		arrived_grabbers = 0;
+		pending_grabs = grabbers.size();
+		generation++;
+		grab_requested.notify_all();
+
+		grabs_finished.wait(guard, [&] { return(pending_grabs == 0); });
+	}
+
+	for (int c = 0; c < played_cameras.size(); ++c)
+		played_cameras[c]->setGrabTime(released);
+}
+
+/*
+Grab the device once and retrieve every channel of it.
+*/
+void CapturePool::grabDevice(CaptureDevice * device)
+{
+	device->lock.lock();
+
+	device->capture->grab();
+	device->grabbed = high_resolution_clock::now();
+
+	for (int c = 0; c < device->channels.size(); ++c)
+	{
+		device->channels[c]->setGrabTime(device->grabbed);
+		device->channels[c]->retrieveFrame();
+	}
+
+	device->lock.unlock();
+}
+
+
+void CapturePool::launchGrabber(CapturePool * pool, int grabber)
+{
+	pool->grabberLoop(grabber);
+}
+
+/*
+Wait for a grab request, meet the other grabbers at the start barrier and grab the own device.
+*/
+void CapturePool::grabberLoop(int grabber)
+{
+	ThreadPlacement::place(THREAD_ROLE_GRABBER, grabber, ThreadPlacement::planProcessor(THREAD_ROLE_GRABBER, grabber, Settings::getConfiguration()), use_priorities);
+	AllocationTracker::setStage(ALLOCATION_CAPTURE);
+
+	int handled_generation = 0;
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> guard(pool_lock);
+			grab_requested.wait(guard, [&] { return(stopping || (generation != handled_generation)); });
+
+			if (stopping)
+				return;
+
+			handled_generation = generation;
+		}
+
+		// Start barrier: The grabbers are woken one after another, so none of them grabs before all are awake
+		arrived_grabbers.fetch_add(1);
+		while (arrived_grabbers.load() < (int)grabbers.size())
+			this_thread::yield();
+
+		grabDevice(devices[grabber]);
+
+		lock_guard<mutex> guard(pool_lock);
+		if (--pending_grabs == 0)
+			grabs_finished.notify_one();
+	}
+}
@@ -4,6 +4,7 @@ Therefore it takes the prepared data from the BackgroundReference. Just like it
 
 Input (from BackgroundReference):
 	BinaryMask pointer				// Bool array covering the frame image containing which pixels are background and which object
+	CoarseMask pointer				// Blocks of the mask which have been filled from a single sample. Cells made of such blocks only are not scanned
 
 Output:
 	contour_pixels pointer			// Array with pixels telling whetehr they are contour or not
@@ -46,17 +47,21 @@ ContoursExtractor::~ContoursExtractor()
 	// Create the new in/out grid
 	if (inout_grid != nullptr)
 		delete[] inout_grid;
+
+	if (cleared_cells != nullptr)
+		delete[] cleared_cells;
 }
 
 
 /*
 Initialize environment data
 */
-void ContoursExtractor::initData(Mat * frame, Mat * background, bool * binaryMask)
+void ContoursExtractor::initData(Mat * frame, Mat * background, bool * binaryMask, CoarseMask * coarse_mask)
 {
 	this->frame = frame;
 
 	this->binaryMask = binaryMask;
+	this->coarse_mask = coarse_mask;
 
 	// Get the pointer of the first pixel of the background Mat (this is the fastest way to access its contents)
 	bc = background->ptr<uchar>(0);
@@ -78,13 +83,27 @@ void ContoursExtractor::initData(Mat * frame, Mat * background, bool * binaryMas
 	cout << "Pixels per frame: " << pixelcount << endl;
 
 
-	// Calculate number of elements in mask contours_grid
-	mask_pixelcount = pixelcount / contour_mask_pixelcount;
+	// Calculate number of elements in mask contours_grid (a remainder of the frame smaller than a cell is not covered, e.g. 8 rows of 1080 with cells of 16)
+	mask_pixelcount = grid_w * grid_h;
+
+
+	// The grids have to be re-planned if the cell size has changed (see applyConfiguration)
+	if ((contour_keypooints_grid != nullptr) && (allocated_mask_pixelcount != mask_pixelcount))
+	{
+		delete[] contour_keypooints_grid;
+		delete[] inout_grid;
+		delete[] cleared_cells;
+		contour_keypooints_grid = nullptr;
+		inout_grid = nullptr;
+		cleared_cells = nullptr;
+	}
+	allocated_mask_pixelcount = mask_pixelcount;
+	computed_cells = Rect(0, 0, grid_w, grid_h); // The grids have to be computed completely first
 
 
 	// Create the new binary contour pixel mask
 	if (contour_pixels == nullptr)
-		contour_pixels = new bool[pixelcount];
+		contour_pixels = new bool[pixelcount](); // The uncovered remainder stays false
 
 	// Create the new contours grid
 	if (contour_keypooints_grid == nullptr)
@@ -93,6 +112,25 @@ void ContoursExtractor::initData(Mat * frame, Mat * background, bool * binaryMas
 	// Create the new in/out grid
 	if (inout_grid == nullptr)
 		inout_grid = new int[mask_pixelcount];
+
+	if (cleared_cells == nullptr)
+		cleared_cells = new bool[mask_pixelcount]();
+}
+
+
+/*
+Take the values of a newly published configuration (called between frames).
+Returns true if the cell size has changed. In that case initData() has to be called again which gives the grids new addresses.
+*/
+bool ContoursExtractor::applyConfiguration(PipelineConfiguration * configuration)
+{
+	noisepixel_tolerance = configuration->noisepixel_tolerance;
+
+	if (contour_mask_size == configuration->contour_mask_size)
+		return(false);
+
+	contour_mask_size = configuration->contour_mask_size;
+	return(true);
 }
 
 
@@ -101,14 +139,35 @@ Compute the actual contours with the input and outputs as described.
 */
 void ContoursExtractor::computeContour()
 {
+	computeContour(Rect(0, 0, grid_w, grid_h));
+}
+
+/*
+Like computeContour() but only for a window of cells (see RegionOfInterest). The binary mask has to be computed one pixel around the window.
+Cells of the previous window which are outside of the new one are reset to "no contour, completely background",
+so the cells outside of the window never contain anything the edges could follow.
+*/
+void ContoursExtractor::computeContour(Rect cells)
+{
+	for (int cy = computed_cells.y; cy < computed_cells.y + computed_cells.height; ++cy)
+		for (int cx = computed_cells.x; cx < computed_cells.x + computed_cells.width; ++cx)
+			if ((cx < cells.x) || (cy < cells.y) || (cx >= cells.x + cells.width) || (cy >= cells.y + cells.height))
+			{
+				contour_keypooints_grid[cy * grid_w + cx] = -1;
+				inout_grid[cy * grid_w + cx] = contour_mask_pixelcount;
+			}
+	computed_cells = cells;
+
 	int ps = 0;
 	int contour_count = 0;
 	int cenx = 0;
 	int ceny = 0;
 
-	for (int y = 0; y < frame_h; y += contour_mask_size)
+	for (int y = cells.y * contour_mask_size; y < (cells.y + cells.height) * contour_mask_size; y += contour_mask_size)
 	{
-		for (int x = 0; x < frame_w; x += contour_mask_size)
+		ps = (y / contour_mask_size) * grid_w + cells.x;
+
+		for (int x = cells.x * contour_mask_size; x < (cells.x + cells.width) * contour_mask_size; x += contour_mask_size)
 		{
 			contour_count = 0;
 			cenx = 0;
@@ -116,6 +175,21 @@ void ContoursExtractor::computeContour()
 
 			//int ps = x / contour_mask_size + (y / contour_mask_size) * grid_w;
 
+			int uniform_state = getUniformCellState(x, y);
+			if (uniform_state >= 0)
+			{
+				inout_grid[ps] = (uniform_state == COARSE_OBJECT) ? 0 : contour_mask_pixelcount;
+				contour_keypooints_grid[ps] = -1;
+
+				if (!cleared_cells[ps])
+					for (int yy = 0; yy < contour_mask_size; yy++)
+						memset(contour_pixels + x + (y + yy)*frame_w, 0, contour_mask_size);
+				cleared_cells[ps] = true;
+
+				ps++;
+				continue;
+			}
+
 			inout_grid[ps] = 0;
 
 			for (int xx = 0; xx < contour_mask_size; xx++)
@@ -141,6 +215,8 @@ void ContoursExtractor::computeContour()
 				}
 			}
 
+			cleared_cells[ps] = (contour_count == 0);
+
 			if (contour_count >= noisepixel_tolerance)
 			{
 				cenx /= contour_count;
@@ -159,6 +235,36 @@ void ContoursExtractor::computeContour()
 }
 
 
+/*
+If the cell at the given pixel and all pixels the contour test compares it with (one around it, except below) have been filled
+from the coarse level with the same class, returns that class (0 or COARSE_OBJECT). Otherwise returns -1 and the cell has to be scanned.
+Such a cell contains no contour pixel. The cells at the border of the frame are always scanned (their neighbors wrap around the rows).
+*/
+int ContoursExtractor::getUniformCellState(int x, int y)
+{
+	int b = coarse_mask->block_size;
+
+	if ((b <= 1) || (x == 0) || (y == 0) || (x + contour_mask_size >= frame_w))
+		return(-1);
+
+	int bx0 = (x - 1) / b;
+	int by0 = (y - 1) / b;
+	int bx1 = (x + contour_mask_size) / b;
+	int by1 = (y + contour_mask_size - 1) / b;
+
+	uchar * states = coarse_mask->states;
+	uchar state = states[by0 * coarse_mask->blocks_w + bx0];
+
+	if (state > COARSE_OBJECT)
+		return(-1);
+
+	for (int by = by0; by <= by1; ++by)
+		for (int bx = bx0; bx <= bx1; ++bx)
+			if (states[by * coarse_mask->blocks_w + bx] != state)
+				return(-1);
+
+	return(state);
+}
 
 
 int * ContoursExtractor::getContourGrid()
@@ -197,9 +303,9 @@ void ContoursExtractor::previewInoutMask(Mat * dest)
 
 	int val = 0;
 	int j = 0;
-	for (int x = 0; x < frame_w; x += contour_mask_size)
+	for (int x = 0; x < grid_w * contour_mask_size; x += contour_mask_size)
 	{
-		for (int y = 0; y < frame_h; y += contour_mask_size)
+		for (int y = 0; y < grid_h * contour_mask_size; y += contour_mask_size)
 		{
 			int ps = x / contour_mask_size + (y / contour_mask_size) * grid_w;
 
@@ -264,7 +370,7 @@ void ContoursExtractor::previewContourKeypointMask(Mat * dest)
 	if (contour_pixels == nullptr)
 		return;
 	
-	computeContour();
+	computeContour(computed_cells); // Only the window of the frame (see RegionOfInterest)
 
 	uchar* d = dest->ptr<uchar>(0);
 
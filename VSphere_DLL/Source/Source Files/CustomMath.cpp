@@ -8,6 +8,19 @@ The code has been highly optimized and enhanced with more arguments to avoid rec
 
 #include "CustomMath.h"
 
+// AVX2 intrinsics are available on every x86 target of Visual Studio (used only if the CPU supports them, see narrow_phase_uses_avx2())
+#if (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))) || defined(__AVX2__)
+#define CUSTOMMATH_USE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+
+// Below this the intersection line is treated as parallel to a ray (same limit as in ModelBuilder::intersectRayPair())
+#define NARROW_PHASE_MIN_D 3000
+
 
 float CustomMath::compute_line_distance(vector3df w, vector3df u, vector3df v, float a, float c, float b, float D)
 {
@@ -157,4 +170,590 @@ void CustomMath::RGB2HSV(float r, float g, float b,
 	h = fabs(K + (g - b) / (6.f * chroma + 1e-20f));
 	s = chroma / (r + 1e-20f);
 	v = r;
-}
\ No newline at end of file
+}
+
+
+
+
+/*
+Batched narrow phase of the intersection of rays (see ModelBuilder::intersectRayPair() for the meaning of the values).
+
+The functions above work on one pair of rays at a time with vectors passed by value.
+The batch computes the same for NARROW_PHASE_BATCH rays of another camera with one own ray:
+the distance of the center lines, the line in which the planes of the rays intersect and
+where that line crosses the start and end edges of both rays.
+The angle between the intersection line and the camera is not computed with atan2, sin and cos.
+With the normalized line direction I, the camera direction C and the normal N of the own ray
+atan2(I.(C x N), I.C) is the angle, so |sin| = |I.(C x N)| / r and cos = I.C / r with r = sqrt((I.(C x N))^2 + (I.C)^2).
+
+The batch also returns the position along the other ray and the angle seen from the other camera.
+Seen from there the intersection line has the direction -I (the planes are intersected in the opposite order),
+so the other camera gets the same results without testing the pair a second time (see CameraPairIntersector).
+
+The results match the single pair functions within floating point tolerance (check_narrow_phase_batch() compares them).
+*/
+
+
+void NarrowPhaseBatch::setRay(Ray3D * ray)
+{
+	count = 0;
+
+	origin = ray->origin;
+	origin_start = ray->origin_start;
+	origin_end = ray->origin_end;
+	normal = ray->normal;
+	width_sq = ray->ray_width_sq;
+}
+
+void NarrowPhaseBatch::addOtherRay(Ray3D * other_ray)
+{
+	origin_x[count] = other_ray->origin.X;
+	origin_y[count] = other_ray->origin.Y;
+	origin_z[count] = other_ray->origin.Z;
+
+	start_x[count] = other_ray->origin_start.X;
+	start_y[count] = other_ray->origin_start.Y;
+	start_z[count] = other_ray->origin_start.Z;
+
+	end_x[count] = other_ray->origin_end.X;
+	end_y[count] = other_ray->origin_end.Y;
+	end_z[count] = other_ray->origin_end.Z;
+
+	normal_x[count] = other_ray->normal.X;
+	normal_y[count] = other_ray->normal.Y;
+	normal_z[count] = other_ray->normal.Z;
+
+	other_width_sq[count] = other_ray->ray_width_sq;
+
+	count++;
+}
+
+
+#ifdef CUSTOMMATH_USE_AVX2
+static bool detect_avx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return(false);
+
+	__cpuid(info, 1);
+	if (((info[2] & (1 << 27)) == 0) || ((info[2] & (1 << 28)) == 0)) // OSXSAVE and AVX
+		return(false);
+
+	if ((_xgetbv(0) & 6) != 6) // The OS saves the YMM registers
+		return(false);
+
+	__cpuidex(info, 7, 0);
+	return((info[1] & (1 << 5)) != 0); // AVX2
+#else
+	return(true); // Compiled for AVX2
+#endif
+}
+
+static const bool avx2_supported = detect_avx2();
+#endif
+
+bool CustomMath::narrow_phase_uses_avx2()
+{
+#ifdef CUSTOMMATH_USE_AVX2
+	return(avx2_supported);
+#else
+	return(false);
+#endif
+}
+
+
+/*
+Compute all pairs of the batch (with AVX2 if available).
+*/
+void CustomMath::compute_narrow_phase_batch(const NarrowPhaseConstants & constants, NarrowPhaseBatch * batch)
+{
+#ifdef CUSTOMMATH_USE_AVX2
+	if (!avx2_supported)
+	{
+		compute_narrow_phase_batch_scalar(constants, batch);
+		return;
+	}
+
+	#define SET(value) _mm256_set1_ps(value)
+	#define ADD(a, b) _mm256_add_ps(a, b)
+	#define SUB(a, b) _mm256_sub_ps(a, b)
+	#define MUL(a, b) _mm256_mul_ps(a, b)
+	#define DIV(a, b) _mm256_div_ps(a, b)
+	#define DOT(ax, ay, az, bx, by, bz) ADD(ADD(MUL(ax, bx), MUL(ay, by)), MUL(az, bz))
+
+	const __m256 sign_mask = SET(-0.0f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = SET(1.0f);
+	const __m256 min_d = SET(NARROW_PHASE_MIN_D);
+
+	// Values of the camera pair and the own ray (the same in all lanes)
+	const __m256 cvx = SET(constants.cam_vec.X), cvy = SET(constants.cam_vec.Y), cvz = SET(constants.cam_vec.Z);
+	const __m256 ovx = SET(constants.other_vec.X), ovy = SET(constants.other_vec.Y), ovz = SET(constants.other_vec.Z);
+	const __m256 cam_dot = SET(constants.cam_dot), other_dot = SET(constants.other_dot), ab_dot = SET(constants.ab_dot), quotient = SET(constants.quotient);
+
+	const __m256 nax = SET(batch->normal.X), nay = SET(batch->normal.Y), naz = SET(batch->normal.Z);
+	const __m256 d1 = SET(-batch->normal.dotProduct(batch->origin));
+
+	vector3df angle_axis = constants.cam_vec_norm.crossProduct(batch->normal);
+	const __m256 axx = SET(angle_axis.X), axy = SET(angle_axis.Y), axz = SET(angle_axis.Z);
+	const __m256 cnx = SET(constants.cam_vec_norm.X), cny = SET(constants.cam_vec_norm.Y), cnz = SET(constants.cam_vec_norm.Z);
+	const __m256 onx = SET(constants.other_vec_norm.X), ony = SET(constants.other_vec_norm.Y), onz = SET(constants.other_vec_norm.Z);
+
+
+	// Distance of the center lines (compute_line_distance)
+	__m256 wx = SUB(_mm256_loadu_ps(batch->origin_x), SET(batch->origin.X));
+	__m256 wy = SUB(_mm256_loadu_ps(batch->origin_y), SET(batch->origin.Y));
+	__m256 wz = SUB(_mm256_loadu_ps(batch->origin_z), SET(batch->origin.Z));
+
+	__m256 d = DOT(cvx, cvy, cvz, wx, wy, wz);
+	__m256 e = DOT(ovx, ovy, ovz, wx, wy, wz);
+	__m256 seg1 = DIV(SUB(MUL(ab_dot, e), MUL(other_dot, d)), quotient);
+	__m256 seg2 = DIV(SUB(MUL(cam_dot, e), MUL(ab_dot, d)), quotient);
+
+	__m256 px = SUB(ADD(wx, MUL(seg1, cvx)), MUL(seg2, ovx));
+	__m256 py = SUB(ADD(wy, MUL(seg1, cvy)), MUL(seg2, ovy));
+	__m256 pz = SUB(ADD(wz, MUL(seg1, cvz)), MUL(seg2, ovz));
+
+	__m256 valid = _mm256_cmp_ps(DOT(px, py, pz, px, py, pz), ADD(SET(batch->width_sq), _mm256_loadu_ps(batch->other_width_sq)), _CMP_LT_OQ);
+
+
+	// Intersection line of the planes (compute_plane_collission)
+	__m256 nbx = _mm256_loadu_ps(batch->normal_x), nby = _mm256_loadu_ps(batch->normal_y), nbz = _mm256_loadu_ps(batch->normal_z);
+
+	__m256 ux = SUB(MUL(nay, nbz), MUL(naz, nby));
+	__m256 uy = SUB(MUL(naz, nbx), MUL(nax, nbz));
+	__m256 uz = SUB(MUL(nax, nby), MUL(nay, nbx));
+
+	__m256 ax = _mm256_andnot_ps(sign_mask, ux);
+	__m256 ay = _mm256_andnot_ps(sign_mask, uy);
+	__m256 az = _mm256_andnot_ps(sign_mask, uz);
+
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(ADD(ADD(ax, ay), az), one, _CMP_NLT_UQ)); // Not (near) parallel
+
+	__m256 d2 = _mm256_xor_ps(sign_mask, DOT(nbx, nby, nbz, _mm256_loadu_ps(batch->origin_x), _mm256_loadu_ps(batch->origin_y), _mm256_loadu_ps(batch->origin_z)));
+
+	// Zero the largest coordinate of the cross product and solve for the other two
+	__m256 x_largest = _mm256_and_ps(_mm256_cmp_ps(ax, ay, _CMP_GT_OQ), _mm256_cmp_ps(ax, az, _CMP_GT_OQ));
+	__m256 y_largest = _mm256_andnot_ps(_mm256_cmp_ps(ax, ay, _CMP_GT_OQ), _mm256_cmp_ps(ay, az, _CMP_GT_OQ));
+
+	__m256 lx = DIV(SUB(MUL(d2, nay), MUL(d1, nby)), uz); // z = 0
+	__m256 ly = DIV(SUB(MUL(d1, nbx), MUL(d2, nax)), uz);
+	__m256 lz = zero;
+
+	lx = _mm256_blendv_ps(lx, zero, x_largest); // x = 0
+	ly = _mm256_blendv_ps(ly, DIV(SUB(MUL(d2, naz), MUL(d1, nbz)), ux), x_largest);
+	lz = _mm256_blendv_ps(lz, DIV(SUB(MUL(d1, nby), MUL(d2, nay)), ux), x_largest);
+
+	lx = _mm256_blendv_ps(lx, DIV(SUB(MUL(d1, nbz), MUL(d2, naz)), uy), y_largest); // y = 0
+	ly = _mm256_blendv_ps(ly, zero, y_largest);
+	lz = _mm256_blendv_ps(lz, DIV(SUB(MUL(d2, nax), MUL(d1, nbx)), uy), y_largest);
+
+	// Normalized direction of the intersection line
+	__m256 length = _mm256_sqrt_ps(DOT(ux, uy, uz, ux, uy, uz));
+	__m256 ix = DIV(ux, length), iy = DIV(uy, length), iz = DIV(uz, length);
+	__m256 dot_a = DOT(ix, iy, iz, ix, iy, iz);
+
+
+	// Crossing of the intersection line with the edges of the other ray (compute_line_collission_eff)
+	__m256 b = DOT(ix, iy, iz, ovx, ovy, ovz);
+	__m256 D = SUB(MUL(dot_a, other_dot), MUL(b, b));
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(D, min_d, _CMP_NLT_UQ));
+
+	wx = SUB(lx, _mm256_loadu_ps(batch->start_x));
+	wy = SUB(ly, _mm256_loadu_ps(batch->start_y));
+	wz = SUB(lz, _mm256_loadu_ps(batch->start_z));
+	d = DOT(ix, iy, iz, wx, wy, wz);
+	e = DOT(ovx, ovy, ovz, wx, wy, wz);
+	_mm256_storeu_ps(batch->other_ray_pos_start, DIV(SUB(MUL(dot_a, e), MUL(b, d)), D));
+	_mm256_storeu_ps(batch->pos_other_start, DIV(SUB(MUL(b, e), MUL(other_dot, d)), D));
+
+	wx = SUB(lx, _mm256_loadu_ps(batch->end_x));
+	wy = SUB(ly, _mm256_loadu_ps(batch->end_y));
+	wz = SUB(lz, _mm256_loadu_ps(batch->end_z));
+	d = DOT(ix, iy, iz, wx, wy, wz);
+	e = DOT(ovx, ovy, ovz, wx, wy, wz);
+	_mm256_storeu_ps(batch->other_ray_pos_end, DIV(SUB(MUL(dot_a, e), MUL(b, d)), D));
+	_mm256_storeu_ps(batch->pos_other_end, DIV(SUB(MUL(b, e), MUL(other_dot, d)), D));
+
+
+	// Crossing of the intersection line with the edges of the own ray (compute_line_collission_eff_full)
+	b = DOT(ix, iy, iz, cvx, cvy, cvz);
+	D = SUB(MUL(dot_a, cam_dot), MUL(b, b));
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(D, min_d, _CMP_NLT_UQ));
+
+	wx = SUB(lx, SET(batch->origin_start.X));
+	wy = SUB(ly, SET(batch->origin_start.Y));
+	wz = SUB(lz, SET(batch->origin_start.Z));
+	d = DOT(ix, iy, iz, wx, wy, wz);
+	e = DOT(cvx, cvy, cvz, wx, wy, wz);
+	_mm256_storeu_ps(batch->this_ray_pos_start, DIV(SUB(MUL(dot_a, e), MUL(b, d)), D));
+	_mm256_storeu_ps(batch->pos_this_start, DIV(SUB(MUL(b, e), MUL(cam_dot, d)), D));
+
+	wx = SUB(lx, SET(batch->origin_end.X));
+	wy = SUB(ly, SET(batch->origin_end.Y));
+	wz = SUB(lz, SET(batch->origin_end.Z));
+	d = DOT(ix, iy, iz, wx, wy, wz);
+	e = DOT(cvx, cvy, cvz, wx, wy, wz);
+	_mm256_storeu_ps(batch->this_ray_pos_end, DIV(SUB(MUL(dot_a, e), MUL(b, d)), D));
+	_mm256_storeu_ps(batch->pos_this_end, DIV(SUB(MUL(b, e), MUL(cam_dot, d)), D));
+
+
+	// Sine and cosine of the angle between the intersection line and the camera
+	__m256 sin_part = DOT(ix, iy, iz, axx, axy, axz);
+	__m256 cos_part = DOT(ix, iy, iz, cnx, cny, cnz);
+	__m256 radius = _mm256_sqrt_ps(ADD(MUL(sin_part, sin_part), MUL(cos_part, cos_part)));
+	__m256 no_angle = _mm256_cmp_ps(radius, zero, _CMP_EQ_OQ); // atan2(0, 0) is 0
+
+	_mm256_storeu_ps(batch->sine, _mm256_blendv_ps(DIV(_mm256_andnot_ps(sign_mask, sin_part), radius), zero, no_angle));
+	_mm256_storeu_ps(batch->cosine, _mm256_blendv_ps(DIV(cos_part, radius), one, no_angle));
+
+	// The same for the other camera (direction -I and the normal of the other ray)
+	__m256 oax = SUB(MUL(ony, nbz), MUL(onz, nby));
+	__m256 oay = SUB(MUL(onz, nbx), MUL(onx, nbz));
+	__m256 oaz = SUB(MUL(onx, nby), MUL(ony, nbx));
+
+	sin_part = DOT(ix, iy, iz, oax, oay, oaz);
+	cos_part = _mm256_xor_ps(sign_mask, DOT(ix, iy, iz, onx, ony, onz));
+	radius = _mm256_sqrt_ps(ADD(MUL(sin_part, sin_part), MUL(cos_part, cos_part)));
+	no_angle = _mm256_cmp_ps(radius, zero, _CMP_EQ_OQ);
+
+	_mm256_storeu_ps(batch->other_sine, _mm256_blendv_ps(DIV(_mm256_andnot_ps(sign_mask, sin_part), radius), zero, no_angle));
+	_mm256_storeu_ps(batch->other_cosine, _mm256_blendv_ps(DIV(cos_part, radius), one, no_angle));
+
+	_mm256_storeu_ps((float*)batch->valid, valid);
+
+	#undef SET
+	#undef ADD
+	#undef SUB
+	#undef MUL
+	#undef DIV
+	#undef DOT
+
+	for (int l = batch->count; l < NARROW_PHASE_BATCH; ++l)
+		batch->valid[l] = 0;
+#else
+	compute_narrow_phase_batch_scalar(constants, batch);
+#endif
+}
+
+
+/*
+The same as compute_narrow_phase_batch() one pair after another (used without AVX2).
+*/
+void CustomMath::compute_narrow_phase_batch_scalar(const NarrowPhaseConstants & constants, NarrowPhaseBatch * batch)
+{
+	const vector3df & cam_vec = constants.cam_vec;
+	const vector3df & other_vec = constants.other_vec;
+
+	vector3df angle_axis = constants.cam_vec_norm.crossProduct(batch->normal);
+
+	for (int l = 0; l < NARROW_PHASE_BATCH; ++l)
+	{
+		batch->valid[l] = 0;
+		if (l >= batch->count)
+			continue;
+
+		vector3df other_origin(batch->origin_x[l], batch->origin_y[l], batch->origin_z[l]);
+		vector3df other_normal(batch->normal_x[l], batch->normal_y[l], batch->normal_z[l]);
+
+		// Distance of the center lines
+		if (!(compute_line_distance(other_origin - batch->origin, cam_vec, other_vec, constants.cam_dot, constants.other_dot, constants.ab_dot, constants.quotient) < (batch->width_sq + batch->other_width_sq[l])))
+			continue;
+
+		// Intersection line of the planes
+		vector3df line_orig, line_target;
+		if (compute_plane_collission(batch->normal, other_normal, batch->origin, other_origin, &line_orig, &line_target) != 2)
+			continue;
+
+		vector3df direction = batch->normal.crossProduct(other_normal);
+		direction.normalize();
+		float dot_a = direction.dotProduct(direction);
+
+		// Crossing with the edges of the other ray
+		float b = direction.dotProduct(other_vec);
+		float D = dot_a * constants.other_dot - b * b;
+		if (D < NARROW_PHASE_MIN_D)
+			continue;
+
+		batch->pos_other_start[l] = compute_line_collission_eff_full(line_orig - vector3df(batch->start_x[l], batch->start_y[l], batch->start_z[l]), direction, other_vec, dot_a, constants.other_dot, b, D, &batch->other_ray_pos_start[l]);
+		batch->pos_other_end[l] = compute_line_collission_eff_full(line_orig - vector3df(batch->end_x[l], batch->end_y[l], batch->end_z[l]), direction, other_vec, dot_a, constants.other_dot, b, D, &batch->other_ray_pos_end[l]);
+
+		// Crossing with the edges of the own ray
+		b = direction.dotProduct(cam_vec);
+		D = dot_a * constants.cam_dot - b * b;
+		if (D < NARROW_PHASE_MIN_D)
+			continue;
+
+		batch->pos_this_start[l] = compute_line_collission_eff_full(line_orig - batch->origin_start, direction, cam_vec, dot_a, constants.cam_dot, b, D, &batch->this_ray_pos_start[l]);
+		batch->pos_this_end[l] = compute_line_collission_eff_full(line_orig - batch->origin_end, direction, cam_vec, dot_a, constants.cam_dot, b, D, &batch->this_ray_pos_end[l]);
+
+		// Sine and cosine without trigonometric functions
+		float sin_part = direction.dotProduct(angle_axis);
+		float cos_part = direction.dotProduct(constants.cam_vec_norm);
+		float radius = sqrt(sin_part * sin_part + cos_part * cos_part);
+
+		batch->sine[l] = (radius != 0) ? abs(sin_part) / radius : 0;
+		batch->cosine[l] = (radius != 0) ? cos_part / radius : 1;
+
+		// The same for the other camera
+		sin_part = direction.dotProduct(constants.other_vec_norm.crossProduct(other_normal));
+		cos_part = -direction.dotProduct(constants.other_vec_norm);
+		radius = sqrt(sin_part * sin_part + cos_part * cos_part);
+
+		batch->other_sine[l] = (radius != 0) ? abs(sin_part) / radius : 0;
+		batch->other_cosine[l] = (radius != 0) ? cos_part / radius : 1;
+
+		batch->valid[l] = -1;
+	}
+}
+
+
+/*
+The batch computed exactly like the original single pair code in ModelBuilder::intersectRayPair() (including atan2, sin and cos).
+Only used as the reference for check_narrow_phase_batch().
+*/
+void CustomMath::compute_narrow_phase_reference(const NarrowPhaseConstants & constants, NarrowPhaseBatch * batch)
+{
+	const vector3df & cam_vec = constants.cam_vec;
+	const vector3df & other_vec = constants.other_vec;
+	const vector3df & cam_norm = constants.cam_vec_norm;
+
+	for (int l = 0; l < NARROW_PHASE_BATCH; ++l)
+	{
+		batch->valid[l] = 0;
+		if (l >= batch->count)
+			continue;
+
+		vector3df other_origin(batch->origin_x[l], batch->origin_y[l], batch->origin_z[l]);
+		vector3df other_normal(batch->normal_x[l], batch->normal_y[l], batch->normal_z[l]);
+
+		if (!(compute_line_distance(other_origin - batch->origin, cam_vec, other_vec, constants.cam_dot, constants.other_dot, constants.ab_dot, constants.quotient) < (batch->width_sq + batch->other_width_sq[l])))
+			continue;
+
+		vector3df line_orig, line_target;
+		if (compute_plane_collission(batch->normal, other_normal, batch->origin, other_origin, &line_orig, &line_target) != 2)
+			continue;
+
+		vector3df direction = (line_target - line_orig);
+		direction.normalize();
+		float dot_a = direction.dotProduct(direction);
+
+		float b = direction.dotProduct(other_vec);
+		float D = (dot_a * constants.other_dot - b*b);
+		if (D < NARROW_PHASE_MIN_D)
+			continue;
+
+		batch->pos_other_start[l] = compute_line_collission_eff_full(line_orig - vector3df(batch->start_x[l], batch->start_y[l], batch->start_z[l]), direction, other_vec, dot_a, constants.other_dot, b, D, &batch->other_ray_pos_start[l]);
+		batch->pos_other_end[l] = compute_line_collission_eff_full(line_orig - vector3df(batch->end_x[l], batch->end_y[l], batch->end_z[l]), direction, other_vec, dot_a, constants.other_dot, b, D, &batch->other_ray_pos_end[l]);
+
+		b = direction.dotProduct(cam_vec);
+		D = (dot_a * constants.cam_dot - b*b);
+		if (D < NARROW_PHASE_MIN_D)
+			continue;
+
+		batch->pos_this_start[l] = compute_line_collission_eff_full(line_orig - batch->origin_start, direction, cam_vec, dot_a, constants.cam_dot, b, D, &batch->this_ray_pos_start[l]);
+		batch->pos_this_end[l] = compute_line_collission_eff_full(line_orig - batch->origin_end, direction, cam_vec, dot_a, constants.cam_dot, b, D, &batch->this_ray_pos_end[l]);
+
+		const vector3df & normal = batch->normal;
+		double angle = atan2(
+			direction.X*cam_norm.Y*normal.Z + cam_norm.X*normal.Y*direction.Z + normal.X*direction.Y*cam_norm.Z - direction.Z*cam_norm.Y*normal.X - cam_norm.Z*normal.Y*direction.X - normal.Z*direction.Y*cam_norm.X
+			, direction.dotProduct(cam_norm)
+		);
+
+		batch->sine[l] = abs(sinf(angle));
+		batch->cosine[l] = cosf(angle);
+
+		// Seen from the other camera (like the single pair code of its ModelBuilder)
+		const vector3df other_direction = -direction;
+		const vector3df & other_norm = constants.other_vec_norm;
+		angle = atan2(
+			other_direction.X*other_norm.Y*other_normal.Z + other_norm.X*other_normal.Y*other_direction.Z + other_normal.X*other_direction.Y*other_norm.Z - other_direction.Z*other_norm.Y*other_normal.X - other_norm.Z*other_normal.Y*other_direction.X - other_normal.Z*other_direction.Y*other_norm.X
+			, other_direction.dotProduct(other_norm)
+		);
+
+		batch->other_sine[l] = abs(sinf(angle));
+		batch->other_cosine[l] = cosf(angle);
+
+		batch->valid[l] = -1;
+	}
+}
+
+
+/*
+Differential test of the batched narrow phase against the reference.
+Returns the number of pairs where the validity differs or a result differs by more than the tolerance
+(relative to the magnitude of the value, at least absolute).
+*/
+int CustomMath::check_narrow_phase_batch(const NarrowPhaseConstants & constants, const NarrowPhaseBatch & batch, float tolerance)
+{
+	NarrowPhaseBatch * computed = new NarrowPhaseBatch(batch);
+	NarrowPhaseBatch * reference = new NarrowPhaseBatch(batch);
+
+	compute_narrow_phase_batch(constants, computed);
+	compute_narrow_phase_reference(constants, reference);
+
+	int mismatches = count_narrow_phase_mismatches(*computed, *reference, tolerance);
+
+	delete(computed);
+	delete(reference);
+
+	return(mismatches);
+}
+
+/*
+Differential test of the AVX2 path against the scalar path on fixed rays, independent of any camera.
+Every own ray is tested with 1 to NARROW_PHASE_BATCH other rays, so all partial batches (the tails of the rays of a camera) are covered.
+Lanes behind the count of a batch must not be valid.
+Returns the number of mismatching pairs (like check_narrow_phase_batch()) or -1 if the CPU has no AVX2 (nothing to compare).
+*/
+int CustomMath::check_narrow_phase_paths(float tolerance, int * checked_pairs)
+{
+	*checked_pairs = 0;
+
+	if (!narrow_phase_uses_avx2())
+		return(-1);
+
+	// Two cameras looking at the same space from different directions (see ModelBuilder::prepareNarrowPhaseConstants)
+	NarrowPhaseConstants constants;
+	constants.cam_vec = vector3df(0, 0, 1000);
+	constants.other_vec = vector3df(800, 0, 600);
+	constants.cam_vec_norm = constants.cam_vec;
+	constants.cam_vec_norm.normalize();
+	constants.other_vec_norm = constants.other_vec;
+	constants.other_vec_norm.normalize();
+	constants.cam_dot = constants.cam_vec.dotProduct(constants.cam_vec);
+	constants.other_dot = constants.other_vec.dotProduct(constants.other_vec);
+	constants.ab_dot = constants.cam_vec.dotProduct(constants.other_vec);
+	constants.quotient = constants.cam_dot * constants.other_dot - constants.ab_dot * constants.ab_dot;
+
+	// Axes of the image plane of the other camera
+	const vector3df other_u(0, 1, 0), other_v(0.6f, 0, -0.8f);
+
+	const int own_rays = 4;
+
+	NarrowPhaseBatch * avx2 = new NarrowPhaseBatch();
+	NarrowPhaseBatch * scalar = new NarrowPhaseBatch();
+	int mismatches = 0;
+
+	for (int k = 0; k < own_rays; ++k)
+		for (int count = 1; count <= NARROW_PHASE_BATCH; ++count)
+		{
+			// Own ray k: an edge of 10 units in the image plane of the camera at a fixed position and angle
+			vector3df origin(-40.0f + 20 * k, -30.0f + 15 * k, 0);
+			vector3df edge(cos(0.3f + 0.4f * k), sin(0.3f + 0.4f * k), 0);
+
+			avx2->count = 0;
+			avx2->origin = origin;
+			avx2->origin_start = origin - edge * 5;
+			avx2->origin_end = origin + edge * 5;
+			avx2->normal = constants.cam_vec.crossProduct(edge);
+			avx2->normal.normalize();
+			avx2->width_sq = 4;
+
+			// The even lanes pass close to the center line of the own ray (mostly valid), the odd lanes close to the next ray (not valid)
+			for (int l = 0; l < count; ++l)
+			{
+				int target = (l % 2 == 0) ? k : (k + 1) % own_rays;
+				vector3df target_point(-40.0f + 20 * target + 0.4f * l - 1, -30.0f + 15 * target + 0.3f * (l % 3), 200.0f + 60 * l);
+				vector3df other_origin = target_point - constants.other_vec * 0.5f;
+
+				float angle = 0.5f + 0.7f * l + 0.2f * k;
+				vector3df other_edge = other_u * cos(angle) + other_v * sin(angle);
+				vector3df other_normal = constants.other_vec.crossProduct(other_edge);
+				other_normal.normalize();
+
+				avx2->origin_x[l] = other_origin.X;
+				avx2->origin_y[l] = other_origin.Y;
+				avx2->origin_z[l] = other_origin.Z;
+				avx2->start_x[l] = other_origin.X - 4 * other_edge.X;
+				avx2->start_y[l] = other_origin.Y - 4 * other_edge.Y;
+				avx2->start_z[l] = other_origin.Z - 4 * other_edge.Z;
+				avx2->end_x[l] = other_origin.X + 4 * other_edge.X;
+				avx2->end_y[l] = other_origin.Y + 4 * other_edge.Y;
+				avx2->end_z[l] = other_origin.Z + 4 * other_edge.Z;
+				avx2->normal_x[l] = other_normal.X;
+				avx2->normal_y[l] = other_normal.Y;
+				avx2->normal_z[l] = other_normal.Z;
+				avx2->other_width_sq[l] = 4;
+				avx2->count++;
+			}
+
+			// Garbage in the unused lanes must not leak into the results
+			for (int l = count; l < NARROW_PHASE_BATCH; ++l)
+			{
+				avx2->origin_x[l] = avx2->origin.X;
+				avx2->origin_y[l] = avx2->origin.Y;
+				avx2->origin_z[l] = avx2->origin.Z;
+				avx2->start_x[l] = avx2->start_y[l] = avx2->start_z[l] = 0;
+				avx2->end_x[l] = avx2->end_y[l] = avx2->end_z[l] = 0;
+				avx2->normal_x[l] = avx2->normal_y[l] = avx2->normal_z[l] = 0;
+				avx2->other_width_sq[l] = 1e6f;
+			}
+
+			*scalar = *avx2;
+
+			compute_narrow_phase_batch(constants, avx2);
+			compute_narrow_phase_batch_scalar(constants, scalar);
+
+			mismatches += count_narrow_phase_mismatches(*avx2, *scalar, tolerance);
+			for (int l = count; l < NARROW_PHASE_BATCH; ++l)
+				if (avx2->valid[l] != 0)
+					mismatches++;
+
+			*checked_pairs += count;
+		}
+
+	delete(avx2);
+	delete(scalar);
+
+	return(mismatches);
+}
+
+
+/*
+Count the pairs of a batch where the validity differs from the reference or a result differs by more than the tolerance.
+*/
+int CustomMath::count_narrow_phase_mismatches(const NarrowPhaseBatch & computed, const NarrowPhaseBatch & reference, float tolerance)
+{
+	int mismatches = 0;
+
+	for (int l = 0; l < reference.count; ++l)
+	{
+		if ((computed.valid[l] != 0) != (reference.valid[l] != 0))
+		{
+			mismatches++;
+			continue;
+		}
+
+		if (reference.valid[l] == 0)
+			continue;
+
+		const float values[][2] = {
+			{ computed.pos_this_start[l], reference.pos_this_start[l] },
+			{ computed.pos_this_end[l], reference.pos_this_end[l] },
+			{ computed.pos_other_start[l], reference.pos_other_start[l] },
+			{ computed.pos_other_end[l], reference.pos_other_end[l] },
+			{ computed.this_ray_pos_start[l], reference.this_ray_pos_start[l] },
+			{ computed.this_ray_pos_end[l], reference.this_ray_pos_end[l] },
+			{ computed.sine[l], reference.sine[l] },
+			{ computed.cosine[l], reference.cosine[l] },
+			{ computed.other_ray_pos_start[l], reference.other_ray_pos_start[l] },
+			{ computed.other_ray_pos_end[l], reference.other_ray_pos_end[l] },
+			{ computed.other_sine[l], reference.other_sine[l] },
+			{ computed.other_cosine[l], reference.other_cosine[l] }
+		};
+
+		for (int v = 0; v < sizeof(values) / sizeof(values[0]); ++v)
+			if (!(abs(values[v][0] - values[v][1]) <= tolerance * max(1.0f, abs(values[v][1]))))
+			{
+				mismatches++;
+				break;
+			}
+	}
+
+	return(mismatches);
+}
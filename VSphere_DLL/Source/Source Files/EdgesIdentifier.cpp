@@ -29,6 +29,9 @@ Output:
 #include <ctime>
 
 
+#define EDGES_PI 3.14159265f
+
+
 EdgesIdentifier::EdgesIdentifier()
 {
 	this->contour_mask_size = Settings::getContourMaskSize();
@@ -51,7 +54,7 @@ void EdgesIdentifier::initData(int frame_w, int frame_h, int * contours_grid, in
 
 	// Calculate number of elements in mask contours_grid
 	grid_cell_pixelcount = contour_mask_size*contour_mask_size;
-	mask_pixelcount = (frame_w * frame_h) / grid_cell_pixelcount;
+	mask_pixelcount = grid_w * grid_h; // Like the grids of the ContoursExtractor
 
 
 	// Todo: Put value in settings
@@ -61,19 +64,36 @@ void EdgesIdentifier::initData(int frame_w, int frame_h, int * contours_grid, in
 }
 
 
+/*
+Take the values of a newly published configuration (called between frames).
+A changed cell size only takes effect with the next call of initData().
+*/
+void EdgesIdentifier::applyConfiguration(PipelineConfiguration * configuration)
+{
+	contour_mask_size = configuration->contour_mask_size;
+}
+
+
 /*
 Compute the new set of results with the current input in the mentioned input pointers.
 Arguments:
 	merge_optimizable_edges -> if true it tries to merge connected edges with similar direction.
 							   This greatly reduces the number of edges and therefore later calculations at intersection.
-							   However this requires a different approach when computing the 3D model from the rays.
-							   That method _might_ drastically increase total computation time again.
-							   To elaborate this is the most significant TODO in this project.
-							   Look into DataStructs -> Ray3D for more information and an incomplete attempt.
-							   Current this optimization is disabled.
+							   The resulting rays are wider than the rays of other cameras so the model has to be built
+							   with Ray3D::addAsModelSubQuads() (see ModelBuilder::computeModelPart()).
+							   Can be switched through the configuration key "merge_edges".
 	bench -> a bench instance helpful for showing information about how many segments have been computed on average over time
 */
 void EdgesIdentifier::computeEdges(bool merge_optimizable_edges, valueBench * bench)
+{
+	computeEdges(merge_optimizable_edges, bench, Rect(0, 0, grid_w, grid_h));
+}
+
+/*
+Like computeEdges() but the edges are only searched from the cells inside a window (see RegionOfInterest).
+The ContoursExtractor keeps all cells outside of the window free of contours, so no edge leaves it.
+*/
+void EdgesIdentifier::computeEdges(bool merge_optimizable_edges, valueBench * bench, Rect cells)
 {
 	segments_start.clear();
 	segments_end.clear();
@@ -85,19 +105,20 @@ void EdgesIdentifier::computeEdges(bool merge_optimizable_edges, valueBench * be
 	int repeats = 0;
 	int segment_end;
 
-	vector<int> gridcord_q;
-	vector<int> segment_start_q;
-	vector<int> directions_q;
+	gridcord_q.clear();
+	segment_start_q.clear();
+	directions_q.clear();
 
 
 	/*
 	To understand the following algorithm better, read the Thesis associated to this project. Chapter Edges detection.
 	The algorithm described there has a recursive description. However to reduce computation and memmory access it has been implemented lineary based on vectors using push_back() and pop().
-	Todo: Replace vectors by manually handled arrays to reduce possible memmory allocations.
+	The vectors are members and keep their capacity, so they only allocate when a frame needs more than all frames before.
 	*/
 
-	// Loop through all grid cells of the contours grid (mask)
-	for (int i = 0; i < mask_pixelcount; i += 1)
+	// Loop through all grid cells of the contours grid (mask) inside the window
+	for (int row = cells.y; row < cells.y + cells.height; ++row)
+	for (int i = row * grid_w + cells.x; i < row * grid_w + cells.x + cells.width; i += 1)
 	{
 		if (contours_grid[i] != -1) // If it has a value and has not been handled already
 		{
@@ -557,51 +578,80 @@ void EdgesIdentifier::computeEdges(bool merge_optimizable_edges, valueBench * be
 		}
 	}
 
-	// optimization through merging
-	if (merge_optimizable_edges) // Currently disabled in this example but it is possible to activate it by commenting this line out and see the preview image of the resulting edges
-	{
-		int segs = segments_start.size();
+	// Optimization through merging
+	if (merge_optimizable_edges)
+		mergeEdges();
 
-		float tol = Settings::getSegmentOptimisationTolerance();
+	// Add to the bench
+	if (segments_start.size() != 0)
+		bench->addValue(segments_start.size());
+}
 
-		int begin_x = 0, begin_y = 0, begin, seg_pos = 0;
-		bool keep = true;
 
-		int end_x, end_y;
+/*
+Merge chains of connected segments with the same orientation into single segments as long as their directions
+do not differ by more than Settings::getSegmentOptimisationTolerance() (radians) from the direction of the merged segment.
+Single segments which are not connected to any other segment are removed, except the first and the last one (as the RayGenerator does for unmerged edges).
+The vectors are compacted in place.
+*/
+void EdgesIdentifier::mergeEdges()
+{
+	int segs = segments_start.size();
+	if (segs == 0)
+		return;
+
+	float tol = Settings::getSegmentOptimisationTolerance();
+
+	int seg_pos = 0;
+	int run_begin = 0;
+	int begin_x = segments_start[0] % frame_w;
+	int begin_y = segments_start[0] / frame_w;
+
+	for (int i = 1; i <= segs; ++i)
+	{
+		bool extend = false;
 
-		// Loop through all segments
-		for (int i = 0; i < segs; ++i)
+		if ((i < segs) && (segments_end[i - 1] == segments_start[i]) && (segments_orientation[i] == segments_orientation[run_begin]))
 		{
-			end_x = (segments_end[i] % frame_w);
-			end_y = (segments_end[i] / frame_w);
+			int start_x = segments_start[i] % frame_w, start_y = segments_start[i] / frame_w;
+			int end_x = segments_end[i] % frame_w, end_y = segments_end[i] / frame_w;
 
-			// If not the first segment and the accurate direction (not the classification into 8 neighbours) is larger than "tol"
-			if ((i == 0) || (segments_end[i - 1] != segments_start[i]) || (abs(atan2(end_y - (segments_start[i] / frame_w), end_x - (segments_start[i] % frame_w)) - atan2(end_y - begin_y, end_x - begin_x)) > tol))
-			{
-				if ((i > 0) && keep) // If the segments should be kept
-				{
-					segments_start[seg_pos] = begin; // Add them as a single one
-					segments_end[seg_pos] = segments_end[i - 1];
-					++seg_pos;
-				}
+			// Direction of the segment compared to the direction of the merged segment if it were extended by it
+			float difference = abs(atan2((float)(end_y - start_y), (float)(end_x - start_x)) - atan2((float)(end_y - begin_y), (float)(end_x - begin_x)));
+			if (difference > EDGES_PI) // Wrap around -pi / pi
+				difference = 2 * EDGES_PI - difference;
 
-				begin = segments_start[i];
-				begin_x = (begin % frame_w);
-				begin_y = (begin / frame_w);
+			extend = (difference <= tol);
+		}
 
-				if ((i == 0) || (segments_end[i - 1] != segments_start[i]))
-					keep = false; // Do not keep following the segment anymore
-			}
-			else keep = true; // Keep this segment
+		if (extend)
+			continue;
+
+
+		// Close the current run [run_begin, i-1]
+		bool isolated = (run_begin == i - 1) && (run_begin > 0) && (i < segs)
+			&& (segments_end[run_begin - 1] != segments_start[run_begin])
+			&& (segments_end[i - 1] != segments_start[i]);
+
+		if (!isolated)
+		{
+			segments_start[seg_pos] = segments_start[run_begin];
+			segments_end[seg_pos] = segments_end[i - 1];
+			segments_orientation[seg_pos] = segments_orientation[run_begin];
+			++seg_pos;
 		}
 
-		segments_start.resize(seg_pos);
-		segments_end.resize(seg_pos);
+		if (i < segs)
+		{
+			run_begin = i;
+			begin_x = segments_start[i] % frame_w;
+			begin_y = segments_start[i] / frame_w;
+		}
 	}
 
-	// Add to the bench
-	if (segments_start.size() != 0)
-		bench->addValue(segments_start.size());
+	segments_start.resize(seg_pos);
+	segments_end.resize(seg_pos);
+	segments_orientation.resize(seg_pos);
 }
 
 
@@ -0,0 +1,516 @@
+/*
+Runs the processing of all cameras as a graph of tasks on a fixed number of worker threads.
+
+The work of a frame consists of these tasks:
+	segment(camera)			Mask, contours, edges and rays of the frame of a camera (PerCamControler::processFrame)
+	intersect(pair, slice)	A slice of the intersections of a pair of cameras (CameraPairIntersector::intersectSlice)
+	content(camera)			Gathering the intersections and building the quads of a camera (PerCamControler::computeContent)
+Every intersect task depends on the segment tasks of both cameras of its pair and every content task on all intersect tasks
+of the pairs its camera is part of. A task starts as soon as the tasks it depends on are finished, so for example the first pairs
+are intersected while other cameras are still segmenting their frames.
+The intersect tasks only exist in the graph of the shared pairs (configuration key shared_pair_intersection with the rays).
+Otherwise every content task directly depends on the segment tasks of all cameras it is paired with.
+
+With the voxel carving (configuration key reconstruction_engine) a frame runs a second graph instead:
+	segment(camera)			Mask, contours and edges and the foreground counts of the mask (no rays)
+	carve(slice)			A slice of the octree (VoxelCarver::carveSlice), after all segment tasks
+	extract(slice)			The faces of the leaves of a slice (VoxelCarver::extractSlice), after all carve tasks
+	content(camera)			Gathering the quads of the slices of a camera, after all extract tasks
+	mesh block(slice)		The faces and vertices of the mesh of a slice (MeshExtractor::buildBlock), after all carve tasks
+	mesh layout				The offsets of the blocks in the mesh (MeshExtractor::layoutMesh), after all mesh block tasks
+	mesh write(slice)		The vertices and triangles of a block (MeshExtractor::writeBlock), after the mesh layout
+The mesh tasks do nothing unless the configuration key surface_mesh is set.
+The polyhedral hull runs the graph without intersect tasks: every content task cuts the cones of its camera
+(PolyhedralHull::cutCamera), which needs the contours of all cameras.
+The number of workers does not depend on the number of cameras (configuration key "worker_threads"; 0 = one per core).
+
+The graphs are built once when the sphere starts. Running a graph only resets the counters of the dependencies.
+Initialization (the first background reference of every camera) is a separate graph without dependencies.
+
+The workers are placed by ThreadPlacement. When pinning per NUMA node, the ready tasks of a camera are put into the queue
+of its home node. A worker takes the tasks of its own node first and only takes those of other nodes when it would be idle otherwise.
+The initialization tasks are never taken by workers of other nodes (unless the home node has no worker): they allocate the frame,
+mask, grid and ray buffers of a camera, whose pages are placed on the node which touches them first.
+Every ready task wakes one idle worker, one of its home node if there is any, so workers are not woken for nothing.
+*/
+
+#include "stdafx.h"
+
+#include "FrameScheduler.h"
+
+#include "ThreadPlacement.h"
+#include "AllocationTracker.h"
+
+
+/*
+Create the graphs and start the workers.
+*/
+FrameScheduler::FrameScheduler(vector<PerCamControler*> * camera_controlers, vector<CameraPairIntersector*> * camera_pairs, VoxelCarver * voxel_carver, MeshExtractor * mesh_extractor, int worker_count, latencyHistogram * slice_latency)
+{
+	this->camera_controlers = camera_controlers;
+	this->camera_pairs = camera_pairs;
+	this->voxel_carver = voxel_carver;
+	this->mesh_extractor = mesh_extractor;
+	this->slice_latency = slice_latency;
+
+	// The placement is only read when the sphere starts
+	PipelineConfiguration * configuration = Settings::getConfiguration();
+	use_priorities = configuration->thread_priorities;
+
+	int node_count = (configuration->thread_pinning == THREAD_PINNING_NUMA) ? ThreadPlacement::getNodeCount() : 1;
+	ready_tasks.resize(node_count);
+	ready_heads.resize(node_count);
+
+	node_workers.resize(node_count, 0);
+	for (int w = 0; w < max(1, worker_count); ++w)
+	{
+		worker_processors.push_back(ThreadPlacement::planProcessor(THREAD_ROLE_WORKER, w, configuration));
+		worker_nodes.push_back((node_count > 1) ? ThreadPlacement::getNode(worker_processors[w]) : 0);
+		node_workers[worker_nodes[w]]++;
+	}
+
+	buildGraphs();
+	buildCarvingGraph();
+
+	// Every queue can hold all tasks of a graph, so running the graphs does not allocate
+	int largest_graph = max(max(initialization_graph.size(), frame_graph.size()), max(shared_pairs_graph.size(), carving_graph.size()));
+	idle_workers.resize(node_count);
+	for (int n = 0; n < node_count; ++n)
+	{
+		ready_tasks[n].reserve(largest_graph);
+		idle_workers[n].reserve(worker_processors.size());
+	}
+
+	for (int w = 0; w < worker_processors.size(); ++w)
+	{
+		worker_wakeups.push_back(new condition_variable());
+		worker_idle.push_back(false);
+	}
+
+	for (int w = 0; w < worker_processors.size(); ++w)
+		workers.push_back(new thread(launchWorker, this, w));
+
+	addInfoLine("Scheduling " + to_string(frame_graph.size()) + " tasks per frame (" + to_string(shared_pairs_graph.size()) + " with shared pairs) on "
+		+ to_string(workers.size()) + " worker threads (" + to_string(node_count) + " NUMA queues).");
+}
+
+/*
+Stop and join the workers (no graph may be running).
+*/
+FrameScheduler::~FrameScheduler()
+{
+	queue_lock.lock();
+	stopping = true;
+	queue_lock.unlock();
+
+	for (int w = 0; w < workers.size(); ++w)
+		worker_wakeups[w]->notify_one();
+
+	for (int w = 0; w < workers.size(); ++w)
+	{
+		workers[w]->join();
+		delete(workers[w]);
+		delete(worker_wakeups[w]);
+	}
+}
+
+
+/*
+The number of workers for a configured value (0 or less means one per core).
+*/
+int FrameScheduler::resolveWorkerCount(int configured_count)
+{
+	if (configured_count > 0)
+		return(configured_count);
+
+	return(max(1, (int)thread::hardware_concurrency()));
+}
+
+int FrameScheduler::getWorkerCount()
+{
+	return(workers.size());
+}
+
+
+int FrameScheduler::addTask(vector<SchedulerTask> * graph, int kind, int index, int slice)
+{
+	SchedulerTask task;
+	task.kind = kind;
+	task.index = index;
+	task.slice = slice;
+	task.node = 0;
+	task.dependencies = 0;
+	task.remaining = 0;
+
+	graph->push_back(task);
+	return(graph->size() - 1);
+}
+
+void FrameScheduler::addDependency(vector<SchedulerTask> * graph, int before, int after)
+{
+	(*graph)[before].successors.push_back(after);
+	(*graph)[after].dependencies++;
+}
+
+
+void FrameScheduler::buildGraphs()
+{
+	int cam_count = camera_controlers->size();
+
+	for (int c = 0; c < cam_count; ++c)
+		addTask(&initialization_graph, TASK_INITIALIZE, c, 0);
+
+
+	// Both frame graphs have the same segment and content tasks (the same indices in both)
+	vector<int> segment_tasks, content_tasks;
+
+	for (int c = 0; c < cam_count; ++c)
+	{
+		segment_tasks.push_back(addTask(&frame_graph, TASK_SEGMENT, c, 0));
+		addTask(&shared_pairs_graph, TASK_SEGMENT, c, 0);
+	}
+
+	for (int c = 0; c < cam_count; ++c)
+	{
+		content_tasks.push_back(addTask(&frame_graph, TASK_CONTENT, c, 0));
+		addTask(&shared_pairs_graph, TASK_CONTENT, c, 0);
+
+		addDependency(&frame_graph, segment_tasks[c], content_tasks[c]);
+		addDependency(&shared_pairs_graph, segment_tasks[c], content_tasks[c]);
+	}
+
+	for (int p = 0; p < camera_pairs->size(); ++p)
+	{
+		// Find the cameras of the pair
+		int first = -1, second = -1;
+		bool first_camera;
+
+		for (int c = 0; c < cam_count; ++c)
+			if ((*camera_pairs)[p]->involves((*camera_controlers)[c]->getRayGenerator(), &first_camera))
+			{
+				if (first_camera)
+					first = c;
+				else
+					second = c;
+			}
+
+		if ((first == -1) || (second == -1))
+		{
+			addError("A pair of cameras could not be found for scheduling!");
+			continue;
+		}
+
+		// Without shared pairs the content of a camera reads the rays (or contours) of the other camera itself
+		addDependency(&frame_graph, segment_tasks[first], content_tasks[second]);
+		addDependency(&frame_graph, segment_tasks[second], content_tasks[first]);
+
+		// The slices read the rays of both cameras and are gathered by both
+		for (int s = 0; s < (*camera_pairs)[p]->getSliceCount(); ++s)
+		{
+			int task = addTask(&shared_pairs_graph, TASK_INTERSECT, p, s);
+
+			addDependency(&shared_pairs_graph, segment_tasks[first], task);
+			addDependency(&shared_pairs_graph, segment_tasks[second], task);
+			addDependency(&shared_pairs_graph, task, content_tasks[first]);
+			addDependency(&shared_pairs_graph, task, content_tasks[second]);
+		}
+	}
+
+
+	assignNodes(&frame_graph);
+	assignNodes(&shared_pairs_graph);
+
+	PipelineConfiguration * configuration = Settings::getConfiguration();
+	int node_count = ready_tasks.size();
+
+	for (int t = 0; t < initialization_graph.size(); ++t)
+		initialization_graph[t].node = ThreadPlacement::getCameraNode(initialization_graph[t].index, configuration) % node_count;
+}
+
+/*
+The graph of a frame with the voxel carving: every slice needs the masks of all cameras and every camera the faces of all slices
+(the faces of a slice are only known once the neighboring slices are carved).
+*/
+void FrameScheduler::buildCarvingGraph()
+{
+	int cam_count = camera_controlers->size();
+	int slice_count = voxel_carver->getSliceCount();
+
+	vector<int> segment_tasks, carve_tasks, extract_tasks;
+
+	for (int c = 0; c < cam_count; ++c)
+		segment_tasks.push_back(addTask(&carving_graph, TASK_SEGMENT, c, 0));
+
+	for (int s = 0; s < slice_count; ++s)
+	{
+		carve_tasks.push_back(addTask(&carving_graph, TASK_CARVE, s, s));
+		for (int c = 0; c < cam_count; ++c)
+			addDependency(&carving_graph, segment_tasks[c], carve_tasks[s]);
+	}
+
+	for (int s = 0; s < slice_count; ++s)
+	{
+		extract_tasks.push_back(addTask(&carving_graph, TASK_EXTRACT, s, s));
+		for (int o = 0; o < slice_count; ++o)
+			addDependency(&carving_graph, carve_tasks[o], extract_tasks[s]);
+	}
+
+	for (int c = 0; c < cam_count; ++c)
+	{
+		int task = addTask(&carving_graph, TASK_CONTENT, c, 0);
+		for (int s = 0; s < slice_count; ++s)
+			addDependency(&carving_graph, extract_tasks[s], task);
+	}
+
+	// The mesh runs beside the extraction of the quads (the vertices of a block are at corners it shares with the neighboring slices)
+	int layout_task = addTask(&carving_graph, TASK_MESH_LAYOUT, 0, 0);
+
+	for (int s = 0; s < slice_count; ++s)
+	{
+		int task = addTask(&carving_graph, TASK_MESH_BLOCK, s, s);
+		for (int o = 0; o < slice_count; ++o)
+			addDependency(&carving_graph, carve_tasks[o], task);
+		addDependency(&carving_graph, task, layout_task);
+	}
+
+	for (int s = 0; s < slice_count; ++s)
+		addDependency(&carving_graph, layout_task, addTask(&carving_graph, TASK_MESH_WRITE, s, s));
+
+	assignNodes(&carving_graph);
+}
+
+/*
+Home nodes of the tasks of a frame graph (an intersection belongs to the first camera of its pair, a slice of the octree to the camera which gathers its quads).
+*/
+void FrameScheduler::assignNodes(vector<SchedulerTask> * graph)
+{
+	PipelineConfiguration * configuration = Settings::getConfiguration();
+	int cam_count = camera_controlers->size();
+	int node_count = ready_tasks.size();
+
+	for (int t = 0; t < graph->size(); ++t)
+	{
+		SchedulerTask & task = (*graph)[t];
+		int camera = task.index;
+
+		if (task.kind == TASK_INTERSECT)
+		{
+			bool first_camera;
+			for (int c = 0; c < cam_count; ++c)
+				if ((*camera_pairs)[task.index]->involves((*camera_controlers)[c]->getRayGenerator(), &first_camera) && first_camera)
+					camera = c;
+		}
+		else if ((task.kind == TASK_CARVE) || (task.kind == TASK_EXTRACT) || (task.kind == TASK_MESH_BLOCK) || (task.kind == TASK_MESH_WRITE))
+			camera = task.index % max(1, cam_count);
+
+		task.node = ThreadPlacement::getCameraNode(camera, configuration) % node_count;
+	}
+}
+
+
+/*
+Compute the first background reference of all cameras (returns when all are finished).
+*/
+void FrameScheduler::initializeCameras()
+{
+	runGraph(&initialization_graph);
+}
+
+/*
+Process the current frame of all cameras (returns when the content of all cameras is ready).
+*/
+void FrameScheduler::processFrame()
+{
+	// The configuration can only change between frames (see SphereControler)
+	PipelineConfiguration * configuration = Settings::getConfiguration();
+	surface_mesh = configuration->surface_mesh;
+
+	if (configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_VOXELS)
+		runGraph(&carving_graph);
+	else if (configuration->shared_pair_intersection && (configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_RAYS))
+		runGraph(&shared_pairs_graph);
+	else
+		runGraph(&frame_graph);
+}
+
+
+/*
+Start all tasks without dependencies and wait until every task of the graph has been executed.
+*/
+void FrameScheduler::runGraph(vector<SchedulerTask> * graph)
+{
+	unique_lock<mutex> guard(queue_lock);
+
+	running_graph = graph;
+	home_only = (graph == &initialization_graph);
+	unfinished_tasks = graph->size();
+
+	for (int n = 0; n < ready_tasks.size(); ++n)
+	{
+		ready_tasks[n].clear();
+		ready_heads[n] = 0;
+	}
+
+	for (int t = 0; t < graph->size(); ++t)
+		(*graph)[t].remaining = (*graph)[t].dependencies;
+
+	for (int t = 0; t < graph->size(); ++t)
+		if ((*graph)[t].remaining == 0)
+			queueTask(graph, t);
+
+	graph_finished.wait(guard, [&] { return(unfinished_tasks == 0); });
+
+	running_graph = nullptr;
+}
+
+
+/*
+Put a ready task into the queue of its home node and wake one idle worker for it (called while queue_lock is held).
+If no worker is idle, the next worker finishing a task takes it.
+*/
+void FrameScheduler::queueTask(vector<SchedulerTask> * graph, int task)
+{
+	int node = (*graph)[task].node;
+
+	ready_tasks[node].push_back(task);
+
+	// A task only the home node takes does not wake a worker of another node
+	int wake_nodes = (home_only && (node_workers[node] > 0)) ? 1 : idle_workers.size();
+
+	for (int n = 0; n < wake_nodes; ++n)
+	{
+		vector<int> & idle = idle_workers[(node + n) % idle_workers.size()];
+		if (!idle.empty())
+		{
+			int worker = idle.back();
+			idle.pop_back();
+
+			worker_idle[worker] = false;
+			worker_wakeups[worker]->notify_one();
+			return;
+		}
+	}
+}
+
+
+/*
+The node whose queue the worker takes the next task from: the own node first, then the others (except for tasks only their home node takes).
+Returns -1 if there is no task for the worker (called while queue_lock is held).
+*/
+int FrameScheduler::findTaskNode(int own_node)
+{
+	for (int n = 0; n < ready_tasks.size(); ++n)
+	{
+		int node = (own_node + n) % ready_tasks.size();
+
+		if (ready_heads[node] == ready_tasks[node].size())
+			continue;
+
+		if ((node != own_node) && home_only && (node_workers[node] > 0))
+			continue;
+
+		return(node);
+	}
+
+	return(-1);
+}
+
+
+void FrameScheduler::launchWorker(FrameScheduler * scheduler, int worker)
+{
+	scheduler->workerLoop(worker);
+}
+
+/*
+Take the next ready task (preferably of the own node), execute it and release the tasks which only waited for this one.
+*/
+void FrameScheduler::workerLoop(int worker)
+{
+	int placement = ThreadPlacement::place(THREAD_ROLE_WORKER, worker, worker_processors[worker], use_priorities);
+	int own_node = worker_nodes[worker];
+
+	unique_lock<mutex> guard(queue_lock);
+
+	while (true)
+	{
+		if (stopping)
+			return;
+
+		// Only a worker which finds no task sleeps, until queueTask() hands it one (which another worker may take first)
+		int node = findTaskNode(own_node);
+		if (node < 0)
+		{
+			worker_idle[worker] = true;
+			idle_workers[own_node].push_back(worker);
+			worker_wakeups[worker]->wait(guard, [&] { return(stopping || !worker_idle[worker]); });
+			continue;
+		}
+
+		vector<SchedulerTask> * graph = running_graph;
+		int t = ready_tasks[node][ready_heads[node]++];
+
+		guard.unlock();
+		executeTask(&(*graph)[t]);
+		ThreadPlacement::countTask(placement, node != own_node);
+		guard.lock();
+
+		for (int s = 0; s < (*graph)[t].successors.size(); ++s)
+		{
+			int successor = (*graph)[t].successors[s];
+			if (--(*graph)[successor].remaining == 0)
+				queueTask(graph, successor);
+		}
+
+		if (--unfinished_tasks == 0)
+			graph_finished.notify_all();
+	}
+}
+
+void FrameScheduler::executeTask(SchedulerTask * task)
+{
+	switch (task->kind)
+	{
+	case TASK_INITIALIZE: (*camera_controlers)[task->index]->initializeProcessing(); break;
+	case TASK_SEGMENT: (*camera_controlers)[task->index]->processFrame(); break;
+	case TASK_INTERSECT:
+		{
+			AllocationTracker::setStage(ALLOCATION_INTERSECTION);
+			high_resolution_clock::time_point start = high_resolution_clock::now();
+			(*camera_pairs)[task->index]->intersectSlice(task->slice);
+			slice_latency->recordSince(start);
+			AllocationTracker::setStage(ALLOCATION_OTHER);
+		}
+		break;
+	case TASK_CONTENT: (*camera_controlers)[task->index]->computeContent(); break;
+	case TASK_CARVE:
+		AllocationTracker::setStage(ALLOCATION_INTERSECTION);
+		voxel_carver->carveSlice(task->slice);
+		AllocationTracker::setStage(ALLOCATION_OTHER);
+		break;
+	case TASK_EXTRACT:
+		AllocationTracker::setStage(ALLOCATION_QUADS);
+		voxel_carver->extractSlice(task->slice);
+		AllocationTracker::setStage(ALLOCATION_OTHER);
+		break;
+	case TASK_MESH_BLOCK:
+		if (surface_mesh)
+		{
+			AllocationTracker::setStage(ALLOCATION_QUADS);
+			mesh_extractor->buildBlock(task->slice);
+			AllocationTracker::setStage(ALLOCATION_OTHER);
+		}
+		break;
+	case TASK_MESH_LAYOUT:
+		if (surface_mesh)
+		{
+			AllocationTracker::setStage(ALLOCATION_QUADS);
+			mesh_extractor->layoutMesh();
+			AllocationTracker::setStage(ALLOCATION_OTHER);
+		}
+		break;
+	case TASK_MESH_WRITE:
+		if (surface_mesh)
+			mesh_extractor->writeBlock(task->slice);
+		break;
+	}
+}
@@ -0,0 +1,160 @@
+/*
+The media clock shared by all cameras of the sphere. Every frame of every camera gets a timestamp on it,
+in microseconds since the start of the sphere (the clock of ModelTiming::capture_us and GetSphereTime()).
+
+Live cameras are stamped with the moment their device has been grabbed (see CapturePool).
+Records store the timestamp of every frame they record; when they are played, the clock advances a play position through these timestamps
+by one frame per sphere frame, and every played camera takes its frame with the timestamp nearest to the position (see RecordingHandler::handleFrame).
+So records which started or dropped frames at different moments are still paired by the moment they were captured, and all of them loop together.
+
+Records which do not overlap in time at all (recorded one after the other, or a record without timestamps played with recorded ones)
+cannot be paired by capture time; they are played from their own starts instead, each shifted by its own offset.
+
+Only the capture thread advances the clock, before it grabs the next frame, and it paces the playback by the frame interval (see SphereControler::sphereLoop).
+The tasks of the cameras read it while the frame is processed.
+
+Input:
+	The timestamps of the played records
+
+Output:
+	The play position of the records in every frame
+*/
+
+#include "stdafx.h"
+
+#include "MediaClock.h"
+
+
+MediaClock::MediaClock()
+{
+	origin = high_resolution_clock::now();
+}
+
+
+/*
+Start of the media time (the start of the sphere).
+*/
+void MediaClock::setOrigin(high_resolution_clock::time_point origin)
+{
+	this->origin = origin;
+}
+
+long long MediaClock::toMediaTime(high_resolution_clock::time_point time)
+{
+	return(duration_cast<microseconds>(time - origin).count());
+}
+
+
+/*
+Take the timestamps of a played record (when it is opened) and return its index for getRecordPosition().
+All records are played where they overlap, in steps of the shortest frame interval. A record needs at least two frames (last after first).
+*/
+int MediaClock::addPlayedRecord(long long first_timestamp, long long last_timestamp, long long frame_interval)
+{
+	PlayedRecord record;
+	record.first_timestamp = first_timestamp;
+	record.last_timestamp = last_timestamp;
+	record.frame_interval = max(frame_interval, 1ll);
+	record.offset = 0;
+	records.push_back(record);
+
+	alignRecords();
+
+	return(records.size() - 1);
+}
+
+/*
+Find the time span all records are played in (again for every added record).
+*/
+void MediaClock::alignRecords()
+{
+	play_start = records[0].first_timestamp;
+	play_end = records[0].last_timestamp;
+	play_step = records[0].frame_interval;
+
+	for (int r = 1; r < records.size(); ++r)
+	{
+		play_start = max(play_start, records[r].first_timestamp);
+		play_end = min(play_end, records[r].last_timestamp);
+		play_step = min(play_step, records[r].frame_interval);
+	}
+
+	if (play_end > play_start)
+	{
+		for (int r = 0; r < records.size(); ++r)
+			records[r].offset = 0;
+	}
+	else
+	{
+		// Without a common time span every record starts with its first frame, and all of them loop after the shortest one
+		if (!aligned_on_starts)
+			addError("The played records do not overlap in time, so their frames cannot be paired by capture time. They are played from their own starts.");
+		aligned_on_starts = true;
+
+		play_start = 0;
+		play_end = records[0].last_timestamp - records[0].first_timestamp;
+		for (int r = 0; r < records.size(); ++r)
+		{
+			records[r].offset = records[r].first_timestamp;
+			play_end = min(play_end, records[r].last_timestamp - records[r].first_timestamp);
+		}
+	}
+
+	play_position = play_start;
+}
+
+/*
+Begin the next frame (called by the capture thread before it grabs). The play position moves on by one step and starts over behind the end.
+*/
+void MediaClock::beginFrame()
+{
+	if (records.empty())
+		return;
+
+	if (!started)
+	{
+		started = true;
+		return;
+	}
+
+	play_position += play_step;
+
+	if (play_position > play_end)
+	{
+		play_position = play_start;
+		loop_count++;
+	}
+}
+
+
+/*
+Timestamp of the records the played cameras have to show in the current frame.
+*/
+long long MediaClock::getPlayPosition()
+{
+	return(play_position);
+}
+
+/*
+Timestamp of a record (see addPlayedRecord) the played camera has to show in the current frame.
+*/
+long long MediaClock::getRecordPosition(int record)
+{
+	return(play_position + records[record].offset);
+}
+
+/*
+Microseconds the sphere loop waits at least between two frames while records are played (0 without played records).
+*/
+long long MediaClock::getFrameInterval()
+{
+	return(records.empty() ? 0 : play_step);
+}
+
+/*
+How often the records have started over.
+*/
+int MediaClock::getLoopCount()
+{
+	return(loop_count);
+}
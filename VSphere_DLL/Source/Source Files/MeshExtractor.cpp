@@ -0,0 +1,351 @@
+/*
+Extracts a closed, indexed triangle mesh from the voxels carved by the VoxelCarver (configuration key surface_mesh).
+Unlike the quads of the model, neighboring triangles share their vertices, so the mesh has no cracks and no duplicated vertices.
+
+The surface consists of the faces between carved and empty voxels (the same faces as the quads of the VoxelCarver,
+but one per voxel so every corner is a vertex). Every corner of the voxels on the surface becomes one vertex which is moved
+to the visual hull like in surface nets: on every edge between the centers of the 8 voxels around the corner which
+connects a carved and an empty voxel, the crossing of the silhouettes is found by bisection (the silhouettes are the exact hull),
+and the vertex is the average of these crossings.
+
+The work is split into the blocks of the slices of the VoxelCarver:
+	buildBlock(block)	Faces of the leaves of the slice and the vertices at the corners the slice owns (see cornerOwner)
+	layoutMesh()		Offsets of the vertices and indices of every block in the mesh (after all blocks are built)
+	writeBlock(block)	Vertices and indices of the block at its offsets (the corners of other blocks are looked up in their tables)
+
+Input:
+	VoxelCarver			// After all slices are carved
+
+Output:
+	vertices			// 5 ints per vertex: X, Y and Z times 100 (like the quads) and the U and V texture coordinates in the texture of all cameras
+	indices				// 3 per triangle; seen from outside the corners of a triangle turn like those of the quads (see VoxelCarver)
+*/
+
+#include "stdafx.h"
+
+#include "MeshExtractor.h"
+
+
+// Bisection steps for the crossing of the silhouettes on an edge (the crossing is exact to 1 / 2^steps of a voxel)
+#define MESH_REFINEMENT_STEPS 3
+
+// Smallest table of the vertices of a block (a power of two)
+#define MESH_MIN_TABLE_SIZE 1024
+
+
+MeshExtractor::MeshExtractor(VoxelCarver * voxel_carver)
+{
+	this->voxel_carver = voxel_carver;
+
+	for (int b = 0; b < voxel_carver->getSliceCount(); ++b)
+		blocks.push_back(new MeshBlock());
+}
+
+MeshExtractor::~MeshExtractor()
+{
+	for (int b = 0; b < blocks.size(); ++b)
+		delete(blocks[b]);
+}
+
+
+int MeshExtractor::cornerIndex(int x, int y, int z)
+{
+	int corners_per_axis = voxel_carver->getGridSize() + 1;
+	return((z * corners_per_axis + y) * corners_per_axis + x);
+}
+
+/*
+The block creating the vertex of a corner: the slice of the first carved voxel around the corner with a face on the surface through the corner.
+That slice meets the corner when it adds its faces, and the choice does not depend on the block asking.
+*/
+int MeshExtractor::cornerOwner(int x, int y, int z)
+{
+	bool carved[8];
+	for (int n = 0; n < 8; ++n)
+		carved[n] = voxel_carver->isOccupied(x - 1 + (n & 1), y - 1 + ((n >> 1) & 1), z - 1 + ((n >> 2) & 1));
+
+	for (int n = 0; n < 8; ++n)
+		if (carved[n] && (!carved[n ^ 1] || !carved[n ^ 2] || !carved[n ^ 4]))
+			return(voxel_carver->getVoxelSlice(x - 1 + (n & 1), y - 1 + ((n >> 1) & 1), z - 1 + ((n >> 2) & 1)));
+
+	return(-1);
+}
+
+/*
+The number of the vertex at a corner in its block (-1 if the block has none there).
+*/
+int MeshExtractor::findVertex(MeshBlock * block, int corner)
+{
+	if (block->table_mask == 0)
+		return(-1);
+
+	for (int slot = (corner * 2654435761u) & block->table_mask; ; slot = (slot + 1) & block->table_mask)
+	{
+		if (block->table_stamps[slot] != block->stamp)
+			return(-1);
+		if (block->table_corners[slot] == corner)
+			return(block->table_vertices[slot]);
+	}
+}
+
+void MeshExtractor::insertVertex(MeshBlock * block, int corner, int vertex)
+{
+	// At most half full, so a search always ends at an empty entry
+	if ((vertex + 1) * 2 > block->table_mask)
+	{
+		int size = max(MESH_MIN_TABLE_SIZE, (block->table_mask + 1) * 2);
+		vector<int> old_corners, old_vertices, old_stamps;
+
+		old_corners.swap(block->table_corners);
+		old_vertices.swap(block->table_vertices);
+		old_stamps.swap(block->table_stamps);
+
+		block->table_corners.assign(size, 0);
+		block->table_vertices.assign(size, 0);
+		block->table_stamps.assign(size, block->stamp - 1);
+		block->table_mask = size - 1;
+
+		for (int slot = 0; slot < old_stamps.size(); ++slot)
+			if (old_stamps[slot] == block->stamp)
+				insertVertex(block, old_corners[slot], old_vertices[slot]);
+	}
+
+	int slot = (corner * 2654435761u) & block->table_mask;
+	while (block->table_stamps[slot] == block->stamp)
+		slot = (slot + 1) & block->table_mask;
+
+	block->table_corners[slot] = corner;
+	block->table_vertices[slot] = vertex;
+	block->table_stamps[slot] = block->stamp;
+}
+
+
+/*
+Add the vertex of a corner: the average of the crossings of the silhouettes on the edges around it, textured by the camera facing its normal.
+*/
+void MeshExtractor::addVertex(MeshBlock * block, int x, int y, int z)
+{
+	// The 8 voxels around the corner (bit 0: x, bit 1: y, bit 2: z)
+	bool carved[8];
+	vector3df normal(0, 0, 0);
+
+	for (int n = 0; n < 8; ++n)
+	{
+		int dx = n & 1, dy = (n >> 1) & 1, dz = (n >> 2) & 1;
+		carved[n] = voxel_carver->isOccupied(x - 1 + dx, y - 1 + dy, z - 1 + dz);
+
+		// Points from the carved voxels towards the empty ones
+		normal += vector3df(dx - 0.5f, dy - 0.5f, dz - 0.5f) * (carved[n] ? -1.0f : 1.0f);
+	}
+
+	vector3df sum(0, 0, 0);
+	int crossings = 0;
+
+	for (int n = 0; n < 8; ++n)
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			int other = n | (1 << axis);
+			if ((other == n) || (carved[n] == carved[other]))
+				continue;
+
+			// Bisection from the center of the carved voxel towards the center of the empty one
+			vector3df inside(x - 0.5f + (n & 1), y - 0.5f + ((n >> 1) & 1), z - 0.5f + ((n >> 2) & 1));
+			vector3df outside = inside;
+			(axis == 0 ? outside.X : (axis == 1 ? outside.Y : outside.Z)) += 1;
+
+			if (!carved[n])
+				swap(inside, outside);
+
+			for (int step = 0; step < MESH_REFINEMENT_STEPS; ++step)
+			{
+				vector3df middle = (inside + outside) * 0.5f;
+				if (voxel_carver->insideHull(middle))
+					inside = middle;
+				else
+					outside = middle;
+			}
+
+			sum += (inside + outside) * 0.5f;
+			crossings++;
+		}
+
+	vector3df position = (crossings > 0) ? sum / (float)crossings : vector3df((float)x, (float)y, (float)z);
+	vector3df world = voxel_carver->gridToWorld(position);
+
+	int u, v;
+	voxel_carver->projectTexture(position, normal, &u, &v);
+
+	block->vertices.push_back((int)(world.X * (float)100));
+	block->vertices.push_back((int)(world.Y * (float)100));
+	block->vertices.push_back((int)(world.Z * (float)100));
+	block->vertices.push_back(u);
+	block->vertices.push_back(v);
+}
+
+/*
+Add a face of a voxel (its corners in the order of the quads) and the vertices of the corners owned by the block.
+*/
+void MeshExtractor::addFace(MeshBlock * block, int block_index, int corners[4][3])
+{
+	for (int k = 0; k < 4; ++k)
+	{
+		int corner = cornerIndex(corners[k][0], corners[k][1], corners[k][2]);
+		block->faces.push_back(corner);
+
+		if ((cornerOwner(corners[k][0], corners[k][1], corners[k][2]) == block_index) && (findVertex(block, corner) == -1))
+		{
+			insertVertex(block, corner, block->vertices.size() / 5);
+			addVertex(block, corners[k][0], corners[k][1], corners[k][2]);
+		}
+	}
+}
+
+
+/*
+Find the faces of the leaves of a slice between carved and empty voxels (a task of the FrameScheduler after all slices are carved).
+*/
+void MeshExtractor::buildBlock(int block_index)
+{
+	MeshBlock * block = blocks[block_index];
+	block->vertices.clear();
+	block->faces.clear();
+	block->stamp++; // Clears the table
+
+	vector<VoxelLeaf> * leaves = voxel_carver->getLeaves(block_index);
+
+	for (int l = 0; l < leaves->size(); ++l)
+	{
+		VoxelLeaf & leaf = (*leaves)[l];
+		int position[3] = { leaf.x, leaf.y, leaf.z };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+			for (int positive = 0; positive < 2; ++positive)
+			{
+				int cell[3];
+				cell[axis] = position[axis] + (positive ? leaf.size : -1);
+
+				for (cell[v] = position[v]; cell[v] < position[v] + leaf.size; ++cell[v])
+					for (cell[u] = position[u]; cell[u] < position[u] + leaf.size; ++cell[u])
+					{
+						if (voxel_carver->isOccupied(cell[0], cell[1], cell[2]))
+							continue;
+
+						// Corners like VoxelCarver::addFaceQuad: last_start, start, last_end, end
+						int u0 = cell[u], u1 = cell[u] + 1;
+						if (!positive)
+							swap(u0, u1);
+
+						int corners[4][3];
+						const int corner_u[4] = { u0, u1, u0, u1 }, corner_v[4] = { cell[v], cell[v], cell[v] + 1, cell[v] + 1 };
+
+						for (int k = 0; k < 4; ++k)
+						{
+							corners[k][axis] = position[axis] + (positive ? leaf.size : 0);
+							corners[k][u] = corner_u[k];
+							corners[k][v] = corner_v[k];
+						}
+
+						addFace(block, block_index, corners);
+					}
+			}
+		}
+	}
+}
+
+/*
+Place the vertices and indices of every block in the mesh (after all blocks are built, before they are written).
+*/
+void MeshExtractor::layoutMesh()
+{
+	int vertex_count = 0, index_count = 0;
+
+	for (int b = 0; b < blocks.size(); ++b)
+	{
+		blocks[b]->first_vertex = vertex_count;
+		blocks[b]->first_index = index_count;
+
+		vertex_count += blocks[b]->vertices.size() / 5;
+		index_count += blocks[b]->faces.size() / 4 * 6;
+	}
+
+	// Only grow when this mesh is larger than all before
+	mesh_vertices.resize(vertex_count * 5);
+	mesh_indices.resize(index_count);
+}
+
+/*
+Write the vertices and the triangles of a block into the mesh (a task of the FrameScheduler after layoutMesh()).
+*/
+void MeshExtractor::writeBlock(int block_index)
+{
+	MeshBlock * block = blocks[block_index];
+
+	if (!block->vertices.empty())
+		memcpy(&mesh_vertices[block->first_vertex * 5], block->vertices.data(), block->vertices.size() * sizeof(int));
+
+	int * indices = mesh_indices.data() + block->first_index;
+	int corners_per_axis = voxel_carver->getGridSize() + 1;
+
+	for (int f = 0; f < block->faces.size(); f += 4)
+	{
+		int corner_vertices[4];
+
+		for (int k = 0; k < 4; ++k)
+		{
+			int corner = block->faces[f + k];
+			int x = corner % corners_per_axis, y = (corner / corners_per_axis) % corners_per_axis, z = corner / (corners_per_axis * corners_per_axis);
+
+			MeshBlock * owner = blocks[cornerOwner(x, y, z)];
+			corner_vertices[k] = owner->first_vertex + findVertex(owner, corner);
+		}
+
+		// (last_start, start, last_end) and (start, end, last_end)
+		*(indices++) = corner_vertices[0];
+		*(indices++) = corner_vertices[1];
+		*(indices++) = corner_vertices[2];
+		*(indices++) = corner_vertices[1];
+		*(indices++) = corner_vertices[3];
+		*(indices++) = corner_vertices[2];
+	}
+}
+
+
+vector<int> * MeshExtractor::getVertices()
+{
+	return(&mesh_vertices);
+}
+
+vector<int> * MeshExtractor::getIndices()
+{
+	return(&mesh_indices);
+}
+
+
+/*
+Edges of the mesh which are not matched by an edge in the opposite direction (0 for a closed surface with consistently oriented triangles).
+Only a check for the benchmark: it allocates.
+*/
+int MeshExtractor::countOpenEdges()
+{
+	map<pair<int, int>, int> edges;
+
+	for (int i = 0; i + 3 <= mesh_indices.size(); i += 3)
+		for (int k = 0; k < 3; ++k)
+		{
+			int a = mesh_indices[i + k], b = mesh_indices[i + (k + 1) % 3];
+
+			if (a < b)
+				edges[make_pair(a, b)]++;
+			else
+				edges[make_pair(b, a)]--;
+		}
+
+	int open = 0;
+	for (map<pair<int, int>, int>::iterator edge = edges.begin(); edge != edges.end(); ++edge)
+		open += abs(edge->second);
+
+	return(open);
+}
@@ -7,9 +7,18 @@ The result are several linear arrays with the required data about the intersecti
 Additionally the index (the position in the mentioned arrays) of every intersection
 is saved in the "intersection_indices" vector of every own ray.
 
-When using only two cameras every collision will be computed twice thus computing more than required.
-However this happens on different threads and memmory areas, preventing an overly significant lost of time and therefore no syncing between cores is required during the computation of the intersections.
-When more than two cameras are used, the fraction which is computed multiple times is reduced.
+Computed like this, every collision is found twice (once by each of the two cameras), which doubles the dominant cost.
+Therefore every pair of cameras is by default intersected only once for both of them by a CameraPairIntersector
+(configuration key "shared_pair_intersection") and this class only gathers its intersections from there (see storePairIntersection()).
+This requires the slices of all pairs of the camera to be complete before gathering (see FrameScheduler).
+Without the shared pairs every camera computes its intersections on its own, without any syncing between the threads.
+
+Two engines find the pairs of rays to test (selected through the configuration key "intersection_engine"):
+the all-pairs engine tests every own ray against every ray of the other cameras,
+the sweep engine only tests the rays which are close enough along the axis perpendicular to both camera directions (see prepareSweep()).
+Both test the pairs in the same order with the same narrow phase and therefore produce the same output.
+The narrow phase either tests one pair after another (intersectRayPair()) or NARROW_PHASE_BATCH pairs at once with AVX2
+(CustomMath::compute_narrow_phase_batch(), selected through "batched_narrow_phase"). The batch matches the single pairs within floating point tolerance.
 
 
 Input (from RayGenerator):
@@ -28,10 +37,23 @@ Output:
 
 #include "ModelBuilder.h"
 
+#include <algorithm>
+
+
+// Relative (and absolute) widening of the search range of the sweep engine to absorb rounding differences to the exact test
+#define SWEEP_RANGE_TOLERANCE 0.01f
+// Minimal length of the cross product of the (unit) directions of two cameras to use the sweep engine for them (about 3 degrees).
+// Below that the all-pairs test itself becomes numerically unstable and the search range would not be reliable.
+#define SWEEP_MIN_DIRECTION_CROSS 0.05f
+
 
 ModelBuilder::ModelBuilder()
 {
 	max_ray_length = Settings::getMaxRayLength();
+	exact_subray_quads = Settings::getConfiguration()->merge_edges;
+	intersection_engine = Settings::getConfiguration()->intersection_engine;
+	batched_narrow_phase = Settings::getConfiguration()->batched_narrow_phase;
+	shared_pair_intersection = Settings::getConfiguration()->shared_pair_intersection;
 }
 
 ModelBuilder::~ModelBuilder()
@@ -62,6 +84,7 @@ void ModelBuilder::referenceAnotherRayGenerator(RayGenerator * ray_generator, bo
 		cam_direction_vec_norm = new vector3df(cam_direction_vec->X, cam_direction_vec->Y, cam_direction_vec->Z);
 		cam_direction_vec_norm->normalize();
 		cam_direction_dot = cam_direction_vec->dotProduct(*cam_direction_vec);
+		subray_workspace.pixel_size = ray_generator->getCameraSource()->getPixelSize();
 
 		// Get the rays of that generator
 		rays = ray_generator->getRays();
@@ -83,6 +106,20 @@ void ModelBuilder::referenceAnotherRayGenerator(RayGenerator * ray_generator, bo
 
 
 			quotients.push_back(cam_direction_dot * other_cam_direction_dots.back() - ab_direction_dots.back()*ab_direction_dots.back());
+
+
+			// Axis along which the distance of rays of both cameras is measured by the sweep engine (see prepareSweep)
+			vector3df sweep_normal = nn->crossProduct(other_dir * vector3df(0, 0, 1));
+			sweep_possible.push_back(sweep_normal.getLength() >= SWEEP_MIN_DIRECTION_CROSS); // Parallel cameras always use all pairs
+			sweep_normal.normalize();
+			sweep_normals.push_back(sweep_normal);
+			sweep_orders.push_back(vector<pair<float, int>>());
+			sweep_max_width_sq.push_back(0);
+
+			pair_intersectors.push_back(nullptr);
+			pair_is_first.push_back(false);
+			pair_offsets.push_back(vector<int>());
+			pair_orders.push_back(vector<PairIntersection*>());
 		}
 	}
 	else
@@ -96,6 +133,78 @@ void ModelBuilder::referenceAnotherRayGenerator(RayGenerator * ray_generator, bo
 }
 
 
+/*
+Use the intersections of a CameraPairIntersector for the other camera of that pair (has to happen after referencing the own RayGenerator).
+Once all other cameras have one, the intersections are gathered from them if "shared_pair_intersection" is set.
+*/
+void ModelBuilder::referencePairIntersector(CameraPairIntersector * pair_intersector)
+{
+	bool first_camera = (pair_intersector->getRays(true) == rays);
+
+	if (!first_camera && (pair_intersector->getRays(false) != rays))
+	{
+		StaticDebug::addError("Referencing a pair of cameras which does not contain the own camera!");
+		return;
+	}
+
+	for (int i = 0; i < other_rays.size(); ++i)
+		if (other_rays[i] == pair_intersector->getRays(!first_camera))
+		{
+			pair_intersectors[i] = pair_intersector;
+			pair_is_first[i] = first_camera;
+		}
+}
+
+/*
+Whether the intersections are gathered from the CameraPairIntersectors.
+*/
+bool ModelBuilder::usesPairIntersections()
+{
+	if (!shared_pair_intersection)
+		return(false);
+
+	for (int i = 0; i < pair_intersectors.size(); ++i)
+		if (pair_intersectors[i] == nullptr)
+			return(false);
+
+	return(true);
+}
+
+
+/*
+Take the values of a newly published configuration (called between frames on all cameras at once).
+The precomputed direction vectors have the length of the rays and are therefore rescaled.
+*/
+void ModelBuilder::applyConfiguration(PipelineConfiguration * configuration)
+{
+	// Merged edges produce wide rays which are hit by other rays only on parts of their width
+	exact_subray_quads = configuration->merge_edges;
+	intersection_engine = configuration->intersection_engine;
+	batched_narrow_phase = configuration->batched_narrow_phase;
+	shared_pair_intersection = configuration->shared_pair_intersection;
+
+	if (configuration->max_ray_length == max_ray_length)
+		return;
+
+	float factor = ((float)configuration->max_ray_length) / max_ray_length;
+	max_ray_length = configuration->max_ray_length;
+
+	if (cam_direction_vec == nullptr) // Not finalized yet
+		return;
+
+	*cam_direction_vec *= factor;
+	cam_direction_dot = cam_direction_vec->dotProduct(*cam_direction_vec);
+
+	for (int i = 0; i < other_cam_direction_vecs.size(); ++i)
+	{
+		*other_cam_direction_vecs[i] *= factor;
+		other_cam_direction_dots[i] = other_cam_direction_vecs[i]->dotProduct(*other_cam_direction_vecs[i]);
+		ab_direction_dots[i] = cam_direction_vec->dotProduct(*other_cam_direction_vecs[i]);
+		quotients[i] = cam_direction_dot * other_cam_direction_dots[i] - ab_direction_dots[i] * ab_direction_dots[i];
+	}
+}
+
+
 /*
 Perform the actual intersection of the rays based on the current values (automtically provide through the rays pointers).
 */
@@ -139,6 +248,24 @@ void ModelBuilder::intersectRays()
 	////
 
 
+	bool gather_pairs = usesPairIntersections();
+
+	if (gather_pairs)
+	{
+		// Order the shared intersections by the own rays (all slices of the pairs have been computed, see FrameScheduler)
+		for (int i = 0; i < other_rays.size(); ++i)
+			pair_intersectors[i]->collect(pair_is_first[i], &pair_offsets[i], &pair_orders[i]);
+	}
+	else
+	{
+		if (intersection_engine == INTERSECTION_ENGINE_SWEEP)
+			prepareSweep();
+
+		if (batched_narrow_phase)
+			prepareNarrowPhaseConstants();
+	}
+
+
 	int colls = 0;
 	int own_rays = rays->size();
 
@@ -150,258 +277,54 @@ void ModelBuilder::intersectRays()
 		int len1 = other_rays.size();
 		for (int i = 0; i < len1; ++i) // Loop through all sets of other rays
 		{
-			int len2 = other_rays[i]->size();
-			for (int j = 0; j < len2; ++j) // Loop through the rays of this set of other rays
+			if (gather_pairs)
 			{
-
-				// Compute the (squared) distance of the lines formed by the center of the two rays
-				float dist = CustomMath::compute_line_distance((*other_rays[i])[j]->origin - (*rays)[k]->origin, *cam_direction_vec, *other_cam_direction_vecs[i], cam_direction_dot, other_cam_direction_dots[i], ab_direction_dots[i], quotients[i]);
-
-				// If this distance is smaller than the sum of the height of the two rays
-				if (dist < ((*rays)[k]->ray_width_sq + (*other_rays[i])[j]->ray_width_sq)) // An intersection is possible
+				// The pairs of rays have already been tested, only the overlap is checked from the view of this camera
+				for (int p = pair_offsets[i][k]; p < pair_offsets[i][k + 1]; ++p)
 				{
-					vector3df line_orig, line_target;
-
-
-					// Compute how the the planes of the two rays inetrsect each other.
-					// The result is a line defined by line_orig and line_target.
-					// In the following this line will be called "main intersection line"
-					if (2 == CustomMath::compute_plane_collission((*rays)[k]->normal, (*other_rays[i])[j]->normal, (*rays)[k]->origin, (*other_rays[i])[j]->origin, &line_orig, &line_target))
-					{ // Planes are not paralel -> intersection line computed						
-							
-						float pos_other_start = 0, pos_other_end = 0, pos_this_start = 0, pos_this_end = 0;
-
-						// The direction of this main intersection line is computed.
-						vector3df intersection_line_direction = (line_target - line_orig);
-
-						//cout << "A dir x: " << line_target.X << " dir y: " << line_target.Y << " dir z: " << line_target.Z << endl;
-						//cout << "B dir x: " << line_orig.X << " dir y: " << line_orig.Y << " dir z: " << line_orig.Z << endl;
-
-
-						intersection_line_direction.normalize(); /// Todo: Maybe remove
-						float dot_a = intersection_line_direction.dotProduct(intersection_line_direction);
-
-#ifdef DEBUG_INTERSECTIONS
-						// Size of the intersection crosses when debug is enabled
-						int siz = 2;
-#endif
-
-
-						// Precompute values
-						float b = intersection_line_direction.dotProduct((*other_cam_direction_vecs[i]));
-						float D = (dot_a * other_cam_direction_dots[i] - b*b);
-
-						if (D < 3000)
-							continue; // If D is small, the lines are nearly parallel and collission is not significant -> continue with next intersection check
-
-
-						// The following two lines compute where the main intersection-line (as computed before)
-						// intersects with the the START EDGE of the OTHER Ray.
-						vector3df origin_a_to_b = line_orig - (*other_rays[i])[j]->origin_start;
-						pos_other_start = CustomMath::compute_line_collission_eff(origin_a_to_b, intersection_line_direction, *other_cam_direction_vecs[i], dot_a, other_cam_direction_dots[i], b, D);
-#ifdef DEBUG_INTERSECTIONS 
-						add3DCross(line_target + pos_other_start*direction_a, siz, &debug_quads);
-#endif
-
-						// The following two lines compute where the main intersection-line (as computed before)
-						// intersects with the the END EDGE of the OTHER Ray.
-						origin_a_to_b = line_orig - (*other_rays[i])[j]->origin_end;
-						pos_other_end = CustomMath::compute_line_collission_eff(origin_a_to_b, intersection_line_direction, *other_cam_direction_vecs[i], dot_a, other_cam_direction_dots[i], b, D );
-#ifdef DEBUG_INTERSECTIONS
-						add3DCross(line_target + pos_other_end*direction_a, siz, &debug_quads);
-#endif
-
-
-						// Precompute values
-						b = intersection_line_direction.dotProduct((*cam_direction_vec));
-						D = (dot_a * cam_direction_dot - b*b);
-
-						if (D < 3000)
-							continue; // If D is small, the lines are nearly parallel and collission is not significant -> continue with next intersection check
-
-
-						float this_ray_pos_start = 0;
-						float this_ray_pos_end = 0;
-
-						// The following two lines compute where the main intersection-line (as computed before)
-						// intersects with the the START EDGE of the OWN Ray.
-						origin_a_to_b = line_orig - (*rays)[k]->origin_start;
-						pos_this_start = CustomMath::compute_line_collission_eff_full(origin_a_to_b, intersection_line_direction, *cam_direction_vec, dot_a, cam_direction_dot, b, D, &this_ray_pos_start);
-#ifdef DEBUG_INTERSECTIONS
-						add3DCross(line_target + pos_this_start*direction_a, siz, &debug_quads);
-#endif
-
-
-						// The following two lines compute where the main intersection-line (as computed before)
-						// intersects with the the END EDGE of the OWN Ray.
-						origin_a_to_b = line_orig - (*rays)[k]->origin_end;
-						pos_this_end = CustomMath::compute_line_collission_eff_full(origin_a_to_b, intersection_line_direction, *cam_direction_vec, dot_a, cam_direction_dot, b, D, &this_ray_pos_end);
-#ifdef DEBUG_INTERSECTIONS
-						add3DCross(line_target + pos_this_end*direction_a, siz, &debug_quads);
-#endif
-
-
-						// The base values now are the following:
-						// pos_this_start
-						// pos_this_end
-						// pos_other_start
-						// pos_other_end
-						// They are all factors along the main intersection line
-						// and determine exactly how the the Rays are related locationwise to each other.
+					if (storePairIntersection((*rays)[k], pair_orders[i][p], i, intersect_ind))
+					{
+						colls++;
 
+						// Add the index of the current intersection to the list of the own array
+						(*rays)[k]->intersection_indices.push_back(intersect_ind);
 
-						//boolean inversed = false;
-						//boolean other_inversed = false;
-
-						// Swap the end with the start to always ensure that the start contains the smaller value
-						if (pos_this_end < pos_this_start)
-						{
-							swap(pos_this_start, pos_this_end);
-							//inversed = true;
-						}
-						if (pos_other_end < pos_other_start)
-						{
-							swap(pos_other_start, pos_other_end);
-							//other_inversed = true;
-						}
-							
-
-						boolean collided = true;
-
-
-						/*
-						The following code tries all the variants how the Rays can intersect each other
-						and choses the right variant.
-
-						The resulting values are the "intersection factors".
-						There is an X factor which tells where along the length of the Ray the intersection occured.
-						And there is an Y factor which tells where along the height of Ray it occured.
-						Together this is the full information of the intersection for every ray.
-						*/
-	
-						// THIS partially overlaps OTHER and PRECEDES: OWN_START <= OTHER_START <= OWN_END <= OTHER_END
-						if ((pos_this_start <= pos_other_start) &&
-							(pos_other_start <= pos_this_end) &&
-							(pos_this_end <= pos_other_end))
-						{
-#ifdef DEBUG_MSG
-							//if (own_rays == 1)
-								cout << "Variant 1" << endl;
-#endif
-							intersection_factor_start_y->push_back((pos_other_start - pos_this_start));
-							intersection_factor_end_y->push_back((pos_this_end - pos_this_start));
-						}
-						else
-
-						// THIS partially overlaps OTHER and EXITS: OTHER_START <= OWN_START <= OTHER_END <= OWN_END
-						if ((pos_other_start <= pos_this_start) &&
-							(pos_this_start <= pos_other_end) &&
-							(pos_other_end <= pos_this_end))
-						{
-#ifdef DEBUG_MSG
-							//if (own_rays == 1)
-								cout << "Variant 3" << endl;
-#endif
-
-							intersection_factor_start_y->push_back(0);
-							intersection_factor_end_y->push_back((pos_other_end - pos_this_start));
-						}
-						else
+						intersect_ind++;
+						local_intersections++;
+					}
+				}
+				continue;
+			}
 
-						// THIS completely inside OTHER: OTHER_START <= OWN_START <= OWN_END <= OTHER_END
-						if ((pos_other_start <= pos_this_start) &&
-							(pos_this_start <= pos_this_end) &&
-							(pos_this_end <= pos_other_end))
-						{
-#ifdef DEBUG_MSG
-							//if (own_rays == 1)
-								cout << "Variant 5" << endl;
-#endif
-							intersection_factor_start_y->push_back(0);
-							intersection_factor_end_y->push_back((pos_this_end - pos_this_start));
-						}
-						else
+			// Find the rays of this set which have to be tested
+			if ((intersection_engine == INTERSECTION_ENGINE_SWEEP) && sweep_possible[i])
+				collectSweepCandidates((*rays)[k], i);
+			else
+			{
+				candidates.clear();
+				for (int j = 0; j < other_rays[i]->size(); ++j)
+					candidates.push_back(j);
+			}
 
-						// OTHER completely inside THIS: OWN_START <= OTHER_START <= OTHER_END <= OWN_END
-						if ((pos_this_start <= pos_other_start) &&
-							(pos_other_start <= pos_other_end) &&
-							(pos_other_end <= pos_this_end))
-						{
-#ifdef DEBUG_MSG						
-							//if (own_rays == 1)
-								cout << "Variant 7" << endl;
-#endif
+			int len2 = candidates.size();
 
-							intersection_factor_start_y->push_back((pos_other_start - pos_this_start));
-							intersection_factor_end_y->push_back((pos_other_end - pos_this_start));
-						}
-						else
-							collided = false; // No type of collission detected
+			if (batched_narrow_phase)
+			{
+				for (int c = 0; c < len2; c += NARROW_PHASE_BATCH) // Loop through the candidates in batches
+				{
+					narrow_phase_batch.setRay((*rays)[k]);
+					for (int l = c; (l < len2) && (l < c + NARROW_PHASE_BATCH); ++l)
+						narrow_phase_batch.addOtherRay((*other_rays[i])[candidates[l]]);
 
+					CustomMath::compute_narrow_phase_batch(narrow_phase_constants[i], &narrow_phase_batch);
 
-						if (collided) // If there has been a real collision
+					for (int l = 0; l < narrow_phase_batch.count; ++l)
+					{
+						if (narrow_phase_batch.valid[l] && storeBatchIntersection((*rays)[k], (*other_rays[i])[candidates[c + l]], l, intersect_ind))
 						{
 							colls++;
 
-							// Compute the angle between the main intersection line and the direction of the camera
-							double intersection_angle = atan2(
-								intersection_line_direction.X*cam_direction_vec_norm->Y*(*rays)[k]->normal.Z + cam_direction_vec_norm->X*(*rays)[k]->normal.Y*intersection_line_direction.Z + (*rays)[k]->normal.X*intersection_line_direction.Y*cam_direction_vec_norm->Z - intersection_line_direction.Z*cam_direction_vec_norm->Y*(*rays)[k]->normal.X - cam_direction_vec_norm->Z*(*rays)[k]->normal.Y*intersection_line_direction.X - (*rays)[k]->normal.Z*intersection_line_direction.Y*cam_direction_vec_norm->X
-								, intersection_line_direction.dotProduct(*cam_direction_vec_norm)
-							);
-								
-							double intersection_sine = abs(sinf(intersection_angle));
-							double intersection_cos = cosf(intersection_angle);
-
-
-							// Adjust the X factors by the sine
-							(*intersection_factor_start_y)[intersect_ind] *= intersection_sine;
-							(*intersection_factor_end_y)[intersect_ind] *= intersection_sine;
-
-							// Compute the X factors
-							intersection_factor_start_x->push_back(this_ray_pos_start * max_ray_length + (*intersection_factor_start_y)[intersect_ind] * (abs(intersection_cos)));
-							intersection_factor_end_x->push_back(this_ray_pos_end * max_ray_length + (*intersection_factor_start_y)[intersect_ind] * intersection_cos);
-
-
-							// Correction if the difference between x values is larger than the height of the ray
-							if (((*intersection_factor_start_x)[intersect_ind] - (*intersection_factor_end_x)[intersect_ind]) > (*rays)[k]->ray_width)
-								(*intersection_factor_start_x)[intersect_ind] = (*intersection_factor_end_x)[intersect_ind] + (*rays)[k]->ray_width;
-							else
-								if (((*intersection_factor_end_x)[intersect_ind] - (*intersection_factor_start_x)[intersect_ind]) > (*rays)[k]->ray_width)
-								(*intersection_factor_end_x)[intersect_ind] = (*intersection_factor_start_x)[intersect_ind] + (*rays)[k]->ray_width;
-								
-							// Correction of the Y values
-							(*intersection_factor_start_y)[intersect_ind] = abs((*intersection_factor_start_y)[intersect_ind]);
-							(*intersection_factor_end_y)[intersect_ind] = abs((*intersection_factor_end_y)[intersect_ind]);
-
-
-
-							// Add the texture coordinates from the camera associated to the "other ray" which intersected with the own one.
-							texture_coordinates->push_back((*other_rays[i])[j]->tex_start_x);
-							texture_coordinates->push_back((*other_rays[i])[j]->tex_start_y);
-							texture_coordinates->push_back((*other_rays[i])[j]->tex_end_x);
-							texture_coordinates->push_back((*other_rays[i])[j]->tex_end_y);
-
-
-
-							/*
-							Compute how the own ray is oriented towards the camera of the other ray.
-							This determines how the data is used which tells on which side
-							of the ray the actual surface begins (the inside/outside classificiation computed by the EdgesIdentifier).
-							The result is whether this intersection represents a point along the own Ray where it enters the surface of the real 3D object (true) or it leaves it (false).
-							*/
-							vector3df rel_pos = (*rays)[k]->origin_start - (*other_rays[i])[j]->origin_start;
-							if ((rel_pos.dotProduct((*other_rays[i])[j]->normal)) > 0)
-								intersection_represents_entering_real_surface->push_back((*other_rays[i])[j]->inside_is_on_the_right);
-							else
-								intersection_represents_entering_real_surface->push_back(!(*other_rays[i])[j]->inside_is_on_the_right);
-
-
-							// Add the average of the start x and the end x to an additional array which will be used to order the intersections
-							intersection_values.push_back(((*intersection_factor_start_x)[intersect_ind] + (*intersection_factor_start_x)[intersect_ind])/2);
-
-
 							// Add the index of the current intersection to the list of the own array
-							// Todo: Replace this vector by a managed array
 							(*rays)[k]->intersection_indices.push_back(intersect_ind);
 
 							intersect_ind++;
@@ -410,6 +333,23 @@ void ModelBuilder::intersectRays()
 					}
 				}
 			}
+			else
+			{
+				for (int c = 0; c < len2; ++c) // Loop through the candidates one by one
+				{
+					if (intersectRayPair((*rays)[k], (*other_rays[i])[candidates[c]], i, intersect_ind))
+					{
+						colls++;
+
+						// Add the index of the current intersection to the list of the own array
+						// Todo: Replace this vector by a managed array
+						(*rays)[k]->intersection_indices.push_back(intersect_ind);
+
+						intersect_ind++;
+						local_intersections++;
+					}
+				}
+			}
 		}
 
 		/*
@@ -482,7 +422,414 @@ void ModelBuilder::intersectRays()
 
 	}
 	
+	intersection_count = intersect_ind;
+
+}
+
+
+/*
+Prepare the sweep engine for the current rays of all other cameras.
+
+All rays of a camera are parallel to its direction. For two cameras with the directions a and b
+the distance between the center lines of two rays is the distance of their origins along n = a x b (normalized).
+So every ray of another camera is reduced to its position along n and those positions are sorted once per frame.
+Every own ray then only needs the rays whose position lies within the sum of the ray widths (binary search)
+instead of all rays of that camera.
+*/
+void ModelBuilder::prepareSweep()
+{
+	for (int i = 0; i < other_rays.size(); ++i)
+	{
+		if (!sweep_possible[i])
+			continue;
+
+		vector<pair<float, int>> & order = sweep_orders[i];
+		order.clear();
+
+		float max_width_sq = 0;
+
+		int len = other_rays[i]->size();
+		for (int j = 0; j < len; ++j)
+		{
+			Ray3D * other_ray = (*other_rays[i])[j];
+
+			order.push_back(pair<float, int>(other_ray->origin.dotProduct(sweep_normals[i]), j));
+			max_width_sq = max(max_width_sq, other_ray->ray_width_sq);
+		}
+
+		sort(order.begin(), order.end());
+		sweep_max_width_sq[i] = max_width_sq;
+	}
+}
+
+/*
+Fill candidates with the indices of all rays of the other camera "other_set" which can be close enough to intersect the given own ray.
+The indices are in ascending order so the intersections are produced in the same order as by the all-pairs engine.
+The search range is slightly widened; the exact test is done by intersectRayPair() in both engines.
+*/
+void ModelBuilder::collectSweepCandidates(Ray3D * ray, int other_set)
+{
+	candidates.clear();
+
+	vector<pair<float, int>> & order = sweep_orders[other_set];
+
+	float position = ray->origin.dotProduct(sweep_normals[other_set]);
+	float range = sqrt(ray->ray_width_sq + sweep_max_width_sq[other_set]) * (1 + SWEEP_RANGE_TOLERANCE) + SWEEP_RANGE_TOLERANCE;
 
+	vector<pair<float, int>>::iterator it = lower_bound(order.begin(), order.end(), pair<float, int>(position - range, -1));
+	for (; (it != order.end()) && (it->first <= position + range); ++it)
+		candidates.push_back(it->second);
+
+	sort(candidates.begin(), candidates.end());
+}
+
+
+/*
+Collect the values of every pair of cameras required by the batched narrow phase (they change with the configuration).
+*/
+void ModelBuilder::prepareNarrowPhaseConstants()
+{
+	narrow_phase_constants.resize(other_rays.size());
+
+	for (int i = 0; i < other_rays.size(); ++i)
+	{
+		NarrowPhaseConstants & constants = narrow_phase_constants[i];
+
+		constants.cam_vec = *cam_direction_vec;
+		constants.cam_vec_norm = *cam_direction_vec_norm;
+		constants.other_vec = *other_cam_direction_vecs[i];
+		constants.other_vec_norm = *other_cam_direction_vecs[i];
+		constants.other_vec_norm.normalize();
+		constants.cam_dot = cam_direction_dot;
+		constants.other_dot = other_cam_direction_dots[i];
+		constants.ab_dot = ab_direction_dots[i];
+		constants.quotient = quotients[i];
+	}
+}
+
+
+/*
+Test a single pair of rays for an intersection (the "narrow phase" shared by both intersection engines).
+other_set is the index of the set of other rays (camera) the other ray belongs to.
+If they intersect, the data is appended at the index intersect_ind of the intersection arrays and true is returned.
+*/
+bool ModelBuilder::intersectRayPair(Ray3D * ray, Ray3D * other_ray, int other_set, int intersect_ind)
+{
+	int i = other_set;
+
+	// Compute the (squared) distance of the lines formed by the center of the two rays
+	float dist = CustomMath::compute_line_distance(other_ray->origin - ray->origin, *cam_direction_vec, *other_cam_direction_vecs[i], cam_direction_dot, other_cam_direction_dots[i], ab_direction_dots[i], quotients[i]);
+
+	// Only if this distance is smaller than the sum of the height of the two rays, an intersection is possible
+	if (!(dist < (ray->ray_width_sq + other_ray->ray_width_sq)))
+		return(false);
+
+	vector3df line_orig, line_target;
+
+
+	// Compute how the the planes of the two rays inetrsect each other.
+	// The result is a line defined by line_orig and line_target.
+	// In the following this line will be called "main intersection line"
+	if (2 == CustomMath::compute_plane_collission(ray->normal, other_ray->normal, ray->origin, other_ray->origin, &line_orig, &line_target))
+	{ // Planes are not paralel -> intersection line computed						
+			
+		float pos_other_start = 0, pos_other_end = 0, pos_this_start = 0, pos_this_end = 0;
+
+		// The direction of this main intersection line is computed.
+		vector3df intersection_line_direction = (line_target - line_orig);
+
+		//cout << "A dir x: " << line_target.X << " dir y: " << line_target.Y << " dir z: " << line_target.Z << endl;
+		//cout << "B dir x: " << line_orig.X << " dir y: " << line_orig.Y << " dir z: " << line_orig.Z << endl;
+
+
+		intersection_line_direction.normalize(); /// Todo: Maybe remove
+		float dot_a = intersection_line_direction.dotProduct(intersection_line_direction);
+
+#ifdef DEBUG_INTERSECTIONS
+		// Size of the intersection crosses when debug is enabled
+		int siz = 2;
+#endif
+
+
+		// Precompute values
+		float b = intersection_line_direction.dotProduct((*other_cam_direction_vecs[i]));
+		float D = (dot_a * other_cam_direction_dots[i] - b*b);
+
+		if (D < 3000)
+			return(false); // If D is small, the lines are nearly parallel and collission is not significant -> continue with next intersection check
+
+
+		// The following two lines compute where the main intersection-line (as computed before)
+		// intersects with the the START EDGE of the OTHER Ray.
+		vector3df origin_a_to_b = line_orig - other_ray->origin_start;
+		pos_other_start = CustomMath::compute_line_collission_eff(origin_a_to_b, intersection_line_direction, *other_cam_direction_vecs[i], dot_a, other_cam_direction_dots[i], b, D);
+#ifdef DEBUG_INTERSECTIONS 
+		add3DCross(line_target + pos_other_start*direction_a, siz, &debug_quads);
+#endif
+
+		// The following two lines compute where the main intersection-line (as computed before)
+		// intersects with the the END EDGE of the OTHER Ray.
+		origin_a_to_b = line_orig - other_ray->origin_end;
+		pos_other_end = CustomMath::compute_line_collission_eff(origin_a_to_b, intersection_line_direction, *other_cam_direction_vecs[i], dot_a, other_cam_direction_dots[i], b, D );
+#ifdef DEBUG_INTERSECTIONS
+		add3DCross(line_target + pos_other_end*direction_a, siz, &debug_quads);
+#endif
+
+
+		// Precompute values
+		b = intersection_line_direction.dotProduct((*cam_direction_vec));
+		D = (dot_a * cam_direction_dot - b*b);
+
+		if (D < 3000)
+			return(false); // If D is small, the lines are nearly parallel and collission is not significant -> continue with next intersection check
+
+
+		float this_ray_pos_start = 0;
+		float this_ray_pos_end = 0;
+
+		// The following two lines compute where the main intersection-line (as computed before)
+		// intersects with the the START EDGE of the OWN Ray.
+		origin_a_to_b = line_orig - ray->origin_start;
+		pos_this_start = CustomMath::compute_line_collission_eff_full(origin_a_to_b, intersection_line_direction, *cam_direction_vec, dot_a, cam_direction_dot, b, D, &this_ray_pos_start);
+#ifdef DEBUG_INTERSECTIONS
+		add3DCross(line_target + pos_this_start*direction_a, siz, &debug_quads);
+#endif
+
+
+		// The following two lines compute where the main intersection-line (as computed before)
+		// intersects with the the END EDGE of the OWN Ray.
+		origin_a_to_b = line_orig - ray->origin_end;
+		pos_this_end = CustomMath::compute_line_collission_eff_full(origin_a_to_b, intersection_line_direction, *cam_direction_vec, dot_a, cam_direction_dot, b, D, &this_ray_pos_end);
+#ifdef DEBUG_INTERSECTIONS
+		add3DCross(line_target + pos_this_end*direction_a, siz, &debug_quads);
+#endif
+
+
+		// The base values now are the following:
+		// pos_this_start
+		// pos_this_end
+		// pos_other_start
+		// pos_other_end
+		// They are all factors along the main intersection line
+		// and determine exactly how the the Rays are related locationwise to each other.
+
+
+		float start_y, end_y;
+		if (!classifyOverlap(pos_this_start, pos_this_end, pos_other_start, pos_other_end, &start_y, &end_y))
+			return(false);
+
+
+		// Compute the angle between the main intersection line and the direction of the camera
+		double intersection_angle = atan2(
+			intersection_line_direction.X*cam_direction_vec_norm->Y*ray->normal.Z + cam_direction_vec_norm->X*ray->normal.Y*intersection_line_direction.Z + ray->normal.X*intersection_line_direction.Y*cam_direction_vec_norm->Z - intersection_line_direction.Z*cam_direction_vec_norm->Y*ray->normal.X - cam_direction_vec_norm->Z*ray->normal.Y*intersection_line_direction.X - ray->normal.Z*intersection_line_direction.Y*cam_direction_vec_norm->X
+			, intersection_line_direction.dotProduct(*cam_direction_vec_norm)
+		);
+			
+		double intersection_sine = abs(sinf(intersection_angle));
+		double intersection_cos = cosf(intersection_angle);
+
+		storeIntersection(ray, other_ray, intersect_ind, start_y, end_y, this_ray_pos_start, this_ray_pos_end, intersection_sine, intersection_cos);
+
+		return(true);
+	}
+
+	return(false);
+}
+
+
+/*
+Finish a pair of the current batch of the narrow phase which passed all tests (valid lane).
+The same as the end of intersectRayPair() with the values computed by CustomMath::compute_narrow_phase_batch().
+*/
+bool ModelBuilder::storeBatchIntersection(Ray3D * ray, Ray3D * other_ray, int lane, int intersect_ind)
+{
+	float start_y, end_y;
+	if (!classifyOverlap(narrow_phase_batch.pos_this_start[lane], narrow_phase_batch.pos_this_end[lane], narrow_phase_batch.pos_other_start[lane], narrow_phase_batch.pos_other_end[lane], &start_y, &end_y))
+		return(false);
+
+	storeIntersection(ray, other_ray, intersect_ind, start_y, end_y, narrow_phase_batch.this_ray_pos_start[lane], narrow_phase_batch.this_ray_pos_end[lane], narrow_phase_batch.sine[lane], narrow_phase_batch.cosine[lane]);
+
+	return(true);
+}
+
+
+/*
+Finish an intersection computed by a CameraPairIntersector for this camera and the camera of other_set.
+For the second camera of the pair the intersection line has the opposite direction, so its factors are negated and both rays swap their roles.
+*/
+bool ModelBuilder::storePairIntersection(Ray3D * ray, PairIntersection * intersection, int other_set, int intersect_ind)
+{
+	float start_y, end_y;
+
+	if (pair_is_first[other_set])
+	{
+		if (!classifyOverlap(intersection->pos_first_start, intersection->pos_first_end, intersection->pos_second_start, intersection->pos_second_end, &start_y, &end_y))
+			return(false);
+
+		storeIntersection(ray, (*other_rays[other_set])[intersection->ray_second], intersect_ind, start_y, end_y, intersection->length_first_start, intersection->length_first_end, intersection->sine_first, intersection->cosine_first);
+	}
+	else
+	{
+		if (!classifyOverlap(-intersection->pos_second_start, -intersection->pos_second_end, -intersection->pos_first_start, -intersection->pos_first_end, &start_y, &end_y))
+			return(false);
+
+		storeIntersection(ray, (*other_rays[other_set])[intersection->ray_first], intersect_ind, start_y, end_y, intersection->length_second_start, intersection->length_second_end, intersection->sine_second, intersection->cosine_second);
+	}
+
+	return(true);
+}
+
+
+/*
+Determine how the rays overlap along the main intersection line (all positions are factors along that line).
+Returns false if they do not overlap; otherwise the interval of the overlap along the height of the own ray.
+*/
+bool ModelBuilder::classifyOverlap(float pos_this_start, float pos_this_end, float pos_other_start, float pos_other_end, float * start_y, float * end_y)
+{
+	//boolean inversed = false;
+	//boolean other_inversed = false;
+
+	// Swap the end with the start to always ensure that the start contains the smaller value
+	if (pos_this_end < pos_this_start)
+	{
+		swap(pos_this_start, pos_this_end);
+		//inversed = true;
+	}
+	if (pos_other_end < pos_other_start)
+	{
+		swap(pos_other_start, pos_other_end);
+		//other_inversed = true;
+	}
+
+
+	/*
+	The following code tries all the variants how the Rays can intersect each other
+	and choses the right variant.
+
+	The resulting values are the "intersection factors".
+	There is an X factor which tells where along the length of the Ray the intersection occured.
+	And there is an Y factor which tells where along the height of Ray it occured.
+	Together this is the full information of the intersection for every ray.
+	*/
+
+	// THIS partially overlaps OTHER and PRECEDES: OWN_START <= OTHER_START <= OWN_END <= OTHER_END
+	if ((pos_this_start <= pos_other_start) &&
+		(pos_other_start <= pos_this_end) &&
+		(pos_this_end <= pos_other_end))
+	{
+#ifdef DEBUG_MSG
+		//if (own_rays == 1)
+			cout << "Variant 1" << endl;
+#endif
+		*start_y = pos_other_start - pos_this_start;
+		*end_y = pos_this_end - pos_this_start;
+	}
+	else
+
+	// THIS partially overlaps OTHER and EXITS: OTHER_START <= OWN_START <= OTHER_END <= OWN_END
+	if ((pos_other_start <= pos_this_start) &&
+		(pos_this_start <= pos_other_end) &&
+		(pos_other_end <= pos_this_end))
+	{
+#ifdef DEBUG_MSG
+		//if (own_rays == 1)
+			cout << "Variant 3" << endl;
+#endif
+
+		*start_y = 0;
+		*end_y = pos_other_end - pos_this_start;
+	}
+	else
+
+	// THIS completely inside OTHER: OTHER_START <= OWN_START <= OWN_END <= OTHER_END
+	if ((pos_other_start <= pos_this_start) &&
+		(pos_this_start <= pos_this_end) &&
+		(pos_this_end <= pos_other_end))
+	{
+#ifdef DEBUG_MSG
+		//if (own_rays == 1)
+			cout << "Variant 5" << endl;
+#endif
+		*start_y = 0;
+		*end_y = pos_this_end - pos_this_start;
+	}
+	else
+
+	// OTHER completely inside THIS: OWN_START <= OTHER_START <= OTHER_END <= OWN_END
+	if ((pos_this_start <= pos_other_start) &&
+		(pos_other_start <= pos_other_end) &&
+		(pos_other_end <= pos_this_end))
+	{
+#ifdef DEBUG_MSG						
+		//if (own_rays == 1)
+			cout << "Variant 7" << endl;
+#endif
+
+		*start_y = pos_other_start - pos_this_start;
+		*end_y = pos_other_end - pos_this_start;
+	}
+	else
+		return(false); // No type of collission detected
+
+	return(true);
+}
+
+
+/*
+Add an intersection at the index intersect_ind of the intersection arrays.
+start_y and end_y are the interval of the overlap (from classifyOverlap());
+intersection_sine and intersection_cos belong to the angle between the main intersection line and the direction of the camera.
+*/
+void ModelBuilder::storeIntersection(Ray3D * ray, Ray3D * other_ray, int intersect_ind, float start_y, float end_y, float this_ray_pos_start, float this_ray_pos_end, double intersection_sine, double intersection_cos)
+{
+	intersection_factor_start_y->push_back(start_y);
+	intersection_factor_end_y->push_back(end_y);
+
+	// Adjust the X factors by the sine
+	(*intersection_factor_start_y)[intersect_ind] *= intersection_sine;
+	(*intersection_factor_end_y)[intersect_ind] *= intersection_sine;
+
+	// Compute the X factors
+	intersection_factor_start_x->push_back(this_ray_pos_start * max_ray_length + (*intersection_factor_start_y)[intersect_ind] * (abs(intersection_cos)));
+	intersection_factor_end_x->push_back(this_ray_pos_end * max_ray_length + (*intersection_factor_start_y)[intersect_ind] * intersection_cos);
+
+
+	// Correction if the difference between x values is larger than the height of the ray
+	if (((*intersection_factor_start_x)[intersect_ind] - (*intersection_factor_end_x)[intersect_ind]) > ray->ray_width)
+		(*intersection_factor_start_x)[intersect_ind] = (*intersection_factor_end_x)[intersect_ind] + ray->ray_width;
+	else
+		if (((*intersection_factor_end_x)[intersect_ind] - (*intersection_factor_start_x)[intersect_ind]) > ray->ray_width)
+		(*intersection_factor_end_x)[intersect_ind] = (*intersection_factor_start_x)[intersect_ind] + ray->ray_width;
+		
+	// Correction of the Y values
+	(*intersection_factor_start_y)[intersect_ind] = abs((*intersection_factor_start_y)[intersect_ind]);
+	(*intersection_factor_end_y)[intersect_ind] = abs((*intersection_factor_end_y)[intersect_ind]);
+
+
+
+	// Add the texture coordinates from the camera associated to the "other ray" which intersected with the own one.
+	texture_coordinates->push_back(other_ray->tex_start_x);
+	texture_coordinates->push_back(other_ray->tex_start_y);
+	texture_coordinates->push_back(other_ray->tex_end_x);
+	texture_coordinates->push_back(other_ray->tex_end_y);
+
+
+
+	/*
+	Compute how the own ray is oriented towards the camera of the other ray.
+	This determines how the data is used which tells on which side
+	of the ray the actual surface begins (the inside/outside classificiation computed by the EdgesIdentifier).
+	The result is whether this intersection represents a point along the own Ray where it enters the surface of the real 3D object (true) or it leaves it (false).
+	*/
+	vector3df rel_pos = ray->origin_start - other_ray->origin_start;
+	if ((rel_pos.dotProduct(other_ray->normal)) > 0)
+		intersection_represents_entering_real_surface->push_back(other_ray->inside_is_on_the_right);
+	else
+		intersection_represents_entering_real_surface->push_back(!other_ray->inside_is_on_the_right);
+
+
+	// Add the average of the start x and the end x to an additional array which will be used to order the intersections
+	intersection_values.push_back(((*intersection_factor_start_x)[intersect_ind] + (*intersection_factor_start_x)[intersect_ind])/2);
 }
 
 
@@ -493,11 +840,55 @@ void ModelBuilder::computeModelPart(vector<int> * output_content)
 {
 	output_content->clear();
 
-	for (int i = 0; i < (*rays).size(); ++i)
+	if (exact_subray_quads)
 	{
-		(*rays)[i]->addAsModelQuads(output_content, *cam_direction_vec_norm, intersection_factor_start_x, intersection_factor_end_x, intersection_factor_start_y, intersection_factor_end_y, intersection_represents_entering_real_surface, texture_coordinates);
+		for (int i = 0; i < (*rays).size(); ++i)
+			(*rays)[i]->addAsModelSubQuads(output_content, *cam_direction_vec_norm, intersection_factor_start_x, intersection_factor_end_x, intersection_factor_start_y, intersection_factor_end_y, intersection_represents_entering_real_surface, texture_coordinates, &subray_workspace);
+	}
+	else
+	{
+		for (int i = 0; i < (*rays).size(); ++i)
+			(*rays)[i]->addAsModelQuads(output_content, *cam_direction_vec_norm, intersection_factor_start_x, intersection_factor_end_x, intersection_factor_start_y, intersection_factor_end_y, intersection_represents_entering_real_surface, texture_coordinates);
 	}
 
 	for (int i = 0; i < debug_quads.size(); ++i)
 		output_content->push_back(debug_quads[i]);
 }
+
+
+/*
+Differential test of the batched narrow phase (see CustomMath::check_narrow_phase_batch()) with all pairs of the current rays.
+Returns the number of mismatching pairs and adds the number of tested pairs to pairs_checked.
+*/
+int ModelBuilder::checkNarrowPhase(float tolerance, int * pairs_checked)
+{
+	prepareNarrowPhaseConstants();
+
+	NarrowPhaseBatch * batch = new NarrowPhaseBatch();
+	int mismatches = 0;
+
+	for (int k = 0; k < rays->size(); ++k)
+		for (int i = 0; i < other_rays.size(); ++i)
+			for (int c = 0; c < other_rays[i]->size(); c += NARROW_PHASE_BATCH)
+			{
+				batch->setRay((*rays)[k]);
+				for (int l = c; (l < other_rays[i]->size()) && (l < c + NARROW_PHASE_BATCH); ++l)
+					batch->addOtherRay((*other_rays[i])[l]);
+
+				mismatches += CustomMath::check_narrow_phase_batch(narrow_phase_constants[i], *batch, tolerance);
+				*pairs_checked += batch->count;
+			}
+
+	delete(batch);
+
+	return(mismatches);
+}
+
+
+/*
+Number of intersections found by the last call of intersectRays()
+*/
+int ModelBuilder::getIntersectionCount()
+{
+	return(intersection_count);
+}
\ No newline at end of file
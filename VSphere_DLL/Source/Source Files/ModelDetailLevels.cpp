@@ -0,0 +1,194 @@
+/*
+Coarser levels of detail of the model part of a camera, computed from its quads after every frame
+(configuration key detail_levels, retrieved through GetModelLevel()). They cost less to render and to transfer than the full model.
+
+All reconstruction engines emit the quads of a face in the order of its contour chain: the second viewing edge of a quad
+(corners last_end and end) is where the first viewing edge (last_start and start) of a following quad is.
+A ray emits a quad per viewing edge, so the quad continuing another one is searched among the next DETAIL_SEARCH_QUADS quads.
+Level n joins runs of up to 2^n such quads into one quad from the first viewing edge of the first quad to the second viewing edge of the last,
+which is the quad the rays in between would give if they were skipped.
+A run ends where the next quad does not continue the last one (its viewing edge or its texture is elsewhere)
+or where it turns away from the direction of the first quad of the run, so the corners of the surface are kept.
+
+Input:
+	quads		// Model part of a camera (see ModelBuilder::computeModelPart)
+
+Output:
+	levels		// Quads of every coarser level in the same format (see getLevel)
+*/
+
+#include "stdafx.h"
+
+#include "ModelDetailLevels.h"
+
+
+// Distance the viewing edges of two quads may be apart and still continue each other: a share of the length of the edges
+// (every ray finds the ends of its viewing edges on its own) and at least this (times 100, like the quads)
+#define DETAIL_JOIN_SHARE 0.25f
+#define DETAIL_JOIN_MIN 100
+
+// Pixels the texture coordinates of the joined viewing edges may be apart
+#define DETAIL_TEXTURE_DISTANCE 2
+
+// Quads after the last one of a run searched for the one continuing it
+#define DETAIL_SEARCH_QUADS 8
+
+// Smallest cosine between the direction of a quad and the direction of the first quad of its run (about 20 degrees)
+#define DETAIL_MAX_BEND 0.94f
+
+
+ModelDetailLevels::ModelDetailLevels()
+{
+}
+
+ModelDetailLevels::~ModelDetailLevels()
+{
+	for (int l = 0; l < levels.size(); ++l)
+		delete(levels[l]);
+}
+
+
+/*
+Whether two corners (3 values each) are closer than the tolerance.
+*/
+bool ModelDetailLevels::nearCorner(int * corner, int * other, float tolerance_sq)
+{
+	float dx = (float)(corner[0] - other[0]), dy = (float)(corner[1] - other[1]), dz = (float)(corner[2] - other[2]);
+	return(dx * dx + dy * dy + dz * dz <= tolerance_sq);
+}
+
+/*
+Whether two texture coordinates (2 values each) show the same pixels.
+*/
+bool ModelDetailLevels::nearTexture(int * texture, int * other)
+{
+	return((abs(texture[0] - other[0]) <= DETAIL_TEXTURE_DISTANCE) && (abs(texture[1] - other[1]) <= DETAIL_TEXTURE_DISTANCE));
+}
+
+/*
+Whether the next quad continues the last one: 1 if its first viewing edge is the second one of the last quad,
+-1 if its second viewing edge is the first one of the last quad (the chain runs the other way), otherwise 0.
+*/
+int ModelDetailLevels::joins(int * last, int * next)
+{
+	float dx = (float)(last[3] - last[0]), dy = (float)(last[4] - last[1]), dz = (float)(last[5] - last[2]);
+	float tolerance = max(DETAIL_JOIN_SHARE * sqrt(dx * dx + dy * dy + dz * dz), (float)DETAIL_JOIN_MIN);
+	float tolerance_sq = tolerance * tolerance;
+
+	if (nearCorner(last + 6, next, tolerance_sq) && nearCorner(last + 9, next + 3, tolerance_sq) && nearTexture(last + 16, next + 12) && nearTexture(last + 18, next + 14))
+		return(1);
+
+	if (nearCorner(next + 6, last, tolerance_sq) && nearCorner(next + 9, last + 3, tolerance_sq) && nearTexture(next + 16, last + 12) && nearTexture(next + 18, last + 14))
+		return(-1);
+
+	return(0);
+}
+
+/*
+Whether a quad points in the direction of the first quad of the run (from the middle of its first to the middle of its second viewing edge).
+*/
+bool ModelDetailLevels::alongRun(int * head, int * next)
+{
+	float head_axis[3], next_axis[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		head_axis[k] = (float)(head[6 + k] + head[9 + k] - head[k] - head[3 + k]);
+		next_axis[k] = (float)(next[6 + k] + next[9 + k] - next[k] - next[3 + k]);
+	}
+
+	float dot = head_axis[0] * next_axis[0] + head_axis[1] * next_axis[1] + head_axis[2] * next_axis[2];
+	float head_sq = head_axis[0] * head_axis[0] + head_axis[1] * head_axis[1] + head_axis[2] * head_axis[2];
+	float next_sq = next_axis[0] * next_axis[0] + next_axis[1] * next_axis[1] + next_axis[2] * next_axis[2];
+
+	return((dot > 0) && (dot * dot >= DETAIL_MAX_BEND * DETAIL_MAX_BEND * head_sq * next_sq));
+}
+
+
+/*
+Compute the levels 1 to level_count from the quads of a frame (a task of the camera after its quads, see PerCamControler::computeContent).
+The levels keep their capacity, so the frames after the largest one do not allocate.
+*/
+void ModelDetailLevels::computeLevels(vector<int> * quads, int level_count)
+{
+	while (levels.size() < level_count)
+		levels.push_back(new vector<int>());
+
+	this->level_count = level_count;
+
+	int quad_count = quads->size() / 20;
+
+	for (int l = 0; l < level_count; ++l)
+	{
+		vector<int> & level = *levels[l];
+		level.clear();
+		level.reserve(quads->size());
+
+		joined_quads.assign(quad_count, false);
+
+		int run_length = 2 << l;
+
+		for (int q = 0; q < quad_count; ++q)
+		{
+			if (joined_quads[q])
+				continue;
+
+			int * head = &(*quads)[q * 20];
+			int * tail = head;
+			int tail_index = q;
+			int direction = 0;
+
+			for (int count = 1; count < run_length; ++count)
+			{
+				int found = -1;
+
+				for (int n = tail_index + 1; (n <= tail_index + DETAIL_SEARCH_QUADS) && (n < quad_count) && (found == -1); ++n)
+				{
+					if (joined_quads[n])
+						continue;
+
+					int * next = &(*quads)[n * 20];
+					int joined = joins(tail, next);
+
+					if ((joined != 0) && ((direction == 0) || (joined == direction)) && alongRun(head, next))
+					{
+						found = n;
+						direction = joined;
+					}
+				}
+
+				if (found == -1)
+					break;
+
+				joined_quads[found] = true;
+				tail = &(*quads)[found * 20];
+				tail_index = found;
+			}
+
+			// The first viewing edge comes from the quad the chain starts with
+			int * first = (direction >= 0) ? head : tail;
+			int * second = (direction >= 0) ? tail : head;
+
+			level.insert(level.end(), first, first + 6);
+			level.insert(level.end(), second + 6, second + 12);
+			level.insert(level.end(), first + 12, first + 16);
+			level.insert(level.end(), second + 16, second + 20);
+		}
+	}
+}
+
+
+/*
+Number of levels computed in the last frame (without level 0).
+*/
+int ModelDetailLevels::getLevelCount()
+{
+	return(level_count);
+}
+
+/*
+The quads of a level (1 to getLevelCount()) of the last frame.
+*/
+vector<int> * ModelDetailLevels::getLevel(int level)
+{
+	return(levels[level - 1]);
+}
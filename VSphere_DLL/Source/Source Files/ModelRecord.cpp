@@ -0,0 +1,482 @@
+/*
+Records the published models to a file or plays them back instead of reconstructing them (see ConfigureModelRecord()).
+Unlike the camera records (see RecordingHandler) a played model record needs neither the cameras nor the pipeline:
+the sphere loop takes the decoded models as fast as they come and publishes them through the usual output functions.
+
+The file (file_path + MODEL_RECORD_EXTENSION) starts with MODEL_RECORD_MAGIC and MODEL_RECORD_VERSION,
+followed by every model as its ModelTiming, its number of quads, the size of its compressed quads and the compressed quads.
+The quads are compressed without loss: every value is predicted from the quad before it (the quads of a face follow its contour chain,
+so the first viewing edge of a quad is about where the second viewing edge of the one before it ends, see ModelDetailLevels.cpp)
+and the difference is Rice coded with a parameter every one of the 20 values of a quad adapts to on its own.
+
+Compressing and writing, or reading and decompressing, happens on an I/O thread. The sphere loop only copies a model into a free frame
+of MODEL_RECORD_FRAMES frames (or swaps a decoded one into the output); if the disk is too slow to take a model, the model is dropped and counted.
+A played record starts over when it ends. The texture is not recorded.
+
+Input:
+	complete model		// Quads and timing of every published model (see SphereControler::sphereLoop)
+
+Output:
+	The file of the record, or the played models
+*/
+
+#include "stdafx.h"
+
+#include "ModelRecord.h"
+
+#include "ThreadPlacement.h"
+
+
+// File of a model record: file path of the record + extension
+#define MODEL_RECORD_EXTENSION ".models"
+#define MODEL_RECORD_MAGIC 0x524D5356		// "VSMR"
+#define MODEL_RECORD_VERSION 1
+
+// Models in flight between the sphere loop and the I/O thread
+#define MODEL_RECORD_FRAMES 8
+
+// Longest unary part of a Rice code; larger values are written with all 32 bits after it
+#define MODEL_RECORD_ESCAPE 24
+
+// Values after which an adaptive Rice parameter forgets half of what it has seen
+#define MODEL_RECORD_RICE_RESET 64
+
+// Largest number of quads a played model may have (protects against a damaged file)
+#define MODEL_RECORD_MAX_QUADS 1000000
+
+
+ModelRecord::ModelRecord(bool recording, string file_path)
+{
+	this->recording = recording;
+	this->file_path = file_path;
+}
+
+/*
+Stop the I/O thread (a recording writes its remaining models first) and close the file.
+*/
+ModelRecord::~ModelRecord()
+{
+	if (io_thread != nullptr)
+	{
+		record_lock.lock();
+		stopping = true;
+		record_lock.unlock();
+		frame_queued.notify_all();
+		frame_freed.notify_all();
+
+		io_thread->join();
+		delete(io_thread);
+	}
+
+	if (recording && (frame_count > 0))
+		addInfoLine("Recorded " + to_string(frame_count) + " models into " + to_string(packed_bytes / 1024) + " KB ("
+			+ to_string(raw_bytes > 0 ? packed_bytes * 100 / raw_bytes : 0) + "% of the quads), " + to_string(dropped_frames) + " models dropped.");
+
+	if (file.is_open())
+		file.close();
+
+	for (int f = 0; f < frames.size(); ++f)
+		delete(frames[f]);
+}
+
+
+bool ModelRecord::getRecording()
+{
+	return(recording);
+}
+
+/*
+Open the file and start the I/O thread (when the sphere starts). Returns false if the file cannot be opened or is no model record.
+*/
+bool ModelRecord::start()
+{
+	string path = file_path + MODEL_RECORD_EXTENSION;
+
+	if (recording)
+	{
+		file.open(path, ios::out | ios::binary | ios::trunc);
+
+		int magic = MODEL_RECORD_MAGIC, version = MODEL_RECORD_VERSION;
+		file.write((char*)&magic, sizeof(int));
+		file.write((char*)&version, sizeof(int));
+	}
+	else
+	{
+		file.open(path, ios::in | ios::binary);
+
+		int magic = 0, version = 0;
+		file.read((char*)&magic, sizeof(int));
+		file.read((char*)&version, sizeof(int));
+
+		if ((magic != MODEL_RECORD_MAGIC) || (version != MODEL_RECORD_VERSION))
+			file.setstate(ios::failbit);
+
+		first_frame = file.tellg();
+	}
+
+	if (!file.good())
+	{
+		addError("Cannot " + string(recording ? "create" : "play") + " the model record " + path + ".");
+		return(false);
+	}
+
+	for (int f = 0; f < MODEL_RECORD_FRAMES; ++f)
+	{
+		frames.push_back(new RecordFrame());
+		free_frames.push_back(frames[f]);
+	}
+	queued_frames.reserve(MODEL_RECORD_FRAMES);
+
+	use_priorities = Settings::getConfiguration()->thread_priorities;
+	io_thread = new thread(launchIoThread, this);
+
+	addInfoLine(string(recording ? "Recording the models to " : "Playing the models from ") + path + ".");
+	return(true);
+}
+
+
+/*
+Hand a published model to the I/O thread (called by the sphere loop, never waits for the disk).
+*/
+void ModelRecord::recordModel(ModelTiming * timing, vector<int> * quads)
+{
+	unique_lock<mutex> guard(record_lock);
+
+	if (failed)
+		return;
+
+	if (free_frames.empty())
+	{
+		dropped_frames++;
+		return;
+	}
+
+	RecordFrame * frame = free_frames.back();
+	free_frames.pop_back();
+	guard.unlock();
+
+	// The frames keep their capacity, so only models larger than all before allocate
+	frame->timing = *timing;
+	frame->quads.assign(quads->begin(), quads->end());
+
+	guard.lock();
+	queued_frames.push_back(frame);
+	frame_queued.notify_one();
+}
+
+/*
+Wait until the next played model is decoded. Returns false if the record cannot be played.
+*/
+bool ModelRecord::waitModel()
+{
+	unique_lock<mutex> guard(record_lock);
+	frame_queued.wait(guard, [&] { return(failed || stopping || !queued_frames.empty()); });
+
+	return(!queued_frames.empty());
+}
+
+/*
+Take the next played model (after waitModel() returned true). Its quads are swapped into the given array, so nothing is copied.
+*/
+void ModelRecord::takeModel(ModelTiming * timing, vector<int> * quads)
+{
+	unique_lock<mutex> guard(record_lock);
+
+	RecordFrame * frame = queued_frames.front();
+	queued_frames.erase(queued_frames.begin());
+	guard.unlock();
+
+	*timing = frame->timing;
+	quads->swap(frame->quads);
+
+	guard.lock();
+	free_frames.push_back(frame);
+	frame_freed.notify_one();
+}
+
+
+void ModelRecord::launchIoThread(ModelRecord * record)
+{
+	ThreadPlacement::place(THREAD_ROLE_RECORDER, 0, ThreadPlacement::planProcessor(THREAD_ROLE_RECORDER, 0, Settings::getConfiguration()), record->use_priorities);
+
+	if (record->recording)
+		record->recordLoop();
+	else
+		record->playLoop();
+}
+
+/*
+Compress and write the queued models until the record is stopped and all of them are written.
+*/
+void ModelRecord::recordLoop()
+{
+	unique_lock<mutex> guard(record_lock);
+
+	while (true)
+	{
+		frame_queued.wait(guard, [&] { return(stopping || !queued_frames.empty()); });
+		if (queued_frames.empty())
+			break;
+
+		RecordFrame * frame = queued_frames.front();
+		queued_frames.erase(queued_frames.begin());
+		guard.unlock();
+
+		bool written = writeFrame(frame);
+
+		guard.lock();
+		free_frames.push_back(frame);
+
+		if (!written)
+		{
+			failed = true;
+			addError("Cannot write the model record " + file_path + MODEL_RECORD_EXTENSION + " anymore.");
+			break;
+		}
+	}
+}
+
+/*
+Read and decompress the models into the free frames until the record is stopped. At its end the record starts over.
+*/
+void ModelRecord::playLoop()
+{
+	unique_lock<mutex> guard(record_lock);
+
+	while (true)
+	{
+		frame_freed.wait(guard, [&] { return(stopping || !free_frames.empty()); });
+		if (stopping)
+			break;
+
+		RecordFrame * frame = free_frames.back();
+		free_frames.pop_back();
+		guard.unlock();
+
+		// A record cut off within a model (for example by a crash) is played up to its last complete model
+		bool read = readFrame(frame);
+		if (!read)
+		{
+			file.clear();
+			file.seekg(first_frame);
+			read = readFrame(frame);
+		}
+
+		guard.lock();
+
+		if (!read)
+		{
+			free_frames.push_back(frame);
+			failed = true;
+			frame_queued.notify_all();
+			addError("The model record " + file_path + MODEL_RECORD_EXTENSION + " contains no model.");
+			break;
+		}
+
+		queued_frames.push_back(frame);
+		frame_queued.notify_one();
+	}
+}
+
+
+bool ModelRecord::writeFrame(RecordFrame * frame)
+{
+	encodeModel(&frame->quads, &packed);
+
+	int quad_count = frame->quads.size() / 20;
+	int packed_size = packed.size();
+
+	file.write((char*)&frame->timing, sizeof(ModelTiming));
+	file.write((char*)&quad_count, sizeof(int));
+	file.write((char*)&packed_size, sizeof(int));
+	file.write((char*)packed.data(), packed_size);
+
+	frame_count++;
+	raw_bytes += frame->quads.size() * sizeof(int);
+	packed_bytes += sizeof(ModelTiming) + 2 * sizeof(int) + packed_size;
+
+	return(file.good());
+}
+
+bool ModelRecord::readFrame(RecordFrame * frame)
+{
+	int quad_count = -1, packed_size = -1;
+
+	file.read((char*)&frame->timing, sizeof(ModelTiming));
+	file.read((char*)&quad_count, sizeof(int));
+	file.read((char*)&packed_size, sizeof(int));
+
+	// Every value takes at most the escape and its 32 bits
+	if (!file.good() || (quad_count < 0) || (quad_count > MODEL_RECORD_MAX_QUADS) || (packed_size < 0) || (packed_size > (long long)quad_count * 20 * (MODEL_RECORD_ESCAPE + 32) / 8 + 8))
+		return(false);
+
+	packed.resize(packed_size);
+	file.read((char*)packed.data(), packed_size);
+
+	return(file.good() && decodeModel(packed.data(), packed_size, quad_count, &frame->quads));
+}
+
+
+/*
+The prediction of a value of a quad from the quad before it (zeros for the first quad) and the values of the quad before this one.
+The first viewing edge continues the second one of the quad before, the second viewing edge is as far from the first one as in the quad before;
+the same for the texture coordinates of both edges.
+*/
+int ModelRecord::predictValue(const int * previous, const int * quad, int index)
+{
+	if (index < 6)
+		return(previous[index + 6]);
+	if (index < 12)
+		return(quad[index - 6] + previous[index] - previous[index - 6]);
+	if (index < 16)
+		return(previous[index + 4]);
+	return(quad[index - 4] + previous[index] - previous[index - 4]);
+}
+
+/*
+The Rice parameter for the next value: the smallest k for which 2^k reaches the average of the values seen so far.
+*/
+int ModelRecord::riceParameter(RiceContext * context)
+{
+	int k = 0;
+	while (((long long)context->count << k) < context->magnitude_sum && (k < 31))
+		k++;
+	return(k);
+}
+
+void ModelRecord::updateContext(RiceContext * context, unsigned int value)
+{
+	context->magnitude_sum += value;
+	context->count++;
+
+	if (context->count >= MODEL_RECORD_RICE_RESET)
+	{
+		context->magnitude_sum >>= 1;
+		context->count >>= 1;
+	}
+}
+
+
+/*
+Compress the quads of a model (the array keeps its capacity, so only models larger than all before allocate).
+*/
+void ModelRecord::encodeModel(vector<int> * quads, vector<unsigned char> * packed)
+{
+	packed->clear();
+
+	unsigned long long bit_buffer = 0;
+	int bit_count = 0;
+
+	auto writeBits = [&](unsigned int value, int bits)
+	{
+		bit_buffer |= (unsigned long long)value << bit_count;
+		bit_count += bits;
+
+		while (bit_count >= 8)
+		{
+			packed->push_back((unsigned char)bit_buffer);
+			bit_buffer >>= 8;
+			bit_count -= 8;
+		}
+	};
+
+	RiceContext contexts[20];
+	for (int i = 0; i < 20; ++i)
+		contexts[i] = { 16, 1 };
+
+	int zeros[20] = {};
+	int quad_count = quads->size() / 20;
+
+	for (int q = 0; q < quad_count; ++q)
+	{
+		const int * quad = quads->data() + q * 20;
+		const int * previous = (q > 0) ? quad - 20 : zeros;
+
+		for (int i = 0; i < 20; ++i)
+		{
+			// Zigzag: small differences of both signs become small values
+			int difference = (int)((unsigned int)quad[i] - (unsigned int)predictValue(previous, quad, i));
+			unsigned int value = ((unsigned int)difference << 1) ^ (unsigned int)(difference >> 31);
+
+			int k = riceParameter(&contexts[i]);
+			unsigned int high = value >> k;
+
+			if (high < MODEL_RECORD_ESCAPE)
+			{
+				writeBits((1u << high) - 1, high + 1); // high ones and the terminating zero
+				if (k > 0)
+					writeBits(value & ((1u << k) - 1), k);
+			}
+			else
+			{
+				writeBits((1u << MODEL_RECORD_ESCAPE) - 1, MODEL_RECORD_ESCAPE);
+				writeBits(value, 32);
+			}
+
+			updateContext(&contexts[i], value);
+		}
+	}
+
+	if (bit_count > 0)
+		packed->push_back((unsigned char)bit_buffer);
+}
+
+/*
+Decompress quad_count quads (the array keeps its capacity). Returns false if the compressed quads are damaged.
+*/
+bool ModelRecord::decodeModel(const unsigned char * packed, int packed_size, int quad_count, vector<int> * quads)
+{
+	unsigned long long bit_buffer = 0;
+	int bit_count = 0;
+	int position = 0;
+	bool overrun = false;
+
+	// Reading past the end gives zeros (which end every unary part) and marks the model as damaged
+	auto readBits = [&](int bits) -> unsigned int
+	{
+		while (bit_count < bits)
+		{
+			if (position < packed_size)
+				bit_buffer |= (unsigned long long)packed[position++] << bit_count;
+			else
+				overrun = true;
+			bit_count += 8;
+		}
+
+		unsigned int value = (unsigned int)(bit_buffer & ((1ull << bits) - 1));
+		bit_buffer >>= bits;
+		bit_count -= bits;
+		return(value);
+	};
+
+	RiceContext contexts[20];
+	for (int i = 0; i < 20; ++i)
+		contexts[i] = { 16, 1 };
+
+	int zeros[20] = {};
+	quads->resize(quad_count * 20);
+
+	for (int q = 0; (q < quad_count) && !overrun; ++q)
+	{
+		int * quad = quads->data() + q * 20;
+		const int * previous = (q > 0) ? quad - 20 : zeros;
+
+		for (int i = 0; i < 20; ++i)
+		{
+			int k = riceParameter(&contexts[i]);
+
+			unsigned int high = 0;
+			while ((high < MODEL_RECORD_ESCAPE) && (readBits(1) == 1))
+				high++;
+
+			unsigned int value = (high < MODEL_RECORD_ESCAPE) ? ((high << k) | readBits(k)) : readBits(32);
+
+			int difference = (int)((value >> 1) ^ (0u - (value & 1)));
+			quad[i] = (int)((unsigned int)predictValue(previous, quad, i) + (unsigned int)difference);
+
+			updateContext(&contexts[i], value);
+		}
+	}
+
+	return(!overrun);
+}
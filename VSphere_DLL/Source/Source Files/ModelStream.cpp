@@ -0,0 +1,196 @@
+/*
+Publishes every model into shared memory, so renderers in other processes on the same host can read it
+without loading the plugin (configuration key model_stream_quads, read with ModelStreamReader.h).
+
+The memory is a named file mapping (MODEL_STREAM_NAME) with a ModelStreamHeader followed by MODEL_STREAM_SLOTS slots.
+Model n is written into slot n % MODEL_STREAM_SLOTS. Only the sphere loop writes and it never waits for a reader:
+the state of a slot is odd while the slot is overwritten and tells the sequence of its model once it is complete (a sequence lock),
+and latest_sequence names the newest complete model. A reader uses the quads directly in the shared memory and afterwards checks
+that the state of the slot has not changed, which gives it the time of MODEL_STREAM_SLOTS - 1 models to use one.
+After every model an event is signaled, so the readers can sleep until the next model instead of polling.
+There are two manual-reset events, one for the even and one for the odd sequences. Publishing model n resets the event of model n + 1
+and sets the one of model n, which wakes every reader waiting for it. A reader waits on the event of the model after the one it has,
+so it neither misses the model nor wakes again for the same one.
+
+A reader may outlive the sphere and keep the memory alive. The next sphere then takes over the memory if its layout is the same:
+it counts up the session of the header (odd while it resets the slots, like the state of a slot) and starts its sequences at 1 again.
+
+Input:
+	complete model		// Quads and timing of every model (see SphereControler::sphereLoop)
+
+Output:
+	shared memory		// See ModelStreamHeader and ModelStreamSlot in PluginDataTypes.h
+*/
+
+#include "stdafx.h"
+
+#include "ModelStream.h"
+
+
+// Models kept in the shared memory at the same time
+#define MODEL_STREAM_SLOTS 4
+
+// Alignment of the slots in the shared memory
+#define MODEL_STREAM_ALIGNMENT 64
+
+
+ModelStream::ModelStream()
+{
+}
+
+ModelStream::~ModelStream()
+{
+	close();
+}
+
+
+/*
+Create the shared memory for models of up to slot_quads quads, or take over the memory an earlier sphere left to its readers.
+Returns false if it cannot be created or is kept with another layout.
+*/
+bool ModelStream::open(const char * name, int slot_quads)
+{
+	close();
+
+	int first_slot = ((sizeof(ModelStreamHeader) + MODEL_STREAM_ALIGNMENT - 1) / MODEL_STREAM_ALIGNMENT) * MODEL_STREAM_ALIGNMENT;
+	int slot_bytes = ((sizeof(ModelStreamSlot) + slot_quads * 20 * sizeof(int) + MODEL_STREAM_ALIGNMENT - 1) / MODEL_STREAM_ALIGNMENT) * MODEL_STREAM_ALIGNMENT;
+	unsigned long long size = first_slot + (unsigned long long)slot_bytes * MODEL_STREAM_SLOTS;
+
+	mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)(size & 0xFFFFFFFF), name);
+	if (mapping == NULL)
+	{
+		addError("Cannot create the shared memory of the model stream (error " + to_string(GetLastError()) + ").");
+		return(false);
+	}
+
+	bool existing = (GetLastError() == ERROR_ALREADY_EXISTS);
+
+	// An existing mapping keeps the size it was created with, so its view is only as large as its header tells
+	view = (char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, existing ? 0 : (SIZE_T)size);
+	if (view == nullptr)
+	{
+		addError("Cannot map the shared memory of the model stream (error " + to_string(GetLastError()) + ").");
+		close();
+		return(false);
+	}
+
+	header = (ModelStreamHeader*)view;
+
+	if (existing)
+	{
+		if ((header->magic != MODEL_STREAM_MAGIC) || (header->version != MODEL_STREAM_VERSION) || (header->active != 0) || (header->slot_count != MODEL_STREAM_SLOTS)
+			|| (header->slot_quads != slot_quads) || (header->slot_bytes != slot_bytes) || (header->first_slot != first_slot))
+		{
+			addError("The shared memory of the model stream is used by another sphere or kept by a reader with another model_stream_quads ("
+				+ to_string(header->slot_quads) + "). The models are not streamed.");
+			header = nullptr;
+			close();
+			return(false);
+		}
+
+		// Readers see the odd session and drop what they hold until the slots are free again
+		InterlockedExchange64(&header->session, header->session + 1);
+
+		header->latest_sequence = 0;
+		for (int s = 0; s < MODEL_STREAM_SLOTS; ++s)
+			getSlot(s)->state = 0;
+
+		header->active = 1;
+		InterlockedExchange64(&header->session, header->session + 1);
+	}
+	else
+	{
+		// The mapping starts zeroed, so every slot is free and no model is published yet
+		header->slot_count = MODEL_STREAM_SLOTS;
+		header->slot_quads = slot_quads;
+		header->slot_bytes = slot_bytes;
+		header->first_slot = first_slot;
+		header->latest_sequence = 0;
+		header->session = 2;
+		header->version = MODEL_STREAM_VERSION;
+		header->active = 1;
+
+		// Readers check the magic last
+		MemoryBarrier();
+		header->magic = MODEL_STREAM_MAGIC;
+	}
+
+	// Readers of an earlier sphere may keep its events, the first sequences of this one start unsignaled
+	for (int e = 0; e < 2; ++e)
+	{
+		model_published[e] = CreateEventA(NULL, TRUE, FALSE, (string(name) + MODEL_STREAM_EVENT_SUFFIX + to_string(e)).c_str());
+		if (model_published[e] == NULL)
+			addError("Cannot create the events of the model stream (error " + to_string(GetLastError()) + "); readers have to poll.");
+		else
+			ResetEvent(model_published[e]);
+	}
+
+	addInfoLine("Streaming the models through the shared memory \"" + string(name) + "\" (" + to_string(size / 1024) + " KB"
+		+ (existing ? ", taken over from an earlier sphere" : "") + ").");
+	return(true);
+}
+
+/*
+Tell the readers that no more models follow and release the shared memory.
+It disappears with its last reader; as long as one is left the next sphere takes it over (see open).
+*/
+void ModelStream::close()
+{
+	if (header != nullptr)
+		header->active = 0;
+
+	// All waiting readers wake up and see the stream has ended
+	for (int e = 0; e < 2; ++e)
+		if (model_published[e] != NULL)
+		{
+			SetEvent(model_published[e]);
+			CloseHandle(model_published[e]);
+			model_published[e] = NULL;
+		}
+
+	if (view != nullptr)
+		UnmapViewOfFile(view);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+
+	view = nullptr;
+	header = nullptr;
+	mapping = NULL;
+}
+
+
+ModelStreamSlot * ModelStream::getSlot(int slot)
+{
+	return((ModelStreamSlot*)(view + header->first_slot + (long long)slot * header->slot_bytes));
+}
+
+/*
+Write a model into its slot and make it the latest one (called by the sphere loop after every model, never blocks).
+*/
+void ModelStream::publish(int sequence, vector<int> * quads, ModelTiming * timing)
+{
+	if (header == nullptr)
+		return;
+
+	ModelStreamSlot * slot = getSlot(sequence % header->slot_count);
+
+	// The readers of this model are woken below, those of the next one wait from now on
+	if (model_published[(sequence + 1) % 2] != NULL)
+		ResetEvent(model_published[(sequence + 1) % 2]);
+
+	// Readers still using the model of this slot see that it changes (the interlocked exchanges are full barriers)
+	InterlockedExchange64(&slot->state, 2 * (long long)sequence + 1);
+
+	int quad_count = min((int)quads->size() / 20, header->slot_quads);
+
+	slot->timing = *timing;
+	slot->quad_count = quad_count;
+	slot->dropped_quads = (int)quads->size() / 20 - quad_count;
+	memcpy(slot + 1, quads->data(), quad_count * 20 * sizeof(int));
+
+	InterlockedExchange64(&slot->state, 2 * (long long)sequence);
+	InterlockedExchange64(&header->latest_sequence, sequence);
+
+	if (model_published[sequence % 2] != NULL)
+		SetEvent(model_published[sequence % 2]);
+}
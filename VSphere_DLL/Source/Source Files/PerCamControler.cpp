@@ -1,6 +1,7 @@
 /*
-This class handles all core classes from the "FrameProcessing" folder and therefore all computing which happens on a single thread and for one camera.
+This class handles all core classes from the "FrameProcessing" folder and therefore all computing which happens for one camera.
 An instance of this class will be created by the SphereControler for every camera.
+Its work is split into tasks (initializeProcessing, processFrame and computeContent) which the FrameScheduler runs on its worker threads.
 
 @Author: Alexander Georgescu
 */
@@ -13,6 +14,9 @@ An instance of this class will be created by the SphereControler for every camer
 #include "EdgesIdentifier.h"
 #include "RayGenerator.h"
 #include "ModelBuilder.h"
+#include "RegionOfInterest.h"
+#include "AllocationTracker.h"
+#include "CapturePool.h"
 
 #include <ctime>
 
@@ -30,76 +34,72 @@ PerCamControler::PerCamControler(CameraHandler * camera_set, RecordingHandler *
 	// This lock is currently not used (is only there for possibledebug purpose)
 	//this->computation_lock = computation_lock;
 
-	tex_offs_x = camera_source->getIndex()*camera_source->getSize().X;
+	// The frames are placed next to each other in the texture in the order of the list (the cameras may have different resolutions, see GetRequiredTextureWidth())
+	tex_offs_x = 0;
+	for (int c = 0; c < camera_list_index; ++c)
+		tex_offs_x += camera_set->getCameraSource(c)->getSize().X;
 	tex_offs_y = 0; // Todo: Change if camera textures are aligned differently (not simply horizontally)
 
 
-	frame_task_mode = 0; // Start without any task
-	next_frame_task_mode = frame_task_mode;
+	background_recompute_requested = false;
+
+	statistics = {};
+	statistics.list_index = camera_list_index;
+
+	configuration_user = Settings::registerConfigurationUser();
+	configuration = Settings::acquireConfiguration(configuration_user);
 
 
 	// Prepare objects required for computing the frame
 	background_reference = new BackgroundReference();
 	contours_extractor = new ContoursExtractor();
+	region_of_interest = new RegionOfInterest();
 	edges_identifier = new EdgesIdentifier();
 	ray_generator = new RayGenerator(camera_source);
 	model_computer = new ModelBuilder();
-
-
-	// Init semaphores
-	controlSem = (PHANDLE)CreateSemaphore(NULL, 1, 1, NULL);
-	workerSem = (PHANDLE)CreateSemaphore(NULL, 0, 1, NULL);
+	detail_levels = new ModelDetailLevels();
 }
 
 PerCamControler::~PerCamControler()
 {
-	processing_thread.join(); // Wait for the loop thread to finish
-
 	delete(background_reference);
 	delete(contours_extractor);
+	delete(region_of_interest);
 	delete(edges_identifier);
 	delete(ray_generator);
 	delete(model_computer);
 
 	delete(output_content);
+	delete(detail_levels);
+
+	Settings::releaseConfigurationUser(configuration_user);
 }
 
 
 /*
 Initialize the camera and return whetehr the camera has been accessed sucessfully.
+The device is opened by the capture pool (once for all channels of a device).
+The first background reference is computed afterwards by the task initializeProcessing().
 */
-bool PerCamControler::initialize()
+bool PerCamControler::initialize(CapturePool * capture_pool)
 {
-	records->startRecordOrPlay(camera_list_index);
+	vector2di size = camera_source->getSize(); // The negotiated mode (see CameraHandler::negotiateModes)
+
+	records->startRecordOrPlay(camera_list_index, Size(size.X, size.Y), camera_source->getFps());
 
 	// If not currently reading from file
 	if (!records->isPlaying(camera_list_index))
 	{
-		capture = new VideoCapture(camera_source->getIndex());
+		capture = capture_pool->openDevice(camera_source);
 
-		if (!capture->isOpened())
+		if (capture == nullptr)
 			return(false);
 
-		if (camera_source->getFocusValue() != -1)
-		{
-			capture->set(CAP_PROP_AUTOFOCUS, 0);
-			capture->set(CAP_PROP_FOCUS, camera_source->getFocusValue());
-		}
-		else
-			capture->set(CAP_PROP_AUTOFOCUS, 1);
+		device_lock = capture_pool->getDeviceLock(camera_source->getIndex());
 	}
 	else
 		addInfoLine("Reading data for " + camera_source->getName() + " from file.");
 
-
-	frame_task_mode = 1;
-	// Set the first iteration to start with computing the background reference
-	computeBackgroundReference();
-
-
-	// Start the actual thread
-	processing_thread = thread(launchFrameLoop, this);
-
 	return(true);
 }
 
@@ -112,281 +112,430 @@ void PerCamControler::referenceOtherCamera(PerCamControler * other_controler)
 	model_computer->referenceAnotherRayGenerator(other_controler->getRayGenerator(), false);
 }
 
-
 /*
-Launch the loop for this camera.
+Take the pairs of all cameras (has to happen before initializeProcessing()).
+The slices of the pairs are tasks of the FrameScheduler.
 */
-void PerCamControler::launchFrameLoop(PerCamControler * thisControler)
+void PerCamControler::takeCameraPairs(vector<CameraPairIntersector*> * camera_pairs)
 {
-	thisControler->frameLoop();
+	this->camera_pairs = camera_pairs;
 }
-void PerCamControler::frameLoop()
-{
-	cam_running = true;
 
-	timeBench bench(0);
-	valueBench averageSegments;
-	valueBench averageComputingTime;
+/*
+Take the voxel carver of the sphere (has to happen before initializeProcessing()).
+Its slices are tasks of the FrameScheduler; this camera only prepares its mask for it and gathers its part of the quads.
+*/
+void PerCamControler::takeVoxelCarver(VoxelCarver * voxel_carver)
+{
+	this->voxel_carver = voxel_carver;
+}
 
-	int preview_mode = Settings::getPreviewType();
+/*
+Take the polyhedral hull of the sphere. This camera hands it its contour chains and cuts the faces of its own cones in its content task.
+*/
+void PerCamControler::takePolyhedralHull(PolyhedralHull * polyhedral_hull)
+{
+	this->polyhedral_hull = polyhedral_hull;
+}
 
-	while (cam_running) // Loops
-	{
-		/*
-		if (!running.load()) // Use busy-waiting when whole VSphere system is paused because processing power is notsignificant then
-		{
-			ReleaseSemaphore(workerSem, 1, NULL); // Send signal to launchSphereLoop
-			continue;
-		};
-		*/
 
-		while(!compute_frame)
-			WaitForSingleObject(controlSem, Settings::getThreadTimeoutMS()); // Wait for signal from the "sphereLoop" in the SphereControler
-		compute_frame = false;
+/*
+Compute the first background reference and prepare the processing objects (a task of the FrameScheduler).
+Grabs the required frames directly from the camera; later references are built while running (see handleBackgroundRecomputation).
+*/
+void PerCamControler::initializeProcessing()
+{
+	// The configuration may have changed since the constructor (before the sphere was attached, see Settings::attachSphere)
+	applyConfiguration(Settings::acquireConfiguration(configuration_user));
 
-		has_computed = false;
+	if ((capture == nullptr) && !records->isPlaying(camera_list_index))
+		return; // The camera could not be opened (see initialize())
 
+	addInfoLine("Computing background reference for camera: " + camera_source->getName());
 
+	getFrame(); // Retrieve the frame from the camera or record
 
+	// All buffers, grids and the texture region are sized from the negotiated mode
+	if ((current_frame.cols != camera_source->getSize().X) || (current_frame.rows != camera_source->getSize().Y))
+	{
+		addError(camera_source->getName() + " delivers " + to_string(current_frame.cols) + "x" + to_string(current_frame.rows) + " pixels instead of the negotiated "
+			+ to_string(camera_source->getSize().X) + "x" + to_string(camera_source->getSize().Y) + ". The camera is not used.");
+		return;
+	}
 
-		preview_mode = Settings::getPreviewType();
+	if (!records->isPlaying(camera_list_index)) // If not reading from a record
+	{
+		int frameNum = Settings::getBackgroundReferenceComputingFrames();
 
+		background_reference->startNewBackground(&current_frame, frameNum);
 
-		switch (frame_task_mode)
+		for (int i = 0; i < frameNum; i++)
 		{
-		case 0: break; // Nothing
-		case 1: // Processing the frame by computing the segments
-			{
-				if (!initialized) break;
-
-				getFrame(); // Retrieve the frame from the camera or record
-
-
-				bench.startTime();
-
-
-				// Compute the binary mask
-				background_reference->computeRGBbinaryMask();
-				// Compute the contours
-				contours_extractor->computeContour();
-				// Compute the edges
-				edges_identifier->computeEdges(/*preview_mode!=7*/ false, &averageSegments);
-
-				//computation_lock->lock();
-				// Generate the rays
-				ray_generator->generateRays();
-				//computation_lock->unlock();
-
-
-				// Update the global texture
-				if (texture_enabled)
-					updateModelTextureRegion();
+			device_lock->lock(); // Other channels of the device may grab at the same time on other workers
+			capture->grab(); // Grab for every channel here (coordinating the grabbing like for the frames
+							 // would overcomplicate things and timing is not relevant in this case
+			capture->retrieve(current_frame, camera_source->getChannel());
+			device_lock->unlock();
+
+			// Add the frame to the background reference
+			background_reference->addFrame();
+		}
 
-				/*
-				// Some settings receivable from the camera
+		// Finalize the new background reference
+		background_reference->finalizeBackground();
 
-				//CAP_PROP_AUTO_EXPOSURE CAP_PROP_EXPOSURE CAP_PROP_BRIGHTNESS
-				cout << "Backlight: " << capture->get(CAP_PROP_BACKLIGHT) << endl;
-				cout << "Aperture: " << capture->get(CAP_PROP_APERTURE) << endl;
-				cout << "Gain: " << capture->get(CAP_PROP_GAIN) << endl;
-				cout << "Settings: " << capture->get(CAP_PROP_SETTINGS) << endl;
-				cout << "White bal U: " << capture->get(CAP_PROP_WHITE_BALANCE_BLUE_U) << endl;
-				cout << "White bal V: " << capture->get(CAP_PROP_WHITE_BALANCE_RED_V) << endl;
-				*/
+		addInfoLine("Computed background reference for camera: " + camera_source->getName());
+	}
+	else // If reading from a record
+	{
+		// A background reference is required neevrtheless but it wont be made from new frames
+		background_reference->startNewBackground(&current_frame, -1);
+	}
 
-				bench.pauseTime();
+	// If reading (playing) from a record, the background reference will be set here from the file. If currently creating a new record, the file will be saved.
+	records->handleBackgroundImage(camera_list_index, background_reference->getBackground());
+	if (records->isPlaying(camera_list_index))
+		background_reference->finalizeBackground(); // Start the model from the loaded image
+
+
+
+	// Reinitialize the contorus extractor
+	contours_extractor->initData(&current_frame, background_reference->getBackground(), background_reference->getBinaryMask(), background_reference->getCoarseMask());
+	region_of_interest->initData(current_frame.cols, current_frame.rows, configuration->contour_mask_size);
+	// Reinitialize the edges identifier
+	edges_identifier->initData(current_frame.cols, current_frame.rows, contours_extractor->getContourGrid(), contours_extractor->getInoutGrid());
+	// Reinitialize the ray generator
+	ray_generator->initData(edges_identifier->getEdgesStarts(), edges_identifier->getEdgesEnds(), edges_identifier->getEdgesOrientations(), getTexOffsetX(), getTexOffsetY());
+	// Reinitialize the model computer
+	model_computer->referenceAnotherRayGenerator(ray_generator, true);
+
+	// Take the intersections of the pairs of cameras this one is part of
+	bool first_camera;
+	if (camera_pairs != nullptr)
+		for (int p = 0; p < camera_pairs->size(); ++p)
+			if ((*camera_pairs)[p]->involves(ray_generator, &first_camera))
+				model_computer->referencePairIntersector((*camera_pairs)[p]);
+	
 
-				// Handle the preview image
-				handlePreview(preview_mode);
-			}
-			break;
-		case 2: // Re-initialize by computing a new background reference
-			{
-				getFrame(); // Retrieve the frame from the camera or record
+	preview_image = background_reference->getBackground()->clone();
 
-				if (!records->isPlaying(camera_list_index)) // If not reading from a record
-				{
-					int frameNum = Settings::getBackgroundReferenceComputingFrames();
 
-					background_reference->startNewBackground(&current_frame, frameNum);
+	bench.resetTime();
 
-					for (int i = 0; i < frameNum; i++)
-					{
-						capture->grab(); // Grab for every channel here (coordinating threads like in the "frameLoop"
-										 // would overcomplicate things and timing is not relevant in this case
-						capture->retrieve(current_frame, camera_source->getChannel());
+	initialized = true;
+}
 
-						// Add the frame to the background reference
-						background_reference->addFrame();
-					}
 
-					// Finalize the new background reference
-					background_reference->finalizeBackground();
+/*
+Process the current frame by computing the segments and generating the rays (a task of the FrameScheduler).
+*/
+void PerCamControler::processFrame()
+{
+	if (!initialized) return;
 
-					addInfoLine("Computed background reference for camera: " + camera_source->getName());
-				}
-				else // If reading from a record
-				{
-					// A background reference is required neevrtheless but it wont be made from new frames
-					background_reference->startNewBackground(&current_frame, -1);
-				}
+	int preview_mode = Settings::getPreviewType();
 
-				// If reading (playing) from a record, the background reference will be set here from the file. If currently creating a new record, the file will be saved.
-				records->handleBackgroundImage(camera_list_index, background_reference->getBackground());
-				background_reference->finalizeBackground();
+	// A new configuration is only published before this task (see SphereControler) so all cameras switch in the same frame
+	if (Settings::getConfiguration()->generation != configuration->generation)
+		applyConfiguration(Settings::acquireConfiguration(configuration_user));
+
+	frame_lock.lock(); // The frame and the background are only read by takeSnapshot() while this is locked
+	high_resolution_clock::time_point capture_start = high_resolution_clock::now();
+	AllocationTracker::setStage(ALLOCATION_CAPTURE);
+	getFrame(); // Take the frame retrieved by the capture pool or read it from the record
+	if (capture == nullptr)
+		latencies[LATENCY_CAPTURE].recordSince(capture_start);
+	AllocationTracker::setStage(ALLOCATION_SEGMENTATION);
+
+
+	bench.startTime();
+	high_resolution_clock::time_point frame_start = high_resolution_clock::now();
+
+	// Frame boundary: Swap in a completed background reference or start building a new one
+	handleBackgroundRecomputation();
+
+	// Restrict the segmentation to a window around the object of the previous frame (the whole frame without roi_tracking)
+	region_of_interest->planFrame();
+	// Compute the binary mask
+	background_reference->computeRGBbinaryMask(region_of_interest->getPixelWindow());
+	// Collect the frame for a background reference in progress
+	background_reference->addShadowFrame();
+	frame_lock.unlock();
+	// Compute the contours
+	contours_extractor->computeContour(region_of_interest->getCellWindow());
+	region_of_interest->takeContours(contours_extractor->getContourGrid());
+	// Compute the edges
+	edges_identifier->computeEdges(configuration->merge_edges, &averageSegments, region_of_interest->getCellWindow());
+	high_resolution_clock::time_point stage_end = latencies[LATENCY_SEGMENTATION].recordSince(frame_start);
+	frame_timing.segmented = stage_end;
+	AllocationTracker::setStage(ALLOCATION_RAYS);
+
+	bool carving = (configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_VOXELS) && (voxel_carver != nullptr);
+	bool cutting = (configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_POLYHEDRAL) && (polyhedral_hull != nullptr);
+
+	if (carving) // The octree is carved from the masks, no rays are required
+		voxel_carver->prepareCamera(camera_list_index, background_reference->getBinaryMask(), region_of_interest->getPixelWindow());
+	else if (cutting) // The cones are cut from the contour chains
+		polyhedral_hull->prepareCamera(camera_list_index, edges_identifier->getEdgesStarts(), edges_identifier->getEdgesEnds(), edges_identifier->getEdgesOrientations(),
+			background_reference->getBinaryMask(), region_of_interest->getPixelWindow());
+	else
+	{
+		//computation_lock->lock();
+		// Generate the rays
+		ray_generator->generateRays(configuration->merge_edges);
+		//computation_lock->unlock();
+
+		// The pairs in which this is the second camera search in its rays
+		bool first_camera;
+		if (camera_pairs != nullptr)
+			for (int p = 0; p < camera_pairs->size(); ++p)
+				if ((*camera_pairs)[p]->involves(ray_generator, &first_camera) && !first_camera)
+					(*camera_pairs)[p]->prepareSweep();
+	}
 
+	frame_timing.rays = latencies[LATENCY_RAYS].recordSince(stage_end);
 
+	// Update the global texture
+	if (texture_enabled)
+		updateModelTextureRegion();
 
-				// Reinitialize the contorus extractor
-				contours_extractor->initData(&current_frame, background_reference->getBackground(), background_reference->getBinaryMask());
-				// Reinitialize the edges identifier
-				edges_identifier->initData(current_frame.cols, current_frame.rows, contours_extractor->getContourGrid(), contours_extractor->getInoutGrid());
-				// Reinitialize the ray generator
-				ray_generator->initData(edges_identifier->getEdgesStarts(), edges_identifier->getEdgesEnds(), edges_identifier->getEdgesOrientations(), getTexOffsetX(), getTexOffsetY());
-				// Reinitialize the model computer
-				model_computer->referenceAnotherRayGenerator(ray_generator, true);
-				
+	/*
+	// Some settings receivable from the camera
+
+	//CAP_PROP_AUTO_EXPOSURE CAP_PROP_EXPOSURE CAP_PROP_BRIGHTNESS
+	cout << "Backlight: " << capture->get(CAP_PROP_BACKLIGHT) << endl;
+	cout << "Aperture: " << capture->get(CAP_PROP_APERTURE) << endl;
+	cout << "Gain: " << capture->get(CAP_PROP_GAIN) << endl;
+	cout << "Settings: " << capture->get(CAP_PROP_SETTINGS) << endl;
+	cout << "White bal U: " << capture->get(CAP_PROP_WHITE_BALANCE_BLUE_U) << endl;
+	cout << "White bal V: " << capture->get(CAP_PROP_WHITE_BALANCE_RED_V) << endl;
+	*/
 
-				preview_image = background_reference->getBackground()->clone();
+	bench.pauseTime();
+	frame_process_ms = duration_cast<microseconds>(high_resolution_clock::now() - frame_start).count() / 1000.0f;
+
+	statistics_lock.lock();
+	statistics.segments = edges_identifier->getEdgesStarts()->size();
+	statistics.rays = (carving || cutting) ? 0 : ray_generator->getRays()->size();
+	statistics.roi_pixel_share = region_of_interest->getPixelShare();
+	statistics.roi_hits = region_of_interest->getHits();
+	statistics.roi_misses = region_of_interest->getMisses();
+	statistics.fine_pixel_share = background_reference->getFinePixelShare();
+	statistics_lock.unlock();
+
+	// Handle the preview image
+	AllocationTracker::setStage(ALLOCATION_PREVIEW);
+	handlePreview(preview_mode);
+	AllocationTracker::setStage(ALLOCATION_OTHER);
+}
 
 
-				bench.resetTime();
+/*
+Compute the collissions of the rays as well as the content of the sphere (the quads) of the processed frame (a task of the FrameScheduler).
+When the pairs of cameras are shared, their intersections have been computed by the preceding tasks of the frame.
+*/
+void PerCamControler::computeContent()
+{
+	if (!initialized) return;
 
-				frame_task_mode = next_frame_task_mode;
+	bench.startTime();
+	high_resolution_clock::time_point content_start = high_resolution_clock::now();
+
+	//computation_lock->lock();
+
+	// With the voxel carving the octree has been carved and its faces extracted by the preceding tasks of the frame
+	bool carving = (configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_VOXELS) && (voxel_carver != nullptr);
+	bool cutting = (configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_POLYHEDRAL) && (polyhedral_hull != nullptr);
+
+	// Compute the intersections of rays (or cut the cones of this camera, the contours of all cameras are ready)
+	AllocationTracker::setStage(ALLOCATION_INTERSECTION);
+	if (cutting)
+		polyhedral_hull->cutCamera(camera_list_index);
+	else if (!carving)
+		model_computer->intersectRays();
+	high_resolution_clock::time_point stage_end = latencies[LATENCY_INTERSECTION].recordSince(content_start);
+	frame_timing.intersected = stage_end;
+	AllocationTracker::setStage(ALLOCATION_QUADS);
+
+	if (carving)
+		voxel_carver->collectModelPart(camera_list_index, output_content);
+	else if (cutting)
+		polyhedral_hull->collectModelPart(camera_list_index, output_content);
+	else if (show_rays)  // ((time(0) % 2) == 1)
+		ray_generator->visualizeRays(output_content, configuration->max_ray_length);
+	else
+		model_computer->computeModelPart(output_content);
 
-				initialized = true;
-			}
-			break;
+	// The coarser levels are made of the same quads (see ModelDetailLevels)
+	detail_levels->computeLevels(output_content, configuration->detail_levels);
+	frame_timing.quads = latencies[LATENCY_QUADS].recordSince(stage_end);
+	AllocationTracker::setStage(ALLOCATION_OTHER);
 
-		case 3: // Process the content of the frame based on the current segments
-			{
-				bench.startTime();
+	//computation_lock->unlock();
 
-				//computation_lock->lock();
 
-				// Compute the intersections of rays
-				model_computer->intersectRays();
+	// Finalize bench
+	bench.endTime();
 
-				if (show_rays)  // ((time(0) % 2) == 1)
-					ray_generator->visualizeRays(output_content, 640);
-				else
-					model_computer->computeModelPart(output_content);
+	statistics_lock.lock();
+	statistics.intersections = (carving || cutting) ? 0 : model_computer->getIntersectionCount();
+	statistics.quads = output_content->size() / 20;
+	statistics.computation_ms = frame_process_ms + duration_cast<microseconds>(high_resolution_clock::now() - content_start).count() / 1000.0f;
+	latencies[LATENCY_CAMERA_FRAME].record(statistics.computation_ms * 1000);
+	statistics_lock.unlock();
 
-				//computation_lock->unlock();
 
+	//// Display some debug bench values
+		if (bench.getAverage() != 0)
+			averageComputingTime.addValue(bench.getAverage());
 
-				// Finalize bench
-				bench.endTime();
+		statistics_lock.lock();
+		statistics.average_computation_ms = averageComputingTime.getAverage();
+		statistics_lock.unlock();
+		bench.printAverage(1, ("Calculation for camera " + camera_source->getName() + " took %f milliseconds.\n").c_str());
 
+		if (records->justLooped(camera_list_index))
+		{
+			averageSegments.printAverageFull(-1, "Average segments detected in camera " + camera_source->getName() + ": %f");
+			averageSegments.resetValue();
 
-				// Delay frame if required (only used when reading a record from file)
-				if (records != nullptr)
-					records->delayFrame(camera_list_index);
+			averageComputingTime.printAverageFull(-1, "Average computation time for camera " + camera_source->getName() + ": %f");
+			averageComputingTime.resetValue();
 
+			// The records start over in sync, so the drift is measured from there
+			statistics_lock.lock();
+			sync_started = false;
+			statistics_lock.unlock();
+		}
+	////
+}
 
-				//// Display some debug bench values
-					if (bench.getAverage() != 0)
-						averageComputingTime.addValue(bench.getAverage());
-					bench.printAverage(1, ("Calculation for camera " + camera_source->getName() + " took %f milliseconds.\n").c_str());
 
-					if (records->justLooped(camera_list_index))
-					{
-						averageSegments.printAverageFull(-1, "Average segments detected in camera " + camera_source->getName() + ": %f");
-						averageSegments.resetValue();
+/*
+Hand a newly published configuration (taken by acquireConfiguration) to all processing objects.
+If the cell size of the contour grid has changed after the initialization, the buffers depending on it are planned again (the frame size stays the same).
+*/
+void PerCamControler::applyConfiguration(PipelineConfiguration * newest)
+{
+	configuration = newest;
 
-						averageComputingTime.printAverageFull(-1, "Average computation time for camera " + camera_source->getName() + ": %f");
-						averageComputingTime.resetValue();
-					}
-				////
+	background_reference->applyConfiguration(configuration);
+	region_of_interest->applyConfiguration(configuration);
+	edges_identifier->applyConfiguration(configuration);
+	model_computer->applyConfiguration(configuration);
 
-			}
-			break;
-		}
-		frame_task_mode = next_frame_task_mode;
+	// Every pair is configured by its first camera
+	bool first_camera;
+	if (camera_pairs != nullptr)
+		for (int p = 0; p < camera_pairs->size(); ++p)
+			if ((*camera_pairs)[p]->involves(ray_generator, &first_camera) && first_camera)
+				(*camera_pairs)[p]->applyConfiguration(configuration);
 
+	if (contours_extractor->applyConfiguration(configuration) && initialized)
+	{
+		contours_extractor->initData(&current_frame, background_reference->getBackground(), background_reference->getBinaryMask(), background_reference->getCoarseMask());
+		region_of_interest->initData(current_frame.cols, current_frame.rows, configuration->contour_mask_size);
+		edges_identifier->initData(current_frame.cols, current_frame.rows, contours_extractor->getContourGrid(), contours_extractor->getInoutGrid());
 
-		has_computed = true;
-		ReleaseSemaphore(workerSem, 1, NULL); // Send signal to the sphereLoop (SphereControler) to continue
+		addInfoLine("Re-planned contour grid of " + camera_source->getName() + " for cell size " + to_string(configuration->contour_mask_size) + ".");
 	}
-
-	addInfoLine("Quitting thread for: " + camera_source->getName());
 }
 
 
 /*
-For cameras with subChannel. Execute before calling readFrame() in different threads
+Take the moment the device of this camera has been grabbed (or the grabbers have been released for a camera played from a record).
 */
-void PerCamControler::grabFrame()
+void PerCamControler::setGrabTime(high_resolution_clock::time_point grab_time)
 {
-	if (camera_source->getIsGrabberChannel())
-		if (capture != nullptr)
-			capture->grab();
+	this->grab_time = grab_time;
 }
 
 /*
-Handle the current frame image
+Retrieve the channel of this camera from the last grab of its device (on the thread which grabbed it, see CapturePool).
+The frame is decoded directly into the current frame, which keeps its buffer from frame to frame.
 */
-void PerCamControler::getFrame()
+void PerCamControler::retrieveFrame()
 {
-	if (capture != nullptr)
-		capture->retrieve(current_frame, camera_source->getChannel()); // get from camera
-
-	if (records != nullptr)
-		records->handleFrame(camera_list_index, &current_frame); // Either get from video record instead or save the frame fromt he camera into a new video
-}
+	if (capture == nullptr)
+		return;
 
+	lock_guard<mutex> guard(frame_lock);
 
+	high_resolution_clock::time_point capture_start = high_resolution_clock::now();
+	capture->retrieve(current_frame, camera_source->getChannel());
+	latencies[LATENCY_CAPTURE].recordSince(capture_start);
+}
 
 /*
-Continue (or initially start) the frame loop by setting the semaphore.
+Whether the camera grabs from a device (false if it is played from a record or its device could not be opened).
 */
-void PerCamControler::processNextFrame()
+bool PerCamControler::isLive()
 {
-	ReleaseSemaphore(controlSem, 1, NULL);
-	compute_frame = true;
+	return(capture != nullptr);
 }
 
-
 /*
-In the next iteration of the loop: Get frames and compute the background reference
+Handle the current frame image
 */
-void PerCamControler::computeBackgroundReference()
+void PerCamControler::getFrame()
 {
-	addInfoLine("Computing background reference for camera: " + camera_source->getName());
+	// The frame was taken by the last grab (a frame retrieved without any grab before is taken now)
+	frame_timing.captured = (grab_time.time_since_epoch().count() != 0) ? grab_time : high_resolution_clock::now();
 
-	int cur = frame_task_mode;
-	frame_task_mode = 2;
-	next_frame_task_mode = cur;
-}
+	// A frame of a device has already been retrieved by the capture pool
 
-/*
-In the next iteration of the loop: Process the most actual frame and compute the edges and generate the rays
-*/
-void PerCamControler::computeFrameProcess()
-{
-	frame_task_mode = 1;
-	next_frame_task_mode = 1;
+	if (records != nullptr)
+	{
+		records->handleFrame(camera_list_index, &current_frame, frame_timing.captured); // Either get from video record instead or save the frame fromt he camera into a new video
+
+		// A played frame lies as far from the play position as it was recorded
+		if (records->isPlaying(camera_list_index))
+			frame_timing.media_us = records->getMediaClock()->getPlayPosition() + records->getFrameOffset(camera_list_index);
+		else
+			frame_timing.media_us = records->getMediaClock()->toMediaTime(frame_timing.captured);
+	}
 }
 
+
+
 /*
-In the next iteration of the loop: Use the currently processed frame and compute the collissions of rays as well as the content of the sphere (the quads)
+Compute the background reference.
+The first one is computed by initializeProcessing() from grabbed frames.
+Afterwards the new reference is built from the next processed frames without interrupting the processing.
 */
-void PerCamControler::computeSphereContent()
+void PerCamControler::computeBackgroundReference()
 {
-	frame_task_mode = 3;
-	next_frame_task_mode = 3;
+	if (initialized)
+		background_recompute_requested = true;
 }
 
 /*
-Quit the processing loop of this camera.
+Called at the start of processing a frame.
 */
-void PerCamControler::quit()
+void PerCamControler::handleBackgroundRecomputation()
 {
-	cam_running = false;
-	frame_task_mode = -1;
-	next_frame_task_mode = -1;
-}
+	if (background_reference->isShadowBackgroundReady())
+	{
+		background_reference->swapShadowBackground();
 
+		// If currently creating a new record, the new reference is saved
+		if (!records->isPlaying(camera_list_index))
+			records->handleBackgroundImage(camera_list_index, background_reference->getBackground());
+
+		addInfoLine("Computed background reference for camera: " + camera_source->getName());
+	}
+
+	if (background_recompute_requested.exchange(false))
+	{
+		if (records->isPlaying(camera_list_index)) // The reference of a record comes from its file
+			addInfoLine("Background reference of " + camera_source->getName() + " is read from the record.");
+		else
+		{
+			background_reference->startShadowBackground(Settings::getBackgroundReferenceComputingFrames());
+			addInfoLine("Computing background reference for camera: " + camera_source->getName() + " from the next " + to_string(Settings::getBackgroundReferenceComputingFrames()) + " frames.");
+		}
+	}
+}
 
 /*
 Take and save the texture pointer from the render engine
@@ -508,19 +657,25 @@ vector<int> * PerCamControler::getSphereContent()
 	return(output_content);
 }
 
-HANDLE PerCamControler::getSem()
+ModelDetailLevels * PerCamControler::getDetailLevels()
 {
-	return(workerSem);
+	return(detail_levels);
 }
 
-thread* PerCamControler::getLoopThread()
+Mat PerCamControler::getCurrentFrame()
 {
-	return(&processing_thread);
+	return(current_frame);
 }
 
-Mat PerCamControler::getCurrentFrame()
+/*
+Copy the current frame and the background image (for the PipelineBenchmark). Can be called from any thread.
+*/
+void PerCamControler::takeSnapshot(Mat * frame, Mat * background)
 {
-	return(current_frame);
+	frame_lock.lock();
+	current_frame.copyTo(*frame);
+	background_reference->getBackground()->copyTo(*background);
+	frame_lock.unlock();
 }
 
 Mat PerCamControler::getPreviewImage()
@@ -543,11 +698,58 @@ void PerCamControler::setShowFullRays(bool show_rays)
 	this->show_rays = show_rays;
 }
 
-bool PerCamControler::hasComputed()
+/*
+Whether the first background reference exists and frames are processed.
+*/
+bool PerCamControler::isInitialized()
+{
+	return(initialized);
+}
+
+/*
+Copy the numbers of the last frame (safe to call from any thread).
+*/
+void PerCamControler::getStatistics(CameraStatistics * target)
+{
+	statistics_lock.lock();
+	*target = statistics;
+	statistics_lock.unlock();
+}
+
+/*
+The durations of a stage of this camera (see VSphereLatencyStage; can be read from any thread).
+*/
+latencyHistogram * PerCamControler::getLatencyHistogram(int stage)
+{
+	return(&latencies[stage]);
+}
+
+/*
+The timing of the last processed frame (read between frames).
+*/
+FrameTiming PerCamControler::getFrameTiming()
 {
-	return(has_computed);
+	return(frame_timing);
 }
 
+/*
+How much later the last frame was captured than the earliest frame of all cameras of the same model (see SphereControler::computeModelTiming).
+The drift is the change since the first frame, or since the last loop of a record.
+*/
+void PerCamControler::recordSyncOffset(float offset_ms)
+{
+	statistics_lock.lock();
+	if (!sync_started)
+	{
+		first_sync_offset_ms = offset_ms;
+		sync_started = true;
+	}
+	statistics.sync_offset_ms = offset_ms;
+	statistics.sync_drift_ms = offset_ms - first_sync_offset_ms;
+	statistics_lock.unlock();
+}
+
+
 CameraSource * PerCamControler::getCameraSource()
 {
 	return(camera_source);
@@ -0,0 +1,506 @@
+/*
+Compares the variants of the processing pipeline on identical input.
+
+Input:
+	A snapshot of every camera (frame, background image and texture offsets) taken from the running sphere (see SphereControler::fillBenchmark())
+	or rendered by a SyntheticScene, which also provides the ground truth to rate the model of every variant.
+
+Output:
+	One BenchmarkResult per variant (see VSphereBenchmarkVariant in PluginDataTypes.h) with the numbers of rays, intersections and quads
+	and the average time per frame of every phase.
+
+For every variant a separate set of processing objects is built from a copy of the active configuration and
+runs on the calling thread. The cameras are processed one after another, so the times are the sum over all cameras
+(the running sphere distributes the same work over its worker threads).
+With the voxel carving the intersection time is the carving of the octree and the quad time the extraction of its faces.
+The background model starts from the 8 bit background image without variance and does not adapt, so every iteration sees exactly the same input.
+In builds with TRACK_ALLOCATIONS every iteration after the first two has to run without any heap allocation (see AllocationTracker).
+*/
+
+#include "stdafx.h"
+
+#include "PipelineBenchmark.h"
+#include "SyntheticScene.h"
+#include "AllocationTracker.h"
+#include "ModelRecord.h"
+
+
+// Iterations which may allocate (the ModelBuilder alternates between two sets of intersection buffers)
+#define ALLOCATION_WARMUP_ITERATIONS 2
+
+// Block size of the coarse level in BENCHMARK_PYRAMID_SEGMENTATION
+#define BENCHMARK_PYRAMID_BLOCK_SIZE 4
+
+
+PipelineBenchmark::PipelineBenchmark()
+{
+}
+
+PipelineBenchmark::~PipelineBenchmark()
+{
+	releasePipeline();
+
+	for (int i = 0; i < cameras.size(); ++i)
+		delete(cameras[i]);
+}
+
+
+/*
+Add the snapshot of a camera. The Mats are copied.
+*/
+void PipelineBenchmark::addCamera(CameraSource * camera_source, Mat frame, Mat background, int tex_offs_x, int tex_offs_y)
+{
+	BenchmarkCamera * camera = new BenchmarkCamera();
+
+	camera->camera_source = camera_source;
+	camera->frame = frame.clone();
+	camera->background = background.clone();
+	camera->tex_offs_x = tex_offs_x;
+	camera->tex_offs_y = tex_offs_y;
+
+	cameras.push_back(camera);
+}
+
+/*
+Rate the model of every variant against the ground truth of the scene the snapshots were rendered from.
+*/
+void PipelineBenchmark::setGroundTruth(SyntheticScene * scene)
+{
+	ground_truth = scene;
+}
+
+
+/*
+Create and connect the processing objects of all cameras like the PerCamControler does.
+*/
+void PipelineBenchmark::buildPipeline(PipelineConfiguration * configuration)
+{
+	releasePipeline();
+
+	for (int i = 0; i < cameras.size(); ++i)
+	{
+		BenchmarkCamera * camera = cameras[i];
+
+		camera->background_reference = new BackgroundReference();
+		camera->contours_extractor = new ContoursExtractor();
+		camera->region_of_interest = new RegionOfInterest();
+		camera->edges_identifier = new EdgesIdentifier();
+		camera->ray_generator = new RayGenerator(camera->camera_source);
+		camera->model_computer = new ModelBuilder();
+		camera->detail_levels = new ModelDetailLevels();
+
+		camera->background_reference->applyConfiguration(configuration);
+		camera->contours_extractor->applyConfiguration(configuration);
+		camera->region_of_interest->applyConfiguration(configuration);
+		camera->edges_identifier->applyConfiguration(configuration);
+		camera->model_computer->applyConfiguration(configuration);
+
+		// Start the model from the background image of the snapshot
+		camera->background_reference->startNewBackground(&camera->frame, -1);
+		camera->background.copyTo(*camera->background_reference->getBackground());
+		camera->background_reference->finalizeBackground();
+
+		camera->contours_extractor->initData(&camera->frame, camera->background_reference->getBackground(), camera->background_reference->getBinaryMask(), camera->background_reference->getCoarseMask());
+		camera->region_of_interest->initData(camera->frame.cols, camera->frame.rows, configuration->contour_mask_size);
+		camera->edges_identifier->initData(camera->frame.cols, camera->frame.rows, camera->contours_extractor->getContourGrid(), camera->contours_extractor->getInoutGrid());
+		camera->ray_generator->initData(camera->edges_identifier->getEdgesStarts(), camera->edges_identifier->getEdgesEnds(), camera->edges_identifier->getEdgesOrientations(), camera->tex_offs_x, camera->tex_offs_y);
+	}
+
+	// Reference the other cameras first and the own one last (see ModelBuilder::referenceAnotherRayGenerator)
+	for (int i = 0; i < cameras.size(); ++i)
+	{
+		for (int j = 0; j < cameras.size(); ++j)
+			if (j != i)
+				cameras[i]->model_computer->referenceAnotherRayGenerator(cameras[j]->ray_generator, false);
+
+		cameras[i]->model_computer->referenceAnotherRayGenerator(cameras[i]->ray_generator, true);
+	}
+
+	// One intersector per pair of cameras in a single slice (everything runs on the calling thread)
+	for (int i = 0; i < cameras.size(); ++i)
+		for (int j = i + 1; j < cameras.size(); ++j)
+		{
+			CameraPairIntersector * camera_pair = new CameraPairIntersector(cameras[i]->ray_generator, cameras[j]->ray_generator, 1);
+			camera_pair->applyConfiguration(configuration);
+
+			cameras[i]->model_computer->referencePairIntersector(camera_pair);
+			cameras[j]->model_computer->referencePairIntersector(camera_pair);
+
+			camera_pairs.push_back(camera_pair);
+		}
+
+	// One slice per camera, so every camera takes the quads of one slice (see VoxelCarver::collectModelPart)
+	if (configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_VOXELS)
+	{
+		voxel_carver = new VoxelCarver(cameras.size());
+
+		for (int i = 0; i < cameras.size(); ++i)
+			voxel_carver->addCamera(cameras[i]->camera_source, cameras[i]->tex_offs_x, cameras[i]->tex_offs_y);
+
+		voxel_carver->applyConfiguration(configuration);
+
+		if (configuration->surface_mesh)
+			mesh_extractor = new MeshExtractor(voxel_carver);
+	}
+
+	if (configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_POLYHEDRAL)
+	{
+		polyhedral_hull = new PolyhedralHull();
+
+		for (int i = 0; i < cameras.size(); ++i)
+			polyhedral_hull->addCamera(cameras[i]->camera_source, cameras[i]->tex_offs_x, cameras[i]->tex_offs_y);
+
+		polyhedral_hull->applyConfiguration(configuration);
+	}
+}
+
+void PipelineBenchmark::releasePipeline()
+{
+	for (int p = 0; p < camera_pairs.size(); ++p)
+		delete(camera_pairs[p]);
+	camera_pairs.clear();
+
+	delete(mesh_extractor);
+	mesh_extractor = nullptr;
+
+	delete(voxel_carver);
+	voxel_carver = nullptr;
+
+	delete(polyhedral_hull);
+	polyhedral_hull = nullptr;
+
+	for (int i = 0; i < cameras.size(); ++i)
+	{
+		BenchmarkCamera * camera = cameras[i];
+
+		if (camera->background_reference == nullptr)
+			continue;
+
+		delete(camera->detail_levels);
+		delete(camera->model_computer);
+		delete(camera->ray_generator);
+		delete(camera->edges_identifier);
+		delete(camera->region_of_interest);
+		delete(camera->contours_extractor);
+		delete(camera->background_reference);
+
+		camera->background_reference = nullptr;
+		camera->contours_extractor = nullptr;
+		camera->region_of_interest = nullptr;
+		camera->edges_identifier = nullptr;
+		camera->ray_generator = nullptr;
+		camera->model_computer = nullptr;
+		camera->detail_levels = nullptr;
+	}
+}
+
+
+/*
+Process the snapshot "iterations" times with the given variant.
+*/
+void PipelineBenchmark::runVariant(int variant, int iterations, BenchmarkResult * result)
+{
+	PipelineConfiguration * configuration = Settings::copyConfiguration();
+	configuration->background_adaptation_rate = 0;
+	configuration->merge_edges = (variant != BENCHMARK_UNMERGED_EDGES) && (variant != BENCHMARK_UNMERGED_EDGES_SWEEP);
+	configuration->intersection_engine = (variant >= BENCHMARK_UNMERGED_EDGES_SWEEP) ? INTERSECTION_ENGINE_SWEEP : INTERSECTION_ENGINE_ALL_PAIRS;
+	configuration->batched_narrow_phase = (variant != BENCHMARK_MERGED_EDGES_SWEEP_SINGLE_PAIRS);
+	configuration->shared_pair_intersection = (variant >= BENCHMARK_MERGED_EDGES_SWEEP_SHARED_PAIRS);
+	configuration->roi_tracking = (variant == BENCHMARK_ROI_TRACKING);
+	configuration->pyramid_block_size = (variant == BENCHMARK_PYRAMID_SEGMENTATION) ? BENCHMARK_PYRAMID_BLOCK_SIZE : 1;
+	configuration->reconstruction_engine = (variant == BENCHMARK_VOXEL_CARVING) ? RECONSTRUCTION_ENGINE_VOXELS : ((variant == BENCHMARK_POLYHEDRAL_HULL) ? RECONSTRUCTION_ENGINE_POLYHEDRAL : RECONSTRUCTION_ENGINE_RAYS);
+	configuration->surface_mesh = (variant == BENCHMARK_VOXEL_CARVING);
+
+	buildPipeline(configuration);
+
+	valueBench segments_bench;
+	double segmentation_us = 0, intersection_us = 0, quad_us = 0, mesh_us = 0, detail_us = 0;
+	double pixel_share_sum = 0, fine_share_sum = 0;
+	long long warm_allocations = 0;
+
+	for (int it = 0; it < iterations; ++it)
+	{
+		// The first iterations size all buffers, the following ones have to reuse them
+		if (it == ALLOCATION_WARMUP_ITERATIONS)
+			warm_allocations = AllocationTracker::getThreadAllocations();
+
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+
+		for (int i = 0; i < cameras.size(); ++i)
+		{
+			RegionOfInterest * region = cameras[i]->region_of_interest;
+
+			region->planFrame();
+			cameras[i]->background_reference->computeRGBbinaryMask(region->getPixelWindow());
+			cameras[i]->contours_extractor->computeContour(region->getCellWindow());
+			region->takeContours(cameras[i]->contours_extractor->getContourGrid());
+			cameras[i]->edges_identifier->computeEdges(configuration->merge_edges, &segments_bench, region->getCellWindow());
+
+			// The carving only needs the masks, the polyhedral hull the contour chains
+			if (voxel_carver != nullptr)
+				voxel_carver->prepareCamera(i, cameras[i]->background_reference->getBinaryMask(), region->getPixelWindow());
+			else if (polyhedral_hull != nullptr)
+				polyhedral_hull->prepareCamera(i, cameras[i]->edges_identifier->getEdgesStarts(), cameras[i]->edges_identifier->getEdgesEnds(), cameras[i]->edges_identifier->getEdgesOrientations(),
+					cameras[i]->background_reference->getBinaryMask(), region->getPixelWindow());
+			else
+				cameras[i]->ray_generator->generateRays(configuration->merge_edges);
+
+			pixel_share_sum += region->getPixelShare();
+			fine_share_sum += cameras[i]->background_reference->getFinePixelShare();
+		}
+
+		for (int p = 0; p < camera_pairs.size(); ++p)
+			camera_pairs[p]->prepareSweep();
+
+		high_resolution_clock::time_point segmented = high_resolution_clock::now();
+
+		if (configuration->shared_pair_intersection)
+			CameraPairIntersector::intersectTasks(&camera_pairs, 0, 1);
+
+		if (voxel_carver != nullptr)
+			for (int s = 0; s < voxel_carver->getSliceCount(); ++s)
+				voxel_carver->carveSlice(s);
+		else if (polyhedral_hull != nullptr)
+			for (int i = 0; i < cameras.size(); ++i)
+				polyhedral_hull->cutCamera(i);
+		else
+			for (int i = 0; i < cameras.size(); ++i)
+				cameras[i]->model_computer->intersectRays();
+
+		high_resolution_clock::time_point intersected = high_resolution_clock::now();
+
+		if (voxel_carver != nullptr)
+		{
+			for (int s = 0; s < voxel_carver->getSliceCount(); ++s)
+				voxel_carver->extractSlice(s);
+
+			for (int i = 0; i < cameras.size(); ++i)
+				voxel_carver->collectModelPart(i, &cameras[i]->output_content);
+		}
+		else if (polyhedral_hull != nullptr)
+			for (int i = 0; i < cameras.size(); ++i)
+				polyhedral_hull->collectModelPart(i, &cameras[i]->output_content);
+		else
+			for (int i = 0; i < cameras.size(); ++i)
+				cameras[i]->model_computer->computeModelPart(&cameras[i]->output_content);
+
+		high_resolution_clock::time_point finished = high_resolution_clock::now();
+
+		if (mesh_extractor != nullptr)
+		{
+			for (int s = 0; s < voxel_carver->getSliceCount(); ++s)
+				mesh_extractor->buildBlock(s);
+
+			mesh_extractor->layoutMesh();
+
+			for (int s = 0; s < voxel_carver->getSliceCount(); ++s)
+				mesh_extractor->writeBlock(s);
+
+			mesh_us += duration_cast<microseconds>(high_resolution_clock::now() - finished).count();
+		}
+
+		if (configuration->detail_levels > 0)
+		{
+			high_resolution_clock::time_point detail_start = high_resolution_clock::now();
+
+			for (int i = 0; i < cameras.size(); ++i)
+				cameras[i]->detail_levels->computeLevels(&cameras[i]->output_content, configuration->detail_levels);
+
+			detail_us += duration_cast<microseconds>(high_resolution_clock::now() - detail_start).count();
+		}
+
+		segmentation_us += duration_cast<microseconds>(segmented - start).count();
+		intersection_us += duration_cast<microseconds>(intersected - segmented).count();
+		quad_us += duration_cast<microseconds>(finished - intersected).count();
+	}
+
+	long long steady_allocations = (iterations > ALLOCATION_WARMUP_ITERATIONS) ? AllocationTracker::getThreadAllocations() - warm_allocations : 0;
+
+	// The input does not change, so the numbers of the last iteration are those of every iteration
+	*result = {};
+	result->variant = variant;
+	result->output_hash = 2166136261u; // FNV-1a
+	for (int i = 0; i < cameras.size(); ++i)
+	{
+		result->rays += cameras[i]->ray_generator->getRays()->size();
+		result->intersections += cameras[i]->model_computer->getIntersectionCount();
+		result->quads += cameras[i]->output_content.size() / 20;
+		result->roi_hits += cameras[i]->region_of_interest->getHits();
+		result->roi_misses += cameras[i]->region_of_interest->getMisses();
+
+		for (int v = 0; v < cameras[i]->output_content.size(); ++v)
+			result->output_hash = (result->output_hash ^ (unsigned int)cameras[i]->output_content[v]) * 16777619u;
+	}
+
+	result->segmentation_ms = (float)(segmentation_us / iterations / 1000.0);
+	result->intersection_ms = (float)(intersection_us / iterations / 1000.0);
+	result->quad_ms = (float)(quad_us / iterations / 1000.0);
+	result->mesh_ms = (float)(mesh_us / iterations / 1000.0);
+	result->detail_ms = (float)(detail_us / iterations / 1000.0);
+	result->frame_ms = result->segmentation_ms + result->intersection_ms + result->quad_ms + result->mesh_ms + result->detail_ms;
+	result->roi_pixel_share = (float)(pixel_share_sum / iterations / cameras.size());
+	result->fine_pixel_share = (float)(fine_share_sum / iterations / cameras.size());
+
+	if (voxel_carver != nullptr)
+	{
+		result->octree_nodes = voxel_carver->getNodeCount();
+		result->octree_leaves = voxel_carver->getLeafCount();
+	}
+
+	if (mesh_extractor != nullptr)
+	{
+		result->mesh_vertices = mesh_extractor->getVertices()->size() / 5;
+		result->mesh_triangles = mesh_extractor->getIndices()->size() / 3;
+		result->mesh_open_edges = mesh_extractor->countOpenEdges();
+	}
+
+	if (polyhedral_hull != nullptr)
+		result->hull_crossings = polyhedral_hull->getCrossingCount();
+
+	if (configuration->detail_levels > 0)
+		for (int i = 0; i < cameras.size(); ++i)
+			result->detail_quads += cameras[i]->detail_levels->getLevel(configuration->detail_levels)->size() / 20;
+
+	result->model_precision = -1;
+	result->model_coverage = -1;
+	result->detail_precision = -1;
+	result->steady_allocations = AllocationTracker::isEnabled() ? (int)steady_allocations : -1;
+
+	if (ground_truth != nullptr)
+	{
+		vector<vector<int>*> models;
+		for (int i = 0; i < cameras.size(); ++i)
+			models.push_back(&cameras[i]->output_content);
+
+		ground_truth->evaluateModel(&models, &result->model_precision, &result->model_coverage);
+
+		// The coarsest level has to stay on the surface like the full model
+		if (configuration->detail_levels > 0)
+		{
+			float detail_coverage;
+			for (int i = 0; i < cameras.size(); ++i)
+				models[i] = cameras[i]->detail_levels->getLevel(configuration->detail_levels);
+
+			ground_truth->evaluateModel(&models, &result->detail_precision, &detail_coverage);
+		}
+	}
+
+	// The model record has to give back exactly the model
+	vector<int> model, played_model;
+	vector<unsigned char> packed;
+	for (int i = 0; i < cameras.size(); ++i)
+		model.insert(model.end(), cameras[i]->output_content.begin(), cameras[i]->output_content.end());
+
+	high_resolution_clock::time_point record_start = high_resolution_clock::now();
+	for (int n = 0; n < iterations; ++n)
+		ModelRecord::encodeModel(&model, &packed);
+	result->record_ms = (float)(duration_cast<microseconds>(high_resolution_clock::now() - record_start).count() / (double)iterations / 1000.0);
+
+	bool decoded = ModelRecord::decodeModel(packed.data(), packed.size(), model.size() / 20, &played_model);
+	result->record_bytes = (decoded && (played_model == model)) ? (int)packed.size() : -1;
+
+	// Differential test of the batched narrow phase on the rays of this variant
+	if (configuration->batched_narrow_phase)
+		for (int i = 0; i < cameras.size(); ++i)
+			result->narrow_phase_mismatches += cameras[i]->model_computer->checkNarrowPhase(NARROW_PHASE_TOLERANCE, &result->narrow_phase_pairs);
+
+	releasePipeline();
+	delete(configuration);
+}
+
+
+/*
+Run all variants and write one result per variant into the array (at most max_count).
+Returns the number of results written.
+*/
+int PipelineBenchmark::run(int iterations, BenchmarkResult * results, int max_count)
+{
+	if (cameras.size() < 2)
+	{
+		addError("The pipeline benchmark requires at least two cameras.");
+		return(0);
+	}
+
+	iterations = max(1, iterations);
+
+	const int variants[] = { BENCHMARK_UNMERGED_EDGES, BENCHMARK_MERGED_EDGES, BENCHMARK_UNMERGED_EDGES_SWEEP, BENCHMARK_MERGED_EDGES_SWEEP, BENCHMARK_MERGED_EDGES_SWEEP_SINGLE_PAIRS, BENCHMARK_MERGED_EDGES_SWEEP_SHARED_PAIRS, BENCHMARK_ROI_TRACKING,
+		BENCHMARK_PYRAMID_SEGMENTATION, BENCHMARK_VOXEL_CARVING, BENCHMARK_POLYHEDRAL_HULL };
+	int count = min(max_count, (int)(sizeof(variants) / sizeof(int)));
+
+	for (int i = 0; i < count; ++i)
+	{
+		runVariant(variants[i], iterations, &results[i]);
+
+		// The sweep engine has to produce exactly the model of the all-pairs engine
+		if ((i >= 2) && (i < 4) && (results[i].output_hash != results[i - 2].output_hash))
+			addError("Benchmark variant " + to_string(results[i].variant) + " produced a different model than variant " + to_string(results[i - 2].variant) + "!");
+
+		addInfoLine("Benchmark variant " + to_string(results[i].variant) + ": " + to_string(results[i].rays) + " rays, " + to_string(results[i].intersections) + " intersections, "
+			+ to_string(results[i].quads) + " quads, " + to_string(results[i].frame_ms) + " ms per frame (segmentation " + to_string(results[i].segmentation_ms)
+			+ " ms, intersection " + to_string(results[i].intersection_ms) + " ms, quads " + to_string(results[i].quad_ms) + " ms)");
+
+		if (ground_truth != nullptr)
+			addInfoLine("Benchmark variant " + to_string(results[i].variant) + ": " + to_string(results[i].model_precision * 100) + "% of the quads on the visual hull, "
+				+ to_string(results[i].model_coverage * 100) + "% of the visual hull covered");
+
+		// The view of the second camera of a pair is computed with different rounding, so single intersections at the limits can differ
+		if (results[i].variant == BENCHMARK_MERGED_EDGES_SWEEP_SHARED_PAIRS)
+			addInfoLine("Shared pairs found " + to_string(results[i].intersections) + " intersections, the cameras on their own " + to_string(results[3].intersections) + ".");
+
+		// The object does not move in a snapshot, so the window has to contain everything the whole frame contains
+		if (results[i].variant == BENCHMARK_ROI_TRACKING)
+		{
+			addInfoLine("Region of interest: " + to_string(results[i].roi_pixel_share * 100) + "% of the pixels segmented, " + to_string(results[i].roi_hits) + " hits, " + to_string(results[i].roi_misses)
+				+ " misses, segmentation " + to_string(results[5].segmentation_ms / max(0.001f, results[i].segmentation_ms)) + " times as fast as on the whole frame.");
+
+			if (results[i].output_hash != results[5].output_hash)
+				addError("Benchmark variant " + to_string(results[i].variant) + " produced a different model than variant " + to_string(results[5].variant) + "!");
+		}
+
+		// Details smaller than a block can be lost, so the model may differ from the one of the whole resolution
+		if (results[i].variant == BENCHMARK_PYRAMID_SEGMENTATION)
+			addInfoLine("Pyramid segmentation: " + to_string(results[i].fine_pixel_share * 100) + "% of the pixels classified at full resolution, segmentation "
+				+ to_string(results[5].segmentation_ms / max(0.001f, results[i].segmentation_ms)) + " times as fast, model " + ((results[i].output_hash == results[5].output_hash) ? "identical to" : "different from")
+				+ " the one of variant " + to_string(results[5].variant) + ".");
+
+		// Both engines reconstruct the visual hull of the same masks; the ground truth tells which one comes closer
+		if (results[i].variant == BENCHMARK_VOXEL_CARVING)
+			addInfoLine("Voxel carving: " + to_string(results[i].octree_nodes) + " cubes tested, " + to_string(results[i].octree_leaves) + " leaves, " + to_string(results[i].quads) + " quads in "
+				+ to_string(results[i].intersection_ms + results[i].quad_ms) + " ms against " + to_string(results[5].quads) + " quads in " + to_string(results[5].intersection_ms + results[5].quad_ms)
+				+ " ms of the rays (variant " + to_string(results[5].variant) + ").");
+
+		// The mesh shares its vertices, so every edge has to be used by exactly two triangles in opposite directions
+		if (results[i].variant == BENCHMARK_VOXEL_CARVING)
+		{
+			addInfoLine("Surface mesh: " + to_string(results[i].mesh_vertices) + " vertices, " + to_string(results[i].mesh_triangles) + " triangles in " + to_string(results[i].mesh_ms) + " ms.");
+
+			if (results[i].mesh_open_edges > 0)
+				addError("The surface mesh of benchmark variant " + to_string(results[i].variant) + " has " + to_string(results[i].mesh_open_edges) + " open edges!");
+		}
+
+		// The cost of the polyhedral hull grows with the crossings of the viewing lines, the one of the rays with their pairs
+		if (results[i].variant == BENCHMARK_POLYHEDRAL_HULL)
+			addInfoLine("Polyhedral hull: " + to_string(results[i].hull_crossings) + " silhouette crossings, " + to_string(results[i].quads) + " quads in "
+				+ to_string(results[i].intersection_ms + results[i].quad_ms) + " ms against " + to_string(results[5].intersections) + " intersections of the rays in "
+				+ to_string(results[5].intersection_ms + results[5].quad_ms) + " ms (variant " + to_string(results[5].variant) + ").");
+
+		// The levels only join quads which continue each other, so the coarsest level has to be about as precise as the full model
+		if (results[i].detail_quads > 0)
+			addInfoLine("Levels of detail: the coarsest level has " + to_string(results[i].detail_quads) + " of " + to_string(results[i].quads) + " quads"
+				+ ((ground_truth != nullptr) ? " (" + to_string(results[i].detail_precision * 100) + "% on the visual hull)" : "") + ", computed in " + to_string(results[i].detail_ms) + " ms.");
+
+		// Lossless compression of the model for a model record (20 values of 4 bytes per quad uncompressed)
+		if ((results[i].record_bytes > 0) && (results[i].quads > 0))
+			addInfoLine("Model record: " + to_string(results[i].record_bytes / results[i].quads) + " bytes per quad instead of 80, compressed in " + to_string(results[i].record_ms) + " ms.");
+		else if (results[i].record_bytes < 0)
+			addError("The model record of benchmark variant " + to_string(results[i].variant) + " does not give back the same quads!");
+
+		if (results[i].steady_allocations > 0)
+			addError("Benchmark variant " + to_string(results[i].variant) + " allocated " + to_string(results[i].steady_allocations) + " times on the heap after " + to_string(ALLOCATION_WARMUP_ITERATIONS) + " iterations (see GetAllocationStatistics())!");
+
+		if (results[i].narrow_phase_mismatches > 0)
+			addError("Batched narrow phase differs from the single pair reference in " + to_string(results[i].narrow_phase_mismatches) + " of " + to_string(results[i].narrow_phase_pairs) + " pairs!");
+	}
+
+	return(count);
+}
@@ -0,0 +1,245 @@
+/*
+A set of all values which control the processing of the camera frames.
+
+Instances are never modified once they have been published through Settings::publishPendingConfiguration().
+To change a value, a copy of the current configuration is modified and staged (see Settings.cpp).
+The cameras pick up the new instance at the next frame boundary by comparing the generation.
+
+Configuration files contain one "key = value" pair per line. Lines starting with '#' are comments.
+The keys are the names in the table below (also listed in PluginDataTypes.h).
+Example:
+	# Tuning for bright rooms
+	background_color_tolerance = 45
+	contour_mask_size = 4
+*/
+
+#include "stdafx.h"
+
+#include "PipelineConfiguration.h"
+
+#include <fstream>
+#include <sstream>
+
+
+// All keys with their valid ranges
+static const ConfigurationKey configuration_keys[] = {
+	{ CONFIG_BACKGROUND_REFERENCE_FRAMES,		"background_reference_frames",		1, 500, true },
+	{ CONFIG_BACKGROUND_COLOR_TOLERANCE,		"background_color_tolerance",		1, 255, true },
+	{ CONFIG_CONTOUR_MASK_SIZE,					"contour_mask_size",				2, 16, true },
+	{ CONFIG_NOISEPIXEL_TOLERANCE,				"noisepixel_tolerance",				0, 256, true },
+	{ CONFIG_SEGMENT_OPTIMISATION_TOLERANCE,	"segment_optimisation_tolerance",	0, 3.1416f, false },
+	{ CONFIG_MAX_RAY_LENGTH,					"max_ray_length",					1, 100000, true },
+	{ CONFIG_THREAD_TIMEOUT_MS,					"thread_timeout_ms",				10, 60000, true },
+	{ CONFIG_PREVIEW_SCALE_FACTOR,				"preview_scale_factor",				0.05f, 1, false },
+	{ CONFIG_BACKGROUND_ADAPTATION_RATE,		"background_adaptation_rate",		0, 1, false },
+	{ CONFIG_BACKGROUND_VARIANCE_FACTOR,		"background_variance_factor",		0, 20, false },
+	{ CONFIG_MERGE_EDGES,						"merge_edges",						0, 1, true },
+	{ CONFIG_INTERSECTION_ENGINE,				"intersection_engine",				0, 1, true },
+	{ CONFIG_BATCHED_NARROW_PHASE,				"batched_narrow_phase",				0, 1, true },
+	{ CONFIG_SHARED_PAIR_INTERSECTION,			"shared_pair_intersection",			0, 1, true },
+	{ CONFIG_WORKER_THREADS,					"worker_threads",					0, 256, true },
+	{ CONFIG_THREAD_PINNING,					"thread_pinning",					0, 2, true },
+	{ CONFIG_FIRST_PROCESSOR,					"first_processor",					0, 4095, true },
+	{ CONFIG_THREAD_PRIORITIES,					"thread_priorities",				0, 1, true },
+	{ CONFIG_ROI_TRACKING,						"roi_tracking",						0, 1, true },
+	{ CONFIG_ROI_MARGIN,						"roi_margin",						0, 1024, true },
+	{ CONFIG_ROI_SWEEP_INTERVAL,				"roi_sweep_interval",				1, 10000, true },
+	{ CONFIG_PYRAMID_BLOCK_SIZE,				"pyramid_block_size",				1, 16, true },
+	{ CONFIG_RECONSTRUCTION_ENGINE,				"reconstruction_engine",			0, 2, true },
+	{ CONFIG_VOXEL_DEPTH,						"voxel_depth",						4, 8, true },
+	{ CONFIG_SURFACE_MESH,						"surface_mesh",						0, 1, true },
+	{ CONFIG_DETAIL_LEVELS,						"detail_levels",					0, 4, true },
+	{ CONFIG_MODEL_STREAM_QUADS,				"model_stream_quads",				0, 1000000, true }
+};
+
+
+int PipelineConfiguration::getKeyCount()
+{
+	return(sizeof(configuration_keys) / sizeof(ConfigurationKey));
+}
+
+/*
+Get the description of a key or nullptr if the key does not exist.
+*/
+const ConfigurationKey * PipelineConfiguration::getKey(int key)
+{
+	for (int i = 0; i < getKeyCount(); ++i)
+		if (configuration_keys[i].key == key)
+			return(&configuration_keys[i]);
+	return(nullptr);
+}
+
+/*
+Get the description of a key by its name in configuration files or nullptr if the name does not exist.
+*/
+const ConfigurationKey * PipelineConfiguration::findKey(const string & name)
+{
+	for (int i = 0; i < getKeyCount(); ++i)
+		if (name == configuration_keys[i].name)
+			return(&configuration_keys[i]);
+	return(nullptr);
+}
+
+
+/*
+Change a single value.
+Returns false (and keeps the previous value) if the key does not exist or the value is not valid.
+*/
+bool PipelineConfiguration::setValue(int key, float value)
+{
+	const ConfigurationKey * description = getKey(key);
+
+	if (description == nullptr)
+	{
+		addError("Unknown configuration key: " + to_string(key));
+		return(false);
+	}
+
+	if ((value < description->min_value) || (value > description->max_value) || (value != value))
+	{
+		addError("Value " + to_string(value) + " out of range for configuration key: " + description->name);
+		return(false);
+	}
+
+	int int_value = (int)(value + 0.5f);
+
+	switch (key)
+	{
+	case CONFIG_BACKGROUND_REFERENCE_FRAMES: background_reference_frames = int_value; break;
+	case CONFIG_BACKGROUND_COLOR_TOLERANCE: background_color_tolerance = int_value; break;
+	case CONFIG_CONTOUR_MASK_SIZE:
+		if ((int_value & (int_value - 1)) != 0) // The frame sizes have to be divisible by the cell size
+		{
+			addError("The contour mask size has to be a power of two.");
+			return(false);
+		}
+		contour_mask_size = int_value;
+		break;
+	case CONFIG_NOISEPIXEL_TOLERANCE: noisepixel_tolerance = int_value; break;
+	case CONFIG_SEGMENT_OPTIMISATION_TOLERANCE: segment_optimisation_tolerance = value; break;
+	case CONFIG_MAX_RAY_LENGTH: max_ray_length = int_value; break;
+	case CONFIG_THREAD_TIMEOUT_MS: thread_timeout_ms = int_value; break;
+	case CONFIG_PREVIEW_SCALE_FACTOR: preview_scale_factor = value; break;
+	case CONFIG_BACKGROUND_ADAPTATION_RATE: background_adaptation_rate = value; break;
+	case CONFIG_BACKGROUND_VARIANCE_FACTOR: background_variance_factor = value; break;
+	case CONFIG_MERGE_EDGES: merge_edges = (int_value != 0); break;
+	case CONFIG_INTERSECTION_ENGINE: intersection_engine = int_value; break;
+	case CONFIG_BATCHED_NARROW_PHASE: batched_narrow_phase = (int_value != 0); break;
+	case CONFIG_SHARED_PAIR_INTERSECTION: shared_pair_intersection = (int_value != 0); break;
+	case CONFIG_WORKER_THREADS: worker_threads = int_value; break;
+	case CONFIG_THREAD_PINNING: thread_pinning = int_value; break;
+	case CONFIG_FIRST_PROCESSOR: first_processor = int_value; break;
+	case CONFIG_THREAD_PRIORITIES: thread_priorities = (int_value != 0); break;
+	case CONFIG_ROI_TRACKING: roi_tracking = (int_value != 0); break;
+	case CONFIG_ROI_MARGIN: roi_margin = int_value; break;
+	case CONFIG_ROI_SWEEP_INTERVAL: roi_sweep_interval = int_value; break;
+	case CONFIG_PYRAMID_BLOCK_SIZE: pyramid_block_size = int_value; break;
+	case CONFIG_RECONSTRUCTION_ENGINE: reconstruction_engine = int_value; break;
+	case CONFIG_VOXEL_DEPTH: voxel_depth = int_value; break;
+	case CONFIG_SURFACE_MESH: surface_mesh = (int_value != 0); break;
+	case CONFIG_DETAIL_LEVELS: detail_levels = int_value; break;
+	case CONFIG_MODEL_STREAM_QUADS: model_stream_quads = int_value; break;
+	}
+
+	return(true);
+}
+
+/*
+Read a single value (returns -1 for unknown keys).
+*/
+float PipelineConfiguration::getValue(int key)
+{
+	switch (key)
+	{
+	case CONFIG_BACKGROUND_REFERENCE_FRAMES: return(background_reference_frames);
+	case CONFIG_BACKGROUND_COLOR_TOLERANCE: return(background_color_tolerance);
+	case CONFIG_CONTOUR_MASK_SIZE: return(contour_mask_size);
+	case CONFIG_NOISEPIXEL_TOLERANCE: return(noisepixel_tolerance);
+	case CONFIG_SEGMENT_OPTIMISATION_TOLERANCE: return(segment_optimisation_tolerance);
+	case CONFIG_MAX_RAY_LENGTH: return(max_ray_length);
+	case CONFIG_THREAD_TIMEOUT_MS: return(thread_timeout_ms);
+	case CONFIG_PREVIEW_SCALE_FACTOR: return(preview_scale_factor);
+	case CONFIG_BACKGROUND_ADAPTATION_RATE: return(background_adaptation_rate);
+	case CONFIG_BACKGROUND_VARIANCE_FACTOR: return(background_variance_factor);
+	case CONFIG_MERGE_EDGES: return(merge_edges ? 1.0f : 0.0f);
+	case CONFIG_INTERSECTION_ENGINE: return(intersection_engine);
+	case CONFIG_BATCHED_NARROW_PHASE: return(batched_narrow_phase ? 1.0f : 0.0f);
+	case CONFIG_SHARED_PAIR_INTERSECTION: return(shared_pair_intersection ? 1.0f : 0.0f);
+	case CONFIG_WORKER_THREADS: return(worker_threads);
+	case CONFIG_THREAD_PINNING: return(thread_pinning);
+	case CONFIG_FIRST_PROCESSOR: return(first_processor);
+	case CONFIG_THREAD_PRIORITIES: return(thread_priorities ? 1.0f : 0.0f);
+	case CONFIG_ROI_TRACKING: return(roi_tracking ? 1.0f : 0.0f);
+	case CONFIG_ROI_MARGIN: return(roi_margin);
+	case CONFIG_ROI_SWEEP_INTERVAL: return(roi_sweep_interval);
+	case CONFIG_PYRAMID_BLOCK_SIZE: return(pyramid_block_size);
+	case CONFIG_RECONSTRUCTION_ENGINE: return(reconstruction_engine);
+	case CONFIG_VOXEL_DEPTH: return(voxel_depth);
+	case CONFIG_SURFACE_MESH: return(surface_mesh ? 1.0f : 0.0f);
+	case CONFIG_DETAIL_LEVELS: return(detail_levels);
+	case CONFIG_MODEL_STREAM_QUADS: return(model_stream_quads);
+	}
+	return(-1);
+}
+
+
+/*
+Apply all values of a configuration file on top of the current values.
+Returns false if the file cannot be read or contains any invalid line. In that case the configuration should be discarded.
+*/
+bool PipelineConfiguration::loadFromFile(const string & file_path)
+{
+	ifstream file(file_path);
+
+	if (!file.is_open())
+	{
+		addError("Could not open configuration file: " + file_path);
+		return(false);
+	}
+
+	bool valid = true;
+	string line;
+	int line_number = 0;
+
+	while (getline(file, line))
+	{
+		line_number++;
+
+		size_t first = line.find_first_not_of(" \t\r");
+		if ((first == string::npos) || (line[first] == '#'))
+			continue; // Empty or comment
+
+		size_t separator = line.find('=');
+		if (separator == string::npos)
+		{
+			addError("Missing '=' in line " + to_string(line_number) + " of " + file_path);
+			valid = false;
+			continue;
+		}
+
+		string name = line.substr(first, separator - first);
+		name.erase(name.find_last_not_of(" \t") + 1);
+
+		const ConfigurationKey * description = findKey(name);
+		if (description == nullptr)
+		{
+			addError("Unknown key '" + name + "' in line " + to_string(line_number) + " of " + file_path);
+			valid = false;
+			continue;
+		}
+
+		float value;
+		istringstream value_stream(line.substr(separator + 1));
+		if (!(value_stream >> value))
+		{
+			addError("Invalid value in line " + to_string(line_number) + " of " + file_path);
+			valid = false;
+			continue;
+		}
+
+		if (!setValue(description->key, value))
+			valid = false;
+	}
+
+	return(valid);
+}
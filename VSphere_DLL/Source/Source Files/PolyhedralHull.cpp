@@ -0,0 +1,530 @@
+/*
+Reconstruction engine which computes the polyhedral visual hull from the contour chains of the EdgesIdentifier
+(configuration key reconstruction_engine, see VSphereReconstructionEngine). It is shared by all cameras of a sphere.
+
+Every edge of a contour chain is the base of a face of the cone of its camera: the strip swept by the edge along the viewing direction
+(the cameras are orthographic, so the cones are prisms). The visual hull on such a face is the part seen inside the silhouettes of all other cameras.
+It is found on the viewing lines through the points of the chain: a viewing line is seen by another camera as a line in its image,
+and the parts of it inside that silhouette lie between the crossings with the edges of that silhouette (which pieces are inside is told by the mask,
+where a chain misses a part of the silhouette the piece is followed through the mask pixel by pixel).
+The intervals inside all silhouettes are the viewing edges of the hull; the face between the viewing edges of the two points of a contour edge
+is emitted as quads, one per pair of overlapping viewing edges. Where the number of viewing edges changes along a contour edge,
+the edge is divided (up to POLYHEDRAL_SUBDIVISIONS times) so the quads follow the change.
+
+All viewing lines of a camera are seen by another camera in the same direction, so the edges of the other silhouette are sorted into bins
+across that direction once per frame (binSilhouette). A viewing line only tests the edges of its bin, so the cost grows with the length of the contours
+and the number of crossings instead of with the pairs of rays.
+
+Every camera cuts the faces of its own cones (a task per camera after the contours of all cameras are ready).
+The quads have the format of the ModelBuilder: four corners (times 100) in the order last_start, start, last_end, end,
+where (start - last_start) x (last_end - last_start) points out of the model, and their texture coordinates in the camera
+which looks most directly at the face.
+
+Input:
+	CameraSource		// Pose of every camera (see addCamera)
+	contour chains		// Segments of the EdgesIdentifier of every camera and frame with the binary mask (see prepareCamera)
+
+Output:
+	output_content		// Quads of the faces of the cones of a camera (see collectModelPart)
+*/
+
+#include "stdafx.h"
+
+#include "PolyhedralHull.h"
+
+#include <algorithm>
+
+
+// Divisions of a contour edge where the number of viewing edges changes along it
+#define POLYHEDRAL_SUBDIVISIONS 3
+
+// Distance (pixels) the viewing lines of the points of a contour are moved into the silhouette, where they do not only graze the hull
+#define POLYHEDRAL_INSET 1.0f
+
+// Bins per edge of a silhouette and the most bins of a silhouette
+#define POLYHEDRAL_EDGES_PER_BIN 2
+#define POLYHEDRAL_MAX_BINS 4096
+
+
+PolyhedralHull::PolyhedralHull()
+{
+}
+
+PolyhedralHull::~PolyhedralHull()
+{
+	for (int c = 0; c < cameras.size(); ++c)
+	{
+		for (int b = 0; b < cameras[c]->bins.size(); ++b)
+			delete(cameras[c]->bins[b]);
+		delete(cameras[c]);
+	}
+}
+
+
+/*
+Add a camera (in the order of the list of cameras).
+*/
+void PolyhedralHull::addCamera(CameraSource * camera_source, int tex_offs_x, int tex_offs_y)
+{
+	HullCamera * camera = new HullCamera();
+
+	camera->camera_source = camera_source;
+	camera->tex_offs_x = tex_offs_x;
+	camera->tex_offs_y = tex_offs_y;
+	camera->binary_mask = nullptr;
+	camera->level_intervals.resize(POLYHEDRAL_SUBDIVISIONS);
+
+	cameras.push_back(camera);
+}
+
+/*
+Take the values of a newly published configuration (called between frames).
+*/
+void PolyhedralHull::applyConfiguration(PipelineConfiguration * configuration)
+{
+	max_ray_length = (float)configuration->max_ray_length;
+}
+
+
+/*
+Take the silhouette of the current frame of a camera (a task of the camera after its edges, see PerCamControler::processFrame).
+The vectors are read until the faces of all cameras are cut.
+*/
+void PolyhedralHull::prepareCamera(int camera_index, vector<int> * segment_starts, vector<int> * segment_ends, vector<bool> * segment_orientations, bool * binary_mask, Rect window)
+{
+	HullCamera * camera = cameras[camera_index];
+	CameraSource * source = camera->camera_source;
+	quaternion direction = source->getDirection();
+
+	// The mode is only known once the camera is opened
+	camera->width = source->getSize().X;
+	camera->height = source->getSize().Y;
+	camera->pixel_size = source->getPixelSize();
+	camera->corner = source->getOrigin() + source->getToCorner();
+	camera->right = direction * vector3df(1, 0, 0);
+	camera->up = direction * vector3df(0, 1, 0);
+	camera->forward = direction * vector3df(0, 0, 1);
+
+	camera->segment_starts = segment_starts;
+	camera->segment_ends = segment_ends;
+	camera->segment_orientations = segment_orientations;
+	camera->binary_mask = binary_mask;
+	camera->window = window;
+	camera->prepared = true;
+}
+
+
+/*
+Pixel position of a point in space in the frame of a camera (like RayGenerator::addRay the other way round).
+*/
+vector2df PolyhedralHull::projectPoint(HullCamera * camera, vector3df position)
+{
+	vector3df relative = position - camera->corner;
+	return(vector2df(relative.dotProduct(camera->right) / camera->pixel_size, -relative.dotProduct(camera->up) / camera->pixel_size));
+}
+
+vector3df PolyhedralHull::pixelPosition(HullCamera * camera, float x, float y)
+{
+	return(camera->corner + camera->right * (x * camera->pixel_size) - camera->up * (y * camera->pixel_size));
+}
+
+
+/*
+Sort the edges of the silhouette of another camera into bins across the direction it sees the viewing lines of a camera in.
+*/
+void PolyhedralHull::binSilhouette(HullCamera * camera, HullCamera * other, SilhouetteBins * bins)
+{
+	bins->direction = vector2df(camera->forward.dotProduct(other->right) / other->pixel_size, -camera->forward.dotProduct(other->up) / other->pixel_size);
+
+	// A viewing line seen within a pixel is decided by the mask
+	float length = bins->direction.getLength();
+	bins->degenerate = (length * max_ray_length < 1);
+	bins->across_min = 0;
+	bins->bin_width = 1;
+	bins->bin_starts.assign(2, 0);
+	bins->bin_edges.clear();
+
+	int edge_count = other->segment_starts->size();
+	if (bins->degenerate || (edge_count == 0))
+		return;
+
+	bins->across = vector2df(-bins->direction.Y, bins->direction.X) / length;
+
+	float across_max = bins->across_min = bins->across.dotProduct(vector2df((float)((*other->segment_starts)[0] % other->width), (float)((*other->segment_starts)[0] / other->width)));
+	for (int e = 0; e < edge_count; ++e)
+	{
+		float across_start = bins->across.dotProduct(vector2df((float)((*other->segment_starts)[e] % other->width), (float)((*other->segment_starts)[e] / other->width)));
+		float across_end = bins->across.dotProduct(vector2df((float)((*other->segment_ends)[e] % other->width), (float)((*other->segment_ends)[e] / other->width)));
+
+		bins->across_min = min(bins->across_min, min(across_start, across_end));
+		across_max = max(across_max, max(across_start, across_end));
+	}
+
+	int bin_count = max(1, min(POLYHEDRAL_MAX_BINS, edge_count / POLYHEDRAL_EDGES_PER_BIN));
+	bins->bin_width = (across_max - bins->across_min) / bin_count + 0.001f;
+	bins->bin_starts.assign(bin_count + 1, 0);
+
+	// Count the edges per bin, turn the counts into the ends of the bins and fill them from the back
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int e = 0; e < edge_count; ++e)
+		{
+			float across_start = bins->across.dotProduct(vector2df((float)((*other->segment_starts)[e] % other->width), (float)((*other->segment_starts)[e] / other->width)));
+			float across_end = bins->across.dotProduct(vector2df((float)((*other->segment_ends)[e] % other->width), (float)((*other->segment_ends)[e] / other->width)));
+
+			int first = (int)((min(across_start, across_end) - bins->across_min) / bins->bin_width);
+			int last = (int)((max(across_start, across_end) - bins->across_min) / bins->bin_width);
+
+			for (int b = first; b <= last; ++b)
+			{
+				if (pass == 0)
+					bins->bin_starts[b]++;
+				else
+					bins->bin_edges[--bins->bin_starts[b]] = e;
+			}
+		}
+
+		if (pass == 0)
+		{
+			for (int b = 1; b <= bin_count; ++b)
+				bins->bin_starts[b] += bins->bin_starts[b - 1];
+			bins->bin_edges.resize(bins->bin_starts[bin_count]);
+		}
+	}
+}
+
+/*
+Whether a pixel position is inside the silhouette of a camera.
+*/
+bool PolyhedralHull::insideMask(HullCamera * camera, vector2df pixel)
+{
+	int x = (int)floor(pixel.X), y = (int)floor(pixel.Y);
+	return(camera->window.contains(Point(x, y)) && !camera->binary_mask[y * camera->width + x]); // true = background
+}
+
+/*
+Append an interval to sorted intervals (continues the last one if they touch).
+*/
+void PolyhedralHull::addInterval(vector<float> * intervals, float from, float to)
+{
+	if (!intervals->empty() && (intervals->back() == from))
+		intervals->back() = to;
+	else
+	{
+		intervals->push_back(from);
+		intervals->push_back(to);
+	}
+}
+
+/*
+The intervals of a viewing line (pairs of distances from the plane of its camera) inside the silhouette of another camera.
+start: the point of the viewing line in the plane of its camera, seen by the other camera.
+
+The edges of the silhouette tell where the line crosses it. The chains of the EdgesIdentifier are not always closed,
+so the pieces between the crossings are not counted as entering and leaving but decided by the mask.
+A piece which is not the same at its ends and its middle misses a crossing and is followed through the mask.
+*/
+void PolyhedralHull::crossSilhouette(HullCamera * camera, HullCamera * other, SilhouetteBins * bins, vector2df start, vector<float> * intervals)
+{
+	intervals->clear();
+
+	vector<float> & crossings = camera->crossings;
+	crossings.clear();
+	crossings.push_back(0);
+
+	// Seen as a point the line has no crossings: it is inside or outside as a whole
+	if (!bins->degenerate)
+	{
+		float across = bins->across.dotProduct(start);
+		int bin = (int)floor((across - bins->across_min) / bins->bin_width);
+
+		// Beside all edges (without edges the line is not seen inside either)
+		if ((bin < 0) || (bin >= (int)bins->bin_starts.size() - 1) || bins->bin_edges.empty())
+			return;
+
+		float direction_sq = bins->direction.getLengthSQ();
+
+		for (int i = bins->bin_starts[bin]; i < bins->bin_starts[bin + 1]; ++i)
+		{
+			int e = bins->bin_edges[i];
+			vector2df from((float)((*other->segment_starts)[e] % other->width), (float)((*other->segment_starts)[e] / other->width));
+			vector2df to((float)((*other->segment_ends)[e] % other->width), (float)((*other->segment_ends)[e] / other->width));
+
+			// Half open, so a line through the point shared by two edges crosses only one of them
+			float across_from = bins->across.dotProduct(from), across_to = bins->across.dotProduct(to);
+			if (!(((across_from <= across) && (across < across_to)) || ((across_to <= across) && (across < across_from))))
+				continue;
+
+			vector2df crossing = from + (to - from) * ((across - across_from) / (across_to - across_from));
+			float position = (crossing - start).dotProduct(bins->direction) / direction_sq;
+
+			if ((position > 0) && (position < max_ray_length))
+				crossings.push_back(position);
+		}
+
+		camera->crossing_count += crossings.size() - 1;
+		sort(crossings.begin() + 1, crossings.end());
+	}
+
+	crossings.push_back(max_ray_length);
+
+	// Distance along the line per pixel of the other frame
+	float pixel_step = bins->degenerate ? max_ray_length : 1 / bins->direction.getLength();
+
+	for (int i = 0; i + 1 < crossings.size(); ++i)
+	{
+		float from = crossings[i], to = crossings[i + 1];
+		if (to <= from)
+			continue;
+
+		float margin = min(pixel_step, (to - from) * 0.5f);
+		bool inside = insideMask(other, start + bins->direction * ((from + to) * 0.5f));
+
+		if ((insideMask(other, start + bins->direction * (from + margin)) == inside) && (insideMask(other, start + bins->direction * (to - margin)) == inside))
+		{
+			if (inside)
+				addInterval(intervals, from, to);
+			continue;
+		}
+
+		float piece_start = from;
+		bool piece_inside = insideMask(other, start + bins->direction * (from + margin));
+
+		for (float position = from + pixel_step; position < to; position += pixel_step)
+		{
+			if (insideMask(other, start + bins->direction * position) == piece_inside)
+				continue;
+
+			if (piece_inside)
+				addInterval(intervals, piece_start, position);
+
+			piece_start = position;
+			piece_inside = !piece_inside;
+		}
+
+		if (piece_inside)
+			addInterval(intervals, piece_start, to);
+	}
+}
+
+/*
+The viewing edges of the viewing line through a pixel position of a camera: the intervals inside the silhouettes of all other cameras.
+*/
+void PolyhedralHull::cutViewingLine(HullCamera * camera, float x, float y, vector<float> * intervals)
+{
+	intervals->clear();
+	intervals->push_back(0);
+	intervals->push_back(max_ray_length);
+
+	vector3df position = pixelPosition(camera, x, y);
+
+	for (int o = 0; (o < cameras.size()) && !intervals->empty(); ++o)
+	{
+		HullCamera * other = cameras[o];
+		if ((other == camera) || !other->prepared)
+			continue;
+
+		crossSilhouette(camera, other, camera->bins[o], projectPoint(other, position), &camera->camera_intervals);
+
+		// Intersect the sorted intervals
+		vector<float> & cut = camera->cut_intervals;
+		vector<float> & current = *intervals;
+		vector<float> & seen = camera->camera_intervals;
+		cut.clear();
+
+		for (int a = 0, b = 0; (a < current.size()) && (b < seen.size()); )
+		{
+			float from = max(current[a], seen[b]);
+			float to = min(current[a + 1], seen[b + 1]);
+
+			if (from < to)
+			{
+				cut.push_back(from);
+				cut.push_back(to);
+			}
+
+			if (current[a + 1] < seen[b + 1])
+				a += 2;
+			else
+				b += 2;
+		}
+
+		intervals->swap(cut);
+	}
+}
+
+
+/*
+Emit the faces of the cone of a contour edge between the viewing edges of its two points.
+Overlapping viewing edges are connected; where their number differs the edge is divided.
+*/
+void PolyhedralHull::addFaces(HullCamera * camera, vector2df from, vector2df to, bool inside_on_right, vector<float> * from_intervals, vector<float> * to_intervals, int level)
+{
+	if ((from_intervals->size() != to_intervals->size()) && (level < POLYHEDRAL_SUBDIVISIONS) && ((to - from).getLengthSQ() > 1))
+	{
+		vector2df middle = (from + to) * 0.5f;
+		vector<float> * middle_intervals = &camera->level_intervals[level];
+
+		cutViewingLine(camera, middle.X, middle.Y, middle_intervals);
+
+		addFaces(camera, from, middle, inside_on_right, from_intervals, middle_intervals, level + 1);
+		addFaces(camera, middle, to, inside_on_right, middle_intervals, to_intervals, level + 1);
+		return;
+	}
+
+	vector<float> & a = *from_intervals;
+	vector<float> & b = *to_intervals;
+
+	for (int i = 0, j = 0; (i < a.size()) && (j < b.size()); )
+	{
+		if ((a[i] < b[j + 1]) && (b[j] < a[i + 1]))
+		{
+			addFaceQuad(camera, from, to, inside_on_right, a[i], a[i + 1], b[j], b[j + 1]);
+			i += 2;
+			j += 2;
+		}
+		else if (a[i + 1] < b[j + 1])
+			i += 2;
+		else
+			j += 2;
+	}
+}
+
+/*
+Emit one quad of a face of a cone: from and to are the pixel positions of the contour edge, near and far the distances along the viewing lines.
+*/
+void PolyhedralHull::addFaceQuad(HullCamera * camera, vector2df from, vector2df to, bool inside_on_right, float from_near, float from_far, float to_near, float to_far)
+{
+	vector3df from_position = pixelPosition(camera, from.X, from.Y);
+	vector3df to_position = pixelPosition(camera, to.X, to.Y);
+
+	// Out of the silhouette, perpendicular to the edge in the image (the orientation of the EdgesIdentifier counts with y growing upwards)
+	vector2df outside(-(to.Y - from.Y), to.X - from.X);
+	if (!inside_on_right)
+		outside = -outside;
+
+	vector3df normal = camera->right * outside.X - camera->up * outside.Y;
+	normal.normalize();
+
+	vector3df corners[4] = {
+		from_position + camera->forward * from_near, from_position + camera->forward * from_far,
+		to_position + camera->forward * to_near, to_position + camera->forward * to_far };
+
+	// last_start, start, last_end, end: the quads turn the same way seen from outside
+	if (camera->forward.crossProduct(to_position - from_position).dotProduct(normal) < 0)
+	{
+		swap(corners[0], corners[2]);
+		swap(corners[1], corners[3]);
+	}
+
+	for (int k = 0; k < 4; ++k)
+	{
+		camera->output.push_back((int)(corners[k].X * (float)100));
+		camera->output.push_back((int)(corners[k].Y * (float)100));
+		camera->output.push_back((int)(corners[k].Z * (float)100));
+	}
+
+	// The camera looking most directly at the face
+	HullCamera * texture_camera = camera;
+	float best = 2;
+	for (int c = 0; c < cameras.size(); ++c)
+	{
+		float facing = cameras[c]->forward.dotProduct(normal);
+		if (cameras[c]->prepared && (facing < best))
+		{
+			best = facing;
+			texture_camera = cameras[c];
+		}
+	}
+
+	for (int k = 0; k < 4; ++k)
+	{
+		vector2df pixel = projectPoint(texture_camera, corners[k]);
+
+		camera->output.push_back(min(max((int)pixel.X, 0), texture_camera->width - 1) + texture_camera->tex_offs_x);
+		camera->output.push_back(min(max((int)pixel.Y, 0), texture_camera->height - 1) + texture_camera->tex_offs_y);
+	}
+}
+
+
+/*
+Cut the faces of the cones of all contour edges of a camera against the silhouettes of the other cameras
+(a task of the FrameScheduler after the contours of all cameras are ready).
+*/
+void PolyhedralHull::cutCamera(int camera_index)
+{
+	HullCamera * camera = cameras[camera_index];
+	camera->output.clear();
+	camera->crossing_count = 0;
+
+	if (!camera->prepared)
+		return;
+
+	// Created in the first frame
+	while (camera->bins.size() < cameras.size())
+		camera->bins.push_back(new SilhouetteBins());
+
+	// A viewing line crosses an edge at most once and is followed through the mask at most once per pixel
+	int most_crossings = 2;
+	for (int o = 0; o < cameras.size(); ++o)
+		if ((o != camera_index) && cameras[o]->prepared)
+		{
+			binSilhouette(camera, cameras[o], camera->bins[o]);
+			most_crossings = max(most_crossings, (int)cameras[o]->segment_starts->size() + cameras[o]->width + cameras[o]->height + 2);
+		}
+
+	// Sized for the frame, so the work does not allocate while cutting
+	camera->crossings.reserve(most_crossings);
+	camera->start_intervals.reserve(most_crossings);
+	camera->end_intervals.reserve(most_crossings);
+	camera->cut_intervals.reserve(most_crossings);
+	camera->camera_intervals.reserve(most_crossings);
+	for (int l = 0; l < camera->level_intervals.size(); ++l)
+		camera->level_intervals[l].reserve(most_crossings);
+
+	vector<int> & starts = *camera->segment_starts;
+	vector<int> & ends = *camera->segment_ends;
+
+	for (int e = 0; e < starts.size(); ++e)
+	{
+		vector2df from((float)(starts[e] % camera->width), (float)(starts[e] / camera->width));
+		vector2df to((float)(ends[e] % camera->width), (float)(ends[e] / camera->width));
+
+		// Into the silhouette (against the outside of addFaceQuad)
+		vector2df inset(to.Y - from.Y, -(to.X - from.X));
+		if (!(*camera->segment_orientations)[e])
+			inset = -inset;
+		if (inset.getLengthSQ() > 0)
+			inset *= POLYHEDRAL_INSET / inset.getLength();
+
+		// Within a chain the viewing edges of a point are shared by its two edges
+		if ((e > 0) && (starts[e] == ends[e - 1]))
+			camera->start_intervals.swap(camera->end_intervals);
+		else
+			cutViewingLine(camera, from.X + inset.X, from.Y + inset.Y, &camera->start_intervals);
+
+		cutViewingLine(camera, to.X + inset.X, to.Y + inset.Y, &camera->end_intervals);
+
+		addFaces(camera, from, to, (*camera->segment_orientations)[e], &camera->start_intervals, &camera->end_intervals, 0);
+	}
+}
+
+/*
+The quads of the faces of the cones of a camera in the last frame.
+*/
+void PolyhedralHull::collectModelPart(int camera_index, vector<int> * output_content)
+{
+	output_content->assign(cameras[camera_index]->output.begin(), cameras[camera_index]->output.end());
+}
+
+
+/*
+Crossings of viewing lines with edges of silhouettes in the last frame (all cameras).
+*/
+int PolyhedralHull::getCrossingCount()
+{
+	int count = 0;
+	for (int c = 0; c < cameras.size(); ++c)
+		count += cameras[c]->crossing_count;
+	return(count);
+}
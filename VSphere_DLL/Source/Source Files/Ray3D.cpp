@@ -18,6 +18,8 @@ The output are the quads and texture coordinates which will be transfered to the
 
 #include "Ray3D.h"
 
+#include <algorithm>
+
 
 /*
 This function computes the quads for the surface of the 3D object based on the intersection data.
@@ -42,8 +44,7 @@ void Ray3D::addAsModelQuads(vector<int> * output, vector3df cam_direction, vecto
 
 	Technically the arrays intersection_factor_start_y and intersection_factor_end_y do contain the exact information of the itnersection
 	along the width of the ray and tehrefore would allow to recompute the exact intersection.
-	However to use those values for a complete model without holes, it requires more complex computations.
-	An attempt for thatw as made. See the huge out-commented block furher below.
+	Those values are used by addAsModelSubQuads() below which is required when edges are merged to wide rays.
 	*/
 	int current_starter = -1;
 	for (int i = 0; i < inters; ++i) // loop through all intersections
@@ -90,261 +91,130 @@ void Ray3D::addAsModelQuads(vector<int> * output, vector3df cam_direction, vecto
 		}
 
 	}
+}
 
-	/*
-	The following is an incomplete possibility to use accurate intersection values.
-	That is important in the case where multiple, differently angled rays cann collide one, large ray.
-	That happens a lot if the "merge_optimizable_edges" functionality is used in the EdgesIdentifier.
-	In those cases, the solution above is not usable because the quad would be rendered always rendered at it's whole width.
-
-	To achieve the correct quads in those cases, the whole ray has to be split up for every intersection along its width and computed individually.
-	So far this solutiond rastically icnreases computation effort but it might not be the best solution and computation is reduced in the ModelComputer as less rays mean less intersections.
-	*/
-	/*
-
-		vector<bool> subray_inactive;
-
-		vector<float> subray_factor_start_y;
-		vector<float> subray_factor_end_y;
-
-		vector<int> subray_base_intersection_index;
-
-
-		int current_main_intersection_index = intersection_indices[0];
-
-		subray_inactive.push_back(false);
-		subray_base_intersection_index.push_back(current_main_intersection_index);
-
-		subray_factor_start_y.push_back(intersection_factor_start_y[current_main_intersection_index]);
-		subray_factor_end_y.push_back(intersection_factor_end_y[current_main_intersection_index]);
-
-		if (false)
-		for (int i = 0; i < intersection_indices.size(); ++i)
-		{
-		current_main_intersection_index = intersection_indices[i];
-
-		vector3df last_start = origin_start + intersection_factor_start_x[current_main_intersection_index] * cam_direction
-		+ intersection_factor_start_y[current_main_intersection_index] * dir_along_y;
-		vector3df last_end = origin_start + intersection_factor_end_x[current_main_intersection_index] * cam_direction
-		+ intersection_factor_end_y[current_main_intersection_index] * dir_along_y;
-
-
-		StaticDebug::add3DCross(last_start, 6, output);
-		StaticDebug::add3DCross(last_end, 6, output);
-		}
-
-		//return;
-
-
-		for (int i = 1; i < intersection_indices.size(); ++i)
-		{
-		current_main_intersection_index = intersection_indices[i];
-
-		float current_main_intersection_start_y = intersection_factor_start_y[current_main_intersection_index];
-		float current_main_intersection_end_y = intersection_factor_end_y[current_main_intersection_index];
-
-		// cout << "START Checking FOR from " << current_main_intersection_start_y << " to " << current_main_intersection_end_y << endl;
-
-		bool nothing_added = true;
-		int current_subrays = subray_inactive.size();
-		int currently_added_subrays = 0;
-
-
-
-		for (int j = subray_inactive.size() - 1; j >= 0; --j)
-		{
-		if (subray_inactive[j]) continue;
-
-		float tocompare_intersection_start_y = subray_factor_start_y[j];
-		float tocompare_intersection_end_y = subray_factor_end_y[j];
-
-		if ((tocompare_intersection_end_y-min_width) <= current_main_intersection_start_y)
-		{
-		// cout << "A ABORTED CHECKING subray from " << tocompare_intersection_start_y << " to " << tocompare_intersection_end_y << " AGAINST main from " << current_main_intersection_start_y << " to " << current_main_intersection_end_y << endl;
-		continue;
-		}
-		if ((tocompare_intersection_start_y+min_width) >= current_main_intersection_end_y)
-		{
-		// cout << "B ABORTED CHECKING subray from " << tocompare_intersection_start_y << " to " << tocompare_intersection_end_y << " AGAINST main from " << current_main_intersection_start_y << " to " << current_main_intersection_end_y << endl;
-		continue;
-		}
-
-		subray_inactive[j] = true;
-
-		// cout << "CHECKING subray from " << tocompare_intersection_start_y << " to " << tocompare_intersection_end_y << " AGAINST main from " << current_main_intersection_start_y << " to " << current_main_intersection_end_y << endl;
-
-		float start, end;
-
-		if (current_main_intersection_start_y > tocompare_intersection_start_y) // If the current intersection start is more to the right than the one to compare with
-		{ // Add a new sub-ray segment from the edge of the origin ray to the new edge
-
-		if ((current_main_intersection_start_y - tocompare_intersection_start_y) > min_width)
-		{
-		bool not_overlapping = true;
-		for (int k = 0; k < currently_added_subrays; ++k)
-		{
-		if (((subray_factor_start_y[current_subrays + k] + min_width) >= subray_factor_start_y[j])
-		&& ((intersection_factor_start_y[current_main_intersection_index] + min_width) >= subray_factor_end_y[current_subrays + k]))
-		not_overlapping = false;
-		}
-
-		if (not_overlapping)
-		{
-		subray_inactive.push_back(false);
-		subray_base_intersection_index.push_back(subray_base_intersection_index[j]);
-
-		subray_factor_start_y.push_back(subray_factor_start_y[j]);
-		subray_factor_end_y.push_back(intersection_factor_start_y[current_main_intersection_index]);
 
-		// cout << "ADDING subray from " << subray_factor_start_y[j] << " to " << intersection_factor_start_y[current_main_intersection_index] << endl;
-		nothing_added = false;
+// Sub-rays narrower than this (in pixels of the camera) are not split off, so slivers are dropped alike at every resolution
+#define MIN_SUBRAY_PIXELS 0.05f
 
-		currently_added_subrays++;
-		}
-		}
-		// cout << "Exec 1" << endl;
-		start = intersection_factor_start_y[current_main_intersection_index];
-		}
-		else
-		{
-		if ((tocompare_intersection_start_y - current_main_intersection_start_y) > min_width)
-		{
-		bool not_overlapping = true;
-		for (int k = 0; k < currently_added_subrays; ++k)
-		{
-		if (((subray_factor_start_y[current_subrays + k] + min_width) >= intersection_factor_start_y[current_main_intersection_index])
-		&& ((subray_factor_start_y[j] + min_width) >= subray_factor_end_y[current_subrays + k]))
-		not_overlapping = false;
-		}
+// Position along the length of the ray where an intersection crosses the height y (inside its interval start_y - end_y)
+#define INTERSECTION_X_AT(ind, y) (((*intersection_factor_end_y)[ind] - (*intersection_factor_start_y)[ind] > min_subray_width) \
+	? (*intersection_factor_start_x)[ind] + ((y) - (*intersection_factor_start_y)[ind]) * ((*intersection_factor_end_x)[ind] - (*intersection_factor_start_x)[ind]) / ((*intersection_factor_end_y)[ind] - (*intersection_factor_start_y)[ind]) \
+	: (*intersection_factor_start_x)[ind])
 
-		if (not_overlapping)
-		{
-		subray_inactive.push_back(false);
-		subray_base_intersection_index.push_back(current_main_intersection_index);
+// Position inside the interval of an intersection as a factor between 0 and 1
+#define INTERSECTION_FRACTION_AT(ind, y) (((*intersection_factor_end_y)[ind] - (*intersection_factor_start_y)[ind] > min_subray_width) \
+	? ((y) - (*intersection_factor_start_y)[ind]) / ((*intersection_factor_end_y)[ind] - (*intersection_factor_start_y)[ind]) \
+	: 0.5f)
 
-		subray_factor_start_y.push_back(intersection_factor_start_y[current_main_intersection_index]);
-		subray_factor_end_y.push_back(subray_factor_start_y[j]);
 
-		// cout << "ADDING subray from " << intersection_factor_start_y[current_main_intersection_index] << " to " << subray_factor_start_y[j] << endl;
-		nothing_added = false;
+/*
+Exact variant of addAsModelQuads() which uses where along the width of the ray every intersection occured.
+This is required when rays are wide compared to the rays of the other cameras (see "merge_optimizable_edges" in the EdgesIdentifier)
+because then several, differently angled rays collide with different parts of the width.
+
+Every intersection covers the interval intersection_factor_start_y - intersection_factor_end_y of the width
+and runs from (intersection_factor_start_x, start_y) to (intersection_factor_end_x, end_y) in the plane of the ray.
+The width is split at the start and end of all intervals. Inside every resulting sub-ray the set of intersections does not change,
+so they are ordered by their position along the length and processed with the same enter/exit logic as the full-width variant.
+The corners of the quads and the texture coordinates are interpolated at the borders of the sub-ray.
+For n intersections this needs O(n) sub-rays with O(n log n) each (n is small for a single ray).
+*/
+void Ray3D::addAsModelSubQuads(vector<int> * output, vector3df cam_direction, vector<float> * intersection_factor_start_x, vector<float> * intersection_factor_end_x, vector<float> * intersection_factor_start_y, vector<float> * intersection_factor_end_y, vector<bool> * is_visible_plane_starter, vector<int> * texture_coordinates, SubRayWorkspace * workspace)
+{
+	if (intersection_indices.size() <= 1) return;
 
-		currently_added_subrays++;
-		}
-		}
-		// cout << "Exec 2" << endl;
-		start = subray_factor_start_y[j];
-		}
+	int inters = intersection_indices.size();
+	float min_subray_width = MIN_SUBRAY_PIXELS * workspace->pixel_size;
 
+	// Borders of the sub-rays
+	vector<float> & breakpoints = workspace->breakpoints;
+	breakpoints.clear();
 
-		if (current_main_intersection_end_y > tocompare_intersection_end_y) // If the current intersection width is more to the right than the one to compare with
-		{ // Add a new sub-ray segment from the width-edge of comparing ray to the edge of the origin
+	for (int i = 0; i < inters; ++i)
+	{
+		int ind = intersection_indices[i];
+		if (ind == -1) continue;
 
-		if ((current_main_intersection_end_y - tocompare_intersection_end_y) > min_width)
-		{
-		bool not_overlapping = true;
-		for (int k = 0; k < currently_added_subrays; ++k)
-		{
-		if (((subray_factor_start_y[current_subrays + k] + min_width) >= subray_factor_end_y[j])
-		&& ((intersection_factor_end_y[current_main_intersection_index] + min_width) >= subray_factor_end_y[current_subrays + k]))
-		not_overlapping = false;
-		}
+		breakpoints.push_back(max(0.0f, min(ray_width, (*intersection_factor_start_y)[ind])));
+		breakpoints.push_back(max(0.0f, min(ray_width, (*intersection_factor_end_y)[ind])));
+	}
 
-		if (not_overlapping)
-		{
-		subray_inactive.push_back(false);
-		subray_base_intersection_index.push_back(current_main_intersection_index);
+	sort(breakpoints.begin(), breakpoints.end());
 
-		subray_factor_start_y.push_back(subray_factor_end_y[j]); // End of subray as start of new subray
-		subray_factor_end_y.push_back(intersection_factor_end_y[current_main_intersection_index]); // End of current main ray
 
-		// cout << "ADDING subray from " << subray_factor_end_y[j] << " to " << intersection_factor_end_y[current_main_intersection_index] << endl;
-		nothing_added = false;
+	vector<pair<float, int>> & active = workspace->active;
 
-		currently_added_subrays++;
-		}
-		}
-		// cout << "Exec 3" << endl;
-		end = subray_factor_end_y[j];
-		}
-		else
-		{
-		if ((tocompare_intersection_end_y - current_main_intersection_end_y) > min_width)
-		{
-		bool not_overlapping = true;
-		for (int k = 0; k < currently_added_subrays; ++k)
-		{
-		if (((subray_factor_start_y[current_subrays + k] + min_width) >= intersection_factor_end_y[current_main_intersection_index])
-		&& ((subray_factor_end_y[j] + min_width) >= subray_factor_end_y[current_subrays + k]))
-		not_overlapping = false;
-		}
+	int breaks = breakpoints.size();
+	int b = 0;
+	while (b < breaks - 1)
+	{
+		float y0 = breakpoints[b];
 
-		if (not_overlapping)
-		{
-		subray_inactive.push_back(false);
-		subray_base_intersection_index.push_back(subray_base_intersection_index[j]);
+		// Skip borders too close to each other (they would produce slivers)
+		int next = b + 1;
+		while ((next < breaks - 1) && (breakpoints[next] - y0 <= min_subray_width))
+			next++;
 
-		subray_factor_start_y.push_back(intersection_factor_end_y[current_main_intersection_index]);
-		subray_factor_end_y.push_back(subray_factor_end_y[j]);
+		float y1 = breakpoints[next];
+		b = next;
 
-		// cout << "ADDING subray from " << intersection_factor_end_y[current_main_intersection_index] << " to " << subray_factor_end_y[j] << endl;
-		nothing_added = false;
+		if (y1 - y0 <= min_subray_width)
+			continue;
 
-		currently_added_subrays++;
-		}
+		float y_center = (y0 + y1) / 2;
 
-		}
-		// cout << "Exec 4" << endl;
-		end = intersection_factor_end_y[current_main_intersection_index];
-		}
 
-		if ((end - start) > min_width)
-		if ((end - start) > min_width)
+		// Collect the intersections covering this sub-ray, ordered along the length of the ray
+		active.clear();
+		for (int i = 0; i < inters; ++i)
 		{
-		float fk1 = (intersection_factor_end_x[subray_base_intersection_index[j]] - intersection_factor_start_x[subray_base_intersection_index[j]]) / (intersection_factor_end_y[subray_base_intersection_index[j]] - intersection_factor_start_y[subray_base_intersection_index[j]]);
-		float fk2 = (intersection_factor_end_x[current_main_intersection_index] - intersection_factor_start_x[current_main_intersection_index]) / (intersection_factor_end_y[current_main_intersection_index] - intersection_factor_start_y[current_main_intersection_index]);
-
-		float x1 = intersection_factor_start_x[subray_base_intersection_index[j]] + (start - intersection_factor_start_y[subray_base_intersection_index[j]]) * fk1;
-		float x2 = intersection_factor_start_x[subray_base_intersection_index[j]] + (end - intersection_factor_start_y[subray_base_intersection_index[j]]) * fk1;
+			int ind = intersection_indices[i];
+			if (ind == -1) continue;
 
-		float x3 = intersection_factor_start_x[current_main_intersection_index] + (start - intersection_factor_start_y[current_main_intersection_index]) * fk2;
-		float x4 = intersection_factor_start_x[current_main_intersection_index] + (end - intersection_factor_start_y[current_main_intersection_index]) * fk2;
-
-		//if (quads_added == 3)
-		{
-		// cout << "added" << endl;
-		addQuad(x1, start, x2, end, x3, start, x4, end, cam_direction, dir_along_y, output);
+			if (((*intersection_factor_start_y)[ind] <= y_center) && (y_center <= (*intersection_factor_end_y)[ind]))
+				active.push_back(pair<float, int>(INTERSECTION_X_AT(ind, y_center), ind));
 		}
 
+		if (active.size() <= 1)
+			continue;
 
-		//addQuad(subray_factor_start_x[j], start, subray_factor_end_x[j], end, intersection_factor_start_x[current_main_intersection_index], start, intersection_factor_end_x[current_main_intersection_index], end, cam_direction, dir_along_y, output);
+		sort(active.begin(), active.end());
 
-		quads_added++;
-		}
 
-		}
-
-		//if (false)
-		if (nothing_added)
+		// Same logic as the full-width variant
+		int current_starter = -1;
+		for (int a = 0; a < active.size(); ++a)
 		{
-		// cout << "ADDING ORIGIN subray from " << intersection_factor_start_y[current_main_intersection_index] << " to " << intersection_factor_end_y[current_main_intersection_index] << endl;
-
-		subray_inactive.push_back(false);
-		subray_base_intersection_index.push_back(current_main_intersection_index);
-
-		subray_factor_start_y.push_back(intersection_factor_start_y[current_main_intersection_index]);
-		subray_factor_end_y.push_back(intersection_factor_end_y[current_main_intersection_index]);
-		}
+			int ind = active[a].second;
 
+			if (current_starter != -1) // If currently inside the object
+			{
+				if (!(*is_visible_plane_starter)[ind]) // If the intersection is an end-intersection
+				{
+					int lind = current_starter;
+
+					addQuad(INTERSECTION_X_AT(lind, y0), y0,
+							INTERSECTION_X_AT(lind, y1), y1,
+							INTERSECTION_X_AT(ind, y0), y0,
+							INTERSECTION_X_AT(ind, y1), y1,
+							cam_direction, dir_along_y, output);
+
+					addTextureInterpolated(texture_coordinates,
+						lind, INTERSECTION_FRACTION_AT(lind, y0), INTERSECTION_FRACTION_AT(lind, y1),
+						ind, INTERSECTION_FRACTION_AT(ind, y0), INTERSECTION_FRACTION_AT(ind, y1),
+						output);
+
+					current_starter = -1; // Now again outside the plane
+				}
+			}
+			else // If not inside the object; avaiting a starter intersection
+			{
+				if ((*is_visible_plane_starter)[ind]) // Starter intersection occured
+					current_starter = ind;
+			}
 		}
-
-		//cout << "Segment list size: " << subray_inactive.size() << endl;
-
-		//cout << "Quads added for a ray: " << quads_added << endl;
-
-
-
-		return;*/
-
+	}
 }
 
 /*
@@ -399,6 +269,27 @@ void Ray3D::addTexture(vector<int> * texture_coordinates, int last_index, int in
 	output->push_back((*texture_coordinates)[index * 4 + 3]);
 }
 
+/*
+Add texture coordinates for a sub-ray. The texture coordinates of the intersections are interpolated by the given fractions.
+*/
+void Ray3D::addTextureInterpolated(vector<int> * texture_coordinates, int last_index, float last_from, float last_to, int index, float from, float to, vector<int> * output)
+{
+	int * l = &(*texture_coordinates)[last_index * 4];
+	int * c = &(*texture_coordinates)[index * 4];
+
+	output->push_back((int)(l[0] + (l[2] - l[0]) * last_from));
+	output->push_back((int)(l[1] + (l[3] - l[1]) * last_from));
+
+	output->push_back((int)(c[0] + (c[2] - c[0]) * from));
+	output->push_back((int)(c[1] + (c[3] - c[1]) * from));
+
+	output->push_back((int)(l[0] + (l[2] - l[0]) * last_to));
+	output->push_back((int)(l[1] + (l[3] - l[1]) * last_to));
+
+	output->push_back((int)(c[0] + (c[2] - c[0]) * to));
+	output->push_back((int)(c[1] + (c[3] - c[1]) * to));
+}
+
 /*
 Add the entire ray with a given maximum length to the output vector (as a quad with 0.0 texture).
 */
@@ -31,9 +31,10 @@ RayGenerator::RayGenerator(CameraSource * camera_source)
 
 RayGenerator::~RayGenerator()
 {
-	int ray_count = rays.size();
+	int ray_count = ray_pool.size();
 	for (int i = 0; i < ray_count; ++i)
-		delete(rays[i]);
+		delete(ray_pool[i]);
+	ray_pool.clear();
 	rays.clear();
 }
 
@@ -44,6 +45,7 @@ void RayGenerator::initData(vector<int> * segment_starts, vector<int> * segment_
 {
 	cam_w = camera_source->getSize().X;
 	cam_h = camera_source->getSize().Y;
+	pixel_size = camera_source->getPixelSize();
 	cam_direction = camera_source->getDirection();
 	cam_left_top = camera_source->getOrigin() + camera_source->getToCorner();
 
@@ -57,11 +59,20 @@ void RayGenerator::initData(vector<int> * segment_starts, vector<int> * segment_
 
 
 /*
-Add a new ray. Todo: To save memmroy allocations, perhaps use some sort of pool of Ray3D and reuse them.
+Add a new ray. The rays of the previous frames are reused, so new ones are only created when a frame has more rays than all before.
 */
 void RayGenerator::addRay(int x1, int y1, int x2, int y2, bool orientation, vector3df cam_left_top, quaternion cam_direction)
 {
-	Ray3D * ray = new Ray3D();
+	Ray3D * ray;
+	if (rays.size() < ray_pool.size())
+		ray = ray_pool[rays.size()];
+	else
+	{
+		ray = new Ray3D();
+		ray_pool.push_back(ray);
+	}
+
+	ray->intersection_indices.clear(); // Keeps its capacity
 
 	// Texture coordinates (Coordinates of the camera
 	ray->tex_start_x = x1 + tex_offs_x;
@@ -71,9 +82,9 @@ void RayGenerator::addRay(int x1, int y1, int x2, int y2, bool orientation, vect
 
 	
 	// Coordinates of the origin in space
-	ray->origin_start = cam_left_top + cam_direction*vector3df(x1, -y1, 0);
-	ray->origin_end = cam_left_top + cam_direction*vector3df(x2, -y2, 0);
-	ray->origin = cam_left_top + cam_direction*vector3df(x1 + (x2 - x1) / 2, -(y1 + (y2 - y1) / 2), 0);
+	ray->origin_start = cam_left_top + cam_direction*(vector3df(x1, -y1, 0) * pixel_size);
+	ray->origin_end = cam_left_top + cam_direction*(vector3df(x2, -y2, 0) * pixel_size);
+	ray->origin = cam_left_top + cam_direction*(vector3df(x1 + (x2 - x1) / 2, -(y1 + (y2 - y1) / 2), 0) * pixel_size);
 
 	ray->dir_along_y = (ray->origin_end - ray->origin_start);
 
@@ -99,19 +110,17 @@ void RayGenerator::addRay(int x1, int y1, int x2, int y2, bool orientation, vect
 
 /*
 Generate the current set of rays based on the current edges.
+edges_merged -> whether the edges have been merged by the EdgesIdentifier (which already removed the edges staying alone)
 */
-void RayGenerator::generateRays()
+void RayGenerator::generateRays(bool edges_merged)
 {
-	int ray_count = rays.size();
-	for (int i = 0; i < ray_count; ++i) // TODO: Remove the delete system and re-use rays
-		delete(rays[i]);
-	rays.clear();
+	rays.clear(); // The rays stay in the pool
 
 
 	int segs = segment_starts->size();
 	for (int i = 0; i < segs; ++i)
 	{
-		if ((i > 0) && (i < segs - 1))
+		if (!edges_merged && (i > 0) && (i < segs - 1))
 		{
 			// Remove edges staying alone (more efficient to omit here than to remove from the vectors of edges)
 			if ((*segment_starts)[i] != (*segment_ends)[i - 1])
@@ -141,9 +150,9 @@ void RayGenerator::visualizeRays(vector<int> * output_content, int length)
 
 
 	vector3df cam_left_top = origin + camera_source->getToCorner();
-	vector3df left_bottom = cam_left_top + cam_direction * vector3df(0, -cam_h, 0);
-	vector3df right_top = cam_left_top + cam_direction * vector3df(cam_w, 0, 0);
-	vector3df right_bottom = cam_left_top + cam_direction * vector3df(cam_w, -cam_h, 0);
+	vector3df left_bottom = cam_left_top + cam_direction * (vector3df(0, -cam_h, 0) * pixel_size);
+	vector3df right_top = cam_left_top + cam_direction * (vector3df(cam_w, 0, 0) * pixel_size);
+	vector3df right_bottom = cam_left_top + cam_direction * (vector3df(cam_w, -cam_h, 0) * pixel_size);
 
 	// Add 4 crosses and an arrow showing the virtual camera plane
 	add3DArrow(origin, direction_vector, 25, &debug_quads);
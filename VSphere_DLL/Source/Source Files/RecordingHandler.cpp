@@ -2,6 +2,12 @@
 This class handles the records.
 Through the handleFrame() function it automatically separates between currently recording a video and playback.
 Same counts for handleBackgroundImage().
+The published models can be recorded or played as well (see ModelRecord).
+
+Every recorded frame is stored with its timestamp on the media clock (file path + "_timestamps.txt", one line per frame).
+When records are played, every camera takes the frame whose timestamp is nearest to the play position of the media clock,
+so the frames of all cameras entering the ModelBuilder were captured at the same moment, however the records were started or dropped frames.
+Records without timestamps are played as if their frames followed each other at the frame rate of the record.
 
 @Author: Alexander Georgescu
 */
@@ -11,12 +17,13 @@ Same counts for handleBackgroundImage().
 #include "RecordingHandler.h"
 
 #include <thread>
+#include <algorithm>
 
 
 RecordingHandler::RecordingHandler(int frame_delay_ms)
 {
 	recorders = new map<int, CameraRecord>();
-	current_position = 0;
+	media_clock = new MediaClock();
 	this->frame_delay_ms = frame_delay_ms;
 }
 RecordingHandler::~RecordingHandler(void)
@@ -28,9 +35,16 @@ RecordingHandler::~RecordingHandler(void)
 			iterator->second.getWriter()->release();
 		if (iterator->second.getReader() != nullptr)
 			iterator->second.getReader()->release();
+		if (iterator->second.getTimestampWriter() != nullptr)
+		{
+			iterator->second.getTimestampWriter()->close();
+			delete(iterator->second.getTimestampWriter());
+		}
 	}
 
 	delete(recorders);
+	delete(media_clock);
+	delete(model_record);
 }
 
 
@@ -44,8 +58,45 @@ void RecordingHandler::playRecord(int camera_list_index, string file_path)
 	recorders->insert(make_pair(camera_list_index, CameraRecord(false, file_path)));
 }
 
-// To be executed inside the cam control
-void RecordingHandler::startRecordOrPlay(int camera_list_index)
+/*
+Record the published models, or play them instead of reconstructing them (one model record at a time).
+*/
+void RecordingHandler::addModelRecord(string file_path)
+{
+	delete(model_record);
+	model_record = new ModelRecord(true, file_path);
+}
+
+void RecordingHandler::playModelRecord(string file_path)
+{
+	delete(model_record);
+	model_record = new ModelRecord(false, file_path);
+}
+
+/*
+Read the frame size and rate of the record a camera is played from (its mode, see CameraHandler::negotiateModes).
+Returns false if the camera is not played from a record or the file cannot be opened.
+*/
+bool RecordingHandler::probeRecord(int camera_list_index, Size * frame_size, double * fps)
+{
+	map<int, CameraRecord>::iterator it = recorders->find(camera_list_index);
+
+	if ((it == recorders->end()) || it->second.getRecording())
+		return(false);
+
+	VideoCapture reader(it->second.getFilePath() + ".mpg");
+	if (!reader.isOpened())
+		return(false);
+
+	*frame_size = Size((int)reader.get(CAP_PROP_FRAME_WIDTH), (int)reader.get(CAP_PROP_FRAME_HEIGHT));
+	*fps = reader.get(CAP_PROP_FPS);
+	reader.release();
+
+	return(frame_size->area() > 0);
+}
+
+// To be executed inside the cam control, with the mode the camera delivers
+void RecordingHandler::startRecordOrPlay(int camera_list_index, Size frame_size, double fps)
 {
 	map<int, CameraRecord>::iterator it = recorders->find(camera_list_index);
 
@@ -53,11 +104,13 @@ void RecordingHandler::startRecordOrPlay(int camera_list_index)
 	{
 		if (it->second.getRecording()) // Save to file
 		{
-			it->second.setWriter(new VideoWriter(it->second.getFilePath() + ".mpg", CV_FOURCC('P', 'I', 'M', '1'), 30, Size(640, 480), true));			
+			it->second.setWriter(new VideoWriter(it->second.getFilePath() + ".mpg", CV_FOURCC('P', 'I', 'M', '1'), (fps > 0) ? fps : 30, frame_size, true));
+			it->second.setTimestampWriter(new ofstream(it->second.getFilePath() + "_timestamps.txt"));
 		}
 		else // Read from file
 		{
 			it->second.setReader(new VideoCapture(it->second.getFilePath() + ".mpg"));
+			loadTimestamps(&it->second, fps);
 		}
 	}
 }
@@ -79,65 +132,112 @@ void RecordingHandler::handleBackgroundImage(int camera_list_index, cv::Mat * ba
 	}
 }
 
-void RecordingHandler::handleFrame(int camera_list_index, cv::Mat * frame)
+/*
+Read the timestamps of a played record, or make them up from the frame rate of a record without them. The media clock plays all records where they overlap.
+*/
+void RecordingHandler::loadTimestamps(CameraRecord * record, double fps)
 {
-	delay_start = high_resolution_clock::now();
+	vector<long long> * timestamps = record->getTimestamps();
+	timestamps->clear();
+
+	ifstream file(record->getFilePath() + "_timestamps.txt");
+	long long timestamp;
+	while (file >> timestamp)
+		timestamps->push_back(timestamp);
 
+	// Every frame needs its timestamp
+	int frame_count = (int)record->getReader()->get(CAP_PROP_FRAME_COUNT);
+	if ((frame_count > 0) && (timestamps->size() > frame_count))
+		timestamps->resize(frame_count);
+
+	// Timestamps which do not grow cannot be played (for example a file edited by hand)
+	if ((timestamps->size() < 2) || !is_sorted(timestamps->begin(), timestamps->end()) || (timestamps->back() <= timestamps->front()))
+	{
+		long long interval = (long long)(1000000 / ((fps > 0) ? fps : 1000.0 / max(frame_delay_ms, 1)));
+
+		timestamps->clear();
+		for (int f = 0; f < max(frame_count, 1); ++f)
+			timestamps->push_back(f * interval);
+
+		addInfoLine("The record " + record->getFilePath() + " has no timestamps; its frames are played " + to_string(interval / 1000) + " ms apart.");
+	}
+
+	// A single frame is shown in every frame and does not move the media clock
+	if (timestamps->size() < 2)
+	{
+		record->setClockRecord(-1);
+		addInfoLine("The record " + record->getFilePath() + " has less than two frames; it is not synchronized with the other records.");
+		return;
+	}
+
+	// A frame is as long as the usual distance of two timestamps (the median, so dropped frames do not count)
+	vector<long long> intervals;
+	for (int f = 1; f < timestamps->size(); ++f)
+		intervals.push_back((*timestamps)[f] - (*timestamps)[f - 1]);
+
+	long long frame_interval = 1;
+	if (!intervals.empty())
+	{
+		nth_element(intervals.begin(), intervals.begin() + intervals.size() / 2, intervals.end());
+		frame_interval = intervals[intervals.size() / 2];
+	}
+
+	record->setClockRecord(media_clock->addPlayedRecord(timestamps->front(), timestamps->back(), frame_interval));
+}
+
+/*
+Save the frame of a camera with its capture time, or replace it by the frame of the record nearest to the play position of the media clock.
+Called by the task of every camera at the same time; every camera only changes its own record.
+*/
+void RecordingHandler::handleFrame(int camera_list_index, cv::Mat * frame, high_resolution_clock::time_point captured)
+{
 	map<int, CameraRecord>::iterator it = recorders->find(camera_list_index);
 
 	if (it != recorders->end())
 	{
 		if (it->second.getRecording()) // Save to file
+		{
 			it->second.getWriter()->write(*frame);
+			*it->second.getTimestampWriter() << media_clock->toMediaTime(captured) << "\n";
+		}
 		else // read from file
 		{
-			it->second.setJustLooped(false);
+			vector<long long> & timestamps = *it->second.getTimestamps();
+			int clock_record = it->second.getClockRecord();
+			long long position = (clock_record >= 0) ? media_clock->getRecordPosition(clock_record) : timestamps.front();
+
+			// The frame with the nearest timestamp
+			int index = lower_bound(timestamps.begin(), timestamps.end(), position) - timestamps.begin();
+			if (index == timestamps.size())
+				index--;
+			else if ((index > 0) && (position - timestamps[index - 1] <= timestamps[index] - position))
+				index--;
 
-			// Synchronize frames
-			it->second.getReader()->set(CV_CAP_PROP_POS_FRAMES, current_position);
-			if (camera_list_index == 0)
-				current_position++;
+			it->second.setJustLooped((clock_record >= 0) && (it->second.getLoop() != media_clock->getLoopCount()));
+			it->second.setLoop(media_clock->getLoopCount());
 
-			//cout << "FRAME: " << it->second.getReader()->get(CV_CAP_PROP_POS_FRAMES) << endl;
+			// Frames following each other are read without seeking
+			if (index != it->second.getNextFrame())
+				it->second.getReader()->set(CV_CAP_PROP_POS_FRAMES, index);
 
 			//it->second.getReader()->set(CV_CAP_PROP_POS_FRAMES, 107); // Examples how to freeze a frame for debugging purpose.
 			//it->second.getReader()->set(CV_CAP_PROP_POS_FRAMES, 36);
-			//it->second.getReader()->set(CV_CAP_PROP_POS_FRAMES, 25);
-			//it->second.getReader()->set(CV_CAP_PROP_POS_FRAMES, 73);
 
-			Mat fr;
-			if ((!it->second.getReader()->read(fr)) || (fr.empty()))
+			// Read directly into the frame of the camera (its memory is reused as long as the size does not change)
+			if ((!it->second.getReader()->read(*frame)) || (frame->empty()))
 			{
-				current_position = 0;
+				// The video ends before its timestamps
+				index = 0;
 				it->second.getReader()->set(CV_CAP_PROP_POS_FRAMES, 0);
-				it->second.getReader()->read(fr);
-				it->second.setJustLooped(true);
+				it->second.getReader()->read(*frame);
 			}
 
-			fr.copyTo(*frame);
+			it->second.setNextFrame(index + 1);
+			it->second.setFrameOffset(timestamps[index] - position);
 		}
 	}
 }
 
-/*
-Perform a delay when reading from a record
-*/
-bool RecordingHandler::delayFrame(int camera_list_index)
-{
-	map<int, CameraRecord>::iterator it = recorders->find(camera_list_index);
-
-	if ((it != recorders->end()) && (!it->second.getRecording()))
-	{
-		int passed_time = chrono::duration_cast<milliseconds>(high_resolution_clock::now() - delay_start).count();
-		if (passed_time < frame_delay_ms)
-		{
-			std::this_thread::sleep_for(std::chrono::milliseconds(frame_delay_ms - passed_time));
-			return(true);
-		}
-	}
-	return(false);
-}
-
 
 bool RecordingHandler::isPlaying(int camera_list_index)
 {
@@ -160,4 +260,33 @@ bool RecordingHandler::justLooped(int camera_list_index)
 		return(it->second.getJustLooped());
 
 	return(false);
+}
+
+/*
+Timestamp of the last played frame of a camera minus the play position it was chosen for, in microseconds (0 if the camera is not played).
+*/
+long long RecordingHandler::getFrameOffset(int camera_list_index)
+{
+	map<int, CameraRecord>::iterator it = recorders->find(camera_list_index);
+
+	if ((it != recorders->end()) && !it->second.getRecording())
+		return(it->second.getFrameOffset());
+
+	return(0);
+}
+
+/*
+The media clock shared by all cameras (see MediaClock).
+*/
+MediaClock * RecordingHandler::getMediaClock()
+{
+	return(media_clock);
+}
+
+/*
+The model record (nullptr if none is configured).
+*/
+ModelRecord * RecordingHandler::getModelRecord()
+{
+	return(model_record);
 }
\ No newline at end of file
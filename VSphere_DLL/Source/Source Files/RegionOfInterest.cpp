@@ -0,0 +1,211 @@
+/*
+Tracks the region of a camera frame which contains the object, so the segmentation (binary mask, contours and edges)
+only has to process a window around it instead of the whole frame. It is bound to exactly one camera.
+
+The window of a frame is the box around all contour cells of the previous frame, extended by the motion allowed between two frames
+(the configuration key roi_margin). The whole frame is segmented again (a sweep):
+	- every roi_sweep_interval frames, to find objects which appear outside of the window,
+	- as long as no contour is found,
+	- after a frame whose contours reach the border of its window (the object may extend beyond it).
+A tracked frame counts as a hit if its contours stay inside the window and as a miss otherwise.
+A sweep which finds contours outside of the last tracked window counts as a miss as well.
+
+Input:
+	The contours grid of the ContoursExtractor (after computeContour() and before the EdgesIdentifier consumes it)
+
+Output:
+	The window of the next frame in cells of the contour grid and in pixels (one pixel larger, the contours compare neighboring pixels)
+*/
+
+#include "stdafx.h"
+
+#include "RegionOfInterest.h"
+
+
+// Cells between the contours and the border of a tracked window (the orientation of an edge is read two cells across it, see EdgesIdentifier)
+#define ROI_BORDER_CELLS 2
+
+
+RegionOfInterest::RegionOfInterest()
+{
+	applyConfiguration(Settings::getConfiguration());
+	initData(0, 0, 1);
+	resetStatistics();
+}
+
+
+/*
+Start tracking on frames of the given size. The first frame is a sweep.
+*/
+void RegionOfInterest::initData(int frame_w, int frame_h, int cell_size)
+{
+	this->frame_w = frame_w;
+	this->frame_h = frame_h;
+	this->cell_size = cell_size;
+
+	grid_w = frame_w / cell_size;
+	grid_h = frame_h / cell_size;
+
+	cells = Rect(0, 0, grid_w, grid_h);
+	tracked_cells = Rect();
+	found_cells = Rect();
+
+	sweep = true;
+	sweep_requested = true;
+	frames_since_sweep = 0;
+	pixel_share = 1;
+}
+
+/*
+Take the values of a newly published configuration (called between frames).
+*/
+void RegionOfInterest::applyConfiguration(PipelineConfiguration * configuration)
+{
+	if (!enabled)
+		sweep_requested = true; // Tracking starts from a complete frame
+
+	enabled = configuration->roi_tracking;
+	margin = configuration->roi_margin;
+	sweep_interval = configuration->roi_sweep_interval;
+}
+
+
+/*
+A box of cells extended on all sides, limited to the grid.
+*/
+Rect RegionOfInterest::dilate(Rect box, int by)
+{
+	int x0 = max(0, box.x - by);
+	int y0 = max(0, box.y - by);
+	int x1 = min(grid_w, box.x + box.width + by);
+	int y1 = min(grid_h, box.y + box.height + by);
+
+	return(Rect(x0, y0, x1 - x0, y1 - y0));
+}
+
+
+/*
+Decide the window of the next frame (call before the binary mask is computed).
+*/
+void RegionOfInterest::planFrame()
+{
+	frames_since_sweep++;
+
+	sweep = !enabled || sweep_requested || (found_cells.area() == 0) || (frames_since_sweep >= sweep_interval);
+
+	if (sweep)
+	{
+		cells = Rect(0, 0, grid_w, grid_h);
+		frames_since_sweep = 0;
+		sweep_requested = false;
+	}
+	else
+	{
+		// The object of the previous frame and the motion allowed until this one
+		cells = dilate(found_cells, (margin + cell_size - 1) / cell_size + ROI_BORDER_CELLS);
+		tracked_cells = cells;
+	}
+
+	pixel_share = (frame_w * frame_h > 0) ? getPixelWindow().area() / (float)(frame_w * frame_h) : 1;
+}
+
+/*
+Find the box of the contour cells inside the window of this frame and rate the window (call after computeContour()).
+*/
+void RegionOfInterest::takeContours(int * contours_grid)
+{
+	int x0 = grid_w, y0 = grid_h, x1 = -1, y1 = -1;
+
+	for (int cy = cells.y; cy < cells.y + cells.height; ++cy)
+		for (int cx = cells.x; cx < cells.x + cells.width; ++cx)
+			if (contours_grid[cy * grid_w + cx] != -1)
+			{
+				x0 = min(x0, cx);
+				y0 = min(y0, cy);
+				x1 = max(x1, cx);
+				y1 = max(y1, cy);
+			}
+
+	found_cells = (x1 >= 0) ? Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1) : Rect();
+
+	if (!enabled)
+		return;
+
+	if (sweep)
+	{
+		// A sweep after tracking shows whether the tracked window missed contours (a new object or a fast motion)
+		if ((tracked_cells.area() > 0) && (x1 >= 0))
+			if ((x0 < tracked_cells.x) || (y0 < tracked_cells.y) || (x1 >= tracked_cells.x + tracked_cells.width) || (y1 >= tracked_cells.y + tracked_cells.height))
+				misses++;
+
+		tracked_cells = Rect();
+		return;
+	}
+
+	// Contours at a border of the window which is not a border of the frame may continue outside of it
+	bool at_border = (x1 >= 0) && (
+		((x0 - cells.x < ROI_BORDER_CELLS) && (cells.x > 0)) ||
+		((y0 - cells.y < ROI_BORDER_CELLS) && (cells.y > 0)) ||
+		((cells.x + cells.width - 1 - x1 < ROI_BORDER_CELLS) && (cells.x + cells.width < grid_w)) ||
+		((cells.y + cells.height - 1 - y1 < ROI_BORDER_CELLS) && (cells.y + cells.height < grid_h)));
+
+	if (at_border)
+	{
+		misses++;
+		sweep_requested = true;
+	}
+	else
+		hits++;
+}
+
+
+Rect RegionOfInterest::getCellWindow()
+{
+	return(cells);
+}
+
+/*
+The window in pixels: the cells and one pixel around them (a complete frame also covers the rest of the frame which is smaller than a cell).
+*/
+Rect RegionOfInterest::getPixelWindow()
+{
+	if ((cells.x == 0) && (cells.y == 0) && (cells.width == grid_w) && (cells.height == grid_h))
+		return(Rect(0, 0, frame_w, frame_h));
+
+	int x0 = max(0, cells.x * cell_size - 1);
+	int y0 = max(0, cells.y * cell_size - 1);
+	int x1 = min(frame_w, (cells.x + cells.width) * cell_size + 1);
+	int y1 = min(frame_h, (cells.y + cells.height) * cell_size + 1);
+
+	return(Rect(x0, y0, x1 - x0, y1 - y0));
+}
+
+
+bool RegionOfInterest::isSweep()
+{
+	return(sweep);
+}
+
+/*
+Share of the pixels of the frame inside the window of the current frame.
+*/
+float RegionOfInterest::getPixelShare()
+{
+	return(pixel_share);
+}
+
+int RegionOfInterest::getHits()
+{
+	return(hits);
+}
+
+int RegionOfInterest::getMisses()
+{
+	return(misses);
+}
+
+void RegionOfInterest::resetStatistics()
+{
+	hits = 0;
+	misses = 0;
+}
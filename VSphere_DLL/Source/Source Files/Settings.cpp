@@ -1,8 +1,16 @@
 /*
 Some global settings.
 
+The values controlling the processing of frames are stored in a PipelineConfiguration.
+They can be changed at runtime through a file or the plugin interface (see VSpherePlugin.cpp).
+A changed configuration is staged first and becomes active when the SphereControler reaches the next frame boundary.
+Without a sphere (before it is created and after it has been destroyed) it becomes active at once.
+Because the active one is published through an atomic pointer, the getters below can be called from any task of the sphere.
+The cameras keep a pointer to their configuration across frames, so they register as users and acknowledge every generation they switch to.
+A replaced configuration is freed at a boundary once every user holds a newer generation.
+Other threads read the values through getConfigurationValue(), which holds the lock against that.
+
 TODO:
-	Enable to adjust more of them from outside the DLL.
 	Perhaps extract the settings related to camera processing to another class individually attached to one certain camera (to enable different processings ettings for every camera)
 
 @Author: Alexander Georgescu
@@ -22,6 +30,14 @@ vector<string> Settings::preview_type_text;
 int Settings::preview_window_variant;
 int Settings::preview_window_order_offset;
 
+atomic<PipelineConfiguration*> Settings::active_configuration(nullptr);
+PipelineConfiguration * Settings::pending_configuration = nullptr;
+vector<PipelineConfiguration*> Settings::retired_configurations;
+vector<int> Settings::user_generations;
+bool Settings::sphere_attached = false;
+mutex Settings::configuration_lock;
+int Settings::last_generation = 0;
+
 
 void Settings::init()
 {
@@ -45,6 +61,10 @@ void Settings::init()
 	};
 
 	max_preview_types = preview_type_text.size();
+
+	// The configuration is kept when the sphere is prepared again
+	if (active_configuration.load() == nullptr)
+		active_configuration.store(new PipelineConfiguration());
 }
 
 ////// Camera processing settings: ///////
@@ -54,7 +74,7 @@ Number of frames to generate the backgroundReference from.
 */
 int Settings::getBackgroundReferenceComputingFrames()
 {
-	return(20);
+	return(getConfiguration()->background_reference_frames);
 }
 
 /*
@@ -63,7 +83,7 @@ See Frameprocessing -> BackgroundReference.cpp for its usage.
 */
 int Settings::getBackgroundColorTolerance()
 {
-	return(35); // 35 //22 // 50
+	return(getConfiguration()->background_color_tolerance); // 35 //22 // 50
 }
 
 /*
@@ -73,7 +93,7 @@ Attention, not all values possible.
 */
 int Settings::getContourMaskSize()
 {
-	return(8); // 4
+	return(getConfiguration()->contour_mask_size); // 4
 }
 
 /*
@@ -81,7 +101,7 @@ How many non-background pixels shall be ignored inside every cell
 */
 int Settings::getNoisepixelTolerance()
 {
-	return(5); // 3 // 5
+	return(getConfiguration()->noisepixel_tolerance); // 3 // 5
 }
 
 /*
@@ -90,7 +110,7 @@ See Frameprocessing -> EdgesIdentifier and look for "merge_optimizable_edges" to
 */
 float Settings::getSegmentOptimisationTolerance()
 {
-	return(0.25f); //0.35f
+	return(getConfiguration()->segment_optimisation_tolerance); //0.35f
 }
 
 /*
@@ -98,7 +118,7 @@ How long the rays can be
 */
 int Settings::getMaxRayLength()
 {
-	return(640);
+	return(getConfiguration()->max_ray_length);
 }
 ///////////
 
@@ -110,12 +130,12 @@ float Settings::getMaxPreviewTypes()
 
 int Settings::getThreadTimeoutMS()
 {
-	return(400);
+	return(getConfiguration()->thread_timeout_ms);
 }
 
 float Settings::getPreviewScaleFactor()
 {
-	return(0.3333);
+	return(getConfiguration()->preview_scale_factor);
 }
 
 
@@ -178,4 +198,222 @@ void Settings::changePreviewWindowOrderOffset(int offset, int maximum)
 void Settings::changePreviewWindowVariant(int variant)
 {
 	preview_window_variant = variant;
-}
\ No newline at end of file
+}
+
+
+
+/*
+Get the active configuration.
+A task of the sphere can use the returned instance until the end of its frame (see publishPendingConfiguration).
+Keeping it longer requires acquireConfiguration().
+*/
+PipelineConfiguration * Settings::getConfiguration()
+{
+	return(active_configuration.load(memory_order_acquire));
+}
+
+float Settings::getConfigurationValue(int key)
+{
+	configuration_lock.lock();
+	float value = getConfiguration()->getValue(key);
+	configuration_lock.unlock();
+
+	return(value);
+}
+
+int Settings::getConfigurationGeneration()
+{
+	configuration_lock.lock();
+	int generation = getConfiguration()->generation;
+	configuration_lock.unlock();
+
+	return(generation);
+}
+
+PipelineConfiguration * Settings::copyConfiguration()
+{
+	configuration_lock.lock();
+	PipelineConfiguration * copy = new PipelineConfiguration(pending_configuration != nullptr ? *pending_configuration : *getConfiguration());
+	configuration_lock.unlock();
+
+	return(copy);
+}
+
+/*
+Change a value of the newest configuration (pending or active) and stage the result.
+*/
+bool Settings::updateConfigurationValue(int key, float value)
+{
+	configuration_lock.lock();
+
+	PipelineConfiguration * configuration = new PipelineConfiguration(pending_configuration != nullptr ? *pending_configuration : *getConfiguration());
+	bool valid = configuration->setValue(key, value);
+
+	if (valid)
+		stageConfiguration(configuration);
+	else
+		delete(configuration);
+
+	bool activated = valid && !sphere_attached && activatePendingConfiguration();
+
+	configuration_lock.unlock();
+
+	if (activated)
+		addInfoLine("Activated configuration generation " + to_string(getConfiguration()->generation) + ".");
+
+	return(valid);
+}
+
+/*
+Apply a configuration file to the newest configuration (pending or active) and stage the result.
+The file is read while the lock is held, so a frame boundary meanwhile waits for it (configuration files only have a few lines).
+*/
+bool Settings::updateConfigurationFromFile(const string & file_path)
+{
+	configuration_lock.lock();
+
+	PipelineConfiguration * configuration = new PipelineConfiguration(pending_configuration != nullptr ? *pending_configuration : *getConfiguration());
+	bool valid = configuration->loadFromFile(file_path);
+
+	if (valid)
+		stageConfiguration(configuration);
+	else
+		delete(configuration);
+
+	bool activated = valid && !sphere_attached && activatePendingConfiguration();
+
+	configuration_lock.unlock();
+
+	if (activated)
+		addInfoLine("Activated configuration generation " + to_string(getConfiguration()->generation) + ".");
+
+	return(valid);
+}
+
+/*
+Stage a new configuration (takes ownership; called while the lock is held). A configuration staged before which has not been published yet is replaced.
+*/
+void Settings::stageConfiguration(PipelineConfiguration * configuration)
+{
+	if (pending_configuration != nullptr)
+		delete(pending_configuration);
+
+	configuration->generation = ++last_generation;
+	pending_configuration = configuration;
+}
+
+/*
+Called by the sphere at a frame boundary, so no task of the previous frame runs anymore.
+*/
+bool Settings::publishPendingConfiguration()
+{
+	configuration_lock.lock();
+
+	releaseUnusedConfigurations();
+	bool activated = activatePendingConfiguration();
+
+	configuration_lock.unlock();
+
+	if (activated)
+		addInfoLine("Activated configuration generation " + to_string(getConfiguration()->generation) + ".");
+
+	return(activated);
+}
+
+/*
+Make the staged configuration active and retire the previous one (called while the lock is held).
+*/
+bool Settings::activatePendingConfiguration()
+{
+	if (pending_configuration == nullptr)
+		return(false);
+
+	PipelineConfiguration * previous = active_configuration.exchange(pending_configuration, memory_order_acq_rel);
+	if (previous != nullptr)
+		retired_configurations.push_back(previous);
+
+	pending_configuration = nullptr;
+
+	return(true);
+}
+
+/*
+Free the retired configurations which every user has replaced by a newer generation (called while the lock is held).
+*/
+void Settings::releaseUnusedConfigurations()
+{
+	int oldest_held = INT_MAX;
+	for (int u = 0; u < user_generations.size(); ++u)
+		oldest_held = min(oldest_held, user_generations[u]);
+
+	for (int i = 0; i < retired_configurations.size(); )
+		if (retired_configurations[i]->generation < oldest_held)
+		{
+			delete(retired_configurations[i]);
+			retired_configurations.erase(retired_configurations.begin() + i);
+		}
+		else
+			++i;
+}
+
+
+/*
+Register a user which keeps a pointer to the configuration (holds none until acquireConfiguration()). Returns its number.
+*/
+int Settings::registerConfigurationUser()
+{
+	configuration_lock.lock();
+	user_generations.push_back(INT_MAX);
+	int user = user_generations.size() - 1;
+	configuration_lock.unlock();
+
+	return(user);
+}
+
+/*
+Take the active configuration. The user holds it (and no older one) until it acquires another one or is released.
+*/
+PipelineConfiguration * Settings::acquireConfiguration(int user)
+{
+	configuration_lock.lock();
+	PipelineConfiguration * configuration = getConfiguration();
+	user_generations[user] = configuration->generation;
+	configuration_lock.unlock();
+
+	return(configuration);
+}
+
+void Settings::releaseConfigurationUser(int user)
+{
+	configuration_lock.lock();
+	user_generations[user] = INT_MAX;
+	configuration_lock.unlock();
+}
+
+
+/*
+Called before the sphere is created: from now on its threads may hold the active configuration, so changes wait for its frame boundaries.
+*/
+void Settings::attachSphere()
+{
+	configuration_lock.lock();
+	sphere_attached = true;
+	configuration_lock.unlock();
+}
+
+/*
+Called after the sphere has been destroyed: no thread holds a configuration anymore, so the retired ones are freed and a staged one becomes active.
+*/
+void Settings::detachSphere()
+{
+	configuration_lock.lock();
+
+	sphere_attached = false;
+	user_generations.clear();
+
+	releaseUnusedConfigurations();
+	activatePendingConfiguration();
+	releaseUnusedConfigurations();
+
+	configuration_lock.unlock();
+}
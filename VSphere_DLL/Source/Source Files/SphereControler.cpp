@@ -2,7 +2,8 @@
 This core class represents a "VSphere" and is created when starting the sphere through the external DLL functions
 See PluginInterface - > VSpherePlugin.cpp for usage.
 
-The class initializes the cameras with their own threads and handles a loop which coordinates the threads with semaphores.
+The class initializes the cameras and handles a loop which processes one frame of all cameras per iteration.
+The processing itself runs as a graph of tasks on the worker threads of a FrameScheduler.
 
 @Author: Alexander Georgescu
 */
@@ -14,6 +15,20 @@ The class initializes the cameras with their own threads and handles a loop whic
 #include "CameraSource.h"
 #include "PerCamControler.h"
 #include "RecordingHandler.h"
+#include "PipelineBenchmark.h"
+#include "FrameScheduler.h"
+#include "CapturePool.h"
+#include "VoxelCarver.h"
+#include "MeshExtractor.h"
+#include "PolyhedralHull.h"
+#include "ModelStream.h"
+#include "ModelRecord.h"
+#include "ThreadPlacement.h"
+#include "AllocationTracker.h"
+
+
+// Wait of the sphere loop before it asks a played model record again which cannot deliver models
+#define MODEL_PLAYBACK_WAIT_MS 100
 
 
 /*
@@ -29,7 +44,9 @@ SphereControler::SphereControler(CameraHandler * camera_set, RecordingHandler *
 
 
 	complete_sphere_content = new vector<int>;
-	threaded_content_computed_and_ready = false;
+
+	memset(&model_timing, 0, sizeof(ModelTiming));
+	start_time = high_resolution_clock::now();
 
 
 
@@ -48,6 +65,9 @@ SphereControler::SphereControler(CameraHandler * camera_set, RecordingHandler *
 
 	addInfoLine("Loading " + to_string(cam_count) + " cameras.");
 
+	// Resolution and frame rate of every camera (everything below sizes itself from them; already done if the texture size has been requested)
+	camera_set->negotiateModes(records);
+
 
 	if (Settings::getPreviewWindowVariant() > 0) // If preview active
 		initPreviewWindows();
@@ -70,48 +90,105 @@ SphereControler::SphereControler(CameraHandler * camera_set, RecordingHandler *
 		}
 	}
 
+	// Create one intersector for every pair of cameras.
+	// With few pairs their work is split into several slices so all workers can take part.
+	int worker_count = FrameScheduler::resolveWorkerCount(Settings::getConfiguration()->worker_threads);
+	int pair_count = cam_count * (cam_count - 1) / 2;
+	int slice_count = max(1, (worker_count + pair_count - 1) / max(1, pair_count));
+
+	for (int c = 0; c < cam_count; c++)
+		for (int d = c + 1; d < cam_count; d++)
+			camera_pairs.push_back(new CameraPairIntersector(camera_controlers[c]->getRayGenerator(), camera_controlers[d]->getRayGenerator(), slice_count));
+
+	for (int c = 0; c < cam_count; c++)
+		camera_controlers[c]->takeCameraPairs(&camera_pairs);
+
+	// The octree of the voxel carving is split into at least one slice per worker and one per camera (every camera gathers the quads of its slices)
+	voxel_carver = new VoxelCarver(max(worker_count, cam_count));
+
+	for (int c = 0; c < cam_count; c++)
+	{
+		voxel_carver->addCamera(camera_controlers[c]->getCameraSource(), camera_controlers[c]->getTexOffsetX(), camera_controlers[c]->getTexOffsetY());
+		camera_controlers[c]->takeVoxelCarver(voxel_carver);
+	}
+
+	voxel_carver->applyConfiguration(Settings::getConfiguration());
+
+	mesh_extractor = new MeshExtractor(voxel_carver);
+
+	// The polyhedral hull is cut by every camera for its own cones
+	polyhedral_hull = new PolyhedralHull();
+
+	for (int c = 0; c < cam_count; c++)
+	{
+		polyhedral_hull->addCamera(camera_controlers[c]->getCameraSource(), camera_controlers[c]->getTexOffsetX(), camera_controlers[c]->getTexOffsetY());
+		camera_controlers[c]->takePolyhedralHull(polyhedral_hull);
+	}
+
+	polyhedral_hull->applyConfiguration(Settings::getConfiguration());
+
 
 
 	addInfoLine("Cameras created.");
 
 
+	// Other processes on this host can read the models from shared memory
+	if (Settings::getConfiguration()->model_stream_quads > 0)
+	{
+		model_stream = new ModelStream();
+		if (!model_stream->open(MODEL_STREAM_NAME, Settings::getConfiguration()->model_stream_quads))
+		{
+			delete(model_stream); // The reason has been reported
+			model_stream = nullptr;
+		}
+	}
+
+	// A played model record replaces grabbing and processing the cameras (see ModelRecord)
+	if ((records != nullptr) && (records->getModelRecord() != nullptr) && records->getModelRecord()->start())
+	{
+		model_record = records->getModelRecord();
+		playing_models = !model_record->getRecording();
+	}
+
+
 	/*
 	Initializes the video input of every camera.
 	By using openCV it creates a handle to the coresponding hardware camera. This allows to check whether the camera actually exists.
-	If the camera does exist, the initialization function here creates the individual threads which
-	constantly handle the associated camera (synchronized with the main trhead through semaphores).
+	The first background reference is computed by the scheduler when the sphere loop starts.
 
 	Note: The function call internally handles whether the real camera is accessed, or it just opens the video file of a recorder!
+	All channels of a device share one handle of the capture pool.
 	*/
+	capture_pool = new CapturePool();
+
+	// All frames are stamped in microseconds since the start of the sphere (see MediaClock)
+	records->getMediaClock()->setOrigin(start_time);
+
 	for (int c = 0; c < cam_count; c++)
 	{
-		if (camera_controlers[c]->initialize())
+		if (camera_controlers[c]->initialize(capture_pool))
 			addInfoLine(camera_controlers[c]->getCameraSource()->getName() + " opened successfully.");
 		else
 			addError(camera_controlers[c]->getCameraSource()->getName() + " FAILED to open!");
 			// Todo: Add a safe error handling; perhaps abortingt he initialisation of whole Sphere.
+
+		capture_pool->addCamera(camera_controlers[c], camera_controlers[c]->isLive());
 	}
 
+	capture_pool->start();
+
 	addInfoLine("All cameras opened.");
 
 
-	// Get the required worker semaphores
-	for (int c = 0; c < cam_count; c++)
-		worker_sems.push_back(camera_controlers[c]->getSem());
+	// The workers processing the tasks of all cameras
+	scheduler = new FrameScheduler(&camera_controlers, &camera_pairs, voxel_carver, mesh_extractor, worker_count, &sphere_latencies[LATENCY_PAIR_SLICE - LATENCY_CAMERA_STAGE_COUNT]);
 
 
 	addInfoLine("STARTING SPHERE!");
 
 
 	// Start the sphere loop
-	localSphereLoop = new thread(launchSphereLoop, this, &worker_sems);
-
-
-
-	// Start processing of the camera
-	for (int c = 0; c < cam_count; c++)
-		camera_controlers[c]->processNextFrame();
-
+	localSphereLoop = new thread(launchSphereLoop, this);
 }
 
 /*
@@ -142,6 +219,14 @@ SphereControler::~SphereControler()
 	}
 	delete(combined_preview_window);
 
+	for (int p = 0; p < camera_pairs.size(); p++)
+		delete(camera_pairs[p]);
+
+	delete(model_stream);
+	delete(polyhedral_hull);
+	delete(mesh_extractor);
+	delete(voxel_carver);
+
 	data_output_lock->unlock();
 	data_output_check_lock->unlock();
 
@@ -158,13 +243,7 @@ Causes the sphere to quit.
 */
 void SphereControler::quit()
 {
-	for (int c = 0; c < cam_count; c++)
-	{
-		camera_threads.push_back((*camera_controlers[c]->getLoopThread()).native_handle());
-		camera_controlers[c]->quit();
-	}
-
-	sphere_running = 0; // Thread about to finish	
+	sphere_running = 0; // Thread about to finish (after the current frame)
 }
 
 /*
@@ -212,76 +291,138 @@ vector<int> * SphereControler::getSphereContentCoordinates()
 	return(complete_sphere_content);
 }
 
+/*
+Get the vertices and the triangles of the mesh (see MeshExtractor). Only valid while the output is locked.
+*/
+vector<int> * SphereControler::getMeshVertices()
+{
+	return(&complete_mesh_vertices);
+}
+vector<int> * SphereControler::getMeshIndices()
+{
+	return(&complete_mesh_indices);
+}
+
+/*
+Get the quads of a level of detail of the model (0 = the full model) or nullptr if the level has not been computed. Only valid while the output is locked.
+*/
+vector<int> * SphereControler::getModelLevel(int level)
+{
+	if (level == 0)
+		return(complete_sphere_content);
+	if ((level < 0) || (level > complete_level_count))
+		return(nullptr);
+
+	return(&complete_detail_levels[level - 1]);
+}
+
 
 
 /*
 Start the loop.
 */
-void SphereControler::launchSphereLoop(SphereControler * thisControler, vector<HANDLE> * workerSems)
+void SphereControler::launchSphereLoop(SphereControler * thisControler)
 {
-	thisControler->sphereLoop(workerSems);
+	thisControler->sphereLoop();
 }
 /*
 Loop function
 */
-void SphereControler::sphereLoop(vector<HANDLE> * workerSems)
+void SphereControler::sphereLoop()
 {
 	sphere_running = 2; // standard running
 
-	camera_threads.clear();
+	// This thread grabs the frames (highest priority when configured, see ThreadPlacement)
+	PipelineConfiguration * configuration = Settings::getConfiguration();
+	bool use_priorities = configuration->thread_priorities; // Read once, the pointer is not kept across frames (see Settings::acquireConfiguration)
+	ThreadPlacement::place(THREAD_ROLE_CAPTURE, 0, ThreadPlacement::planProcessor(THREAD_ROLE_CAPTURE, 0, configuration), use_priorities);
 
 	fpsBench fps_counter;
+	high_resolution_clock::time_point last_output_time;
+	int model_count = 0;
 	int prev_mode = 0;
 	bool press = false;
 
+
+	// Grab the first frame for all channels and compute the first background references
+	if (!playing_models)
+	{
+		records->getMediaClock()->beginFrame();
+		capture_pool->grabAll();
+
+		scheduler->initializeCameras();
+	}
+
+	ModelTiming played_timing;
+	high_resolution_clock::time_point last_frame_start = high_resolution_clock::now();
+
+
 	// Loop
 	while (sphere_running>0)
 	{
 		fps_counter.newFrame(true);
 
 
-		// Grab the next frame for all channels
-		for (int c = 0; c < cam_count; c++)
-			camera_controlers[c]->grabFrame();
-
-		// Send signal to the cameraFrameLoops that next frame can be processed.
-		for (int c = 0; c < cam_count; c++)
-			camera_controlers[c]->processNextFrame();
+		// Frame boundary: A staged configuration becomes active here so every camera processes the frame with it
+		Settings::publishPendingConfiguration();
+		voxel_carver->applyConfiguration(Settings::getConfiguration()); // Places the octree again if its depth changed
+		polyhedral_hull->applyConfiguration(Settings::getConfiguration());
 
 
-		// Wait for signal from the cameraFrameLoops that processing has finished.
-		bool contin = true;
-		while (contin) // Prevent spurious wakeup
+		if (playing_models)
 		{
-			WaitForMultipleObjects(cam_count, &(*workerSems)[0], true, Settings::getThreadTimeoutMS()*1.25f); // not INFINITE 
-			contin = false();
-			for (int c = 0; c < cam_count; c++)
-				if (!camera_controlers[c]->hasComputed()) contin = true;
+			has_new_model_frame = false;
+
+			// The next model comes from the model record as soon as it is decompressed
+			if (!model_record->waitModel())
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(MODEL_PLAYBACK_WAIT_MS));
+				continue;
+			}
 		}
+		else
+		{
+			// Grab the next frame of all devices at the same time and retrieve all channels
+			AllocationTracker::setStage(ALLOCATION_CAPTURE);
 
+			// Records are played at the pace they were recorded in (live cameras wait for their devices anyway)
+			long long frame_interval_us = records->getMediaClock()->getFrameInterval();
+			if (frame_interval_us > 0)
+				std::this_thread::sleep_until(last_frame_start + microseconds(frame_interval_us));
+			last_frame_start = high_resolution_clock::now();
 
-		
-		////// Process everything with the new data
-		
-		
-		
-		
-		if (!threaded_content_computed_and_ready) // the current loop iteration has processed the frames and computed the segments from the 2D images
-		{
-			has_new_model_frame = false;
+			records->getMediaClock()->beginFrame(); // Played cameras take the frames of the next moment of their records
+			capture_pool->grabAll();
+			AllocationTracker::setStage(ALLOCATION_OTHER);
 
-			// -> Give command to compute the sphere content (quads) from the segments
-			for (int c = 0; c < cam_count; c++)
-				camera_controlers[c]->computeSphereContent();
 
-			threaded_content_computed_and_ready = true;
+			has_new_model_frame = false;
+
+			// Process the frame of all cameras: segments, rays, intersections and quads (see FrameScheduler)
+			high_resolution_clock::time_point frame_start = high_resolution_clock::now();
+			scheduler->processFrame();
+			sphere_latencies[LATENCY_SPHERE_FRAME - LATENCY_CAMERA_STAGE_COUNT].recordSince(frame_start);
 		}
-		else // The current iteration has processed the frames and prepared the content
-		{
-			data_output_lock->lock();
 
-			// ->Content is ready
-			complete_sphere_content->clear();
+
+
+		////// Output the content
+
+		data_output_lock->lock();
+		AllocationTracker::setStage(ALLOCATION_OUTPUT);
+
+		// ->Content is ready
+		complete_sphere_content->clear();
+
+		if (playing_models)
+			model_record->takeModel(&played_timing, complete_sphere_content); // Swaps the arrays
+		else
+		{
+			// Only grows when this model is larger than all before
+			int content_size = 0;
+			for (int c = 0; c < cam_count; c++)
+				content_size += camera_controlers[c]->getSphereContent()->size();
+			complete_sphere_content->reserve(content_size);
 
 			// Unite all contents to one array
 			for (int c = 0; c < cam_count; c++)
@@ -291,32 +432,101 @@ void SphereControler::sphereLoop(vector<HANDLE> * workerSems)
 				// Combine to the final dataset
 				complete_sphere_content->insert(end(*complete_sphere_content), begin(*content_data), end(*content_data));
 			}
+		}
 
+		// The coarser levels of the same frame (all cameras computed them with the configuration of this frame; a model record has no levels)
+		PipelineConfiguration * frame_configuration = Settings::getConfiguration();
+		complete_level_count = playing_models ? 0 : frame_configuration->detail_levels;
+		if (complete_detail_levels.size() < complete_level_count)
+			complete_detail_levels.resize(complete_level_count);
 
-			data_output_check_lock->lock();
-			has_new_model_frame = true;
-			data_output_check_lock->unlock();
-
-			data_output_lock->unlock();
+		for (int l = 1; l <= complete_level_count; l++)
+		{
+			vector<int> & level = complete_detail_levels[l - 1];
+			level.clear();
 
-			// Allow to continue
-			ReleaseSemaphore(data_output_sem, 1, NULL);
+			// A camera which has not processed a frame yet has no levels
+			int level_size = 0;
+			for (int c = 0; c < cam_count; c++)
+				if (camera_controlers[c]->getDetailLevels()->getLevelCount() >= l)
+					level_size += camera_controlers[c]->getDetailLevels()->getLevel(l)->size();
+			level.reserve(level_size);
 
-			// -> Give command to compute the segments of the next frame
 			for (int c = 0; c < cam_count; c++)
-				camera_controlers[c]->computeFrameProcess();
-		
+				if (camera_controlers[c]->getDetailLevels()->getLevelCount() >= l)
+				{
+					vector<int> * level_data = camera_controlers[c]->getDetailLevels()->getLevel(l);
+					level.insert(end(level), begin(*level_data), end(*level_data));
+				}
+		}
+
+		// The mesh of the same voxels (assign only grows the arrays)
+		if (frame_configuration->surface_mesh && (frame_configuration->reconstruction_engine == RECONSTRUCTION_ENGINE_VOXELS) && !playing_models)
+		{
+			complete_mesh_vertices.assign(mesh_extractor->getVertices()->begin(), mesh_extractor->getVertices()->end());
+			complete_mesh_indices.assign(mesh_extractor->getIndices()->begin(), mesh_extractor->getIndices()->end());
+		}
+		else
+		{
+			complete_mesh_vertices.clear();
+			complete_mesh_indices.clear();
+		}
 
-			//updateTexture(); // moved to the EndRetrievingModel function
 
-			threaded_content_computed_and_ready = false; 
+		// The model is complete: It gets the next sequence number and the timing of its frames
+		high_resolution_clock::time_point publish_time = high_resolution_clock::now();
+		if (playing_models)
+		{
+			// A played model keeps its recorded durations and its age: it counts as captured published_ms before now
+			model_timing = played_timing;
+			model_timing.sequence = model_count + 1;
+			model_timing.capture_us = duration_cast<microseconds>(publish_time - start_time).count() - (long long)(played_timing.published_ms * 1000);
 		}
-		
+		else
+			computeModelTiming(model_count + 1, publish_time);
+		sphere_latencies[LATENCY_CAPTURE_TO_MODEL - LATENCY_CAMERA_STAGE_COUNT].record(model_timing.published_ms * 1000);
+
+		data_output_check_lock->lock();
+		has_new_model_frame = true;
+		data_output_check_lock->unlock();
+
+		AllocationTracker::setStage(ALLOCATION_OTHER);
+		data_output_lock->unlock();
+
+		// Only this loop changes the content, so it can be copied into the shared memory without holding the output
+		if (model_stream != nullptr)
+			model_stream->publish(model_count + 1, complete_sphere_content, &model_timing);
+
+		// The model record compresses and writes the model on its own thread
+		if ((model_record != nullptr) && !playing_models)
+			model_record->recordModel(&model_timing, complete_sphere_content);
+
+		// Allow to continue
+		ReleaseSemaphore(data_output_sem, 1, NULL);
+
+		// The variation of this interval is the frame time jitter seen by the host
+		high_resolution_clock::time_point output_time = high_resolution_clock::now();
+		if (model_count++ > 0)
+			sphere_latencies[LATENCY_FRAME_INTERVAL - LATENCY_CAMERA_STAGE_COUNT].record((double)duration_cast<microseconds>(output_time - last_output_time).count());
+		last_output_time = output_time;
 
+		//updateTexture(); // moved to the EndRetrievingModel function
 
 
+
+		// The preview comes last: it must not delay the capture of the next frame or the intersections (see ThreadPlacement::setPreviewPriority)
 		if (Settings::getPreviewType() != 0)
+		{
+			if (use_priorities)
+				ThreadPlacement::setPreviewPriority(true);
+
+			AllocationTracker::setStage(ALLOCATION_PREVIEW);
 			handlePreviewWindows();
+			AllocationTracker::setStage(ALLOCATION_OTHER);
+
+			if (use_priorities)
+				ThreadPlacement::setPreviewPriority(false);
+		}
 
 
 		// This code allows to break the computation at the end of a record (only if the cemera inputs are records)
@@ -331,22 +541,13 @@ void SphereControler::sphereLoop(vector<HANDLE> * workerSems)
 	// The loop has ended -> means the Spehre has been caused to quit
 
 
-	// Send the signal a last time to allow the upper calls of camera_controlers[c]->quit(); to take effect and the camera threads quit
-	for (int c = 0; c < cam_count; c++)
-		camera_controlers[c]->processNextFrame();
-
-	time_t ref_time = time(0);
-
-	// Wait until threads have finished
-	WaitForMultipleObjects(camera_threads.size(), &(camera_threads[0]), true, Settings::getThreadTimeoutMS());
-
-	if ((difftime(time(0), ref_time) * 1000) >(Settings::getThreadTimeoutMS()*0.8)) // Timed out 
-	{
-		for (int c = 0; c < cam_count; c++)
-			TerminateThread(camera_threads[c], 0);
+	// No graph is running anymore, so the workers can be stopped
+	delete(scheduler);
+	scheduler = nullptr;
 
-		addError("Quitting the camera threads required killing!");
-	}
+	// Releases the devices
+	delete(capture_pool);
+	capture_pool = nullptr;
 
 	addInfoLine("Quitting main sphere thread.");
 
@@ -479,8 +680,12 @@ void SphereControler::handlePreviewWindows()
 
 		Mat * img = combined_preview_window->getMat();
 
-		// Copy the currently main preview image
-		camera_controlers[cam]->getPreviewImage().copyTo((*img)(Rect(0, 0, refw, refh)));
+		// Copy the currently main preview image (scaled to the size of the first camera if its resolution differs)
+		Mat main_region = (*img)(Rect(0, 0, refw, refh));
+		if (camera_controlers[cam]->getPreviewImage().size() == main_region.size())
+			camera_controlers[cam]->getPreviewImage().copyTo(main_region);
+		else
+			resize(camera_controlers[cam]->getPreviewImage(), main_region, main_region.size(), 0, 0, INTER_AREA);
 
 		// Rescale and copy all other windows
 		for (int c = 0; c < cam_count - 1; c++)
@@ -515,6 +720,166 @@ Set whether all rays should be shown.
 */
 void SphereControler::setShowFullRays(bool showRays)
 {
+	show_full_rays = showRays;
+
 	for (int c = 0; c < cam_count; c++)
 		camera_controlers[c]->setShowFullRays(showRays);
-}
\ No newline at end of file
+}
+
+bool SphereControler::getShowFullRays()
+{
+	return(show_full_rays);
+}
+
+/*
+Copy the numbers of the last frame of a camera.
+*/
+void SphereControler::getCameraStatistics(int list_index, CameraStatistics * target)
+{
+	camera_controlers[list_index]->getStatistics(target);
+}
+
+
+/*
+Fill an array with the latency statistics of every stage of every camera followed by those of the whole sphere.
+Returns the number of elements written.
+*/
+int SphereControler::getLatencyStatistics(LatencyStatistics * statistics, int max_count)
+{
+	int written = 0;
+
+	for (int c = 0; c < cam_count; ++c)
+		for (int stage = 0; (stage < LATENCY_CAMERA_STAGE_COUNT) && (written < max_count); ++stage, ++written)
+		{
+			camera_controlers[c]->getLatencyHistogram(stage)->fillStatistics(&statistics[written]);
+			statistics[written].camera = c;
+			statistics[written].stage = stage;
+		}
+
+	for (int stage = LATENCY_CAMERA_STAGE_COUNT; (stage < LATENCY_STAGE_COUNT) && (written < max_count); ++stage, ++written)
+	{
+		sphere_latencies[stage - LATENCY_CAMERA_STAGE_COUNT].fillStatistics(&statistics[written]);
+		statistics[written].camera = -1;
+		statistics[written].stage = stage;
+	}
+
+	return(written);
+}
+
+/*
+Start all latency histograms again (for example to look at a time window only).
+*/
+void SphereControler::resetLatencyStatistics()
+{
+	for (int c = 0; c < cam_count; ++c)
+		for (int stage = 0; stage < LATENCY_CAMERA_STAGE_COUNT; ++stage)
+			camera_controlers[c]->getLatencyHistogram(stage)->resetValues();
+
+	for (int stage = LATENCY_CAMERA_STAGE_COUNT; stage < LATENCY_STAGE_COUNT; ++stage)
+		sphere_latencies[stage - LATENCY_CAMERA_STAGE_COUNT].resetValues();
+}
+
+
+/*
+Combine the timing of the frames of all cameras into the timing of the model (called while the output is locked).
+The model is as old as its earliest captured frame, a stage is complete when the last camera has finished it.
+How far apart the frames were captured is measured on the media clock, so played cameras count with the captures of their records.
+*/
+void SphereControler::computeModelTiming(int sequence, high_resolution_clock::time_point published)
+{
+	high_resolution_clock::time_point first_capture = published, segmented, rays, intersected, quads;
+	long long first_media = 0, last_media = 0;
+	int camera_count = 0;
+	bool any_camera = false;
+
+	for (int c = 0; c < cam_count; ++c)
+	{
+		if (!camera_controlers[c]->isInitialized())
+			continue;
+
+		FrameTiming timing = camera_controlers[c]->getFrameTiming();
+
+		if (!any_camera)
+		{
+			first_capture = timing.captured;
+			segmented = timing.segmented;
+			rays = timing.rays;
+			intersected = timing.intersected;
+			quads = timing.quads;
+			first_media = last_media = timing.media_us;
+			camera_count = 1;
+			any_camera = true;
+			continue;
+		}
+
+		first_media = min(first_media, timing.media_us);
+		last_media = max(last_media, timing.media_us);
+		camera_count++;
+
+		first_capture = min(first_capture, timing.captured);
+		segmented = max(segmented, timing.segmented);
+		rays = max(rays, timing.rays);
+		intersected = max(intersected, timing.intersected);
+		quads = max(quads, timing.quads);
+	}
+
+	if (!any_camera)
+		segmented = rays = intersected = quads = first_capture;
+
+	model_timing.sequence = sequence;
+	model_timing.capture_us = duration_cast<microseconds>(first_capture - start_time).count();
+	model_timing.capture_spread_ms = (last_media - first_media) / 1000.0f;
+	model_timing.segmented_ms = duration_cast<microseconds>(segmented - first_capture).count() / 1000.0f;
+	model_timing.rays_ms = duration_cast<microseconds>(rays - first_capture).count() / 1000.0f;
+	model_timing.intersected_ms = duration_cast<microseconds>(intersected - first_capture).count() / 1000.0f;
+	model_timing.quads_ms = duration_cast<microseconds>(quads - first_capture).count() / 1000.0f;
+	model_timing.published_ms = duration_cast<microseconds>(published - first_capture).count() / 1000.0f;
+
+	// The skew between the cameras and the offset of every camera to the earliest one
+	if (camera_count > 1)
+	{
+		sphere_latencies[LATENCY_CAPTURE_SKEW - LATENCY_CAMERA_STAGE_COUNT].record((double)(last_media - first_media));
+
+		for (int c = 0; c < cam_count; ++c)
+			if (camera_controlers[c]->isInitialized())
+				camera_controlers[c]->recordSyncOffset((camera_controlers[c]->getFrameTiming().media_us - first_media) / 1000.0f);
+	}
+}
+
+/*
+The timing of the published model. Call it while the output is locked (see lockOutput) to get the timing of exactly the model being read.
+*/
+void SphereControler::getModelTiming(ModelTiming * timing)
+{
+	*timing = model_timing;
+}
+
+/*
+Microseconds since the sphere was created (the clock of ModelTiming::capture_us).
+*/
+long long SphereControler::getSphereTime()
+{
+	return(duration_cast<microseconds>(high_resolution_clock::now() - start_time).count());
+}
+
+
+/*
+Hand a snapshot of every camera to the benchmark.
+Returns false if not all cameras have been initialized yet.
+*/
+bool SphereControler::fillBenchmark(PipelineBenchmark * benchmark)
+{
+	for (int i = 0; i < cam_count; ++i)
+		if (!camera_controlers[i]->isInitialized())
+			return(false);
+
+	for (int i = 0; i < cam_count; ++i)
+	{
+		Mat frame, background;
+		camera_controlers[i]->takeSnapshot(&frame, &background);
+
+		benchmark->addCamera(camera_controlers[i]->getCameraSource(), frame, background, camera_controlers[i]->getTexOffsetX(), camera_controlers[i]->getTexOffsetY());
+	}
+
+	return(true);
+}
@@ -0,0 +1,513 @@
+/*
+A synthetic input for the pipeline: analytic shapes seen by any number of cameras, with the ground truth of the volume.
+
+The shapes (spheres, boxes, tori and articulated cylinders) are placed around the origin; their number is the complexity.
+The cameras are spread on a ring around the origin (alternating above and below it) at half the ray length, looking at the origin
+like configured cameras do (see CameraSource). Every pixel of a camera is traced along the same parallel ray the RayGenerator
+builds for it (sphere tracing of the distance functions), so a frame shows the shaded shapes in front of a textured background
+which is also returned as the background image.
+
+The ground truth is computed on a voxel grid around the shapes:
+	shape voxels	Inside any shape
+	hull voxels		Inside the silhouettes of all cameras (the visual hull, the best any silhouette based model can reach)
+The overlap of both shows how much the camera count limits the accuracy. The model of a pipeline run is compared with the
+surface of the visual hull (see evaluateModel()).
+
+Input:
+	camera count, resolution, complexity
+
+Output:
+	frames and backgrounds		// For the PipelineBenchmark (see fillBenchmark())
+	SyntheticGroundTruth		// Volumes of the shapes and the visual hull
+*/
+
+#include "stdafx.h"
+
+#include "SyntheticScene.h"
+#include "PipelineBenchmark.h"
+
+
+// Voxels per axis of the ground truth grid
+#define SYNTHETIC_GRID_SIZE 80
+
+// Sphere tracing: distance counting as a hit and the maximal steps per pixel (grazing rays count as missing)
+#define SYNTHETIC_TRACE_EPSILON 0.25f
+#define SYNTHETIC_TRACE_STEPS 96
+
+// Elevation of the cameras above and below the ring (radians)
+#define SYNTHETIC_CAMERA_ELEVATION 0.35f
+
+// Width of the camera planes in space (like configured cameras, see ConfigureCamera), so the scene is the same at every resolution
+#define SYNTHETIC_VIEW_WIDTH 640
+
+
+SyntheticScene::SyntheticScene(int camera_count, int width, int height, int complexity, int max_ray_length)
+{
+	this->width = width;
+	this->height = height;
+	this->max_ray_length = max_ray_length;
+
+	pixel_size = SYNTHETIC_VIEW_WIDTH / (float)width;
+
+	buildShapes(max(1, complexity));
+	placeCameras(camera_count);
+
+	for (int c = 0; c < camera_count; ++c)
+		render(c);
+
+	computeGroundTruth();
+}
+
+SyntheticScene::~SyntheticScene()
+{
+	for (int c = 0; c < camera_sources.size(); ++c)
+		delete(camera_sources[c]);
+}
+
+
+/*
+Place the shapes on a spiral around the origin. Every fourth primitive is of the same type and they get smaller outwards.
+*/
+void SyntheticScene::buildShapes(int complexity)
+{
+	shape_count = complexity;
+
+	// The shapes have to stay inside the images and the rays of all cameras
+	float size = min(0.3f * min(width, height) * pixel_size, 0.15f * max_ray_length);
+
+	const unsigned char colors[4][3] = { { 240, 200, 180 }, { 180, 240, 200 }, { 200, 180, 240 }, { 240, 240, 170 } }; // BGR
+
+	for (int i = 0; i < complexity; ++i)
+	{
+		float fraction = (i + 0.5f) / complexity;
+		float distance = (complexity == 1) ? 0 : 0.5f * size * sqrt(fraction);
+		float theta = i * 2.39996f; // Golden angle
+		float phi = acos(1 - 2 * fraction);
+
+		vector3df position(distance * sin(phi) * cos(theta), distance * cos(phi), distance * sin(phi) * sin(theta));
+		float s = 0.35f * size / (1 + 0.15f * i);
+
+		SyntheticShape shape;
+		shape.a = position;
+		shape.b = position;
+		shape.half_size = vector3df(0, 0, 0);
+		shape.radius = s;
+		shape.minor_radius = 0;
+		memcpy(shape.color, colors[i % 4], 3);
+
+		switch (i % 4)
+		{
+		case 0:
+			shape.type = SHAPE_SPHERE;
+			shapes.push_back(shape);
+			break;
+		case 1:
+			shape.type = SHAPE_BOX;
+			shape.half_size = vector3df(0.9f * s, 0.6f * s, 0.45f * s);
+			shapes.push_back(shape);
+			break;
+		case 2:
+			shape.type = SHAPE_TORUS;
+			shape.radius = 0.8f * s;
+			shape.minor_radius = 0.28f * s;
+			shapes.push_back(shape);
+			break;
+		case 3:
+			// Articulated cylinder: three capsules bending at the joints
+			shape.type = SHAPE_CAPSULE;
+			shape.radius = 0.22f * s;
+			for (int j = 0; j < 3; ++j)
+			{
+				vector3df direction(cos(theta + 0.9f * j), (j == 1) ? -0.2f : 0.5f, sin(theta + 0.9f * j));
+				direction.normalize();
+
+				shape.b = shape.a + direction * (0.9f * s);
+				shapes.push_back(shape);
+				shape.a = shape.b;
+			}
+			break;
+		}
+	}
+
+	bound_radius = 0;
+	for (int i = 0; i < shapes.size(); ++i)
+	{
+		SyntheticShape & shape = shapes[i];
+		float extent = 0;
+
+		switch (shape.type)
+		{
+		case SHAPE_SPHERE: extent = shape.a.getLength() + shape.radius; break;
+		case SHAPE_BOX: extent = shape.a.getLength() + shape.half_size.getLength(); break;
+		case SHAPE_TORUS: extent = shape.a.getLength() + shape.radius + shape.minor_radius; break;
+		case SHAPE_CAPSULE: extent = max(shape.a.getLength(), shape.b.getLength()) + shape.radius; break;
+		}
+
+		bound_radius = max(bound_radius, extent);
+	}
+}
+
+/*
+Cameras on a ring around the origin at half the ray length, every second one above the ring and the others below.
+*/
+void SyntheticScene::placeCameras(int camera_count)
+{
+	float distance = max_ray_length / 2.0f;
+
+	for (int c = 0; c < camera_count; ++c)
+	{
+		// Half a step off the Z axis: quaternion::lookRotation() is undefined for cameras looking exactly along -Z
+		float azimuth = 2 * (float)M_PI * (c + 0.5f) / camera_count;
+		float elevation = (c % 2 == 0) ? SYNTHETIC_CAMERA_ELEVATION : -SYNTHETIC_CAMERA_ELEVATION / 2;
+
+		vector3df origin(distance * cos(elevation) * sin(azimuth), distance * sin(elevation), distance * cos(elevation) * cos(azimuth));
+
+		camera_sources.push_back(new CameraSource(c, c, false, vector2di(SYNTHETIC_VIEW_WIDTH, (int)(height * pixel_size)), origin, vector3df(0, 0, 0), 0));
+		camera_sources.back()->setMode(vector2di(width, height), 0);
+	}
+}
+
+
+/*
+Distance from a point to the closest shape (negative inside).
+*/
+float SyntheticScene::distance(vector3df point, int * nearest_shape)
+{
+	float nearest = FLT_MAX;
+
+	for (int i = 0; i < shapes.size(); ++i)
+	{
+		SyntheticShape & shape = shapes[i];
+		vector3df p = point - shape.a;
+		float d = 0;
+
+		switch (shape.type)
+		{
+		case SHAPE_SPHERE:
+			d = p.getLength() - shape.radius;
+			break;
+		case SHAPE_BOX:
+		{
+			vector3df q(abs(p.X) - shape.half_size.X, abs(p.Y) - shape.half_size.Y, abs(p.Z) - shape.half_size.Z);
+			vector3df outside(max(q.X, 0.0f), max(q.Y, 0.0f), max(q.Z, 0.0f));
+			d = outside.getLength() + min(max(q.X, max(q.Y, q.Z)), 0.0f);
+			break;
+		}
+		case SHAPE_TORUS:
+		{
+			float ring = sqrt(p.X * p.X + p.Z * p.Z) - shape.radius;
+			d = sqrt(ring * ring + p.Y * p.Y) - shape.minor_radius;
+			break;
+		}
+		case SHAPE_CAPSULE:
+		{
+			vector3df axis = shape.b - shape.a;
+			float h = max(0.0f, min(1.0f, p.dotProduct(axis) / axis.dotProduct(axis)));
+			d = (p - axis * h).getLength() - shape.radius;
+			break;
+		}
+		}
+
+		if (d < nearest)
+		{
+			nearest = d;
+			if (nearest_shape != nullptr)
+				*nearest_shape = i;
+		}
+	}
+
+	return(nearest);
+}
+
+vector3df SyntheticScene::normal(vector3df point)
+{
+	const float e = 0.5f;
+
+	vector3df n(distance(point + vector3df(e, 0, 0), nullptr) - distance(point - vector3df(e, 0, 0), nullptr),
+				distance(point + vector3df(0, e, 0), nullptr) - distance(point - vector3df(0, e, 0), nullptr),
+				distance(point + vector3df(0, 0, e), nullptr) - distance(point - vector3df(0, 0, e), nullptr));
+	n.normalize();
+
+	return(n);
+}
+
+/*
+Follow a ray of a camera over the whole ray length and find the first shape it hits.
+*/
+bool SyntheticScene::trace(vector3df start, vector3df direction, vector3df * hit, int * hit_shape)
+{
+	// Only the part inside the bounding sphere has to be traced
+	float b = start.dotProduct(direction);
+	float discriminant = b * b - (start.dotProduct(start) - bound_radius * bound_radius);
+
+	if (discriminant < 0)
+		return(false);
+
+	float t = max(0.0f, -b - sqrt(discriminant));
+	float t_end = min((float)max_ray_length, -b + sqrt(discriminant));
+
+	for (int step = 0; (step < SYNTHETIC_TRACE_STEPS) && (t <= t_end); ++step)
+	{
+		vector3df point = start + direction * t;
+		float d = distance(point, hit_shape);
+
+		if (d < SYNTHETIC_TRACE_EPSILON)
+		{
+			*hit = point;
+			return(true);
+		}
+
+		t += d;
+	}
+
+	return(false);
+}
+
+
+/*
+Render the frame, the background and the silhouette of a camera.
+*/
+void SyntheticScene::render(int camera)
+{
+	CameraSource * source = camera_sources[camera];
+	quaternion direction = source->getDirection();
+
+	vector3df right = direction * vector3df(1, 0, 0);
+	vector3df up = direction * vector3df(0, 1, 0);
+	vector3df forward = direction * vector3df(0, 0, 1);
+	vector3df left_top = source->getOrigin() + source->getToCorner();
+
+	vector3df light = up * 0.5f - forward;
+	light.normalize();
+
+	Mat frame(height, width, CV_8UC3), background(height, width, CV_8UC3), mask(height, width, CV_8UC1, Scalar(0));
+
+	uchar * f = frame.ptr<uchar>(0);
+	uchar * b = background.ptr<uchar>(0);
+	uchar * m = mask.ptr<uchar>(0);
+
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x)
+		{
+			int i = y * width + x;
+
+			// Dark texture which differs between the cameras
+			b[i * 3] = f[i * 3] = (uchar)(70 + 25 * sin(x * 0.045f + camera) * cos(y * 0.06f));
+			b[i * 3 + 1] = f[i * 3 + 1] = (uchar)(60 + 20 * sin((x + y) * 0.03f));
+			b[i * 3 + 2] = f[i * 3 + 2] = (uchar)(80 + 20 * cos(x * 0.02f - y * 0.05f + camera));
+
+			// The ray of the pixel (see RayGenerator::addRay)
+			vector3df hit;
+			int shape;
+
+			if (trace(left_top + (right * (x + 0.5f) - up * (y + 0.5f)) * pixel_size, forward, &hit, &shape))
+			{
+				float shade = 0.65f + 0.35f * max(0.0f, normal(hit).dotProduct(light));
+
+				for (int ch = 0; ch < 3; ++ch)
+					f[i * 3 + ch] = (uchar)(shapes[shape].color[ch] * shade);
+				m[i] = 255;
+			}
+		}
+
+	frames.push_back(frame);
+	backgrounds.push_back(background);
+	masks.push_back(mask);
+}
+
+/*
+The pixel of a camera a point is seen in (false if outside the image or the ray length).
+*/
+bool SyntheticScene::project(int camera, vector3df point, int * x, int * y)
+{
+	CameraSource * source = camera_sources[camera];
+	quaternion direction = source->getDirection();
+
+	vector3df relative = point - (source->getOrigin() + source->getToCorner());
+
+	float depth = relative.dotProduct(direction * vector3df(0, 0, 1));
+	if ((depth < 0) || (depth > max_ray_length))
+		return(false);
+
+	*x = (int)floor(relative.dotProduct(direction * vector3df(1, 0, 0)) / pixel_size);
+	*y = (int)floor(-relative.dotProduct(direction * vector3df(0, 1, 0)) / pixel_size);
+
+	return((*x >= 0) && (*x < width) && (*y >= 0) && (*y < height));
+}
+
+
+int SyntheticScene::voxelIndex(int x, int y, int z)
+{
+	return((z * grid_size + y) * grid_size + x);
+}
+
+/*
+Classify every voxel of the grid and find the surface of the visual hull.
+*/
+void SyntheticScene::computeGroundTruth()
+{
+	grid_size = SYNTHETIC_GRID_SIZE;
+	float half = bound_radius * 1.05f;
+	grid_min = vector3df(-half, -half, -half);
+	voxel_size = 2 * half / grid_size;
+
+	int voxel_count = grid_size * grid_size * grid_size;
+	shape_grid.assign(voxel_count, 0);
+	hull_grid.assign(voxel_count, 0);
+	surface_grid.assign(voxel_count, 0);
+
+	shape_voxels = hull_voxels = overlap_voxels = surface_voxels = 0;
+
+	for (int z = 0; z < grid_size; ++z)
+		for (int y = 0; y < grid_size; ++y)
+			for (int x = 0; x < grid_size; ++x)
+			{
+				vector3df center = grid_min + vector3df(x + 0.5f, y + 0.5f, z + 0.5f) * voxel_size;
+				int v = voxelIndex(x, y, z);
+
+				shape_grid[v] = (distance(center, nullptr) <= 0);
+
+				bool inside_all = true;
+				for (int c = 0; (c < camera_sources.size()) && inside_all; ++c)
+				{
+					int px, py;
+					inside_all = project(c, center, &px, &py) && (masks[c].ptr<uchar>(0)[py * width + px] != 0);
+				}
+				hull_grid[v] = inside_all;
+
+				shape_voxels += shape_grid[v];
+				hull_voxels += hull_grid[v];
+				overlap_voxels += (shape_grid[v] && hull_grid[v]);
+			}
+
+	// Surface: hull voxels with a neighbour outside the hull
+	const int offsets[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+	for (int z = 0; z < grid_size; ++z)
+		for (int y = 0; y < grid_size; ++y)
+			for (int x = 0; x < grid_size; ++x)
+			{
+				if (!hull_grid[voxelIndex(x, y, z)])
+					continue;
+
+				for (int n = 0; n < 6; ++n)
+				{
+					int nx = x + offsets[n][0], ny = y + offsets[n][1], nz = z + offsets[n][2];
+
+					if ((nx < 0) || (ny < 0) || (nz < 0) || (nx >= grid_size) || (ny >= grid_size) || (nz >= grid_size) || !hull_grid[voxelIndex(nx, ny, nz)])
+					{
+						surface_grid[voxelIndex(x, y, z)] = 1;
+						surface_voxels++;
+						break;
+					}
+				}
+			}
+}
+
+
+int SyntheticScene::getCameraCount()
+{
+	return(camera_sources.size());
+}
+
+CameraSource * SyntheticScene::getCameraSource(int camera)
+{
+	return(camera_sources[camera]);
+}
+
+/*
+Hand the frames of all cameras to the benchmark (the cameras stay owned by this scene).
+*/
+void SyntheticScene::fillBenchmark(PipelineBenchmark * benchmark)
+{
+	for (int c = 0; c < camera_sources.size(); ++c)
+		benchmark->addCamera(camera_sources[c], frames[c], backgrounds[c], 0, 0);
+
+	benchmark->setGroundTruth(this);
+}
+
+
+/*
+Whether a point is within one voxel of the surface of the visual hull.
+*/
+bool SyntheticScene::nearSurface(vector3df point)
+{
+	vector3df cell = (point - grid_min) / voxel_size;
+	int x = (int)floor(cell.X), y = (int)floor(cell.Y), z = (int)floor(cell.Z);
+
+	for (int dz = -1; dz <= 1; ++dz)
+		for (int dy = -1; dy <= 1; ++dy)
+			for (int dx = -1; dx <= 1; ++dx)
+			{
+				int nx = x + dx, ny = y + dy, nz = z + dz;
+				if ((nx >= 0) && (ny >= 0) && (nz >= 0) && (nx < grid_size) && (ny < grid_size) && (nz < grid_size) && surface_grid[voxelIndex(nx, ny, nz)])
+					return(true);
+			}
+
+	return(false);
+}
+
+/*
+Compare the quads of a model (output of the ModelBuilders of all cameras) with the surface of the visual hull.
+precision: share of the quad centers within one voxel of the surface
+coverage: share of the surface voxels with a quad center within one voxel
+*/
+void SyntheticScene::evaluateModel(vector<vector<int>*> * models, float * precision, float * coverage)
+{
+	vector<unsigned char> covered(surface_grid.size(), 0);
+	int samples = 0, samples_near = 0, covered_voxels = 0;
+
+	for (int m = 0; m < models->size(); ++m)
+	{
+		vector<int> & model = *(*models)[m];
+
+		for (int q = 0; q + 20 <= model.size(); q += 20) // 4 corners with 3 coordinates (times 100) and 8 texture coordinates
+		{
+			vector3df center((model[q] + model[q + 3] + model[q + 6] + model[q + 9]) / 400.0f,
+							 (model[q + 1] + model[q + 4] + model[q + 7] + model[q + 10]) / 400.0f,
+							 (model[q + 2] + model[q + 5] + model[q + 8] + model[q + 11]) / 400.0f);
+			samples++;
+
+			if (!nearSurface(center))
+				continue;
+			samples_near++;
+
+			vector3df cell = (center - grid_min) / voxel_size;
+			int x = (int)floor(cell.X), y = (int)floor(cell.Y), z = (int)floor(cell.Z);
+
+			for (int dz = -1; dz <= 1; ++dz)
+				for (int dy = -1; dy <= 1; ++dy)
+					for (int dx = -1; dx <= 1; ++dx)
+					{
+						int nx = x + dx, ny = y + dy, nz = z + dz;
+						if ((nx < 0) || (ny < 0) || (nz < 0) || (nx >= grid_size) || (ny >= grid_size) || (nz >= grid_size))
+							continue;
+
+						int v = voxelIndex(nx, ny, nz);
+						if (surface_grid[v] && !covered[v])
+						{
+							covered[v] = 1;
+							covered_voxels++;
+						}
+					}
+		}
+	}
+
+	*precision = (samples > 0) ? (float)samples_near / samples : 0;
+	*coverage = (surface_voxels > 0) ? (float)covered_voxels / surface_voxels : 0;
+}
+
+void SyntheticScene::getGroundTruth(SyntheticGroundTruth * truth)
+{
+	truth->camera_count = camera_sources.size();
+	truth->width = width;
+	truth->height = height;
+	truth->shape_count = shape_count;
+	truth->grid_size = grid_size;
+	truth->voxel_size = voxel_size;
+	truth->shape_voxels = shape_voxels;
+	truth->hull_voxels = hull_voxels;
+
+	int union_voxels = shape_voxels + hull_voxels - overlap_voxels;
+	truth->volume_overlap = (union_voxels > 0) ? (float)overlap_voxels / union_voxels : 0;
+}
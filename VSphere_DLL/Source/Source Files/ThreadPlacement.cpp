@@ -0,0 +1,275 @@
+/*
+Places the threads of the sphere on logical processors and sets their priorities (configuration keys "thread_pinning",
+"first_processor" and "thread_priorities", read when the sphere starts).
+
+Processors are numbered over all processor groups (group 0 first). NUMA nodes are numbered in the order of their processors,
+nodes without processors are skipped.
+With THREAD_PINNING_NUMA every camera has a home node and the FrameScheduler prefers the workers of that node for its tasks.
+Its initialization task, which allocates the frame, mask, grid and ray buffers, only runs on a worker of the home node
+(unless the node has none), so their pages are touched first (and placed by Windows) there.
+Buffers which grow later can land on another node, since idle workers take the frame tasks of other nodes.
+
+Every placed thread is registered and reported through GetThreadPlacements() until the sphere is started again.
+
+Input:
+	PipelineConfiguration	// Pinning policy and priorities
+
+Output:
+	ThreadPlacementInfo		// For every thread of the sphere
+*/
+
+#include "stdafx.h"
+
+#include "ThreadPlacement.h"
+#include "AllocationTracker.h"
+
+#include <algorithm>
+
+
+vector<ThreadPlacementInfo> ThreadPlacement::placements;
+mutex ThreadPlacement::placements_lock;
+ThreadPlacement::TaskCounters ThreadPlacement::task_counters[PLACEMENT_COUNTED_THREADS];
+
+
+int ThreadPlacement::getProcessorCount()
+{
+	return(max(1, (int)GetActiveProcessorCount(ALL_PROCESSOR_GROUPS)));
+}
+
+/*
+Translate a processor number counted over all groups into the group and the number within it.
+*/
+bool ThreadPlacement::toProcessorNumber(int processor, PROCESSOR_NUMBER * number)
+{
+	int group_count = GetActiveProcessorGroupCount();
+
+	for (int g = 0; g < group_count; ++g)
+	{
+		int group_size = GetActiveProcessorCount(g);
+
+		if (processor < group_size)
+		{
+			number->Group = g;
+			number->Number = processor;
+			number->Reserved = 0;
+			return(true);
+		}
+		processor -= group_size;
+	}
+
+	return(false);
+}
+
+/*
+The processors of every NUMA node which has any.
+*/
+vector<vector<int>> ThreadPlacement::getNodeProcessors()
+{
+	ULONG highest_node = 0;
+	if (!GetNumaHighestNodeNumber(&highest_node))
+		highest_node = 0;
+
+	vector<vector<int>> nodes(highest_node + 1);
+
+	for (int p = 0; p < getProcessorCount(); ++p)
+	{
+		PROCESSOR_NUMBER number;
+		USHORT node = 0;
+
+		if (!toProcessorNumber(p, &number) || !GetNumaProcessorNodeEx(&number, &node) || (node > highest_node))
+			node = 0;
+
+		nodes[node].push_back(p);
+	}
+
+	vector<vector<int>> used_nodes;
+	for (int n = 0; n < nodes.size(); ++n)
+		if (!nodes[n].empty())
+			used_nodes.push_back(nodes[n]);
+
+	return(used_nodes);
+}
+
+int ThreadPlacement::getNodeCount()
+{
+	return(max(1, (int)getNodeProcessors().size()));
+}
+
+/*
+The node of a processor (0 if unknown).
+*/
+int ThreadPlacement::getNode(int processor)
+{
+	vector<vector<int>> nodes = getNodeProcessors();
+
+	for (int n = 0; n < nodes.size(); ++n)
+		for (int i = 0; i < nodes[n].size(); ++i)
+			if (nodes[n][i] == processor)
+				return(n);
+
+	return(0);
+}
+
+
+/*
+The processor a thread should be pinned to (-1 = not pinned).
+index is the number of a worker; the capture thread takes the first processor, the workers the following ones.
+*/
+int ThreadPlacement::planProcessor(int role, int index, PipelineConfiguration * configuration)
+{
+	if ((configuration->thread_pinning == THREAD_PINNING_NONE) || (role == THREAD_ROLE_CONTROL) || (role == THREAD_ROLE_GRABBER) || (role == THREAD_ROLE_RECORDER))
+		return(-1); // The control thread only waits, the grabbers mostly wait for their devices and the recorder for the disk
+
+	int count = getProcessorCount();
+	int first = configuration->first_processor % count;
+
+	if ((role == THREAD_ROLE_CAPTURE) || (count == 1))
+		return(first);
+
+	if (configuration->thread_pinning == THREAD_PINNING_COMPACT)
+		return((first + 1 + index % (count - 1)) % count);
+
+
+	// NUMA: Worker after worker on the next node, starting with the node of the capture thread
+	vector<vector<int>> nodes = getNodeProcessors();
+	int node_count = nodes.size();
+
+	vector<int> & node = nodes[(getNode(first) + index) % node_count];
+
+	if (node.size() > 1) // Keep the processor of the capture thread free
+		node.erase(remove(node.begin(), node.end(), first), node.end());
+
+	return(node[(index / node_count) % node.size()]);
+}
+
+/*
+The home node of a camera (always 0 unless pinning per NUMA node).
+*/
+int ThreadPlacement::getCameraNode(int camera, PipelineConfiguration * configuration)
+{
+	if (configuration->thread_pinning != THREAD_PINNING_NUMA)
+		return(0);
+
+	return((getNode(configuration->first_processor % getProcessorCount()) + camera) % getNodeCount());
+}
+
+
+/*
+Capture and grabbers > workers (intersections) > control, recorder and preview
+*/
+int ThreadPlacement::getRolePriority(int role)
+{
+	switch (role)
+	{
+	case THREAD_ROLE_CAPTURE: return(THREAD_PRIORITY_HIGHEST);
+	case THREAD_ROLE_GRABBER: return(THREAD_PRIORITY_HIGHEST);
+	case THREAD_ROLE_WORKER: return(THREAD_PRIORITY_ABOVE_NORMAL);
+	case THREAD_ROLE_CONTROL: return(THREAD_PRIORITY_BELOW_NORMAL);
+	case THREAD_ROLE_RECORDER: return(THREAD_PRIORITY_BELOW_NORMAL);
+	}
+
+	return(THREAD_PRIORITY_NORMAL);
+}
+
+
+/*
+Pin the calling thread to the given processor (if not -1), set the priority of its role and register it.
+Returns the number of the registration (for countTask).
+*/
+int ThreadPlacement::place(int role, int index, int processor, bool use_priorities)
+{
+	HANDLE thread_handle = GetCurrentThread();
+
+	if (processor >= 0)
+	{
+		PROCESSOR_NUMBER number;
+		GROUP_AFFINITY affinity;
+		memset(&affinity, 0, sizeof(GROUP_AFFINITY));
+
+		if (toProcessorNumber(processor, &number))
+		{
+			affinity.Group = number.Group;
+			affinity.Mask = (KAFFINITY)1 << number.Number;
+		}
+
+		if ((affinity.Mask == 0) || !SetThreadGroupAffinity(thread_handle, &affinity, NULL))
+		{
+			addError("Could not pin a thread to processor " + to_string(processor) + ".");
+			processor = -1;
+		}
+	}
+
+	if (use_priorities)
+		if (!SetThreadPriority(thread_handle, getRolePriority(role)))
+			addError("Could not set the priority of a thread.");
+
+	ThreadPlacementInfo info;
+	info.role = role;
+	info.index = index;
+	info.processor = processor;
+	info.numa_node = (processor >= 0) ? getNode(processor) : -1;
+	info.priority = GetThreadPriority(thread_handle);
+	info.tasks = 0;
+	info.foreign_tasks = 0;
+
+	AllocationTracker::nameThread(role, index);
+
+	lock_guard<mutex> guard(placements_lock);
+	placements.push_back(info);
+	return(placements.size() - 1);
+}
+
+/*
+Count a task executed by a registered worker (called for every task, so it only touches the counters of the worker).
+*/
+void ThreadPlacement::countTask(int placement, bool foreign)
+{
+	TaskCounters & counters = task_counters[min(placement, PLACEMENT_COUNTED_THREADS - 1)];
+
+	counters.tasks.fetch_add(1, memory_order_relaxed);
+	if (foreign)
+		counters.foreign_tasks.fetch_add(1, memory_order_relaxed);
+}
+
+
+/*
+The capture thread draws the preview between two frames. Meanwhile it runs below the workers and the grabbers (only called when priorities are used).
+*/
+void ThreadPlacement::setPreviewPriority(bool drawing)
+{
+	SetThreadPriority(GetCurrentThread(), drawing ? THREAD_PRIORITY_BELOW_NORMAL : getRolePriority(THREAD_ROLE_CAPTURE));
+}
+
+
+/*
+Copy the registrations into an array of the caller. Returns the number of elements written.
+*/
+int ThreadPlacement::getPlacements(ThreadPlacementInfo * infos, int max_count)
+{
+	lock_guard<mutex> guard(placements_lock);
+
+	int count = min((int)placements.size(), max_count);
+	for (int i = 0; i < count; ++i)
+	{
+		infos[i] = placements[i];
+		infos[i].tasks = (int)task_counters[min(i, PLACEMENT_COUNTED_THREADS - 1)].tasks.load(memory_order_relaxed);
+		infos[i].foreign_tasks = (int)task_counters[min(i, PLACEMENT_COUNTED_THREADS - 1)].foreign_tasks.load(memory_order_relaxed);
+	}
+
+	return(count);
+}
+
+/*
+Forget all registrations (when the sphere starts, before any of its threads is placed).
+*/
+void ThreadPlacement::reset()
+{
+	lock_guard<mutex> guard(placements_lock);
+	placements.clear();
+
+	for (int t = 0; t < PLACEMENT_COUNTED_THREADS; ++t)
+	{
+		task_counters[t].tasks = 0;
+		task_counters[t].foreign_tasks = 0;
+	}
+}
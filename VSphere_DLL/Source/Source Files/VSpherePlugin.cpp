@@ -35,6 +35,11 @@ Therefore the entire unity editor has to be shut down before recompiling.
 #include "SphereControler.h"
 #include "CameraHandler.h"
 #include "RecordingHandler.h"
+#include "PipelineBenchmark.h"
+#include "ThreadPlacement.h"
+#include "AllocationTracker.h"
+#include "SyntheticScene.h"
+#include "CustomMath.h"
 
 
 
@@ -124,7 +129,7 @@ extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureCamera(int ha
 	int ind;
 	if (hardware_channel < 0)
 		ind = camera_set->addCamera(hardware_index,
-			vector2di(640, 480), // Todo: Add automatical retrieval of the maximum camera resolution or allow this as external arguments
+			vector2di(640, 480), // Width of the camera plane in space and the requested resolution (see ConfigureCameraMode())
 			vector3df(location_x, location_y, location_z),
 			vector3df(offset_x, offset_y, offset_z),
 			focus_value);
@@ -141,6 +146,36 @@ extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureCamera(int ha
 	return(ind);
 }
 
+/*
+Request the resolution and frame rate of a configured camera (640x480 by default). Has to be called before the texture size is requested and before StartSphere().
+The camera plane keeps its size in space, so a higher resolution only gives finer pixels.
+If the camera does not deliver the mode, the next smaller one of 1920x1080, 1280x720 and 640x480 is tried; in the end the camera keeps what it delivers.
+Cameras played from a record always take the mode of the record. GetCameraInfos() returns the negotiated modes once the texture size has been requested or the sphere has started.
+-- Arguments:
+configured_camera_index: Number returned by the ConfigureCamera() function.
+width, height: Requested resolution in pixels (0 = the largest one available)
+fps: Requested frame rate (0 = whatever the camera delivers)
+*/
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureCameraMode(int configured_camera_index, int width, int height, int fps)
+{
+	if ((camera_set == nullptr) || (configured_camera_index < 0) || (configured_camera_index >= camera_set->getCount()) || (width < 0) || (height < 0) || (fps < 0))
+	{
+		addError("Invalid camera mode for camera with index " + to_string(configured_camera_index) + ".");
+		return(false);
+	}
+	if (sphere_already_running)
+	{
+		addError("The camera mode cannot be changed while the sphere is running.");
+		return(false);
+	}
+
+	camera_set->getCameraSource(configured_camera_index)->requestMode(vector2di(width, height), fps);
+
+	addInfoLine("Requested " + to_string(width) + "x" + to_string(height) + " pixels at " + to_string(fps) + " fps for camera with index " + to_string(configured_camera_index) + ".");
+
+	return(true);
+}
+
 /*
 Configure a recording handler. This allows to either record the entire streams as well as the background reference to files, or paly fromt hsoe files.
 -- Arguments:
@@ -167,6 +202,41 @@ extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureRecordHandle
 	return(true);
 }
 
+/*
+Configure the model record. This allows to record every published model (its quads and timing) to a compressed file,
+or to play such a file instead of reconstructing the models: the models are then published as fast as they are decompressed,
+without grabbing or processing any camera (for demonstrations, regression tests and load tests of the consumers; see ModelRecord).
+-- Arguments:
+file_path: File to write or load from (without extension)
+type: 0 = nothing; 1 = new recording; 2 = playback;
+*/
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ConfigureModelRecord(char* file_path, int type)
+{
+	if ((recorder_set == nullptr) || (type < 0) || (type > 2))
+		return(false);
+	if (sphere_already_running)
+	{
+		addError("The model record cannot be changed while the sphere is running.");
+		return(false);
+	}
+
+	string path = MakeStringCopy(file_path);
+
+	if (type == 1)
+	{
+		recorder_set->addModelRecord(path);
+		addInfoLine("Configured recording of the models.");
+	}
+	if (type == 2)
+	{
+		recorder_set->playModelRecord(path);
+		addInfoLine("Configured playback of the models.");
+	}
+	addInfoLine("File path is: " + path);
+
+	return(true);
+}
+
 /*
 Starts the actual sphere (in an alternate thread) and returns. This has to be called after cameras and records have been set.
 -- Arguments:
@@ -197,7 +267,10 @@ This thread does not finish until the sphere has not closed and cleaned up.
 */
 void startThreadedSphere()
 {
-	// Create/start the VR sphere
+	ThreadPlacement::reset(); // Only the threads of this run are reported
+
+	// Create/start the VR sphere (its threads start in the constructor, so from now on configurations are only published at its frame boundaries)
+	Settings::attachSphere();
 	VSphere = new SphereControler(camera_set, recorder_set);
 
 	// Enable texture
@@ -209,6 +282,9 @@ void startThreadedSphere()
 	// Signalize that the sphere is ready. // TODO: Replace this boolean by an atomic if unstable
 	sphere_already_running = true;
 
+	// From now on this thread only waits
+	ThreadPlacement::place(THREAD_ROLE_CONTROL, 0, ThreadPlacement::planProcessor(THREAD_ROLE_CONTROL, 0, Settings::getConfiguration()), Settings::getConfiguration()->thread_priorities);
+
 	VSphere->joinSphereThread(); // Join the inner thread of the VSphere. This function returns once the sphere has been closed.
 
 	delete(VSphere); // Call the destructor to free memmory
@@ -220,6 +296,8 @@ void startThreadedSphere()
 	addInfoLine("Finishing recordings.");
 	delete(recorder_set); // Call the destructor to free memmory
 
+	Settings::detachSphere(); // No thread of the sphere can hold a configuration anymore
+
 	addInfoLine("VSphere quitted succesfully.");
 
 	// Allow the system to restart
@@ -245,149 +323,407 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API  QuitSphere()
 
 
 /*
-Modify a series of settings.
-This simple but somewhat insecure method based on a string as a command is used to avoid dozens of functions.
-TODO: Change
+Change a setting of the running system.
+-- Arguments:
+control: One of the VSphereControl values (see PluginDataTypes.h)
+value: The new value (its meaning depends on the control)
+-- Returns:
+Whether the control and its value have been accepted.
 */
-extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetInternalData(char* data_element)
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetControl(int control, int value)
 {
-	string element = MakeStringCopy(data_element);
-
-	addInfoLine("Received command: " + element);
-	
-	if (element == "Full rays: true")
+	switch (control)
 	{
-		VSphere->setShowFullRays(true);
+	case CONTROL_SHOW_FULL_RAYS:
+		if (!sphere_already_running) return(false);
+		VSphere->setShowFullRays(value != 0);
 		return(true);
-	}
 
-	if (element == "Full rays: false")
-	{
-		VSphere->setShowFullRays(false);
+	case CONTROL_PREVIEW_TYPE:
+		if ((value < -2) || (value >= Settings::getMaxPreviewTypes())) break;
+		Settings::changePreviewType(value);
+		addInfoLine("Switched to preview type: " + Settings::getPreviewString());
 		return(true);
-	}
 
-	if (element == "Last preview type")
-	{
-		Settings::changePreviewType(-1);
-		addInfoLine("Switched to preview type: " + Settings::getPreviewString());
+	case CONTROL_PREVIEW_WINDOW_VARIANT:
+		if ((value < 0) || (value > 2)) break;
+		Settings::changePreviewWindowVariant(value);
+		if (sphere_already_running)
+			VSphere->initPreviewWindows();
+		addInfoLine(value == 0 ? "Disabled preview window." : "Enabled preview windows.");
 		return(true);
-	}
 
-	if (element == "Next preview type")
-	{
-		Settings::changePreviewType(-2);
-		addInfoLine("Switched to preview type: " + Settings::getPreviewString());
+	case CONTROL_PREVIEW_WINDOW_ORDER_OFFSET:
+		if ((value < -2) || (value >= camera_set->getCount())) break;
+		Settings::changePreviewWindowOrderOffset(value, camera_set->getCount());
+		addInfoLine("Changed preview window order offset.");
 		return(true);
 	}
 
+	addError("Control NOT RECOGNIZED! Control: " + to_string(control) + " Value: " + to_string(value));
+	return(false);
+}
 
-	for (int i = 0; i < Settings::getMaxPreviewTypes(); ++i)
-	{
-		if (element == "Preview type: " + to_string(i))
-		{
-			Settings::changePreviewType(i);
-			addInfoLine("Switched to preview type: " + Settings::getPreviewString());			
-			return(true);
-		}
-	}
-	
-	if (element == "Preview window variant: 0")
+/*
+Read a single value of the current state (one of the VSphereQuery values, see PluginDataTypes.h).
+Returns -1 for unknown queries.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetQuery(int query)
+{
+	switch (query)
 	{
-		Settings::changePreviewWindowVariant(0);
-		VSphere->initPreviewWindows();
-		addInfoLine("Disabled preview window.");
-		return(true);
+	case QUERY_IS_RUNNING: return(sphere_already_running ? 1 : 0);
+	case QUERY_CAMERA_COUNT: return(camera_set != nullptr ? camera_set->getCount() : 0);
+	case QUERY_PREVIEW_TYPE_COUNT: return(Settings::getMaxPreviewTypes());
+	case QUERY_PREVIEW_TYPE: return(Settings::getPreviewType());
+	case QUERY_PREVIEW_WINDOW_VARIANT: return(Settings::getPreviewWindowVariant());
+	case QUERY_PREVIEW_WINDOW_ORDER_OFFSET: return(Settings::getPreviewWindowOrderOffset());
+	case QUERY_SHOW_FULL_RAYS: return((sphere_already_running && VSphere->getShowFullRays()) ? 1 : 0);
+	case QUERY_MODEL_QUAD_COUNT: return(sphere_already_running ? VSphere->getSphereContentSize() / 20 : 0);
+	case QUERY_CONFIGURATION_GENERATION: return(Settings::getConfiguration() != nullptr ? Settings::getConfigurationGeneration() : -1);
 	}
 
-	if (element == "Preview window variant: 1")
-	{
-		Settings::changePreviewWindowVariant(1);
-		VSphere->initPreviewWindows();
-		addInfoLine("Enabled preview windows.");
-		return(true);
-	}
+	return(-1);
+}
+
+/*
+Fill the complete state of the sphere in a single call.
+*/
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetSphereState(SphereState* state)
+{
+	if (state == nullptr) return(false);
+
+	state->is_running = GetQuery(QUERY_IS_RUNNING);
+	state->camera_count = GetQuery(QUERY_CAMERA_COUNT);
+	state->preview_type = GetQuery(QUERY_PREVIEW_TYPE);
+	state->preview_type_count = GetQuery(QUERY_PREVIEW_TYPE_COUNT);
+	state->preview_window_variant = GetQuery(QUERY_PREVIEW_WINDOW_VARIANT);
+	state->preview_window_order_offset = GetQuery(QUERY_PREVIEW_WINDOW_ORDER_OFFSET);
+	state->show_full_rays = GetQuery(QUERY_SHOW_FULL_RAYS);
+	state->model_quad_count = GetQuery(QUERY_MODEL_QUAD_COUNT);
+
+	return(true);
+}
 
-	if (element == "Preview window variant: 2")
+/*
+Fill an array with the origin and size of all configured cameras.
+-- Arguments:
+infos: Array provided by the caller
+max_count: Number of elements in that array
+-- Returns:
+The number of elements written.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCameraInfos(CameraInfo* infos, int max_count)
+{
+	if ((camera_set == nullptr) || (infos == nullptr)) return(0);
+
+	int count = min(camera_set->getCount(), max_count);
+	for (int i = 0; i < count; ++i)
 	{
-		Settings::changePreviewWindowVariant(2);
-		VSphere->initPreviewWindows();
-		addInfoLine("Enabled preview windows.");
-		return(true);
+		CameraSource * source = camera_set->getCameraSource(i);
+		vector3df origin = source->getOrigin();
+		vector2di size = source->getSize();
+
+		infos[i].list_index = i;
+		infos[i].hardware_index = source->getIndex();
+		infos[i].channel = source->getChannel();
+		infos[i].origin_x = origin.X;
+		infos[i].origin_y = origin.Y;
+		infos[i].origin_z = origin.Z;
+		infos[i].width = size.X;
+		infos[i].height = size.Y;
+		infos[i].fps = source->getFps();
 	}
 
+	return(count);
+}
+
+/*
+Fill an array with the numbers of the last processed frame of every camera.
+Works like GetCameraInfos(). Returns 0 if the sphere is not running.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCameraStatistics(CameraStatistics* statistics, int max_count)
+{
+	if ((!sphere_already_running) || (statistics == nullptr)) return(0);
+
+	int count = min(camera_set->getCount(), max_count);
+	for (int i = 0; i < count; ++i)
+		VSphere->getCameraStatistics(i, &statistics[i]);
+
+	return(count);
+}
+
+/*
+Fill an array with the latency distribution of every stage (see VSphereLatencyStage): all stages of every camera, then those of the whole sphere.
+Recording them does not block the processing. Returns 0 if the sphere is not running.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetLatencyStatistics(LatencyStatistics* statistics, int max_count)
+{
+	if ((!sphere_already_running) || (statistics == nullptr)) return(0);
+
+	return(VSphere->getLatencyStatistics(statistics, max_count));
+}
+
+/*
+Start all latency histograms again.
+*/
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetLatencyStatistics()
+{
+	if (sphere_already_running)
+		VSphere->resetLatencyStatistics();
+}
+
+/*
+Fill an array with the placement of all threads of the sphere (processor, NUMA node, priority and executed tasks).
+Works like GetCameraInfos(). The threads of the last run are still reported after the sphere has quit.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetThreadPlacements(ThreadPlacementInfo* infos, int max_count)
+{
+	if (infos == nullptr) return(0);
 
-	if (element == "Last preview window order offset")
+	return(ThreadPlacement::getPlacements(infos, max_count));
+}
+
+/*
+Fill an array with the heap allocations of every thread in every stage (see VSphereAllocationStage; only entries with allocations).
+Only counted in builds with TRACK_ALLOCATIONS (see AllocationTracker.h), otherwise returns 0.
+After the first frames no processing stage should allocate anymore.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetAllocationStatistics(AllocationStatistics* statistics, int max_count)
+{
+	if (statistics == nullptr) return(0);
+
+	return(AllocationTracker::getStatistics(statistics, max_count));
+}
+
+/*
+Count the allocations from zero again.
+*/
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetAllocationStatistics()
+{
+	AllocationTracker::reset();
+}
+
+
+/*
+Change a value of the processing configuration (see VSphereConfigurationKey in PluginDataTypes.h).
+While the sphere is running, the change takes effect at the next frame boundary. Several changes before that are applied together.
+-- Returns:
+Whether the key exists and the value is valid.
+*/
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetConfigurationValue(int key, float value)
+{
+	if (Settings::getConfiguration() == nullptr) return(false); // PrepareSphere() not called yet
+
+	return(Settings::updateConfigurationValue(key, value));
+}
+
+/*
+Read a value of the active configuration (-1 for unknown keys).
+*/
+extern "C" float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetConfigurationValue(int key)
+{
+	if (Settings::getConfiguration() == nullptr) return(-1);
+
+	return(Settings::getConfigurationValue(key));
+}
+
+/*
+Load a configuration file (see PipelineConfiguration.cpp for the format). Keys not in the file keep their current value.
+Like SetConfigurationValue() the new values take effect at the next frame boundary.
+If the file contains any invalid line, nothing is changed.
+*/
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API LoadConfiguration(char* file_path)
+{
+	if ((Settings::getConfiguration() == nullptr) || (file_path == nullptr)) return(false);
+
+	if (!Settings::updateConfigurationFromFile(MakeStringCopy(file_path)))
 	{
-		Settings::changePreviewWindowOrderOffset(-1, camera_set->getCount());
-		addInfoLine("Changed preview window order offset.");
-		return(true);
+		addError("Configuration file not applied: " + MakeStringCopy(file_path));
+		return(false);
 	}
 
-	if (element == "Next preview window order offset")
+	addInfoLine("Loaded configuration file: " + MakeStringCopy(file_path));
+
+	return(true);
+}
+
+
+/*
+Compare the variants of the processing pipeline (see VSphereBenchmarkVariant) on a snapshot of the current frames of all cameras.
+Runs on the calling thread; the sphere keeps running meanwhile.
+-- Arguments:
+iterations: number of times every variant processes the snapshot
+results: array receiving one BenchmarkResult per variant
+max_count: size of that array
+-- Returns:
+Number of results written (0 if the sphere is not running or not initialized yet).
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RunPipelineBenchmark(int iterations, BenchmarkResult* results, int max_count)
+{
+	if ((!sphere_already_running) || (results == nullptr)) return(0);
+
+	PipelineBenchmark benchmark;
+
+	if (!VSphere->fillBenchmark(&benchmark))
 	{
-		Settings::changePreviewWindowOrderOffset(-2, camera_set->getCount());
-		addInfoLine("Changed preview window order offset.");
-		return(true);
+		addError("The pipeline benchmark requires all cameras to be initialized.");
+		return(0);
 	}
 
+	return(benchmark.run(iterations, results, max_count));
+}
 
-	for (int i = 0; i < camera_set->getCount(); ++i)
+/*
+Compare the variants of the processing pipeline on a synthetic scene of analytic shapes (see SyntheticScene) instead of the cameras.
+Does not require the sphere to run, only PrepareSphere(); the active configuration is used.
+-- Arguments:
+camera_count: number of cameras around the shapes (2 - 64)
+width, height: resolution of every camera (the scene covers the same space at every resolution, so stage costs can be compared between resolutions)
+complexity: number of shapes (1 - 64)
+iterations, results, max_count: like RunPipelineBenchmark()
+ground_truth: receives the volumes of the scene (may be nullptr)
+-- Returns:
+Number of results written.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RunSyntheticBenchmark(int camera_count, int width, int height, int complexity, int iterations, BenchmarkResult* results, int max_count, SyntheticGroundTruth* ground_truth)
+{
+	if ((Settings::getConfiguration() == nullptr) || (results == nullptr)) return(0); // PrepareSphere() not called yet
+
+	if ((camera_count < 2) || (camera_count > 64) || (width < 64) || (height < 64) || (complexity < 1) || (complexity > 64))
 	{
-		if (element == "Preview window order offset: " + to_string(i))
-		{
-			Settings::changePreviewWindowOrderOffset(i, camera_set->getCount());
-			addInfoLine("Changed preview window order offset.");
-			return(true);
-		}
+		addError("Invalid arguments for the synthetic benchmark.");
+		return(0);
 	}
 
-	addError("Command NOT RECOGNIZED! String: " + element);
+	addInfoLine("Rendering a synthetic scene of " + to_string(complexity) + " shapes for " + to_string(camera_count) + " cameras of " + to_string(width) + "x" + to_string(height) + " pixels.");
 
-	return(false);
+	SyntheticScene scene(camera_count, width, height, complexity, (int)Settings::getConfigurationValue(CONFIG_MAX_RAY_LENGTH));
+
+	if (ground_truth != nullptr)
+		scene.getGroundTruth(ground_truth);
+
+	PipelineBenchmark benchmark;
+	scene.fillBenchmark(&benchmark);
+
+	return(benchmark.run(iterations, results, max_count));
+}
+
+/*
+Compare the AVX2 path of the batched narrow phase with the scalar path on fixed rays (see CustomMath::check_narrow_phase_paths).
+Requires neither cameras nor PrepareSphere().
+-- Arguments:
+checked_pairs: receives the number of compared pairs of rays
+-- Returns:
+Number of pairs where the paths differ, -1 if the CPU does not support AVX2.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API CheckNarrowPhase(int* checked_pairs)
+{
+	int pairs = 0;
+	int mismatches = CustomMath::check_narrow_phase_paths(NARROW_PHASE_TOLERANCE, &pairs);
+
+	if (mismatches > 0)
+		addError("The AVX2 narrow phase differs from the scalar one in " + to_string(mismatches) + " of " + to_string(pairs) + " pairs!");
+
+	if (checked_pairs != nullptr)
+		*checked_pairs = pairs;
+
+	return(mismatches);
 }
 
 
 /*
-Modify a series of settings and data.
-This simple but somewhat insecure method based on a string as a command is used to avoid dozens of functions.
-TODO: Change
+Legacy variant of SetControl() based on a string as a command.
+It is kept for existing scripts; every string is mapped to the corresponding control.
 */
-extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetInternalData(char* data_element)
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetInternalData(char* data_element)
 {
-	string element = MakeStringCopy(data_element);
+	if (data_element == nullptr) return(false);
+
+	addInfoLine("Received command: " + MakeStringCopy(data_element));
 
-	if (element == "Is running")
-		return(sphere_already_running ? 1 : 0);
+	int value;
 
-	if (element == "Number of cameras")
-		return(camera_set->getCount());
+	if (strcmp(data_element, "Full rays: true") == 0)
+		return(SetControl(CONTROL_SHOW_FULL_RAYS, 1));
+	if (strcmp(data_element, "Full rays: false") == 0)
+		return(SetControl(CONTROL_SHOW_FULL_RAYS, 0));
 
-	if (element == "Number of preview modes")
-		return(Settings::getMaxPreviewTypes());
+	if (strcmp(data_element, "Last preview type") == 0)
+		return(SetControl(CONTROL_PREVIEW_TYPE, -1));
+	if (strcmp(data_element, "Next preview type") == 0)
+		return(SetControl(CONTROL_PREVIEW_TYPE, -2));
+	if (parseCommandValue(data_element, "Preview type: ", &value))
+		return(SetControl(CONTROL_PREVIEW_TYPE, value));
 
-	if (element == "Preview type")
-		return(Settings::getPreviewType());
+	if (parseCommandValue(data_element, "Preview window variant: ", &value))
+		return(SetControl(CONTROL_PREVIEW_WINDOW_VARIANT, value));
 
-	if (element == "Preview window order offset")
-		return(Settings::getPreviewWindowOrderOffset());
+	if (strcmp(data_element, "Last preview window order offset") == 0)
+		return(SetControl(CONTROL_PREVIEW_WINDOW_ORDER_OFFSET, -1));
+	if (strcmp(data_element, "Next preview window order offset") == 0)
+		return(SetControl(CONTROL_PREVIEW_WINDOW_ORDER_OFFSET, -2));
+	if (parseCommandValue(data_element, "Preview window order offset: ", &value))
+		return(SetControl(CONTROL_PREVIEW_WINDOW_ORDER_OFFSET, value));
 
+	addError("Command NOT RECOGNIZED! String: " + MakeStringCopy(data_element));
 
-	for (int i = 0; i < camera_set->getCount(); i++)
+	return(false);
+}
+
+
+/*
+Legacy variant of GetQuery() and GetCameraInfos() based on a string as a command.
+Returns -1 for unknown strings.
+*/
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetInternalData(char* data_element)
+{
+	if (data_element == nullptr) return(-1);
+
+	if (strcmp(data_element, "Is running") == 0)
+		return(GetQuery(QUERY_IS_RUNNING));
+	if (strcmp(data_element, "Number of cameras") == 0)
+		return(GetQuery(QUERY_CAMERA_COUNT));
+	if (strcmp(data_element, "Number of preview modes") == 0)
+		return(GetQuery(QUERY_PREVIEW_TYPE_COUNT));
+	if (strcmp(data_element, "Preview type") == 0)
+		return(GetQuery(QUERY_PREVIEW_TYPE));
+	if (strcmp(data_element, "Preview window order offset") == 0)
+		return(GetQuery(QUERY_PREVIEW_WINDOW_ORDER_OFFSET));
+
+
+	// "Origin of camera <index>value X" and "Size of camera <index>value X"
+	bool origin = strncmp(data_element, "Origin of camera ", 17) == 0;
+	bool size = strncmp(data_element, "Size of camera ", 15) == 0;
+
+	if ((origin || size) && (camera_set != nullptr))
 	{
-		if (element == "Origin of camera " + to_string(i) + "value X")
-			return(camera_set->getCameraSource(i)->getOrigin().X);
-		if (element == "Origin of camera " + to_string(i) + "value Y")
-			return(camera_set->getCameraSource(i)->getOrigin().Y);
-		if (element == "Origin of camera " + to_string(i) + "value Z")
-			return(camera_set->getCameraSource(i)->getOrigin().Z);
-
-		if (element == "Size of camera " + to_string(i) + "value X")
-			return(camera_set->getCameraSource(i)->getSize().X);
-		if (element == "Size of camera " + to_string(i) + "value Y")
-			return(camera_set->getCameraSource(i)->getSize().Y);
+		const char * number = data_element + (origin ? 17 : 15);
+		char * rest;
+		long index = strtol(number, &rest, 10);
+
+		if ((rest != number) && (index >= 0) && (index < camera_set->getCount()) && (strncmp(rest, "value ", 6) == 0))
+		{
+			CameraSource * source = camera_set->getCameraSource(index);
+
+			char axis = rest[6];
+			if (origin)
+			{
+				if (axis == 'X') return(source->getOrigin().X);
+				if (axis == 'Y') return(source->getOrigin().Y);
+				if (axis == 'Z') return(source->getOrigin().Z);
+			}
+			else
+			{
+				if (axis == 'X') return(source->getSize().X);
+				if (axis == 'Y') return(source->getSize().Y);
+			}
+		}
 	}
 
+	addError("Data element NOT RECOGNIZED! String: " + MakeStringCopy(data_element));
+
+	return(-1);
 }
 
 
@@ -406,6 +742,8 @@ extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRequiredTextureWidt
 		return(0);
 	}
 
+	camera_set->negotiateModes(recorder_set); // The texture is sized from the resolutions the cameras deliver
+
 	int width = 0;
 	for (int i = 0; i < camera_set->getCount(); ++i)
 		width += camera_set->getCameraSource(i)->getSize().X; // Todo: Currently all cameras are aligned horizintally. They should be changed to a square pattern
@@ -425,7 +763,11 @@ extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRequiredTextureHeig
 		return(0);
 	}
 
-	int height = camera_set->getCameraSource(0)->getSize().Y;  // Todo: Currently all cameras are aligned horizontally. They should be changed to a square pattern
+	camera_set->negotiateModes(recorder_set);
+
+	int height = 0;
+	for (int i = 0; i < camera_set->getCount(); ++i)
+		height = max(height, camera_set->getCameraSource(i)->getSize().Y);  // Todo: Currently all cameras are aligned horizontally. They should be changed to a square pattern
 	return(roundToNextPotency(height, 2));
 }
 
@@ -478,6 +820,8 @@ Value 4-6: X, Y and Z coordinate of the second point multiplicated by 1000
 Value 7-9: X, Y and Z coordinate of the third point multiplicated by 1000
 Value 10-12: X, Y and Z coordinate of the fourth point multiplicated by 1000
 Value 13-20: U and V coordinates for every point in pairs of two.
+
+Until EndRetrievingModel() the sequence number and the capture timestamps of this model are available through GetModelTiming().
 */
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartRetrievingModel(int** quadsData, int* quadsCount)
 {
@@ -504,6 +848,78 @@ extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API EndRetrievingModel()
 	return true;
 }
 
+/*
+Retrieve the closed triangle mesh of the model (configuration keys surface_mesh and reconstruction_engine = voxels).
+Only valid between StartRetrievingModel() and EndRetrievingModel(); it is made of the same voxels as the quads.
+-- Arguments:
+verticesData: pointer to an array of INTs with 5 values per vertex: X, Y and Z multiplicated by 100 (like the quads), U and V
+verticesCount: pointer to a single int telling the number of vertices
+indicesData: pointer to an array of INTs with 3 vertex numbers per triangle; neighboring triangles share their vertices
+indicesCount: pointer to a single int telling the number of triangles
+
+Returns false if the model has no mesh.
+*/
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetModelMesh(int** verticesData, int* verticesCount, int** indicesData, int* indicesCount)
+{
+	if (!sphere_already_running) return(false);
+
+	vector<int> * vertices = VSphere->getMeshVertices();
+	vector<int> * indices = VSphere->getMeshIndices();
+
+	*verticesData = vertices->data();
+	*verticesCount = vertices->size() / 5;
+	*indicesData = indices->data();
+	*indicesCount = indices->size() / 3;
+
+	return(!indices->empty());
+}
+
+/*
+Retrieve a coarser level of detail of the model (configuration key detail_levels, see ModelDetailLevels).
+Only valid between StartRetrievingModel() and EndRetrievingModel(); it is made of the same quads as the model, joined along the contours.
+-- Arguments:
+level: 0 = the full model (like StartRetrievingModel()), 1 to detail_levels = up to 2^level quads joined into one
+quadsData: pointer to an array of INTs with the quads in the format of StartRetrievingModel() (the same texture)
+quadsCount: pointer to a single int telling the number of quads
+
+Returns false if the level has not been computed for this model.
+*/
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetModelLevel(int level, int** quadsData, int* quadsCount)
+{
+	if ((!sphere_already_running) || (quadsData == nullptr) || (quadsCount == nullptr)) return(false);
+
+	vector<int> * quads = VSphere->getModelLevel(level);
+	if (quads == nullptr) return(false);
+
+	*quadsData = quads->data();
+	*quadsCount = quads->size() / 20;
+
+	return(true);
+}
+
+/*
+Retrieve the sequence number and the timing of the model (see ModelTiming).
+Called between StartRetrievingModel() and EndRetrievingModel() it belongs to exactly the retrieved model.
+The age of the model when it is used is GetSphereTime() - capture_us.
+*/
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetModelTiming(ModelTiming* timing)
+{
+	if ((!sphere_already_running) || (timing == nullptr)) return(false);
+
+	VSphere->getModelTiming(timing);
+	return(timing->sequence > 0);
+}
+
+/*
+Current time of the clock of ModelTiming::capture_us in microseconds.
+*/
+extern "C" long long UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetSphereTime()
+{
+	if (!sphere_already_running) return(0);
+
+	return(VSphere->getSphereTime());
+}
+
 
 
 
@@ -530,10 +946,24 @@ void ClearScreen()
 
 // Transforms external char data to a string
 string MakeStringCopy(const char* str) {
-	if (str == NULL) return NULL;
-	char* res = (char*)malloc(strlen(str) + 1);
-	strcpy(res, str);
-	return(String(res));
+	if (str == NULL) return("");
+	return(string(str));
+}
+
+// Checks whether the command starts with the prefix followed by an integer and nothing else
+bool parseCommandValue(const char* command, const char* prefix, int* value)
+{
+	size_t length = strlen(prefix);
+	if (strncmp(command, prefix, length) != 0) return(false);
+
+	const char * number = command + length;
+	char * rest;
+	long parsed = strtol(number, &rest, 10);
+
+	if ((rest == number) || (*rest != '\0')) return(false);
+
+	*value = (int)parsed;
+	return(true);
 }
 
 // Rounds to the next given potency (required to have textures of 2^X size)
@@ -0,0 +1,597 @@
+/*
+Reconstruction engine which carves the visual hull out of a sparse octree instead of intersecting the rays of the cameras
+(configuration key reconstruction_engine, see VSphereReconstructionEngine). It is shared by all cameras of a sphere.
+
+The octree spans a cube around the point the optical axes of the cameras meet, large enough for the view of every camera.
+A cube is projected into every camera; the box around its projection is looked up in a summed area table of the foreground
+pixels of the binary mask of the camera:
+	no foreground pixel		The cube is outside the silhouette and is carved away (with all its children)
+	only foreground pixels	The cube is inside the silhouette; its children are not tested against this camera again
+	otherwise				The cube is divided into 8 children (adaptive; only cubes crossing a silhouette are divided)
+Cubes inside the silhouettes of all cameras become leaves. On the finest level (2^voxel_depth voxels per axis) a cube
+is decided by the pixel its center is seen in. The cameras are orthographic, so a cube is projected in two dot products.
+
+The cubes of the upper levels are distributed to slices which are carved independently (tasks of the FrameScheduler).
+Once all slices are carved, every slice emits the faces of its leaves which border empty voxels. Neighboring faces in
+a row of voxels are merged into one quad. The quads have the format of the ModelBuilder: four corners (times 100) in the order
+last_start, start, last_end, end, where (start - last_start) x (last_end - last_start) points out of the model,
+and their texture coordinates in the camera which looks most directly at the face.
+
+Input:
+	CameraSource		// Pose of every camera (see addCamera)
+	binary mask			// Of every camera and frame with the window it was computed in (see prepareCamera)
+
+Output:
+	output_content		// Quads of the model, split into one part per camera (see collectModelPart)
+*/
+
+#include "stdafx.h"
+
+#include "VoxelCarver.h"
+
+
+// Result of the projection of a cube into a camera
+#define CUBE_OUTSIDE 0
+#define CUBE_INSIDE 1
+#define CUBE_PARTIAL 2
+
+// Cameras tracked per cube in one bit each
+#define VOXEL_MAX_CAMERAS 64
+
+// Top level cubes per slice (more cubes balance the slices better, the cubes of the object are not evenly distributed)
+#define VOXEL_CUBES_PER_SLICE 8
+
+
+VoxelCarver::VoxelCarver(int slice_count)
+{
+	for (int s = 0; s < max(1, slice_count); ++s)
+		slices.push_back(new CarvingSlice());
+
+	for (int d = 0; d < 6; ++d)
+		face_cameras[d] = 0;
+}
+
+VoxelCarver::~VoxelCarver()
+{
+	for (int s = 0; s < slices.size(); ++s)
+		delete(slices[s]);
+
+	for (int c = 0; c < cameras.size(); ++c)
+		delete(cameras[c]);
+}
+
+
+/*
+Add a camera (in the order of the list of cameras). Call applyConfiguration() after the last one.
+*/
+void VoxelCarver::addCamera(CameraSource * camera_source, int tex_offs_x, int tex_offs_y)
+{
+	if (cameras.size() >= VOXEL_MAX_CAMERAS)
+	{
+		addError("The voxel carving supports at most " + to_string(VOXEL_MAX_CAMERAS) + " cameras.");
+		return;
+	}
+
+	CarvingCamera * camera = new CarvingCamera();
+
+	camera->camera_source = camera_source;
+	camera->width = camera_source->getSize().X;
+	camera->height = camera_source->getSize().Y;
+	camera->tex_offs_x = tex_offs_x;
+	camera->tex_offs_y = tex_offs_y;
+	camera->binary_mask = nullptr;
+
+	cameras.push_back(camera);
+}
+
+/*
+Take the values of a newly published configuration (called between frames). The grid is only placed again if its depth or the ray length changed.
+*/
+void VoxelCarver::applyConfiguration(PipelineConfiguration * configuration)
+{
+	if ((configuration->voxel_depth == depth) && (configuration->max_ray_length == max_ray_length))
+		return;
+
+	depth = configuration->voxel_depth;
+	max_ray_length = configuration->max_ray_length;
+
+	placeGrid();
+}
+
+
+/*
+Place the octree around the point closest to the optical axes of all cameras (least squares) and project it into every camera.
+*/
+void VoxelCarver::placeGrid()
+{
+	vector3df rows[3] = { vector3df(0, 0, 0), vector3df(0, 0, 0), vector3df(0, 0, 0) };
+	vector3df target(0, 0, 0), mean_target(0, 0, 0);
+	float half = max_ray_length / 2.0f;
+
+	if (!cameras.empty())
+		half = 0;
+
+	for (int c = 0; c < cameras.size(); ++c)
+	{
+		CameraSource * source = cameras[c]->camera_source;
+		vector3df forward = source->getDirection() * vector3df(0, 0, 1);
+		vector3df origin = source->getOrigin();
+
+		// Sum of the projections onto the planes perpendicular to the axes: (I - d * d^T)
+		vector3df axis_rows[3] = {
+			vector3df(1 - forward.X * forward.X, -forward.X * forward.Y, -forward.X * forward.Z),
+			vector3df(-forward.Y * forward.X, 1 - forward.Y * forward.Y, -forward.Y * forward.Z),
+			vector3df(-forward.Z * forward.X, -forward.Z * forward.Y, 1 - forward.Z * forward.Z) };
+
+		for (int r = 0; r < 3; ++r)
+			rows[r] += axis_rows[r];
+		target += vector3df(axis_rows[0].dotProduct(origin), axis_rows[1].dotProduct(origin), axis_rows[2].dotProduct(origin));
+		mean_target += (origin + forward * (max_ray_length / 2.0f)) / (float)cameras.size();
+
+		half = max(half, source->getPixelSize() * max(cameras[c]->width, cameras[c]->height) / 2);
+	}
+
+	// Cramer's rule (the matrix is symmetric); parallel axes have no common point
+	vector3df center = mean_target;
+	float determinant = rows[0].dotProduct(rows[1].crossProduct(rows[2]));
+
+	if (fabs(determinant) > 0.001f)
+		center = vector3df(target.dotProduct(rows[1].crossProduct(rows[2])),
+						   rows[0].dotProduct(target.crossProduct(rows[2])),
+						   rows[0].dotProduct(rows[1].crossProduct(target))) / determinant;
+
+	grid_size = 1 << depth;
+	grid_min = center - vector3df(half, half, half);
+	voxel_size = 2 * half / grid_size;
+
+	slice_level = 1;
+	while ((slice_level < depth - 1) && ((1 << (3 * slice_level)) < VOXEL_CUBES_PER_SLICE * (int)slices.size()))
+		slice_level++;
+
+	occupancy.assign(grid_size * grid_size * grid_size, 0);
+	for (int s = 0; s < slices.size(); ++s)
+	{
+		slices[s]->leaves.clear();
+		slices[s]->output.clear();
+	}
+
+	for (int c = 0; c < cameras.size(); ++c)
+	{
+		CarvingCamera * camera = cameras[c];
+		CameraSource * source = camera->camera_source;
+		quaternion direction = source->getDirection();
+
+		vector3df right = direction * vector3df(1, 0, 0);
+		vector3df up = direction * vector3df(0, 1, 0);
+		vector3df to_grid = grid_min - (source->getOrigin() + source->getToCorner());
+
+		camera->forward = direction * vector3df(0, 0, 1);
+
+		// Like SyntheticScene::project (y grows downwards in the image)
+		camera->grid_to_x = right * (voxel_size / source->getPixelSize());
+		camera->grid_to_y = up * (-voxel_size / source->getPixelSize());
+		camera->x_at_origin = to_grid.dotProduct(right) / source->getPixelSize();
+		camera->y_at_origin = -to_grid.dotProduct(up) / source->getPixelSize();
+
+		camera->x_extent_min = min(0.0f, camera->grid_to_x.X) + min(0.0f, camera->grid_to_x.Y) + min(0.0f, camera->grid_to_x.Z);
+		camera->x_extent_max = max(0.0f, camera->grid_to_x.X) + max(0.0f, camera->grid_to_x.Y) + max(0.0f, camera->grid_to_x.Z);
+		camera->y_extent_min = min(0.0f, camera->grid_to_y.X) + min(0.0f, camera->grid_to_y.Y) + min(0.0f, camera->grid_to_y.Z);
+		camera->y_extent_max = max(0.0f, camera->grid_to_y.X) + max(0.0f, camera->grid_to_y.Y) + max(0.0f, camera->grid_to_y.Z);
+	}
+
+	// The faces of a direction take their texture from the camera looking most directly at them
+	for (int d = 0; d < 6; ++d)
+	{
+		float sign = (d % 2 == 1) ? 1.0f : -1.0f;
+		vector3df normal((d / 2 == 0) ? sign : 0, (d / 2 == 1) ? sign : 0, (d / 2 == 2) ? sign : 0);
+
+		float best = 2;
+		for (int c = 0; c < cameras.size(); ++c)
+		{
+			float facing = cameras[c]->forward.dotProduct(normal);
+			if (facing < best)
+			{
+				best = facing;
+				face_cameras[d] = c;
+			}
+		}
+	}
+
+	addInfoLine("Voxel carving on " + to_string(grid_size) + "^3 voxels of " + to_string(voxel_size) + " units (" + to_string(1 << (3 * slice_level)) + " cubes in " + to_string(slices.size()) + " slices).");
+}
+
+
+/*
+Count the foreground pixels of the mask of a camera in the window it was computed in (a task of the camera after its mask, see PerCamControler::processFrame).
+Pixels outside of the window count as background.
+*/
+void VoxelCarver::prepareCamera(int camera_index, bool * binary_mask, Rect window)
+{
+	CarvingCamera * camera = cameras[camera_index];
+	int table_width = window.width + 1;
+
+	camera->binary_mask = binary_mask;
+	camera->window = window;
+	camera->foreground_table.resize(table_width * (window.height + 1)); // Keeps its capacity for smaller windows
+
+	int * table = camera->foreground_table.data();
+	memset(table, 0, table_width * sizeof(int));
+
+	for (int r = 0; r < window.height; ++r)
+	{
+		int * row = table + (r + 1) * table_width;
+		int * above = row - table_width;
+		bool * mask = binary_mask + (window.y + r) * camera->width + window.x;
+		int sum = 0;
+
+		row[0] = 0;
+		for (int c = 0; c < window.width; ++c)
+		{
+			sum += !mask[c]; // true = background
+			row[c + 1] = above[c + 1] + sum;
+		}
+	}
+
+	camera->prepared = true;
+}
+
+
+/*
+Classify a cube (position and size in voxels) by the foreground pixels in the box around its projection.
+*/
+int VoxelCarver::classifyCube(CarvingCamera * camera, int x, int y, int z, int size)
+{
+	vector3df position((float)x, (float)y, (float)z);
+	float px = camera->grid_to_x.dotProduct(position) + camera->x_at_origin;
+	float py = camera->grid_to_y.dotProduct(position) + camera->y_at_origin;
+
+	int x0 = (int)floor(px + size * camera->x_extent_min), x1 = (int)floor(px + size * camera->x_extent_max);
+	int y0 = (int)floor(py + size * camera->y_extent_min), y1 = (int)floor(py + size * camera->y_extent_max);
+
+	Rect & window = camera->window;
+	int right = window.x + window.width - 1, bottom = window.y + window.height - 1;
+
+	if ((x1 < window.x) || (x0 > right) || (y1 < window.y) || (y0 > bottom))
+		return(CUBE_OUTSIDE);
+
+	bool clipped = (x0 < window.x) || (x1 > right) || (y0 < window.y) || (y1 > bottom);
+
+	x0 = max(x0, window.x) - window.x;
+	y0 = max(y0, window.y) - window.y;
+	x1 = min(x1, right) - window.x + 1;
+	y1 = min(y1, bottom) - window.y + 1;
+
+	int table_width = window.width + 1;
+	int * table = camera->foreground_table.data();
+	int count = table[y1 * table_width + x1] - table[y0 * table_width + x1] - table[y1 * table_width + x0] + table[y0 * table_width + x0];
+
+	if (count == 0)
+		return(CUBE_OUTSIDE);
+	if (!clipped && (count == (x1 - x0) * (y1 - y0)))
+		return(CUBE_INSIDE);
+	return(CUBE_PARTIAL);
+}
+
+/*
+Whether a position of the grid (in voxels) is seen in a foreground pixel.
+*/
+bool VoxelCarver::pointInside(CarvingCamera * camera, vector3df position)
+{
+	int px = (int)floor(camera->grid_to_x.dotProduct(position) + camera->x_at_origin);
+	int py = (int)floor(camera->grid_to_y.dotProduct(position) + camera->y_at_origin);
+
+	if (!camera->window.contains(Point(px, py)))
+		return(false);
+
+	return(!camera->binary_mask[py * camera->width + px]);
+}
+
+/*
+Carve a cube against the cameras which have not seen it inside their silhouette yet (one bit per camera) and divide it where required.
+*/
+void VoxelCarver::carveCube(CarvingSlice * slice, int x, int y, int z, int level, unsigned long long undecided)
+{
+	slice->nodes++;
+
+	int size = grid_size >> level;
+
+	for (int c = 0; c < cameras.size(); ++c)
+		if (undecided & (1ULL << c))
+		{
+			int state = classifyCube(cameras[c], x, y, z, size);
+
+			if (state == CUBE_OUTSIDE)
+				return;
+			if (state == CUBE_INSIDE)
+				undecided &= ~(1ULL << c);
+		}
+
+	if ((undecided != 0) && (level < depth))
+	{
+		int half = size / 2;
+		for (int child = 0; child < 8; ++child)
+			carveCube(slice, x + (child & 1) * half, y + ((child >> 1) & 1) * half, z + ((child >> 2) & 1) * half, level + 1, undecided);
+		return;
+	}
+
+	// A single voxel on the silhouette of a camera
+	for (int c = 0; (c < cameras.size()) && (undecided != 0); ++c)
+		if ((undecided & (1ULL << c)) && !pointInside(cameras[c], vector3df(x + 0.5f, y + 0.5f, z + 0.5f)))
+			return;
+
+	VoxelLeaf leaf = { x, y, z, size };
+	slice->leaves.push_back(leaf);
+}
+
+/*
+Write a value into the occupancy of all voxels of the leaves of a slice.
+*/
+void VoxelCarver::markLeaves(CarvingSlice * slice, unsigned char value)
+{
+	for (int l = 0; l < slice->leaves.size(); ++l)
+	{
+		VoxelLeaf & leaf = slice->leaves[l];
+
+		for (int z = leaf.z; z < leaf.z + leaf.size; ++z)
+			for (int y = leaf.y; y < leaf.y + leaf.size; ++y)
+				memset(&occupancy[(z * grid_size + y) * grid_size + leaf.x], value, leaf.size);
+	}
+}
+
+
+/*
+Carve the cubes of a slice for the current masks (a task of the FrameScheduler after all cameras prepared their masks).
+The slices only write the voxels of their own cubes, so they can run at the same time.
+*/
+void VoxelCarver::carveSlice(int slice_index)
+{
+	CarvingSlice * slice = slices[slice_index];
+
+	markLeaves(slice, 0);
+	slice->leaves.clear();
+	slice->nodes = 0;
+
+	// Cameras which failed to open have no mask and do not carve
+	unsigned long long undecided = 0;
+	for (int c = 0; c < cameras.size(); ++c)
+		if (cameras[c]->prepared)
+			undecided |= (1ULL << c);
+
+	if ((undecided == 0) || (grid_size == 0))
+		return;
+
+	int cubes_per_axis = 1 << slice_level;
+	int cube_size = grid_size >> slice_level;
+	int cube_count = cubes_per_axis * cubes_per_axis * cubes_per_axis;
+
+	for (int t = slice_index; t < cube_count; t += slices.size())
+		carveCube(slice, (t % cubes_per_axis) * cube_size, ((t / cubes_per_axis) % cubes_per_axis) * cube_size, (t / (cubes_per_axis * cubes_per_axis)) * cube_size, slice_level, undecided);
+
+	markLeaves(slice, 1);
+}
+
+
+bool VoxelCarver::isOccupied(int x, int y, int z)
+{
+	if ((x < 0) || (y < 0) || (z < 0) || (x >= grid_size) || (y >= grid_size) || (z >= grid_size))
+		return(false);
+
+	return(occupancy[(z * grid_size + y) * grid_size + x] != 0);
+}
+
+/*
+Emit the faces of the leaves of a slice which border empty voxels (a task of the FrameScheduler after all slices are carved).
+*/
+void VoxelCarver::extractSlice(int slice_index)
+{
+	CarvingSlice * slice = slices[slice_index];
+	slice->output.clear();
+
+	for (int l = 0; l < slice->leaves.size(); ++l)
+	{
+		VoxelLeaf & leaf = slice->leaves[l];
+		int position[3] = { leaf.x, leaf.y, leaf.z };
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// The face spans the two other axes in cyclic order, so u x v points along the axis
+			int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+			for (int positive = 0; positive < 2; ++positive)
+			{
+				int plane = position[axis] + (positive ? leaf.size : 0);
+				int cell[3];
+				cell[axis] = positive ? plane : plane - 1;
+
+				// At the border of the grid the whole face is exposed
+				if ((cell[axis] < 0) || (cell[axis] >= grid_size))
+				{
+					addFaceQuad(slice, axis, positive != 0, plane, position[u], position[u] + leaf.size, position[v], position[v] + leaf.size);
+					continue;
+				}
+
+				for (cell[v] = position[v]; cell[v] < position[v] + leaf.size; ++cell[v])
+				{
+					int run_start = -1;
+
+					for (cell[u] = position[u]; cell[u] <= position[u] + leaf.size; ++cell[u])
+					{
+						bool exposed = (cell[u] < position[u] + leaf.size) && !isOccupied(cell[0], cell[1], cell[2]);
+
+						if (exposed && (run_start == -1))
+							run_start = cell[u];
+						else if (!exposed && (run_start != -1))
+						{
+							addFaceQuad(slice, axis, positive != 0, plane, run_start, cell[u], cell[v], cell[v] + 1);
+							run_start = -1;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+/*
+Add a face of voxels (the plane along the axis and the ranges along the two other axes, in voxels) as a quad with its texture coordinates.
+*/
+void VoxelCarver::addFaceQuad(CarvingSlice * slice, int axis, bool positive, int plane, int u0, int u1, int v0, int v1)
+{
+	int u = (axis + 1) % 3, v = (axis + 2) % 3;
+
+	// The faces in the negative direction run along u backwards, so all quads turn the same way seen from outside
+	if (!positive)
+		swap(u0, u1);
+
+	float corners[4][3];
+	const int corner_u[4] = { u0, u1, u0, u1 }, corner_v[4] = { v0, v0, v1, v1 }; // last_start, start, last_end, end
+
+	for (int k = 0; k < 4; ++k)
+	{
+		corners[k][axis] = (float)plane;
+		corners[k][u] = (float)corner_u[k];
+		corners[k][v] = (float)corner_v[k];
+	}
+
+	for (int k = 0; k < 4; ++k)
+	{
+		vector3df position = grid_min + vector3df(corners[k][0], corners[k][1], corners[k][2]) * voxel_size;
+
+		slice->output.push_back((int)(position.X * (float)100));
+		slice->output.push_back((int)(position.Y * (float)100));
+		slice->output.push_back((int)(position.Z * (float)100));
+	}
+
+	CarvingCamera * camera = cameras[face_cameras[axis * 2 + (positive ? 1 : 0)]];
+
+	for (int k = 0; k < 4; ++k)
+	{
+		int tex_u, tex_v;
+		projectTexture(camera, vector3df(corners[k][0], corners[k][1], corners[k][2]), &tex_u, &tex_v);
+
+		slice->output.push_back(tex_u);
+		slice->output.push_back(tex_v);
+	}
+}
+
+/*
+Texture coordinates of a position of the grid in the frame of a camera (limited to the frame, so they stay inside its part of the texture).
+*/
+void VoxelCarver::projectTexture(CarvingCamera * camera, vector3df position, int * u, int * v)
+{
+	int tx = (int)(camera->grid_to_x.dotProduct(position) + camera->x_at_origin);
+	int ty = (int)(camera->grid_to_y.dotProduct(position) + camera->y_at_origin);
+
+	*u = min(max(tx, 0), camera->width - 1) + camera->tex_offs_x;
+	*v = min(max(ty, 0), camera->height - 1) + camera->tex_offs_y;
+}
+
+
+/*
+Gather the quads of the slices of a camera: camera c takes the slices c, c + camera count and so on,
+so the model of the sphere is still the union of the content of all cameras.
+*/
+void VoxelCarver::collectModelPart(int part, vector<int> * output_content)
+{
+	output_content->clear();
+
+	for (int s = part; s < slices.size(); s += max(1, (int)cameras.size()))
+		output_content->insert(output_content->end(), slices[s]->output.begin(), slices[s]->output.end());
+}
+
+
+int VoxelCarver::getSliceCount()
+{
+	return(slices.size());
+}
+
+/*
+Cubes tested in the last frame (all slices).
+*/
+int VoxelCarver::getNodeCount()
+{
+	int count = 0;
+	for (int s = 0; s < slices.size(); ++s)
+		count += slices[s]->nodes;
+	return(count);
+}
+
+/*
+Cubes inside all silhouettes in the last frame (all slices).
+*/
+int VoxelCarver::getLeafCount()
+{
+	int count = 0;
+	for (int s = 0; s < slices.size(); ++s)
+		count += slices[s]->leaves.size();
+	return(count);
+}
+
+
+int VoxelCarver::getGridSize()
+{
+	return(grid_size);
+}
+
+/*
+Leaves of a slice in the last frame.
+*/
+vector<VoxelLeaf> * VoxelCarver::getLeaves(int slice)
+{
+	return(&slices[slice]->leaves);
+}
+
+/*
+The slice a voxel belongs to: the one carving the top level cube it lies in.
+*/
+int VoxelCarver::getVoxelSlice(int x, int y, int z)
+{
+	int cubes_per_axis = 1 << slice_level;
+	int cube_size = grid_size >> slice_level;
+
+	return((((z / cube_size) * cubes_per_axis + (y / cube_size)) * cubes_per_axis + (x / cube_size)) % slices.size());
+}
+
+/*
+Whether a position of the grid (in voxels) is inside the silhouettes of all cameras with a mask.
+*/
+bool VoxelCarver::insideHull(vector3df position)
+{
+	for (int c = 0; c < cameras.size(); ++c)
+		if (cameras[c]->prepared && !pointInside(cameras[c], position))
+			return(false);
+
+	return(true);
+}
+
+vector3df VoxelCarver::gridToWorld(vector3df position)
+{
+	return(grid_min + position * voxel_size);
+}
+
+/*
+Texture coordinates of a position of the grid in the camera which looks most directly at a surface with the given normal.
+*/
+void VoxelCarver::projectTexture(vector3df position, vector3df normal, int * u, int * v)
+{
+	CarvingCamera * best = nullptr;
+	float best_facing = 2;
+
+	for (int c = 0; c < cameras.size(); ++c)
+	{
+		float facing = cameras[c]->forward.dotProduct(normal);
+		if (cameras[c]->prepared && (facing < best_facing))
+		{
+			best_facing = facing;
+			best = cameras[c];
+		}
+	}
+
+	if (best == nullptr)
+	{
+		*u = *v = 0;
+		return;
+	}
+
+	projectTexture(best, position, u, v);
+}
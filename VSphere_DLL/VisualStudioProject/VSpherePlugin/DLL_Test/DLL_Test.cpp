@@ -68,6 +68,11 @@ int main()
 			printf("could not locate the function");
 		}
 
+		func_bool_arg_str_int ConfigureModelRecord = (func_bool_arg_str_int)GetProcAddress(hGetProcIDDLL, "ConfigureModelRecord");
+		if (!ConfigureModelRecord) {
+			printf("could not locate the function");
+		}
+
 		func_arg_intptrptr_intptr StartRetrievingModel = (func_arg_intptrptr_intptr)GetProcAddress(hGetProcIDDLL, "StartRetrievingModel");
 		if (!StartRetrievingModel) {
 			printf("could not locate the function");
@@ -77,6 +82,26 @@ int main()
 		if (!EndRetrievingModel) {
 			printf("could not locate the function");
 		}
+
+		func_bool_arg_int_intptrptr_intptr GetModelLevel = (func_bool_arg_int_intptrptr_intptr)GetProcAddress(hGetProcIDDLL, "GetModelLevel");
+		if (!GetModelLevel) {
+			printf("could not locate the function");
+		}
+
+		func_int_arg_int_benchptr_int RunPipelineBenchmark = (func_int_arg_int_benchptr_int)GetProcAddress(hGetProcIDDLL, "RunPipelineBenchmark");
+		if (!RunPipelineBenchmark) {
+			printf("could not locate the function");
+		}
+
+		func_int_arg_5int_benchptr_int_truthptr RunSyntheticBenchmark = (func_int_arg_5int_benchptr_int_truthptr)GetProcAddress(hGetProcIDDLL, "RunSyntheticBenchmark");
+		if (!RunSyntheticBenchmark) {
+			printf("could not locate the function");
+		}
+
+		func_int_arg_intptr CheckNarrowPhase = (func_int_arg_intptr)GetProcAddress(hGetProcIDDLL, "CheckNarrowPhase");
+		if (!CheckNarrowPhase) {
+			printf("could not locate the function");
+		}
 			
 		/* ---------- */
 
@@ -87,6 +112,70 @@ int main()
 		PrepareSphere(true, 33); // Prepare the sphere with enabled console (true) and 33ms standard delay between frames (this delay is only used when frames are read from files and not directly streamed)
 
 
+		// Compare the AVX2 and the scalar narrow phase of the ray intersection on fixed rays (no cameras or records required)
+		bool run_narrow_phase_check = true;
+
+		if (run_narrow_phase_check)
+		{
+			int pairs;
+			int mismatches = CheckNarrowPhase(&pairs);
+
+			if (mismatches < 0)
+				printf("--- DLL TEST --- NARROW PHASE: NO AVX2, ONLY THE SCALAR PATH IS USED\n");
+			else
+				printf("--- DLL TEST --- NARROW PHASE: %d OF %d PAIRS DIFFER BETWEEN AVX2 AND SCALAR\n", mismatches, pairs);
+		}
+
+
+		// Set to true to measure how the pipeline scales with the number of cameras on synthetic scenes (no cameras or records required)
+		bool run_synthetic_benchmark = false;
+
+		if (run_synthetic_benchmark)
+		{
+			const int camera_counts[] = { 2, 4, 6, 8, 10, 12 };
+
+			for (int c = 0; c < 6; ++c)
+			{
+				BenchmarkResult results[10];
+				SyntheticGroundTruth truth;
+				int count = RunSyntheticBenchmark(camera_counts[c], 640, 480, 4, 20, results, 10, &truth);
+
+				printf("--- DLL TEST --- SYNTHETIC SCENE: %d cameras, %d shapes, visual hull overlap %f\n", truth.camera_count, truth.shape_count, truth.volume_overlap);
+				for (int i = 0; i < count; ++i)
+					printf("--- DLL TEST --- SYNTHETIC VARIANT %d: %d quads, %f ms per frame, precision %f, coverage %f, coarsest level %d quads (precision %f) in %f ms\n",
+						results[i].variant, results[i].quads, results[i].frame_ms, results[i].model_precision, results[i].model_coverage,
+						results[i].detail_quads, results[i].detail_precision, results[i].detail_ms);
+
+				// Rays of the shared pairs against the voxel carving
+				if (count >= 9)
+					printf("--- DLL TEST --- RAYS VS VOXELS, %d cameras: %f ms / %f ms, coverage %f / %f\n", truth.camera_count,
+						results[5].intersection_ms + results[5].quad_ms, results[8].intersection_ms + results[8].quad_ms, results[5].model_coverage, results[8].model_coverage);
+
+				if (count == 10)
+					printf("--- DLL TEST --- RAYS VS POLYHEDRAL HULL, %d cameras: %f ms / %f ms, precision %f / %f\n", truth.camera_count,
+						results[5].intersection_ms + results[5].quad_ms, results[9].intersection_ms + results[9].quad_ms, results[5].model_precision, results[9].model_precision);
+			}
+		}
+
+		// Set to true to compare the cost of the stages at the resolutions of the cameras (to choose the mode of every camera, see ConfigureCameraMode)
+		bool run_resolution_benchmark = false;
+
+		if (run_resolution_benchmark)
+		{
+			const int resolutions[][2] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 } };
+
+			for (int r = 0; r < 3; ++r)
+			{
+				BenchmarkResult results[10];
+				int count = RunSyntheticBenchmark(4, resolutions[r][0], resolutions[r][1], 4, 20, results, 10, nullptr);
+
+				for (int i = 0; i < count; ++i)
+					printf("--- DLL TEST --- %dx%d VARIANT %d: %f ms per frame (segmentation %f, intersection %f, quads %f), %d rays\n",
+						resolutions[r][0], resolutions[r][1], results[i].variant, results[i].frame_ms, results[i].segmentation_ms, results[i].intersection_ms, results[i].quad_ms, results[i].rays);
+			}
+		}
+
+
 		// Prepare sample cameras (see the DLL for arguments)
 		int camA = ConfigureCamera(0, -1, 5,
 			1, 1, 320, // Root coordinate of the camera in space. It's orientation is always towards 0,0,0
@@ -104,6 +193,10 @@ int main()
 		ConfigureRecordHandler(camA, (records_root_path + "TestRecordB" + to_string(camA)).c_str(), record_type);
 		ConfigureRecordHandler(camB, (records_root_path + "TestRecordB" + to_string(camB)).c_str(), record_type);
 
+		// Record the models, or play them without processing the cameras at all (to load test the consumers)
+		int model_record_type = 0; // 0: nothing; 1: Recording; 2: Playing;
+		ConfigureModelRecord((records_root_path + "TestModels").c_str(), model_record_type);
+
 
 
 		StartSphere(1, 9); /* Start the sphere with the a combined preview window (2 = combined; 1 = separated)
@@ -122,6 +215,12 @@ int main()
 						   */
 
 
+		// Set to true to compare the pipeline variants (merged and unmerged edges, intersection engines) once after the first model frames
+		// Build Release-TrackAllocations to have heap allocations in the steady frames reported as errors
+		bool run_benchmark = false;
+		int model_frames = 0;
+
+
 		while (true)
 		{
 			if (CheckNewModel()) // If a new model is ready to be transfered
@@ -155,7 +254,37 @@ int main()
 
 				printf("RETRIEVED COORDINATES OF %d QUADS!\n", quads);
 
+				// The coarser levels of detail of the same model (configuration key detail_levels)
+				int level_quads;
+				int * level_data;
+				for (int level = 1; GetModelLevel(level, &level_data, &level_quads); ++level)
+					printf("--- DLL TEST --- LEVEL OF DETAIL %d: %d QUADS\n", level, level_quads);
+
 				EndRetrievingModel(); // End retrieving model (unlocks the output data)
+
+				if (run_benchmark && (++model_frames == 50))
+				{
+					BenchmarkResult results[10];
+					int count = RunPipelineBenchmark(100, results, 10);
+
+					for (int i = 0; i < count; ++i)
+						printf("--- DLL TEST --- BENCHMARK VARIANT %d: %d rays, %d intersections, %d quads, %f ms per frame (segmentation %f ms, intersection %f ms, quads %f ms), model hash %08x\n",
+							results[i].variant, results[i].rays, results[i].intersections, results[i].quads,
+							results[i].frame_ms, results[i].segmentation_ms, results[i].intersection_ms, results[i].quad_ms, results[i].output_hash);
+
+					if (count >= 7)
+						printf("--- DLL TEST --- REGION OF INTEREST: %f of the pixels, %d hits, %d misses\n", results[6].roi_pixel_share, results[6].roi_hits, results[6].roi_misses);
+
+					if (count >= 8)
+						printf("--- DLL TEST --- PYRAMID SEGMENTATION: %f of the pixels at full resolution\n", results[7].fine_pixel_share);
+
+					if (count >= 9)
+						printf("--- DLL TEST --- VOXEL CARVING: %d cubes tested, %d leaves, mesh of %d vertices and %d triangles (%d open edges) in %f ms\n", results[8].octree_nodes, results[8].octree_leaves,
+							results[8].mesh_vertices, results[8].mesh_triangles, results[8].mesh_open_edges, results[8].mesh_ms);
+
+					if (count == 10)
+						printf("--- DLL TEST --- POLYHEDRAL HULL: %d silhouette crossings, %d quads\n", results[9].hull_crossings, results[9].quads);
+				}
 			}
 
 			// Additional delay if desired
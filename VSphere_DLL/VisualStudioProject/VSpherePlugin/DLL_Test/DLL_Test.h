@@ -2,6 +2,8 @@
 
 #include "stdafx.h"
 
+#include "../../../Source/Header Files/PluginDataTypes.h"
+
 typedef void(__stdcall *func)();
 typedef bool(__stdcall *func_bool)();
 typedef int(__stdcall *func_int)();
@@ -9,7 +11,12 @@ typedef void(__stdcall *func_arg_int_int)(int, int);
 typedef void(__stdcall *func_arg_bool_int)(bool, int);
 typedef int(__stdcall *func_int_arg_9int)(int, int, int, int, int, int, int, int, int);
 typedef void(__stdcall *func_arg_int_str_int)(int, const char*, int);
+typedef bool(__stdcall *func_bool_arg_str_int)(const char*, int);
 typedef void(__stdcall *func_arg_intptrptr_intptr)(int**, int*);
+typedef bool(__stdcall *func_bool_arg_int_intptrptr_intptr)(int, int**, int*);
+typedef int(__stdcall *func_int_arg_int_benchptr_int)(int, BenchmarkResult*, int);
+typedef int(__stdcall *func_int_arg_5int_benchptr_int_truthptr)(int, int, int, int, int, BenchmarkResult*, int, SyntheticGroundTruth*);
+typedef int(__stdcall *func_int_arg_intptr)(int*);
 
 int main();
 